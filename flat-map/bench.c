@@ -0,0 +1,1089 @@
+// bench.c
+// Benchmarks for the flat map.
+//
+// The churn benchmark fills the map to a steady-state population,
+// after which each round removes a random resident key and inserts a
+// fresh one. Over time, this churn degrades the clustering of a linear
+// probing table (which accumulates tombstones until the next resize)
+// but not that of a robin hood table; the benchmark reports the latency
+// percentiles of lookups for both resident and absent keys under each
+// probing scheme. When the map is built with statistics (`make STATS=1
+// bench`), it also reports the percentiles of the probe length of
+// lookups of resident and absent keys in the churned table.
+//
+// The layout benchmark measures the throughput of a read-mostly
+// workload issued by several threads against each table layout,
+// across a range of page sizes.
+//
+// The load benchmark measures the time to populate a map from
+// scratch, inserting keys one at a time into a map that grows from
+// its default capacity and into one sized in advance, and loading
+// all of the keys at once with flat_map_bulk_load().
+//
+// The resize benchmark populates a map under the blocking resize
+// policy with an increasing number of resize threads, and reports
+// the longest stall of a single insert, which is that of the final
+// (largest) resize.
+//
+// The typed benchmark compares lookups of small values stored by
+// pointer in a flat_map against those stored by value in a map
+// generated by FLAT_MAP_DEFINE().
+//
+// The memory benchmark measures random lookups in a large map whose
+// table is allocated from the heap and mapped with huge pages.
+//
+// The snapshot benchmark compares the time to restore a populated
+// map by reinserting each key against that to open a snapshot of it
+// with flat_map_open_mapped(), for values stored inline and in a blob.
+//
+// The aggregate benchmark counts the occurrences of random keys,
+// comparing a lookup followed by an insert of the incremented count
+// against a single flat_map_compute() per key.
+//
+// The lock benchmark measures the throughput of updates to resident
+// keys, each of which takes a page lock, for each kind of page lock
+// across a matrix of page sizes and thread counts. Lookups are not
+// measured, as they read pages optimistically regardless of the kind.
+//
+// The reclaim benchmark runs a read-mostly workload whose updates
+// replace heap-allocated values that readers dereference, comparing
+// a map under immediate reclamation, made safe by a mutex around
+// every operation, against a map under deferred reclamation whose
+// readers delimit each lookup with flat_map_enter() and _leave().
+//
+// The dense benchmark populates a map to just over 0.85 of a table
+// of 2^20 cells under each probing scheme and reports the memory in
+// use, which doubles for the schemes that resize at a load of 0.75,
+// along with the latency percentiles of lookups.
+//
+// The sweep benchmark visits every key of a large map with an iterator
+// and with flat_map_parallel_for_each() across a range of thread
+// counts, while another thread inserts keys into the map.
+//
+// The NUMA benchmark runs the read-mostly workload of the layout
+// benchmark against a map under each NUMA placement policy. On a
+// machine with a single node, it measures only the overhead of the
+// policy: binding the table and, for replicas, copying every updated
+// page to each of them.
+
+#define _GNU_SOURCE
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <malloc.h>
+#include <pthread.h>
+
+#include "flat_map.h"
+#include "flat_map_typed.h"
+
+// The number of keys resident in the map at steady state.
+#define N_RESIDENT (1 << 16)
+
+// The number of churn rounds; each round removes and inserts a key.
+#define N_ROUNDS   (1 << 20)
+
+// The number of lookups timed after every round.
+#define N_LOOKUPS  4
+
+// The number of threads in the layout benchmark.
+#define N_THREADS    4
+
+// The number of operations issued by each thread in the layout
+// benchmark; one in every UPDATE_RATIO operations is an update.
+#define N_OPERATIONS (1 << 22)
+#define UPDATE_RATIO 10
+
+// The number of keys populated by the load benchmark.
+#define N_LOAD (1 << 22)
+
+// The number of updates issued by each thread of the lock benchmark.
+#define N_LOCK_UPDATES (1 << 20)
+
+// The number of operations issued by each thread of the reclaim
+// benchmark; the ratio of updates is that of the layout benchmark.
+#define N_RECLAIM_OPERATIONS (1 << 20)
+
+// The number of keys populated by the dense benchmark.
+#define N_DENSE 900000
+
+// The number of keys resident in the map of the sweep benchmark.
+#define N_SWEEP (1 << 22)
+
+// A small value, as stored by the typed benchmark.
+typedef struct payload
+{
+    uint64_t a;
+    uint64_t b;
+} payload_t;
+
+FLAT_MAP_DEFINE(payload_map, uint64_t, payload_t, flat_map_hash_u64, flat_map_eq_u64)
+
+typedef struct samples
+{
+    uint64_t* data;
+    size_t    count;
+} samples_t;
+
+typedef struct worker_arg
+{
+    flat_map_t* map;
+    uint64_t    seed;
+} worker_arg_t;
+
+typedef struct sweep_arg
+{
+    flat_map_t* map;
+    bool*       stop;
+} sweep_arg_t;
+
+typedef struct reclaim_arg
+{
+    flat_map_t*      map;
+    pthread_mutex_t* lock;
+    uint64_t         seed;
+    uint64_t         sum;
+} reclaim_arg_t;
+
+static uint64_t next_random(uint64_t* state);
+static uint64_t now_ns(void);
+static int compare_u64(const void* a, const void* b);
+
+static void record(samples_t* samples, uint64_t start);
+static void report(const char* label, samples_t* samples);
+static void report_probes(
+    const char*             label,
+    const flat_map_stats_t* before,
+    const flat_map_stats_t* after);
+
+static void bench_churn(const char* label, flat_map_probing_t probing);
+static void bench_dense(const char* label, flat_map_probing_t probing);
+static void bench_layout(const char* label, flat_map_layout_t layout, size_t page_size);
+static void* layout_worker(void* arg);
+static void bench_load(void);
+static void bench_resize(size_t resize_threads);
+static void bench_typed(void);
+static void bench_memory(const char* label, flat_map_memory_t memory);
+static void bench_snapshot(void);
+static void bench_aggregate(void);
+static void* increment_count(map_key_t key, void* value, void* ctx);
+static void bench_locks(const char* label, flat_map_lock_kind_t lock_kind,
+    size_t page_size, size_t n_threads);
+static void* lock_worker(void* arg);
+static void bench_reclaim(const char* label, flat_map_reclaim_t reclaim, size_t n_threads);
+static void* reclaim_worker(void* arg);
+static void bench_numa(const char* label, flat_map_numa_t numa);
+static void bench_sweep(void);
+static void* sweep_writer(void* arg);
+static void count_key(map_key_t key, void* value, void* ctx);
+static void* make_value(map_key_t key);
+static void nop_deleter(void* value);
+
+int main(void)
+{
+    bench_churn("linear", FLAT_MAP_PROBING_LINEAR);
+    bench_churn("robin hood", FLAT_MAP_PROBING_ROBIN_HOOD);
+    bench_churn("hopscotch", FLAT_MAP_PROBING_HOPSCOTCH);
+
+    bench_dense("linear", FLAT_MAP_PROBING_LINEAR);
+    bench_dense("robin hood", FLAT_MAP_PROBING_ROBIN_HOOD);
+    bench_dense("hopscotch", FLAT_MAP_PROBING_HOPSCOTCH);
+
+    const size_t page_sizes[] = { 1, 4, 16, 64, 256 };
+    for (size_t i = 0; i < sizeof(page_sizes)/sizeof(page_sizes[0]); ++i)
+    {
+        bench_layout("split", FLAT_MAP_LAYOUT_SPLIT, page_sizes[i]);
+        bench_layout("paged", FLAT_MAP_LAYOUT_PAGED, page_sizes[i]);
+    }
+
+    bench_load();
+
+    for (size_t threads = 1; threads <= N_THREADS; threads *= 2)
+    {
+        bench_resize(threads);
+    }
+
+    bench_typed();
+
+    bench_memory("heap", FLAT_MAP_MEMORY_HEAP);
+    bench_memory("mapped", FLAT_MAP_MEMORY_MAPPED);
+
+    bench_snapshot();
+
+    bench_aggregate();
+
+    const char* lock_labels[] = { "pthread", "spin", "ticket", "rwlock" };
+    const flat_map_lock_kind_t lock_kinds[] = {
+        FLAT_MAP_LOCK_PTHREAD_RWLOCK, FLAT_MAP_LOCK_SPINLOCK,
+        FLAT_MAP_LOCK_TICKET, FLAT_MAP_LOCK_RWLOCK };
+    const size_t lock_page_sizes[] = { 1, 16, 256 };
+
+    for (size_t i = 0; i < sizeof(lock_page_sizes)/sizeof(lock_page_sizes[0]); ++i)
+    {
+        for (size_t threads = 1; threads <= N_THREADS; threads *= 2)
+        {
+            for (size_t j = 0; j < sizeof(lock_kinds)/sizeof(lock_kinds[0]); ++j)
+            {
+                bench_locks(lock_labels[j], lock_kinds[j], lock_page_sizes[i], threads);
+            }
+        }
+    }
+
+    for (size_t threads = 1; threads <= N_THREADS; threads *= 2)
+    {
+        bench_reclaim("mutex", FLAT_MAP_RECLAIM_IMMEDIATE, threads);
+        bench_reclaim("deferred", FLAT_MAP_RECLAIM_DEFERRED, threads);
+    }
+
+    bench_sweep();
+
+    bench_numa("none", FLAT_MAP_NUMA_NONE);
+    bench_numa("interleave", FLAT_MAP_NUMA_INTERLEAVE);
+    bench_numa("partition", FLAT_MAP_NUMA_PARTITION);
+    bench_numa("replicate", FLAT_MAP_NUMA_REPLICATE);
+
+    return EXIT_SUCCESS;
+}
+
+static void bench_churn(const char* label, flat_map_probing_t probing)
+{
+    flat_map_attr_t* attr = flat_map_attr_default();
+    attr->page_size = 8;
+    attr->deleter   = nop_deleter;
+    attr->probing   = probing;
+
+    flat_map_t* map = flat_map_new_with_attr(attr);
+    flat_map_attr_delete(attr);
+    if (NULL == map)
+    {
+        fprintf(stderr, "failed to construct map\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // the resident keys, in a ring of fixed size; all keys are
+    // odd such that even keys are guaranteed to be absent
+    map_key_t* resident = malloc(N_RESIDENT*sizeof(map_key_t));
+
+    uint64_t state = 0x2545F4914F6CDD1DULL;
+    for (size_t i = 0; i < N_RESIDENT; ++i)
+    {
+        resident[i] = next_random(&state) | 1;
+        flat_map_insert(map, resident[i], (void*)1, NULL);
+    }
+
+    samples_t hits   = { malloc(N_ROUNDS*N_LOOKUPS*sizeof(uint64_t)), 0 };
+    samples_t misses = { malloc(N_ROUNDS*N_LOOKUPS*sizeof(uint64_t)), 0 };
+
+    for (size_t round = 0; round < N_ROUNDS; ++round)
+    {
+        const size_t victim = next_random(&state) % N_RESIDENT;
+        flat_map_remove(map, resident[victim]);
+
+        resident[victim] = next_random(&state) | 1;
+        flat_map_insert(map, resident[victim], (void*)1, NULL);
+
+        for (size_t i = 0; i < N_LOOKUPS; ++i)
+        {
+            const map_key_t hit  = resident[next_random(&state) % N_RESIDENT];
+            const map_key_t miss = next_random(&state) & ~1ULL;
+
+            uint64_t start = now_ns();
+            flat_map_find(map, hit);
+            record(&hits, start);
+
+            start = now_ns();
+            flat_map_find(map, miss);
+            record(&misses, start);
+        }
+    }
+
+    printf("%s\n", label);
+    report("find (hit)", &hits);
+    report("find (miss)", &misses);
+
+    // the probe lengths of the churned table are isolated from
+    // those of the churn itself by lookups issued after it
+    flat_map_stats_t before;
+    flat_map_stats_t between;
+    flat_map_stats_t after;
+    if (flat_map_get_stats(map, &before))
+    {
+        for (size_t i = 0; i < N_RESIDENT; ++i)
+        {
+            flat_map_find(map, resident[next_random(&state) % N_RESIDENT]);
+        }
+
+        flat_map_get_stats(map, &between);
+
+        for (size_t i = 0; i < N_RESIDENT; ++i)
+        {
+            flat_map_find(map, next_random(&state) & ~1ULL);
+        }
+
+        flat_map_get_stats(map, &after);
+
+        report_probes("probe (hit)", &before, &between);
+        report_probes("probe (miss)", &between, &after);
+    }
+
+    free(hits.data);
+    free(misses.data);
+    free(resident);
+    flat_map_delete(map);
+}
+
+static void bench_dense(const char* label, flat_map_probing_t probing)
+{
+    const size_t in_use = mallinfo2().uordblks + mallinfo2().hblkhd;
+
+    flat_map_attr_t* attr = flat_map_attr_default();
+    attr->page_size = 64;
+    attr->deleter   = nop_deleter;
+    attr->probing   = probing;
+
+    flat_map_t* map = flat_map_new_with_attr(attr);
+    flat_map_attr_delete(attr);
+    if (NULL == map)
+    {
+        fprintf(stderr, "failed to construct map\n");
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t state = 0x2545F4914F6CDD1DULL;
+    for (size_t i = 0; i < N_DENSE; ++i)
+    {
+        flat_map_insert(map, next_random(&state) | 1, (void*)1, NULL);
+    }
+
+    const size_t bytes = mallinfo2().uordblks + mallinfo2().hblkhd - in_use;
+
+    samples_t hits   = { malloc(N_DENSE*sizeof(uint64_t)), 0 };
+    samples_t misses = { malloc(N_DENSE*sizeof(uint64_t)), 0 };
+
+    // replay the sequence of keys to look up each resident key
+    uint64_t replay = 0x2545F4914F6CDD1DULL;
+    for (size_t i = 0; i < N_DENSE; ++i)
+    {
+        const map_key_t hit  = next_random(&replay) | 1;
+        const map_key_t miss = next_random(&state) & ~1ULL;
+
+        uint64_t start = now_ns();
+        flat_map_find(map, hit);
+        record(&hits, start);
+
+        start = now_ns();
+        flat_map_find(map, miss);
+        record(&misses, start);
+    }
+
+    printf("dense %s: %.1f MiB\n", label, (double)bytes / (1 << 20));
+    report("find (hit)", &hits);
+    report("find (miss)", &misses);
+
+    free(hits.data);
+    free(misses.data);
+    flat_map_delete(map);
+}
+
+static void bench_layout(const char* label, flat_map_layout_t layout, size_t page_size)
+{
+    flat_map_attr_t* attr = flat_map_attr_default();
+    attr->page_size = page_size;
+    attr->deleter   = nop_deleter;
+    attr->layout    = layout;
+
+    flat_map_t* map = flat_map_new_with_attr(attr);
+    flat_map_attr_delete(attr);
+    if (NULL == map)
+    {
+        fprintf(stderr, "failed to construct map\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (map_key_t k = 1; k <= N_RESIDENT; ++k)
+    {
+        flat_map_insert(map, k, (void*)1, NULL);
+    }
+
+    pthread_t    threads[N_THREADS];
+    worker_arg_t args[N_THREADS];
+
+    const uint64_t start = now_ns();
+
+    for (size_t i = 0; i < N_THREADS; ++i)
+    {
+        args[i].map  = map;
+        args[i].seed = 0x9E3779B97F4A7C15ULL*(i + 1);
+        pthread_create(&threads[i], NULL, layout_worker, &args[i]);
+    }
+
+    for (size_t i = 0; i < N_THREADS; ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    const double seconds = (double)(now_ns() - start) / 1e9;
+    const double mops    = (double)N_THREADS*N_OPERATIONS / seconds / 1e6;
+
+    printf("layout %-5s  page_size %3zu  %7.2f Mops/s\n", label, page_size, mops);
+
+    flat_map_delete(map);
+}
+
+static void* layout_worker(void* arg)
+{
+    worker_arg_t* worker = (worker_arg_t*)arg;
+    uint64_t state = worker->seed;
+
+    for (size_t i = 0; i < N_OPERATIONS; ++i)
+    {
+        const map_key_t key = next_random(&state) % N_RESIDENT + 1;
+        if (i % UPDATE_RATIO == 0)
+        {
+            flat_map_insert(worker->map, key, (void*)1, NULL);
+        }
+        else
+        {
+            flat_map_find(worker->map, key);
+        }
+    }
+
+    return NULL;
+}
+
+static void bench_numa(const char* label, flat_map_numa_t numa)
+{
+    flat_map_attr_t* attr = flat_map_attr_default();
+    attr->deleter = nop_deleter;
+    attr->numa    = numa;
+
+    flat_map_t* map = flat_map_new_with_attr(attr);
+    flat_map_attr_delete(attr);
+    if (NULL == map)
+    {
+        fprintf(stderr, "failed to construct map\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (map_key_t k = 1; k <= N_RESIDENT; ++k)
+    {
+        flat_map_insert(map, k, (void*)1, NULL);
+    }
+
+    pthread_t    threads[N_THREADS];
+    worker_arg_t args[N_THREADS];
+
+    const uint64_t start = now_ns();
+
+    for (size_t i = 0; i < N_THREADS; ++i)
+    {
+        args[i].map  = map;
+        args[i].seed = 0x9E3779B97F4A7C15ULL*(i + 1);
+        pthread_create(&threads[i], NULL, layout_worker, &args[i]);
+    }
+
+    for (size_t i = 0; i < N_THREADS; ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    const double seconds = (double)(now_ns() - start) / 1e9;
+    const double mops    = (double)N_THREADS*N_OPERATIONS / seconds / 1e6;
+
+    printf("numa %-10s  %7.2f Mops/s\n", label, mops);
+
+    flat_map_delete(map);
+}
+
+static void bench_load(void)
+{
+    map_key_t* keys = malloc(N_LOAD*sizeof(map_key_t));
+    void** values   = malloc(N_LOAD*sizeof(void*));
+
+    uint64_t state = 0x2545F4914F6CDD1DULL;
+    for (size_t i = 0; i < N_LOAD; ++i)
+    {
+        keys[i]   = next_random(&state) | 1;
+        values[i] = (void*)1;
+    }
+
+    flat_map_t* maps[2] = {
+        flat_map_new(8, nop_deleter),
+        flat_map_new_with_capacity(8, nop_deleter, N_LOAD) };
+    const char* labels[2] = { "insert (growing)", "insert (sized)" };
+
+    for (size_t i = 0; i < 2; ++i)
+    {
+        const uint64_t start = now_ns();
+        for (size_t j = 0; j < N_LOAD; ++j)
+        {
+            flat_map_insert(maps[i], keys[j], values[j], NULL);
+        }
+
+        printf("load %-16s %8.1f ms\n", labels[i], (double)(now_ns() - start) / 1e6);
+        flat_map_delete(maps[i]);
+    }
+
+    flat_map_t* map = flat_map_new(8, nop_deleter);
+
+    const uint64_t start = now_ns();
+    flat_map_bulk_load(map, keys, values, N_LOAD);
+    printf("load %-16s %8.1f ms\n", "bulk", (double)(now_ns() - start) / 1e6);
+
+    flat_map_delete(map);
+    free(keys);
+    free(values);
+}
+
+static void bench_resize(size_t resize_threads)
+{
+    flat_map_attr_t* attr = flat_map_attr_default();
+    attr->page_size      = 8;
+    attr->deleter        = nop_deleter;
+    attr->resize_threads = resize_threads;
+
+    flat_map_t* map = flat_map_new_with_attr(attr);
+    flat_map_attr_delete(attr);
+    if (NULL == map)
+    {
+        fprintf(stderr, "failed to construct map\n");
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t state = 0x2545F4914F6CDD1DULL;
+    uint64_t stall = 0;
+
+    const uint64_t begin = now_ns();
+    for (size_t i = 0; i < N_LOAD; ++i)
+    {
+        const map_key_t key = next_random(&state) | 1;
+
+        const uint64_t start = now_ns();
+        flat_map_insert(map, key, (void*)1, NULL);
+
+        const uint64_t elapsed = now_ns() - start;
+        if (elapsed > stall)
+        {
+            stall = elapsed;
+        }
+    }
+
+    printf("resize threads %zu  total %8.1f ms  max stall %8.1f ms\n",
+        resize_threads,
+        (double)(now_ns() - begin) / 1e6,
+        (double)stall / 1e6);
+
+    flat_map_delete(map);
+}
+
+static void bench_typed(void)
+{
+    flat_map_t*    map   = flat_map_new(8, free);
+    payload_map_t* typed = payload_map_new(8);
+    if (NULL == map || NULL == typed)
+    {
+        fprintf(stderr, "failed to construct map\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (map_key_t k = 1; k <= N_RESIDENT; ++k)
+    {
+        payload_t* value = malloc(sizeof(payload_t));
+        *value = (payload_t){ k, k };
+
+        flat_map_insert(map, k, value, NULL);
+        payload_map_insert(typed, k, *value);
+    }
+
+    // the values read are accumulated such that the reads are not elided
+    uint64_t state        = 0x2545F4914F6CDD1DULL;
+    volatile uint64_t sum = 0;
+
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < N_OPERATIONS; ++i)
+    {
+        const map_key_t key = next_random(&state) % N_RESIDENT + 1;
+        const payload_t* value = flat_map_find(map, key);
+        sum += value->b;
+    }
+
+    const double pointer_mops = (double)N_OPERATIONS / ((double)(now_ns() - start) / 1e3);
+
+    start = now_ns();
+    for (size_t i = 0; i < N_OPERATIONS; ++i)
+    {
+        const map_key_t key = next_random(&state) % N_RESIDENT + 1;
+        payload_t value = { 0, 0 };
+        payload_map_find(typed, key, &value);
+        sum += value.b;
+    }
+
+    const double typed_mops = (double)N_OPERATIONS / ((double)(now_ns() - start) / 1e3);
+
+    printf("find flat_map %7.2f Mops/s  typed %7.2f Mops/s\n", pointer_mops, typed_mops);
+
+    payload_map_delete(typed);
+    flat_map_delete(map);
+}
+
+static void bench_memory(const char* label, flat_map_memory_t memory)
+{
+    flat_map_attr_t* attr = flat_map_attr_default();
+    attr->page_size      = 8;
+    attr->deleter        = nop_deleter;
+    attr->expected_items = N_LOAD;
+    attr->memory         = memory;
+
+    uint64_t start = now_ns();
+
+    flat_map_t* map = flat_map_new_with_attr(attr);
+    flat_map_attr_delete(attr);
+    if (NULL == map)
+    {
+        fprintf(stderr, "failed to construct map\n");
+        exit(EXIT_FAILURE);
+    }
+
+    const double new_ms = (double)(now_ns() - start) / 1e6;
+
+    for (map_key_t k = 1; k <= N_LOAD; ++k)
+    {
+        flat_map_insert(map, k, (void*)1, NULL);
+    }
+
+    uint64_t state = 0x2545F4914F6CDD1DULL;
+
+    start = now_ns();
+    for (size_t i = 0; i < N_OPERATIONS; ++i)
+    {
+        flat_map_find(map, next_random(&state) % N_LOAD + 1);
+    }
+
+    const double mops = (double)N_OPERATIONS / ((double)(now_ns() - start) / 1e3);
+
+    printf("memory %-6s  new %7.2f ms  find %7.2f Mops/s\n", label, new_ms, mops);
+
+    flat_map_delete(map);
+}
+
+static void bench_snapshot(void)
+{
+    const char* path = "bench.snapshot";
+
+    map_key_t* keys = malloc(N_LOAD*sizeof(map_key_t));
+
+    uint64_t state = 0x2545F4914F6CDD1DULL;
+    for (size_t i = 0; i < N_LOAD; ++i)
+    {
+        keys[i] = next_random(&state) | 1;
+    }
+
+    uint64_t start = now_ns();
+
+    flat_map_t* map = flat_map_new(8, free);
+    for (size_t i = 0; i < N_LOAD; ++i)
+    {
+        payload_t* value = malloc(sizeof(payload_t));
+        *value = (payload_t){ keys[i], keys[i] };
+        flat_map_insert(map, keys[i], value, NULL);
+    }
+
+    printf("restore %-14s %8.1f ms\n", "reinsert", (double)(now_ns() - start) / 1e6);
+
+    const size_t value_sizes[] = { 0, sizeof(payload_t) };
+    const char* labels[]       = { "mapped inline", "mapped blob" };
+
+    for (size_t i = 0; i < 2; ++i)
+    {
+        start = now_ns();
+        flat_map_save(map, path, value_sizes[i]);
+        const double save_ms = (double)(now_ns() - start) / 1e6;
+
+        start = now_ns();
+        flat_map_t* opened = flat_map_open_mapped(path, nop_deleter);
+        const double open_ms = (double)(now_ns() - start) / 1e6;
+
+        // the first lookups fault the table in from the file
+        start = now_ns();
+        for (size_t j = 0; j < N_LOAD; ++j)
+        {
+            flat_map_find(opened, keys[j]);
+        }
+
+        printf("restore %-14s %8.1f ms  (save %8.1f ms, first pass of finds %8.1f ms)\n",
+            labels[i], open_ms, save_ms, (double)(now_ns() - start) / 1e6);
+
+        flat_map_delete(opened);
+    }
+
+    unlink(path);
+    flat_map_delete(map);
+    free(keys);
+}
+
+// xorshift64*
+static void bench_aggregate(void)
+{
+    map_key_t* keys = malloc(N_OPERATIONS*sizeof(map_key_t));
+
+    // each key recurs many times over the course of the benchmark
+    uint64_t state = 0x2545F4914F6CDD1DULL;
+    for (size_t i = 0; i < N_OPERATIONS; ++i)
+    {
+        keys[i] = (next_random(&state) % N_RESIDENT) + 1;
+    }
+
+    // the count for each key is stored in the value pointer
+    flat_map_t* map = flat_map_new(8, nop_deleter);
+
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < N_OPERATIONS; ++i)
+    {
+        const uintptr_t count = (uintptr_t)flat_map_find(map, keys[i]);
+        flat_map_insert(map, keys[i], (void*)(count + 1), NULL);
+    }
+
+    printf("aggregate %-12s %8.1f ms\n", "find + insert", (double)(now_ns() - start) / 1e6);
+    flat_map_delete(map);
+
+    map = flat_map_new(8, nop_deleter);
+
+    start = now_ns();
+    for (size_t i = 0; i < N_OPERATIONS; ++i)
+    {
+        flat_map_compute(map, keys[i], increment_count, NULL);
+    }
+
+    printf("aggregate %-12s %8.1f ms\n", "compute", (double)(now_ns() - start) / 1e6);
+    flat_map_delete(map);
+
+    free(keys);
+}
+
+static void* increment_count(map_key_t key, void* value, void* ctx)
+{
+    (void)key;
+    (void)ctx;
+    return (void*)((uintptr_t)value + 1);
+}
+
+static void bench_locks(
+    const char*          label,
+    flat_map_lock_kind_t lock_kind,
+    size_t               page_size,
+    size_t               n_threads)
+{
+    flat_map_attr_t* attr = flat_map_attr_default();
+    attr->page_size = page_size;
+    attr->deleter   = nop_deleter;
+    attr->lock_kind = lock_kind;
+
+    flat_map_t* map = flat_map_new_with_attr(attr);
+    flat_map_attr_delete(attr);
+    if (NULL == map)
+    {
+        fprintf(stderr, "failed to construct map\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (map_key_t k = 1; k <= N_RESIDENT; ++k)
+    {
+        flat_map_insert(map, k, (void*)1, NULL);
+    }
+
+    pthread_t    threads[N_THREADS];
+    worker_arg_t args[N_THREADS];
+
+    const uint64_t start = now_ns();
+
+    for (size_t i = 0; i < n_threads; ++i)
+    {
+        args[i].map  = map;
+        args[i].seed = 0x9E3779B97F4A7C15ULL*(i + 1);
+        pthread_create(&threads[i], NULL, lock_worker, &args[i]);
+    }
+
+    for (size_t i = 0; i < n_threads; ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    const double seconds = (double)(now_ns() - start) / 1e9;
+    const double mops    = (double)n_threads*N_LOCK_UPDATES / seconds / 1e6;
+
+    printf("lock %-8s page_size %3zu  threads %zu  %7.2f Mops/s\n",
+        label, page_size, n_threads, mops);
+
+    flat_map_delete(map);
+}
+
+static void* lock_worker(void* arg)
+{
+    worker_arg_t* worker = (worker_arg_t*)arg;
+    uint64_t state = worker->seed;
+
+    for (size_t i = 0; i < N_LOCK_UPDATES; ++i)
+    {
+        const map_key_t key = next_random(&state) % N_RESIDENT + 1;
+        flat_map_insert(worker->map, key, (void*)1, NULL);
+    }
+
+    return NULL;
+}
+
+static void bench_reclaim(
+    const char*        label,
+    flat_map_reclaim_t reclaim,
+    size_t             n_threads)
+{
+    flat_map_attr_t* attr = flat_map_attr_default();
+    attr->reclaim = reclaim;
+
+    flat_map_t* map = flat_map_new_with_attr(attr);
+    flat_map_attr_delete(attr);
+    if (NULL == map)
+    {
+        fprintf(stderr, "failed to construct map\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (map_key_t k = 1; k <= N_RESIDENT; ++k)
+    {
+        flat_map_insert(map, k, make_value(k), NULL);
+    }
+
+    // values under immediate reclamation are only safe
+    // to dereference while every remover is excluded
+    pthread_mutex_t lock;
+    pthread_mutex_init(&lock, NULL);
+
+    pthread_t     threads[N_THREADS];
+    reclaim_arg_t args[N_THREADS];
+
+    const uint64_t start = now_ns();
+
+    for (size_t i = 0; i < n_threads; ++i)
+    {
+        args[i].map  = map;
+        args[i].lock = (FLAT_MAP_RECLAIM_IMMEDIATE == reclaim) ? &lock : NULL;
+        args[i].seed = 0x9E3779B97F4A7C15ULL*(i + 1);
+        args[i].sum  = 0;
+        pthread_create(&threads[i], NULL, reclaim_worker, &args[i]);
+    }
+
+    for (size_t i = 0; i < n_threads; ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    const double seconds = (double)(now_ns() - start) / 1e9;
+    const double mops    = (double)n_threads*N_RECLAIM_OPERATIONS / seconds / 1e6;
+
+    printf("reclaim %-8s threads %zu  %7.2f Mops/s\n", label, n_threads, mops);
+
+    pthread_mutex_destroy(&lock);
+    flat_map_delete(map);
+}
+
+static void* reclaim_worker(void* arg)
+{
+    reclaim_arg_t* worker = (reclaim_arg_t*)arg;
+    uint64_t state = worker->seed;
+
+    for (size_t i = 0; i < N_RECLAIM_OPERATIONS; ++i)
+    {
+        const uint64_t r    = next_random(&state);
+        const map_key_t key = r % N_RESIDENT + 1;
+
+        if (worker->lock != NULL)
+        {
+            pthread_mutex_lock(worker->lock);
+        }
+
+        const rcu_handle_t handle = flat_map_enter(worker->map);
+
+        if (0 == (r >> 32) % UPDATE_RATIO)
+        {
+            flat_map_remove(worker->map, key);
+            flat_map_insert(worker->map, key, make_value(key), NULL);
+        }
+        else
+        {
+            const uint64_t* value = (const uint64_t*)flat_map_find(worker->map, key);
+            if (value != NULL)
+            {
+                worker->sum += *value;
+            }
+        }
+
+        flat_map_leave(worker->map, handle);
+
+        if (worker->lock != NULL)
+        {
+            pthread_mutex_unlock(worker->lock);
+        }
+    }
+
+    return NULL;
+}
+
+static void* make_value(map_key_t key)
+{
+    uint64_t* value = malloc(sizeof(uint64_t));
+    *value = key;
+    return value;
+}
+
+static uint64_t next_random(uint64_t* state)
+{
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x*0x2545F4914F6CDD1DULL;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int compare_u64(const void* a, const void* b)
+{
+    const uint64_t x = *(const uint64_t*)a;
+    const uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void record(samples_t* samples, uint64_t start)
+{
+    samples->data[samples->count++] = now_ns() - start;
+}
+
+// report the percentiles of the probe lengths of the operations
+// between two snapshots of the statistics of a map; each is given
+// as the exclusive upper bound of its bucket in the histogram
+static void report_probes(
+    const char*             label,
+    const flat_map_stats_t* before,
+    const flat_map_stats_t* after)
+{
+    uint64_t counts[FLAT_MAP_STATS_BUCKETS];
+    uint64_t total = 0;
+    for (size_t i = 0; i < FLAT_MAP_STATS_BUCKETS; ++i)
+    {
+        counts[i] = after->probe_length[i] - before->probe_length[i];
+        total += counts[i];
+    }
+
+    const uint64_t ranks[] = { total/2, (total*99)/100, (total*999)/1000 };
+    uint64_t bounds[3];
+
+    for (size_t j = 0; j < 3; ++j)
+    {
+        uint64_t cumulative = 0;
+        size_t   bucket     = 0;
+        while (bucket < FLAT_MAP_STATS_BUCKETS - 1
+            && cumulative + counts[bucket] <= ranks[j])
+        {
+            cumulative += counts[bucket++];
+        }
+
+        bounds[j] = 1ULL << (bucket + 1);
+    }
+
+    printf("  %-12s p50 < %5lu     p99 < %5lu     p99.9 < %6lu cells\n",
+        label, bounds[0], bounds[1], bounds[2]);
+}
+
+static void report(const char* label, samples_t* samples)
+{
+    qsort(samples->data, samples->count, sizeof(uint64_t), compare_u64);
+
+    const size_t n = samples->count;
+    printf("  %-12s p50 %5lu ns  p99 %5lu ns  p99.9 %6lu ns  max %8lu ns\n",
+        label,
+        samples->data[n/2],
+        samples->data[(n*99)/100],
+        samples->data[(n*999)/1000],
+        samples->data[n - 1]);
+}
+
+static void nop_deleter(void* value)
+{
+    (void)value;
+}
+
+static void bench_sweep(void)
+{
+    flat_map_t* map = flat_map_new(64, nop_deleter);
+    for (map_key_t k = 1; k <= N_SWEEP; ++k)
+    {
+        flat_map_insert(map, k, (void*)1, NULL);
+    }
+
+    // the writer inserts keys beyond the resident keys until stopped
+    bool stop = false;
+    sweep_arg_t writer_arg = { map, &stop };
+
+    pthread_t writer;
+    pthread_create(&writer, NULL, sweep_writer, &writer_arg);
+
+    flat_map_iter_t* iter = flat_map_iter_new(map);
+
+    uint64_t start = now_ns();
+
+    size_t n_visited = 0;
+    map_key_t key;
+    while (flat_map_iter_next(iter, &key, NULL))
+    {
+        ++n_visited;
+    }
+
+    double elapsed = (double)(now_ns() - start) / 1e9;
+    printf("sweep iterator       %8.1f Mkeys/s\n", (double)n_visited / elapsed / 1e6);
+
+    flat_map_iter_delete(iter);
+
+    // the rate of each parallel sweep is that of the resident keys,
+    // as counting the visits would serialize the threads
+    for (size_t threads = 1; threads <= N_THREADS; threads *= 2)
+    {
+        start = now_ns();
+        flat_map_parallel_for_each(map, threads, count_key, NULL);
+
+        elapsed = (double)(now_ns() - start) / 1e9;
+        printf("sweep for_each threads %zu %8.1f Mkeys/s\n",
+            threads, (double)N_SWEEP / elapsed / 1e6);
+    }
+
+    __atomic_store_n(&stop, true, __ATOMIC_RELEASE);
+    pthread_join(writer, NULL);
+
+    flat_map_delete(map);
+}
+
+// insert fresh keys until stopped
+static void* sweep_writer(void* arg)
+{
+    sweep_arg_t* a = (sweep_arg_t*)arg;
+
+    for (map_key_t k = N_SWEEP + 1; !__atomic_load_n(a->stop, __ATOMIC_ACQUIRE); ++k)
+    {
+        flat_map_insert(a->map, k, (void*)1, NULL);
+    }
+
+    return NULL;
+}
+
+// the number of keys visited by the calling thread
+static __thread size_t n_swept;
+
+static void count_key(map_key_t key, void* value, void* ctx)
+{
+    ++n_swept;
+}
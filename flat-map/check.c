@@ -4,10 +4,16 @@
 // attribute gnu_printf
 #pragma GCC diagnostic ignored "-Wignored-attributes"
 
+#define _GNU_SOURCE
 #include <check.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include "flat_map.h"
+#include "flat_map_typed.h"
+#include "murmur3.h"
 
 // ----------------------------------------------------------------------------
 // Definitions for Testing
@@ -33,6 +39,260 @@ static void delete_point(void* p)
     free(as_point);
 }
 
+#define N_CONCURRENT_KEYS    4096
+#define N_CONCURRENT_WRITERS 4
+#define N_CONCURRENT_READERS 4
+
+typedef struct concurrent_arg
+{
+    flat_map_t* map;
+    size_t      id;
+    bool*       stop;
+} concurrent_arg_t;
+
+// insert every key in the writer's partition of the key space
+static void* concurrent_writer(void* arg)
+{
+    concurrent_arg_t* a = (concurrent_arg_t*) arg;
+
+    for (map_key_t k = 1; k <= N_CONCURRENT_KEYS; ++k)
+    {
+        if (k % N_CONCURRENT_WRITERS == a->id)
+        {
+            flat_map_insert(a->map, k, make_point((float)k, (float)k), NULL);
+        }
+    }
+
+    return NULL;
+}
+
+// repeatedly search for keys while writers are active
+static void* concurrent_reader(void* arg)
+{
+    concurrent_arg_t* a = (concurrent_arg_t*) arg;
+
+    while (!__atomic_load_n(a->stop, __ATOMIC_ACQUIRE))
+    {
+        for (map_key_t k = 1; k <= N_CONCURRENT_KEYS; ++k)
+        {
+            point_t* p = (point_t*)flat_map_find(a->map, k);
+            if (p != NULL)
+            {
+                ck_assert(p->x == (float)k);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+#define N_COMPUTE_KEYS   1024
+#define N_COMPUTE_ROUNDS 64
+
+// count the invocations for a key in the x coordinate of its point
+static void* count_point(map_key_t key, void* value, void* ctx)
+{
+    (void)key;
+    (void)ctx;
+
+    if (NULL == value)
+    {
+        return make_point(1.0f, 0.0f);
+    }
+
+    ((point_t*)value)->x += 1.0f;
+    return value;
+}
+
+// replace the point for a key with a new point, if present
+static void* replace_point(map_key_t key, void* value, void* ctx)
+{
+    (void)ctx;
+    return (NULL == value) ? NULL : make_point((float)key, (float)key);
+}
+
+// count each key of the key space a number of times
+static void* compute_writer(void* arg)
+{
+    concurrent_arg_t* a = (concurrent_arg_t*) arg;
+
+    for (size_t round = 0; round < N_COMPUTE_ROUNDS; ++round)
+    {
+        for (map_key_t k = 1; k <= N_COMPUTE_KEYS; ++k)
+        {
+            flat_map_compute(a->map, k, count_point, NULL);
+        }
+    }
+
+    return NULL;
+}
+
+#define N_STABLE_KEYS 2048
+
+// insert every key beyond the stable keys in the writer's partition
+static void* hopscotch_writer(void* arg)
+{
+    concurrent_arg_t* a = (concurrent_arg_t*) arg;
+
+    for (map_key_t k = N_STABLE_KEYS + 1; k <= 4*N_STABLE_KEYS; ++k)
+    {
+        if (k % N_CONCURRENT_WRITERS == a->id)
+        {
+            ck_assert(flat_map_insert(a->map, k, make_point((float)k, (float)k), NULL));
+        }
+    }
+
+    return NULL;
+}
+
+// search for the stable keys, which are never absent, while
+// concurrent insertions move them within their neighborhoods
+static void* hopscotch_reader(void* arg)
+{
+    concurrent_arg_t* a = (concurrent_arg_t*) arg;
+
+    while (!__atomic_load_n(a->stop, __ATOMIC_ACQUIRE))
+    {
+        for (map_key_t k = 1; k <= N_STABLE_KEYS; ++k)
+        {
+            point_t* p = (point_t*)flat_map_find(a->map, k);
+            ck_assert(p != NULL);
+            ck_assert(p->x == (float)k);
+        }
+    }
+
+    return NULL;
+}
+
+typedef struct visit_arg
+{
+    flat_map_t* map;
+    uint8_t*    visits;
+} visit_arg_t;
+
+// count the visits to each key, and remove each odd key
+static void visit_key(map_key_t key, void* value, void* ctx)
+{
+    visit_arg_t* a = (visit_arg_t*)ctx;
+
+    ck_assert(((point_t*)value)->x == (float)key);
+    __atomic_add_fetch(&a->visits[key], 1, __ATOMIC_RELAXED);
+
+    if (key % 2 == 1)
+    {
+        ck_assert(flat_map_remove(a->map, key));
+    }
+}
+
+// compute the hash of a key as the map does
+static uint32_t hash_key(map_key_t key)
+{
+    uint32_t hash;
+    MurmurHash3_x86_32((void*)&key, sizeof(map_key_t), 0, &hash);
+    return hash;
+}
+
+#define N_RECLAIM_KEYS   1024
+#define N_RECLAIM_ROUNDS 16
+
+static size_t n_reclaimed_points;
+
+// poison a point before it is destroyed, such that a
+// reader that still holds it observes the poison
+static void reclaim_point(void* p)
+{
+    ((point_t*)p)->x = -1.0f;
+    free(p);
+    __atomic_add_fetch(&n_reclaimed_points, 1, __ATOMIC_RELAXED);
+}
+
+// replace every key in the writer's partition of the key space
+static void* reclaim_writer(void* arg)
+{
+    concurrent_arg_t* a = (concurrent_arg_t*) arg;
+
+    for (size_t round = 0; round < N_RECLAIM_ROUNDS; ++round)
+    {
+        for (map_key_t k = 1; k <= N_RECLAIM_KEYS; ++k)
+        {
+            if (k % N_CONCURRENT_WRITERS == a->id)
+            {
+                ck_assert(flat_map_remove(a->map, k));
+                ck_assert(flat_map_insert(a->map, k, make_point((float)k, (float)k), NULL));
+            }
+        }
+    }
+
+    return NULL;
+}
+
+// read the points found for keys while they are replaced
+static void* reclaim_reader(void* arg)
+{
+    concurrent_arg_t* a = (concurrent_arg_t*) arg;
+
+    while (!__atomic_load_n(a->stop, __ATOMIC_ACQUIRE))
+    {
+        for (map_key_t k = 1; k <= N_RECLAIM_KEYS; ++k)
+        {
+            rcu_handle_t handle = flat_map_enter(a->map);
+
+            point_t* p = (point_t*)flat_map_find(a->map, k);
+            if (p != NULL)
+            {
+                ck_assert(p->x == (float)k);
+            }
+
+            flat_map_leave(a->map, handle);
+        }
+    }
+
+    return NULL;
+}
+
+// a map that stores points by value
+FLAT_MAP_DEFINE(point_map, uint64_t, point_t, flat_map_hash_u64, flat_map_eq_u64)
+
+#define N_TYPED_KEYS 100000
+
+#define SNAPSHOT_PATH    "/tmp/flat_map_check.snapshot"
+#define N_SNAPSHOT_SAVES 8
+
+typedef struct typed_arg
+{
+    point_map_t* map;
+    size_t       id;
+} typed_arg_t;
+
+// insert every key in the writer's partition of the key space
+static void* typed_writer(void* arg)
+{
+    typed_arg_t* a = (typed_arg_t*) arg;
+
+    for (uint64_t k = 0; k < N_TYPED_KEYS; ++k)
+    {
+        if (k % N_CONCURRENT_WRITERS == a->id)
+        {
+            point_map_insert(a->map, k, (point_t){ (float)k, (float)k });
+        }
+    }
+
+    return NULL;
+}
+
+// repeatedly save the map to the path shared by every saver
+static void* snapshot_saver(void* arg)
+{
+    concurrent_arg_t* a = (concurrent_arg_t*) arg;
+
+    for (size_t i = 0; i < N_SNAPSHOT_SAVES; ++i)
+    {
+        ck_assert(flat_map_save(a->map, SNAPSHOT_PATH, 0));
+    }
+
+    return NULL;
+}
+
 // ----------------------------------------------------------------------------
 // Test Cases
 
@@ -176,6 +436,1646 @@ START_TEST(test_flat_map_remove)
 }
 END_TEST
 
+START_TEST(test_flat_map_new_with_attr)
+{
+    flat_map_attr_t* attr = flat_map_attr_new();
+    ck_assert(attr != NULL);
+
+    // should fail, attributes not set
+    flat_map_t* map1 = flat_map_new_with_attr(attr);
+    ck_assert(NULL == map1);
+
+    attr->page_size     = 4;
+    attr->deleter       = delete_point;
+    attr->resize_policy = FLAT_MAP_RESIZE_INCREMENTAL;
+
+    flat_map_t* map2 = flat_map_new_with_attr(attr);
+    ck_assert(map2 != NULL);
+
+    flat_map_delete(map2);
+    flat_map_attr_delete(attr);
+}
+END_TEST
+
+START_TEST(test_flat_map_incremental_resize)
+{
+    flat_map_attr_t* attr = flat_map_attr_default();
+    ck_assert(attr != NULL);
+
+    attr->page_size     = 2;
+    attr->deleter       = delete_point;
+    attr->resize_policy = FLAT_MAP_RESIZE_INCREMENTAL;
+
+    flat_map_t* map = flat_map_new_with_attr(attr);
+    ck_assert(map != NULL);
+
+    // insert enough keys to trigger many resize operations,
+    // removing some along the way so migration sees tombstones
+    for (map_key_t k = 1; k <= 1024; ++k)
+    {
+        ck_assert(flat_map_insert(map, k, make_point((float)k, (float)k), NULL));
+        if (k % 8 == 0)
+        {
+            ck_assert(flat_map_remove(map, k / 2));
+        }
+    }
+
+    for (map_key_t k = 1; k <= 1024; ++k)
+    {
+        const bool removed = (k % 4 == 0) && (k <= 512);
+        point_t* p = (point_t*)flat_map_find(map, k);
+        if (removed)
+        {
+            ck_assert(NULL == p);
+        }
+        else
+        {
+            ck_assert(p != NULL);
+            ck_assert(p->x == (float)k);
+        }
+    }
+
+    flat_map_delete(map);
+    flat_map_attr_delete(attr);
+}
+END_TEST
+
+START_TEST(test_flat_map_control_bytes)
+{
+    flat_map_attr_t* attr = flat_map_attr_default();
+    ck_assert(attr != NULL);
+
+    attr->page_size     = 32;
+    attr->deleter       = delete_point;
+    attr->control_bytes = true;
+
+    flat_map_t* map = flat_map_new_with_attr(attr);
+    ck_assert(map != NULL);
+
+    for (map_key_t k = 1; k <= 1024; ++k)
+    {
+        ck_assert(flat_map_insert(map, k, make_point((float)k, (float)k), NULL));
+    }
+
+    for (map_key_t k = 1; k <= 1024; k += 2)
+    {
+        ck_assert(flat_map_remove(map, k));
+    }
+
+    for (map_key_t k = 1; k <= 1024; ++k)
+    {
+        point_t* p = (point_t*)flat_map_find(map, k);
+        if (k % 2 == 1)
+        {
+            ck_assert(NULL == p);
+        }
+        else
+        {
+            ck_assert(p != NULL);
+            ck_assert(p->x == (float)k);
+        }
+    }
+
+    // keys that are not present in the map
+    for (map_key_t k = 1025; k <= 2048; ++k)
+    {
+        ck_assert(!flat_map_contains(map, k));
+    }
+
+    flat_map_delete(map);
+    flat_map_attr_delete(attr);
+}
+END_TEST
+
+START_TEST(test_flat_map_robin_hood)
+{
+    flat_map_attr_t* attr = flat_map_attr_default();
+    ck_assert(attr != NULL);
+
+    attr->page_size     = 4;
+    attr->deleter       = delete_point;
+    attr->resize_policy = FLAT_MAP_RESIZE_INCREMENTAL;
+    attr->probing       = FLAT_MAP_PROBING_ROBIN_HOOD;
+
+    // control bytes are not supported with robin hood probing
+    attr->control_bytes = true;
+    ck_assert(NULL == flat_map_new_with_attr(attr));
+
+    attr->control_bytes = false;
+
+    flat_map_t* map = flat_map_new_with_attr(attr);
+    ck_assert(map != NULL);
+
+    for (map_key_t k = 1; k <= 1024; ++k)
+    {
+        ck_assert(flat_map_insert(map, k, make_point((float)k, (float)k), NULL));
+    }
+
+    // churn the map such that removals shift keys across pages
+    for (size_t round = 0; round < 4; ++round)
+    {
+        for (map_key_t k = 1; k <= 1024; k += 2)
+        {
+            ck_assert(flat_map_remove(map, k));
+            ck_assert(!flat_map_remove(map, k));
+        }
+
+        for (map_key_t k = 1; k <= 1024; ++k)
+        {
+            point_t* p = (point_t*)flat_map_find(map, k);
+            if (k % 2 == 1)
+            {
+                ck_assert(NULL == p);
+            }
+            else
+            {
+                ck_assert(p != NULL);
+                ck_assert(p->x == (float)k);
+            }
+        }
+
+        for (map_key_t k = 1; k <= 1024; k += 2)
+        {
+            ck_assert(flat_map_insert(map, k, make_point((float)k, (float)k), NULL));
+        }
+    }
+
+    for (map_key_t k = 1; k <= 1024; ++k)
+    {
+        point_t* p = (point_t*)flat_map_find(map, k);
+        ck_assert(p != NULL);
+        ck_assert(p->x == (float)k);
+    }
+
+    flat_map_delete(map);
+    flat_map_attr_delete(attr);
+}
+END_TEST
+
+// The number of cells in a neighborhood under hopscotch probing.
+#define HOP_RANGE 31
+
+START_TEST(test_flat_map_hopscotch)
+{
+    const size_t page_sizes[] = { 4, 64 };
+    const flat_map_resize_policy_t policies[] = {
+        FLAT_MAP_RESIZE_BLOCKING, FLAT_MAP_RESIZE_INCREMENTAL };
+
+    for (size_t i = 0; i < 4; ++i)
+    {
+        flat_map_attr_t* attr = flat_map_attr_default();
+        ck_assert(attr != NULL);
+
+        attr->page_size     = page_sizes[i % 2];
+        attr->deleter       = delete_point;
+        attr->resize_policy = policies[i / 2];
+        attr->probing       = FLAT_MAP_PROBING_HOPSCOTCH;
+
+        // control bytes are not supported with hopscotch probing
+        attr->control_bytes = true;
+        ck_assert(NULL == flat_map_new_with_attr(attr));
+
+        attr->control_bytes = false;
+
+        flat_map_t* map = flat_map_new_with_attr(attr);
+        ck_assert(map != NULL);
+
+        for (map_key_t k = 1; k <= 4096; ++k)
+        {
+            ck_assert(flat_map_insert(map, k, make_point((float)k, (float)k), NULL));
+        }
+
+        // churn the map such that insertions reuse tombstones
+        for (size_t round = 0; round < 4; ++round)
+        {
+            for (map_key_t k = 1; k <= 4096; k += 2)
+            {
+                ck_assert(flat_map_remove(map, k));
+                ck_assert(!flat_map_remove(map, k));
+            }
+
+            ck_assert(flat_map_size(map) == 2048);
+
+            for (map_key_t k = 1; k <= 4096; ++k)
+            {
+                point_t* p = (point_t*)flat_map_find(map, k);
+                if (k % 2 == 1)
+                {
+                    ck_assert(NULL == p);
+                }
+                else
+                {
+                    ck_assert(p != NULL);
+                    ck_assert(p->x == (float)k);
+                }
+            }
+
+            for (map_key_t k = 1; k <= 4096; k += 2)
+            {
+                ck_assert(flat_map_insert(map, k, make_point((float)k, (float)k), NULL));
+            }
+        }
+
+        ck_assert(flat_map_size(map) == 4096);
+
+        // keys are moved by insertions without being missed by readers
+        bool stop = false;
+
+        pthread_t writers[N_CONCURRENT_WRITERS];
+        pthread_t readers[N_CONCURRENT_READERS];
+        concurrent_arg_t writer_args[N_CONCURRENT_WRITERS];
+        concurrent_arg_t reader_args[N_CONCURRENT_READERS];
+
+        for (map_key_t k = 1; k <= 4096; ++k)
+        {
+            ck_assert(flat_map_remove(map, k));
+        }
+
+        for (map_key_t k = 1; k <= N_STABLE_KEYS; ++k)
+        {
+            ck_assert(flat_map_insert(map, k, make_point((float)k, (float)k), NULL));
+        }
+
+        for (size_t j = 0; j < N_CONCURRENT_READERS; ++j)
+        {
+            reader_args[j] = (concurrent_arg_t){ .map = map, .id = j, .stop = &stop };
+            ck_assert(0 == pthread_create(&readers[j], NULL, hopscotch_reader, &reader_args[j]));
+        }
+
+        for (size_t j = 0; j < N_CONCURRENT_WRITERS; ++j)
+        {
+            writer_args[j] = (concurrent_arg_t){ .map = map, .id = j, .stop = NULL };
+            ck_assert(0 == pthread_create(&writers[j], NULL, hopscotch_writer, &writer_args[j]));
+        }
+
+        for (size_t j = 0; j < N_CONCURRENT_WRITERS; ++j)
+        {
+            ck_assert(0 == pthread_join(writers[j], NULL));
+        }
+
+        __atomic_store_n(&stop, true, __ATOMIC_RELEASE);
+
+        for (size_t j = 0; j < N_CONCURRENT_READERS; ++j)
+        {
+            ck_assert(0 == pthread_join(readers[j], NULL));
+        }
+
+        ck_assert(flat_map_size(map) == 4*N_STABLE_KEYS);
+
+        flat_map_delete(map);
+        flat_map_attr_delete(attr);
+    }
+
+    // keys that share an initial cell fill its neighborhood, as long as
+    // the table has at most 2^16 cells, after which a further key is
+    // rejected rather than placed outside of the neighborhood
+    map_key_t colliding[HOP_RANGE + 1];
+    size_t n_colliding = 0;
+    for (map_key_t k = 1; n_colliding < HOP_RANGE + 1; ++k)
+    {
+        if ((hash_key(k) & 0xFFFF) == (hash_key(1) & 0xFFFF))
+        {
+            colliding[n_colliding++] = k;
+        }
+    }
+
+    flat_map_attr_t* attr = flat_map_attr_default();
+    ck_assert(attr != NULL);
+
+    attr->page_size = 4;
+    attr->deleter   = delete_point;
+    attr->probing   = FLAT_MAP_PROBING_HOPSCOTCH;
+
+    flat_map_t* map = flat_map_new_with_attr(attr);
+    ck_assert(map != NULL);
+
+    for (size_t i = 0; i < HOP_RANGE; ++i)
+    {
+        ck_assert(flat_map_insert(map, colliding[i], make_point((float)i, (float)i), NULL));
+    }
+
+    point_t* rejected = make_point((float)HOP_RANGE, (float)HOP_RANGE);
+    ck_assert(!flat_map_insert(map, colliding[HOP_RANGE], rejected, NULL));
+    delete_point(rejected);
+
+    for (size_t i = 0; i < HOP_RANGE; ++i)
+    {
+        point_t* p = (point_t*)flat_map_find(map, colliding[i]);
+        ck_assert(p != NULL);
+        ck_assert(p->x == (float)i);
+    }
+
+    ck_assert(!flat_map_contains(map, colliding[HOP_RANGE]));
+
+    // a removal leaves a tombstone within the neighborhood,
+    // which the rejected key then reuses
+    ck_assert(flat_map_remove(map, colliding[0]));
+    ck_assert(flat_map_insert(map, colliding[HOP_RANGE],
+        make_point((float)HOP_RANGE, (float)HOP_RANGE), NULL));
+
+    ck_assert(!flat_map_contains(map, colliding[0]));
+    ck_assert(flat_map_contains(map, colliding[HOP_RANGE]));
+    ck_assert(flat_map_size(map) == HOP_RANGE);
+
+    flat_map_delete(map);
+
+    // a bulk load rejects such a key in the same way,
+    // retaining the keys that it placed
+    map = flat_map_new_with_attr(attr);
+    ck_assert(map != NULL);
+
+    void* values[HOP_RANGE + 1];
+    for (size_t i = 0; i < HOP_RANGE + 1; ++i)
+    {
+        values[i] = make_point((float)i, (float)i);
+    }
+
+    ck_assert(!flat_map_bulk_load(map, colliding, values, HOP_RANGE + 1));
+    ck_assert(flat_map_size(map) == HOP_RANGE);
+
+    for (size_t i = 0; i < HOP_RANGE + 1; ++i)
+    {
+        if (!flat_map_contains(map, colliding[i]))
+        {
+            delete_point(values[i]);
+        }
+    }
+
+    flat_map_delete(map);
+    flat_map_attr_delete(attr);
+}
+END_TEST
+
+START_TEST(test_flat_map_iterate)
+{
+    const flat_map_probing_t probings[] = {
+        FLAT_MAP_PROBING_LINEAR, FLAT_MAP_PROBING_ROBIN_HOOD, FLAT_MAP_PROBING_HOPSCOTCH };
+    const flat_map_resize_policy_t policies[] = {
+        FLAT_MAP_RESIZE_BLOCKING, FLAT_MAP_RESIZE_INCREMENTAL };
+
+    uint8_t* visits = malloc(4*N_STABLE_KEYS + 1);
+    ck_assert(visits != NULL);
+
+    map_key_t key;
+    void* value;
+
+    for (size_t i = 0; i < 6; ++i)
+    {
+        flat_map_attr_t* attr = flat_map_attr_default();
+        ck_assert(attr != NULL);
+
+        attr->page_size     = 4;
+        attr->deleter       = delete_point;
+        attr->probing       = probings[i % 3];
+        attr->resize_policy = policies[i / 3];
+
+        flat_map_t* map = flat_map_new_with_attr(attr);
+        ck_assert(map != NULL);
+
+        flat_map_iter_t* iter = flat_map_iter_new(map);
+        ck_assert(iter != NULL);
+        ck_assert(!flat_map_iter_next(iter, &key, &value));
+        flat_map_iter_delete(iter);
+
+        for (map_key_t k = 1; k <= N_STABLE_KEYS; ++k)
+        {
+            ck_assert(flat_map_insert(map, k, make_point((float)k, (float)k), NULL));
+        }
+
+        // in the absence of concurrent operations, each key is visited once
+        memset(visits, 0, 4*N_STABLE_KEYS + 1);
+
+        iter = flat_map_iter_new(map);
+        ck_assert(iter != NULL);
+        while (flat_map_iter_next(iter, &key, &value))
+        {
+            ck_assert(key >= 1 && key <= N_STABLE_KEYS);
+            ck_assert(((point_t*)value)->x == (float)key);
+            ++visits[key];
+        }
+        flat_map_iter_delete(iter);
+
+        for (map_key_t k = 1; k <= N_STABLE_KEYS; ++k)
+        {
+            ck_assert(1 == visits[k]);
+        }
+
+        // the callback removes the odd keys as they are visited
+        memset(visits, 0, 4*N_STABLE_KEYS + 1);
+
+        visit_arg_t arg = { .map = map, .visits = visits };
+        ck_assert(flat_map_parallel_for_each(map, 4, visit_key, &arg));
+
+        for (map_key_t k = 1; k <= N_STABLE_KEYS; ++k)
+        {
+            ck_assert(1 == visits[k]);
+            ck_assert((k % 2 == 0) == flat_map_contains(map, k));
+        }
+
+        ck_assert(flat_map_size(map) == N_STABLE_KEYS / 2);
+
+        // a key that is present throughout is visited once despite
+        // the resizes caused by concurrent insertions, including the
+        // migration of its page between the tables of a slice
+        memset(visits, 0, 4*N_STABLE_KEYS + 1);
+
+        pthread_t writers[N_CONCURRENT_WRITERS];
+        concurrent_arg_t writer_args[N_CONCURRENT_WRITERS];
+        for (size_t j = 0; j < N_CONCURRENT_WRITERS; ++j)
+        {
+            writer_args[j] = (concurrent_arg_t){ .map = map, .id = j, .stop = NULL };
+            ck_assert(0 == pthread_create(&writers[j], NULL, hopscotch_writer, &writer_args[j]));
+        }
+
+        iter = flat_map_iter_new(map);
+        ck_assert(iter != NULL);
+        while (flat_map_iter_next(iter, &key, &value))
+        {
+            ck_assert(key >= 1 && key <= 4*N_STABLE_KEYS);
+            ++visits[key];
+        }
+        flat_map_iter_delete(iter);
+
+        for (size_t j = 0; j < N_CONCURRENT_WRITERS; ++j)
+        {
+            ck_assert(0 == pthread_join(writers[j], NULL));
+        }
+
+        for (map_key_t k = 2; k <= N_STABLE_KEYS; k += 2)
+        {
+            ck_assert(1 == visits[k]);
+        }
+
+        // a key that is present throughout is visited despite
+        // the table shrinking in the midst of the iteration
+        memset(visits, 0, 4*N_STABLE_KEYS + 1);
+
+        iter = flat_map_iter_new(map);
+        ck_assert(iter != NULL);
+        for (size_t j = 0; j < N_STABLE_KEYS; ++j)
+        {
+            ck_assert(flat_map_iter_next(iter, &key, &value));
+            visits[key] = 1;
+        }
+
+        for (map_key_t k = N_STABLE_KEYS + 1; k <= 4*N_STABLE_KEYS; ++k)
+        {
+            ck_assert(flat_map_remove(map, k));
+        }
+
+        ck_assert(flat_map_compact(map));
+
+        while (flat_map_iter_next(iter, &key, &value))
+        {
+            ck_assert(key >= 1 && key <= 4*N_STABLE_KEYS);
+            visits[key] = 1;
+        }
+        flat_map_iter_delete(iter);
+
+        for (map_key_t k = 2; k <= N_STABLE_KEYS; k += 2)
+        {
+            ck_assert(1 == visits[k]);
+        }
+
+        flat_map_delete(map);
+        flat_map_attr_delete(attr);
+    }
+
+    free(visits);
+}
+END_TEST
+
+START_TEST(test_flat_map_numa)
+{
+    const flat_map_numa_t policies[] = {
+        FLAT_MAP_NUMA_INTERLEAVE, FLAT_MAP_NUMA_PARTITION, FLAT_MAP_NUMA_REPLICATE };
+    const flat_map_probing_t probings[] = {
+        FLAT_MAP_PROBING_LINEAR, FLAT_MAP_PROBING_ROBIN_HOOD, FLAT_MAP_PROBING_HOPSCOTCH };
+
+    // replicas require the split layout
+    flat_map_attr_t* attr = flat_map_attr_default();
+    ck_assert(attr != NULL);
+
+    attr->numa   = FLAT_MAP_NUMA_REPLICATE;
+    attr->layout = FLAT_MAP_LAYOUT_PAGED;
+    ck_assert(NULL == flat_map_new_with_attr(attr));
+
+    flat_map_attr_delete(attr);
+
+    // the machine may have a single node, in which case
+    // every node but the first is simulated
+    for (size_t i = 0; i < 9; ++i)
+    {
+        attr = flat_map_attr_default();
+        ck_assert(attr != NULL);
+
+        attr->page_size     = 4;
+        attr->deleter       = delete_point;
+        attr->numa          = policies[i % 3];
+        attr->numa_nodes    = 2 + (i % 2);
+        attr->probing       = probings[i / 3];
+        attr->resize_policy = FLAT_MAP_RESIZE_INCREMENTAL;
+
+        flat_map_t* map = flat_map_new_with_attr(attr);
+        ck_assert(map != NULL);
+
+        for (map_key_t k = 1; k <= N_STABLE_KEYS; ++k)
+        {
+            ck_assert(flat_map_insert(map, k, make_point((float)k, (float)k), NULL));
+        }
+
+        for (map_key_t k = 1; k <= N_STABLE_KEYS; k += 2)
+        {
+            ck_assert(flat_map_remove(map, k));
+        }
+
+        // lookups on each node observe every write
+        for (int node = 0; node < (int)attr->numa_nodes; ++node)
+        {
+            flat_map_set_thread_node(node);
+
+            for (map_key_t k = 1; k <= N_STABLE_KEYS; ++k)
+            {
+                point_t* p = (point_t*)flat_map_find(map, k);
+                if (k % 2 == 1)
+                {
+                    ck_assert(NULL == p);
+                }
+                else
+                {
+                    ck_assert(p != NULL);
+                    ck_assert(p->x == (float)k);
+                }
+            }
+        }
+
+        flat_map_set_thread_node(-1);
+
+        // readers on the default node find the stable keys while
+        // writers insert others, resizing the map
+        for (map_key_t k = 1; k <= N_STABLE_KEYS; k += 2)
+        {
+            ck_assert(flat_map_insert(map, k, make_point((float)k, (float)k), NULL));
+        }
+
+        bool stop = false;
+
+        pthread_t writers[N_CONCURRENT_WRITERS];
+        pthread_t readers[N_CONCURRENT_READERS];
+        concurrent_arg_t writer_args[N_CONCURRENT_WRITERS];
+        concurrent_arg_t reader_args[N_CONCURRENT_READERS];
+
+        for (size_t j = 0; j < N_CONCURRENT_READERS; ++j)
+        {
+            reader_args[j] = (concurrent_arg_t){ .map = map, .id = j, .stop = &stop };
+            ck_assert(0 == pthread_create(&readers[j], NULL, hopscotch_reader, &reader_args[j]));
+        }
+
+        for (size_t j = 0; j < N_CONCURRENT_WRITERS; ++j)
+        {
+            writer_args[j] = (concurrent_arg_t){ .map = map, .id = j, .stop = NULL };
+            ck_assert(0 == pthread_create(&writers[j], NULL, hopscotch_writer, &writer_args[j]));
+        }
+
+        for (size_t j = 0; j < N_CONCURRENT_WRITERS; ++j)
+        {
+            ck_assert(0 == pthread_join(writers[j], NULL));
+        }
+
+        __atomic_store_n(&stop, true, __ATOMIC_RELEASE);
+
+        for (size_t j = 0; j < N_CONCURRENT_READERS; ++j)
+        {
+            ck_assert(0 == pthread_join(readers[j], NULL));
+        }
+
+        ck_assert(flat_map_size(map) == 4*N_STABLE_KEYS);
+
+        flat_map_delete(map);
+
+        // keys loaded in bulk are placed without the page locks
+        map = flat_map_new_with_attr(attr);
+        ck_assert(map != NULL);
+
+        map_key_t keys[64];
+        void* values[64];
+        for (size_t j = 0; j < 64; ++j)
+        {
+            keys[j]   = j + 1;
+            values[j] = make_point((float)(j + 1), 0.0f);
+        }
+
+        ck_assert(flat_map_bulk_load(map, keys, values, 64));
+
+        flat_map_set_thread_node((int)attr->numa_nodes - 1);
+        for (map_key_t k = 1; k <= 64; ++k)
+        {
+            point_t* p = (point_t*)flat_map_find(map, k);
+            ck_assert(p != NULL);
+            ck_assert(p->x == (float)k);
+        }
+
+        flat_map_set_thread_node(-1);
+
+        flat_map_delete(map);
+        flat_map_attr_delete(attr);
+    }
+}
+END_TEST
+
+START_TEST(test_flat_map_batch)
+{
+    flat_map_t* map = flat_map_new(4, delete_point);
+    ck_assert(map != NULL);
+
+    map_key_t keys[400];
+    void* values[400];
+    void* out[400];
+
+    for (size_t i = 0; i < 200; ++i)
+    {
+        keys[i]   = (map_key_t)(i + 1);
+        values[i] = make_point((float)(i + 1), 0.0f);
+    }
+
+    ck_assert(flat_map_insert_batch(map, keys, values, out, 200) == 200);
+    for (size_t i = 0; i < 200; ++i)
+    {
+        ck_assert(NULL == out[i]);
+    }
+
+    // update the first 100 keys; the reserved key is rejected
+    for (size_t i = 0; i < 100; ++i)
+    {
+        values[i] = make_point((float)(i + 1), 1.0f);
+    }
+
+    keys[100]   = 0;
+    values[100] = NULL;
+
+    ck_assert(flat_map_insert_batch(map, keys, values, out, 101) == 100);
+    for (size_t i = 0; i < 100; ++i)
+    {
+        ck_assert(out[i] != NULL);
+        delete_point(out[i]);
+    }
+
+    ck_assert(NULL == out[100]);
+
+    // search for both present and absent keys
+    for (size_t i = 0; i < 400; ++i)
+    {
+        keys[i] = (map_key_t)(i + 1);
+    }
+
+    ck_assert(flat_map_find_batch(map, keys, values, 400) == 200);
+    for (size_t i = 0; i < 400; ++i)
+    {
+        point_t* p = (point_t*)values[i];
+        if (i < 200)
+        {
+            ck_assert(p != NULL);
+            ck_assert(p->x == (float)(i + 1));
+            ck_assert(p->y == ((i < 100) ? 1.0f : 0.0f));
+        }
+        else
+        {
+            ck_assert(NULL == p);
+        }
+    }
+
+    flat_map_delete(map);
+}
+END_TEST
+
+START_TEST(test_flat_map_paged_layout)
+{
+    const size_t page_sizes[] = { 1, 8, 256 };
+
+    for (size_t i = 0; i < sizeof(page_sizes)/sizeof(page_sizes[0]); ++i)
+    {
+        flat_map_attr_t* attr = flat_map_attr_default();
+        ck_assert(attr != NULL);
+
+        attr->page_size     = page_sizes[i];
+        attr->deleter       = delete_point;
+        attr->resize_policy = FLAT_MAP_RESIZE_INCREMENTAL;
+        attr->layout        = FLAT_MAP_LAYOUT_PAGED;
+
+        flat_map_t* map = flat_map_new_with_attr(attr);
+        ck_assert(map != NULL);
+
+        for (map_key_t k = 1; k <= 1024; ++k)
+        {
+            ck_assert(flat_map_insert(map, k, make_point((float)k, (float)k), NULL));
+        }
+
+        for (map_key_t k = 1; k <= 1024; k += 2)
+        {
+            ck_assert(flat_map_remove(map, k));
+        }
+
+        for (map_key_t k = 1; k <= 1024; ++k)
+        {
+            point_t* p = (point_t*)flat_map_find(map, k);
+            if (k % 2 == 1)
+            {
+                ck_assert(NULL == p);
+            }
+            else
+            {
+                ck_assert(p != NULL);
+                ck_assert(p->x == (float)k);
+            }
+        }
+
+        flat_map_delete(map);
+        flat_map_attr_delete(attr);
+    }
+}
+END_TEST
+
+START_TEST(test_flat_map_compact)
+{
+    const flat_map_resize_policy_t policies[] = {
+        FLAT_MAP_RESIZE_BLOCKING, FLAT_MAP_RESIZE_INCREMENTAL };
+    const flat_map_probing_t probings[] = {
+        FLAT_MAP_PROBING_LINEAR, FLAT_MAP_PROBING_ROBIN_HOOD };
+
+    for (size_t i = 0; i < 4; ++i)
+    {
+        flat_map_attr_t* attr = flat_map_attr_default();
+        ck_assert(attr != NULL);
+
+        attr->page_size     = 4;
+        attr->deleter       = delete_point;
+        attr->resize_policy = policies[i % 2];
+        attr->probing       = probings[i / 2];
+
+        flat_map_t* map = flat_map_new_with_attr(attr);
+        ck_assert(map != NULL);
+
+        for (map_key_t k = 1; k <= 4096; ++k)
+        {
+            ck_assert(flat_map_insert(map, k, make_point((float)k, (float)k), NULL));
+        }
+
+        for (map_key_t k = 1; k <= 4096; ++k)
+        {
+            if (k % 64 != 0)
+            {
+                ck_assert(flat_map_remove(map, k));
+            }
+        }
+
+        ck_assert(flat_map_compact(map));
+        ck_assert(flat_map_compact(map));
+
+        for (map_key_t k = 1; k <= 4096; ++k)
+        {
+            point_t* p = (point_t*)flat_map_find(map, k);
+            if (k % 64 == 0)
+            {
+                ck_assert(p != NULL);
+                ck_assert(p->x == (float)k);
+            }
+            else
+            {
+                ck_assert(NULL == p);
+            }
+        }
+
+        // churn through many distinct keys, such that tombstones
+        // accumulate and are purged in place as the map fills
+        for (map_key_t k = 8192; k < 8192 + 65536; ++k)
+        {
+            ck_assert(flat_map_insert(map, k, make_point((float)k, (float)k), NULL));
+            ck_assert(flat_map_remove(map, k));
+        }
+
+        for (map_key_t k = 64; k <= 4096; k += 64)
+        {
+            ck_assert(flat_map_contains(map, k));
+        }
+
+        flat_map_delete(map);
+        flat_map_attr_delete(attr);
+    }
+}
+END_TEST
+
+START_TEST(test_flat_map_new_with_capacity)
+{
+    flat_map_t* map = flat_map_new_with_capacity(8, delete_point, 10000);
+    ck_assert(map != NULL);
+
+    for (map_key_t k = 1; k <= 10000; ++k)
+    {
+        ck_assert(flat_map_insert(map, k, make_point((float)k, (float)k), NULL));
+    }
+
+    for (map_key_t k = 1; k <= 10000; ++k)
+    {
+        point_t* p = (point_t*)flat_map_find(map, k);
+        ck_assert(p != NULL);
+        ck_assert(p->x == (float)k);
+    }
+
+    flat_map_delete(map);
+}
+END_TEST
+
+START_TEST(test_flat_map_bulk_load)
+{
+    const size_t n_keys = 10000;
+
+    for (size_t i = 0; i < 3; ++i)
+    {
+        flat_map_attr_t* attr = flat_map_attr_default();
+        ck_assert(attr != NULL);
+
+        attr->deleter       = delete_point;
+        attr->probing       = (1 == i) ? FLAT_MAP_PROBING_ROBIN_HOOD : FLAT_MAP_PROBING_LINEAR;
+        attr->control_bytes = (2 == i);
+
+        flat_map_t* map = flat_map_new_with_attr(attr);
+        ck_assert(map != NULL);
+
+        map_key_t* keys = malloc((n_keys + 1)*sizeof(map_key_t));
+        void** values   = malloc((n_keys + 1)*sizeof(void*));
+        ck_assert(keys != NULL && values != NULL);
+
+        for (size_t j = 0; j < n_keys; ++j)
+        {
+            keys[j]   = (map_key_t)(j + 1);
+            values[j] = make_point((float)(j + 1), 0.0f);
+        }
+
+        // a repeated key takes its final value
+        keys[n_keys]   = 1;
+        values[n_keys] = make_point(1.0f, 1.0f);
+
+        ck_assert(flat_map_bulk_load(map, keys, values, n_keys + 1));
+
+        for (map_key_t k = 1; k <= n_keys; ++k)
+        {
+            point_t* p = (point_t*)flat_map_find(map, k);
+            ck_assert(p != NULL);
+            ck_assert(p->x == (float)k);
+            ck_assert(p->y == ((1 == k) ? 1.0f : 0.0f));
+        }
+
+        ck_assert(!flat_map_contains(map, n_keys + 1));
+
+        // the map is no longer empty
+        ck_assert(!flat_map_bulk_load(map, keys, values, 1));
+
+        // the map remains fully functional after the load
+        for (map_key_t k = 1; k <= n_keys; k += 2)
+        {
+            ck_assert(flat_map_remove(map, k));
+        }
+
+        for (map_key_t k = n_keys + 1; k <= 2*n_keys; ++k)
+        {
+            ck_assert(flat_map_insert(map, k, make_point((float)k, 0.0f), NULL));
+        }
+
+        for (map_key_t k = 1; k <= 2*n_keys; ++k)
+        {
+            ck_assert(flat_map_contains(map, k) == (k > n_keys || k % 2 == 0));
+        }
+
+        free(keys);
+        free(values);
+        flat_map_delete(map);
+        flat_map_attr_delete(attr);
+    }
+
+    // reserved keys are rejected
+    flat_map_t* map = flat_map_new(8, delete_point);
+    ck_assert(map != NULL);
+
+    map_key_t keys[]   = { 1, 0 };
+    void*     values[] = { NULL, NULL };
+    ck_assert(!flat_map_bulk_load(map, keys, values, 2));
+
+    flat_map_delete(map);
+}
+END_TEST
+
+START_TEST(test_flat_map_parallel_resize)
+{
+    const flat_map_probing_t probings[] = {
+        FLAT_MAP_PROBING_LINEAR, FLAT_MAP_PROBING_ROBIN_HOOD };
+
+    for (size_t i = 0; i < 2; ++i)
+    {
+        flat_map_attr_t* attr = flat_map_attr_default();
+        ck_assert(attr != NULL);
+
+        attr->page_size      = 4;
+        attr->deleter        = delete_point;
+        attr->probing        = probings[i];
+        attr->resize_threads = 4;
+
+        flat_map_t* map = flat_map_new_with_attr(attr);
+        ck_assert(map != NULL);
+
+        // large enough that the final resizes are parallel
+        for (map_key_t k = 1; k <= 200000; ++k)
+        {
+            ck_assert(flat_map_insert(map, k, make_point((float)k, (float)k), NULL));
+        }
+
+        for (map_key_t k = 1; k <= 200000; ++k)
+        {
+            point_t* p = (point_t*)flat_map_find(map, k);
+            ck_assert(p != NULL);
+            ck_assert(p->x == (float)k);
+        }
+
+        flat_map_delete(map);
+
+        attr->resize_threads = 0;
+        ck_assert(NULL == flat_map_new_with_attr(attr));
+
+        flat_map_attr_delete(attr);
+    }
+}
+END_TEST
+
+START_TEST(test_flat_map_size)
+{
+    const flat_map_probing_t probings[] = {
+        FLAT_MAP_PROBING_LINEAR, FLAT_MAP_PROBING_ROBIN_HOOD };
+
+    for (size_t i = 0; i < 2; ++i)
+    {
+        flat_map_attr_t* attr = flat_map_attr_default();
+        ck_assert(attr != NULL);
+
+        attr->page_size = 4;
+        attr->deleter   = delete_point;
+        attr->probing   = probings[i];
+
+        flat_map_t* map = flat_map_new_with_attr(attr);
+        ck_assert(map != NULL);
+        ck_assert(flat_map_size(map) == 0);
+
+        // large enough that the counts are sharded
+        for (map_key_t k = 1; k <= 100000; ++k)
+        {
+            ck_assert(flat_map_insert(map, k, make_point((float)k, (float)k), NULL));
+        }
+
+        ck_assert(flat_map_size(map) == 100000);
+
+        // updates do not change the count
+        for (map_key_t k = 1; k <= 1000; ++k)
+        {
+            void* out = NULL;
+            ck_assert(flat_map_insert(map, k, make_point((float)k, (float)k), &out));
+            delete_point(out);
+        }
+
+        ck_assert(flat_map_size(map) == 100000);
+
+        for (map_key_t k = 1; k <= 100000; k += 2)
+        {
+            ck_assert(flat_map_remove(map, k));
+        }
+
+        ck_assert(flat_map_size(map) == 50000);
+
+        ck_assert(flat_map_compact(map));
+        ck_assert(flat_map_size(map) == 50000);
+
+        flat_map_delete(map);
+        flat_map_attr_delete(attr);
+    }
+}
+END_TEST
+
+START_TEST(test_flat_map_compute)
+{
+    const flat_map_probing_t probings[] = {
+        FLAT_MAP_PROBING_LINEAR, FLAT_MAP_PROBING_ROBIN_HOOD };
+    const flat_map_resize_policy_t policies[] = {
+        FLAT_MAP_RESIZE_BLOCKING, FLAT_MAP_RESIZE_INCREMENTAL };
+
+    for (size_t i = 0; i < 4; ++i)
+    {
+        flat_map_attr_t* attr = flat_map_attr_default();
+        ck_assert(attr != NULL);
+
+        attr->page_size     = 4;
+        attr->deleter       = delete_point;
+        attr->probing       = probings[i % 2];
+        attr->resize_policy = policies[i / 2];
+
+        flat_map_t* map = flat_map_new_with_attr(attr);
+        ck_assert(map != NULL);
+
+        // a NULL result for an absent key inserts nothing
+        ck_assert(NULL == flat_map_compute(map, 1, replace_point, NULL));
+        ck_assert(!flat_map_contains(map, 1));
+        ck_assert(flat_map_size(map) == 0);
+
+        // the first computation for each key inserts it, and
+        // the subsequent computations update it in place
+        for (size_t round = 0; round < 3; ++round)
+        {
+            for (map_key_t k = 1; k <= 10000; ++k)
+            {
+                point_t* p = (point_t*)flat_map_compute(map, k, count_point, NULL);
+                ck_assert(p != NULL);
+                ck_assert(p->x == (float)(round + 1));
+            }
+        }
+
+        ck_assert(flat_map_size(map) == 10000);
+
+        // a replaced value is destroyed by the map
+        for (map_key_t k = 1; k <= 10000; ++k)
+        {
+            point_t* p = (point_t*)flat_map_compute(map, k, replace_point, NULL);
+            ck_assert(p != NULL);
+            ck_assert(p == flat_map_find(map, k));
+            ck_assert(p->x == (float)k);
+        }
+
+        ck_assert(flat_map_size(map) == 10000);
+
+        flat_map_delete(map);
+        flat_map_attr_delete(attr);
+    }
+
+    // concurrent computations for the same key are serialized
+    for (size_t i = 0; i < 2; ++i)
+    {
+        flat_map_attr_t* attr = flat_map_attr_default();
+        ck_assert(attr != NULL);
+
+        attr->page_size     = 4;
+        attr->deleter       = delete_point;
+        attr->resize_policy = policies[i];
+
+        flat_map_t* map = flat_map_new_with_attr(attr);
+        ck_assert(map != NULL);
+
+        pthread_t writers[N_CONCURRENT_WRITERS];
+        concurrent_arg_t args[N_CONCURRENT_WRITERS];
+
+        for (size_t j = 0; j < N_CONCURRENT_WRITERS; ++j)
+        {
+            args[j].map  = map;
+            args[j].id   = j;
+            args[j].stop = NULL;
+            ck_assert(0 == pthread_create(&writers[j], NULL, compute_writer, &args[j]));
+        }
+
+        for (size_t j = 0; j < N_CONCURRENT_WRITERS; ++j)
+        {
+            ck_assert(0 == pthread_join(writers[j], NULL));
+        }
+
+        ck_assert(flat_map_size(map) == N_COMPUTE_KEYS);
+        for (map_key_t k = 1; k <= N_COMPUTE_KEYS; ++k)
+        {
+            point_t* p = (point_t*)flat_map_find(map, k);
+            ck_assert(p != NULL);
+            ck_assert(p->x == (float)(N_CONCURRENT_WRITERS*N_COMPUTE_ROUNDS));
+        }
+
+        flat_map_delete(map);
+        flat_map_attr_delete(attr);
+    }
+}
+END_TEST
+
+START_TEST(test_flat_map_stats)
+{
+    flat_map_stats_t stats;
+    ck_assert(!flat_map_get_stats(NULL, &stats));
+
+    flat_map_t* map = flat_map_new(4, delete_point);
+    ck_assert(map != NULL);
+
+    for (map_key_t k = 1; k <= 1000; ++k)
+    {
+        ck_assert(flat_map_insert(map, k, make_point((float)k, (float)k), NULL));
+    }
+
+    for (map_key_t k = 1; k <= 1000; k += 2)
+    {
+        ck_assert(flat_map_remove(map, k));
+    }
+
+    for (map_key_t k = 1; k <= 1000; ++k)
+    {
+        flat_map_find(map, k);
+    }
+
+    if (!flat_map_get_stats(map, &stats))
+    {
+        // statistics are compiled out
+        ck_assert(0 == stats.resizes);
+        ck_assert(0 == stats.lock_acquisitions);
+        flat_map_delete(map);
+        return;
+    }
+
+    // each insert, remove, and find is recorded once
+    uint64_t n_probes = 0;
+    uint64_t n_crossings = 0;
+    for (size_t i = 0; i < FLAT_MAP_STATS_BUCKETS; ++i)
+    {
+        n_probes    += stats.probe_length[i];
+        n_crossings += stats.pages_crossed[i];
+    }
+
+    ck_assert(n_probes == 2500);
+    ck_assert(n_crossings == 2500);
+
+    // the map grew from its initial capacity, without
+    // resizing since the removals left their tombstones
+    ck_assert(stats.resizes > 0);
+    ck_assert(stats.resize_ns >= stats.max_resize_ns);
+    ck_assert(stats.tombstones == 500);
+
+    // inserts and removes each lock at least one page
+    ck_assert(stats.lock_acquisitions >= 1500);
+    ck_assert(stats.lock_contentions <= stats.lock_acquisitions);
+
+    flat_map_delete(map);
+}
+END_TEST
+
+START_TEST(test_flat_map_lock_kinds)
+{
+    const flat_map_lock_kind_t lock_kinds[] = {
+        FLAT_MAP_LOCK_PTHREAD_RWLOCK, FLAT_MAP_LOCK_SPINLOCK,
+        FLAT_MAP_LOCK_TICKET, FLAT_MAP_LOCK_RWLOCK };
+    const flat_map_probing_t probings[] = {
+        FLAT_MAP_PROBING_LINEAR, FLAT_MAP_PROBING_ROBIN_HOOD };
+    const flat_map_layout_t layouts[] = {
+        FLAT_MAP_LAYOUT_SPLIT, FLAT_MAP_LAYOUT_PAGED };
+
+    for (size_t i = 0; i < 16; ++i)
+    {
+        flat_map_attr_t* attr = flat_map_attr_default();
+        ck_assert(attr != NULL);
+
+        attr->page_size = 4;
+        attr->deleter   = delete_point;
+        attr->lock_kind = lock_kinds[i % 4];
+        attr->probing   = probings[(i / 4) % 2];
+        attr->layout    = layouts[i / 8];
+
+        flat_map_t* map = flat_map_new_with_attr(attr);
+        ck_assert(map != NULL);
+
+        // the counts are only exact if the page locks exclude
+        // concurrent computations for keys in the same page
+        pthread_t writers[N_CONCURRENT_WRITERS];
+        concurrent_arg_t args[N_CONCURRENT_WRITERS];
+
+        for (size_t j = 0; j < N_CONCURRENT_WRITERS; ++j)
+        {
+            args[j] = (concurrent_arg_t){ .map = map, .id = j, .stop = NULL };
+            ck_assert(0 == pthread_create(&writers[j], NULL, compute_writer, &args[j]));
+        }
+
+        for (size_t j = 0; j < N_CONCURRENT_WRITERS; ++j)
+        {
+            ck_assert(0 == pthread_join(writers[j], NULL));
+        }
+
+        for (map_key_t k = 1; k <= N_COMPUTE_KEYS; ++k)
+        {
+            point_t* p = (point_t*)flat_map_find(map, k);
+            ck_assert(p != NULL);
+            ck_assert(p->x == (float)(N_CONCURRENT_WRITERS*N_COMPUTE_ROUNDS));
+        }
+
+        for (map_key_t k = 1; k <= N_COMPUTE_KEYS; ++k)
+        {
+            ck_assert(flat_map_remove(map, k));
+        }
+
+        ck_assert(flat_map_size(map) == 0);
+
+        flat_map_delete(map);
+        flat_map_attr_delete(attr);
+    }
+}
+END_TEST
+
+START_TEST(test_flat_map_reclaim)
+{
+    flat_map_attr_t* attr = flat_map_attr_default();
+    ck_assert(attr != NULL);
+
+    attr->page_size = 4;
+    attr->deleter   = reclaim_point;
+    attr->reclaim   = FLAT_MAP_RECLAIM_DEFERRED;
+
+    n_reclaimed_points = 0;
+
+    flat_map_t* map = flat_map_new_with_attr(attr);
+    ck_assert(map != NULL);
+
+    for (map_key_t k = 1; k <= N_RECLAIM_KEYS; ++k)
+    {
+        ck_assert(flat_map_insert(map, k, make_point((float)k, (float)k), NULL));
+    }
+
+    // a value removed within a read-side critical section
+    // is not destroyed until the section ends
+    rcu_handle_t handle = flat_map_enter(map);
+
+    point_t* p = (point_t*)flat_map_find(map, 1);
+    ck_assert(p != NULL);
+    ck_assert(flat_map_remove(map, 1));
+    ck_assert(!flat_map_contains(map, 1));
+    ck_assert(p->x == 1.0f);
+
+    flat_map_leave(map, handle);
+
+    flat_map_synchronize(map);
+    ck_assert(1 == n_reclaimed_points);
+
+    ck_assert(flat_map_insert(map, 1, make_point(1.0f, 1.0f), NULL));
+
+    // readers never observe a destroyed value
+    bool stop = false;
+
+    pthread_t writers[N_CONCURRENT_WRITERS];
+    pthread_t readers[N_CONCURRENT_READERS];
+    concurrent_arg_t writer_args[N_CONCURRENT_WRITERS];
+    concurrent_arg_t reader_args[N_CONCURRENT_READERS];
+
+    for (size_t i = 0; i < N_CONCURRENT_READERS; ++i)
+    {
+        reader_args[i] = (concurrent_arg_t){ .map = map, .id = i, .stop = &stop };
+        ck_assert(0 == pthread_create(&readers[i], NULL, reclaim_reader, &reader_args[i]));
+    }
+
+    for (size_t i = 0; i < N_CONCURRENT_WRITERS; ++i)
+    {
+        writer_args[i] = (concurrent_arg_t){ .map = map, .id = i, .stop = NULL };
+        ck_assert(0 == pthread_create(&writers[i], NULL, reclaim_writer, &writer_args[i]));
+    }
+
+    for (size_t i = 0; i < N_CONCURRENT_WRITERS; ++i)
+    {
+        ck_assert(0 == pthread_join(writers[i], NULL));
+    }
+
+    __atomic_store_n(&stop, true, __ATOMIC_RELEASE);
+
+    for (size_t i = 0; i < N_CONCURRENT_READERS; ++i)
+    {
+        ck_assert(0 == pthread_join(readers[i], NULL));
+    }
+
+    // every replaced value is destroyed once no reader remains
+    flat_map_synchronize(map);
+    ck_assert(n_reclaimed_points == 1 + N_RECLAIM_ROUNDS*N_RECLAIM_KEYS);
+
+    flat_map_delete(map);
+    ck_assert(n_reclaimed_points == 1 + (N_RECLAIM_ROUNDS + 1)*N_RECLAIM_KEYS);
+
+    flat_map_attr_delete(attr);
+}
+END_TEST
+
+START_TEST(test_flat_map_memory)
+{
+    const flat_map_memory_t memories[] = {
+        FLAT_MAP_MEMORY_HEAP, FLAT_MAP_MEMORY_MAPPED, FLAT_MAP_MEMORY_HUGETLB };
+    const flat_map_layout_t layouts[] = {
+        FLAT_MAP_LAYOUT_SPLIT, FLAT_MAP_LAYOUT_PAGED };
+
+    for (size_t i = 0; i < 6; ++i)
+    {
+        flat_map_attr_t* attr = flat_map_attr_default();
+        ck_assert(attr != NULL);
+
+        attr->page_size = 8;
+        attr->deleter   = delete_point;
+        attr->memory    = memories[i % 3];
+        attr->layout    = layouts[i / 3];
+
+        flat_map_t* map = flat_map_new_with_attr(attr);
+        ck_assert(map != NULL);
+
+        // large enough that the final tables span several huge pages
+        for (map_key_t k = 1; k <= 200000; ++k)
+        {
+            ck_assert(flat_map_insert(map, k, make_point((float)k, (float)k), NULL));
+        }
+
+        for (map_key_t k = 1; k <= 200000; k += 2)
+        {
+            ck_assert(flat_map_remove(map, k));
+        }
+
+        for (map_key_t k = 1; k <= 200000; ++k)
+        {
+            point_t* p = (point_t*)flat_map_find(map, k);
+            if (k % 2 == 0)
+            {
+                ck_assert(p != NULL);
+                ck_assert(p->x == (float)k);
+            }
+            else
+            {
+                ck_assert(NULL == p);
+            }
+        }
+
+        ck_assert(flat_map_compact(map));
+
+        flat_map_delete(map);
+        flat_map_attr_delete(attr);
+    }
+}
+END_TEST
+
+START_TEST(test_flat_map_snapshot)
+{
+    const char* path = SNAPSHOT_PATH;
+
+    const flat_map_probing_t probings[] = {
+        FLAT_MAP_PROBING_LINEAR, FLAT_MAP_PROBING_ROBIN_HOOD };
+
+    for (size_t i = 0; i < 2; ++i)
+    {
+        flat_map_attr_t* attr = flat_map_attr_default();
+        ck_assert(attr != NULL);
+
+        attr->page_size     = 4;
+        attr->deleter       = delete_point;
+        attr->probing       = probings[i];
+        attr->resize_policy = FLAT_MAP_RESIZE_INCREMENTAL;
+
+        flat_map_t* map = flat_map_new_with_attr(attr);
+        ck_assert(map != NULL);
+        flat_map_attr_delete(attr);
+
+        for (map_key_t k = 1; k <= 10000; ++k)
+        {
+            ck_assert(flat_map_insert(map, k, make_point((float)k, (float)k), NULL));
+        }
+
+        for (map_key_t k = 1; k <= 10000; k += 3)
+        {
+            ck_assert(flat_map_remove(map, k));
+        }
+
+        // values are copied into the blob of the snapshot
+        ck_assert(flat_map_save(map, path, sizeof(point_t)));
+        flat_map_delete(map);
+
+        map = flat_map_open_mapped(path, delete_point);
+        ck_assert(map != NULL);
+        ck_assert(flat_map_size(map) == 6666);
+
+        for (map_key_t k = 1; k <= 10000; ++k)
+        {
+            point_t* p = (point_t*)flat_map_find(map, k);
+            if (k % 3 == 1)
+            {
+                ck_assert(NULL == p);
+            }
+            else
+            {
+                ck_assert(p != NULL);
+                ck_assert(p->x == (float)k);
+            }
+        }
+
+        // a second instance of the snapshot finds the address of
+        // its blob in use by the first, so its values are relocated
+        flat_map_t* second = flat_map_open_mapped(path, delete_point);
+        ck_assert(second != NULL);
+
+        for (map_key_t k = 2; k <= 10000; k += 3)
+        {
+            point_t* p = (point_t*)flat_map_find(second, k);
+            ck_assert(p != NULL);
+            ck_assert(p->x == (float)k);
+            ck_assert(p != flat_map_find(map, k));
+        }
+
+        flat_map_delete(second);
+
+        // values in the snapshot are never passed to the deleter,
+        // while values inserted after the map is opened are
+        for (map_key_t k = 2; k <= 10000; k += 3)
+        {
+            ck_assert(flat_map_remove(map, k));
+        }
+
+        for (map_key_t k = 10001; k <= 20000; ++k)
+        {
+            ck_assert(flat_map_insert(map, k, make_point((float)k, (float)k), NULL));
+        }
+
+        ck_assert(flat_map_size(map) == 13333);
+        ck_assert(flat_map_contains(map, 3));
+        ck_assert(flat_map_contains(map, 20000));
+
+        flat_map_delete(map);
+    }
+
+    // values stored inline
+    flat_map_t* map = flat_map_new(8, delete_point);
+    ck_assert(map != NULL);
+
+    for (map_key_t k = 1; k <= 1000; ++k)
+    {
+        ck_assert(flat_map_insert(map, k, (void*)(uintptr_t)(k*2), NULL));
+    }
+
+    ck_assert(flat_map_save(map, path, 0));
+
+    flat_map_t* opened = flat_map_open_mapped(path, delete_point);
+    ck_assert(opened != NULL);
+
+    for (map_key_t k = 1; k <= 1000; ++k)
+    {
+        ck_assert((uintptr_t)flat_map_find(opened, k) == k*2);
+    }
+
+    // concurrent saves to the same path each write a file of their
+    // own, and the last to complete replaces the file whole
+    pthread_t        savers[N_CONCURRENT_WRITERS];
+    concurrent_arg_t save_args[N_CONCURRENT_WRITERS];
+
+    for (size_t i = 0; i < N_CONCURRENT_WRITERS; ++i)
+    {
+        save_args[i] = (concurrent_arg_t){ .map = map, .id = i, .stop = NULL };
+        pthread_create(&savers[i], NULL, snapshot_saver, &save_args[i]);
+    }
+
+    for (size_t i = 0; i < N_CONCURRENT_WRITERS; ++i)
+    {
+        pthread_join(savers[i], NULL);
+    }
+
+    flat_map_t* reopened = flat_map_open_mapped(path, delete_point);
+    ck_assert(reopened != NULL);
+    ck_assert(flat_map_size(reopened) == 1000);
+
+    for (map_key_t k = 1; k <= 1000; ++k)
+    {
+        ck_assert((uintptr_t)flat_map_find(reopened, k) == k*2);
+
+        void* out = NULL;
+        ck_assert(flat_map_insert(reopened, k, NULL, &out));
+    }
+
+    flat_map_delete(reopened);
+
+    // the integers are not pointers to be destroyed
+    for (map_key_t k = 1; k <= 1000; ++k)
+    {
+        void* out = NULL;
+        ck_assert(flat_map_insert(map, k, NULL, &out));
+        ck_assert(flat_map_insert(opened, k, NULL, &out));
+    }
+
+    flat_map_delete(map);
+    flat_map_delete(opened);
+
+    // a truncated snapshot is rejected
+    ck_assert(0 == truncate(path, 100));
+    ck_assert(NULL == flat_map_open_mapped(path, delete_point));
+    ck_assert(NULL == flat_map_open_mapped("/nonexistent/snapshot", delete_point));
+
+    unlink(path);
+}
+END_TEST
+
+START_TEST(test_flat_map_typed)
+{
+    ck_assert(NULL == point_map_new(3));
+
+    point_map_t* map = point_map_new(4);
+    ck_assert(map != NULL);
+
+    // every value of the key type is a valid key
+    ck_assert(point_map_insert(map, 0, (point_t){ 1.0f, 2.0f }));
+    ck_assert(point_map_insert(map, UINT64_MAX, (point_t){ 3.0f, 4.0f }));
+
+    point_t p;
+    ck_assert(point_map_find(map, 0, &p));
+    ck_assert(p.x == 1.0f && p.y == 2.0f);
+    ck_assert(point_map_find(map, UINT64_MAX, &p));
+    ck_assert(p.x == 3.0f && p.y == 4.0f);
+
+    // an insert of a present key replaces its value
+    ck_assert(point_map_insert(map, 0, (point_t){ 5.0f, 6.0f }));
+    ck_assert(point_map_find(map, 0, &p));
+    ck_assert(p.x == 5.0f);
+    ck_assert(point_map_size(map) == 2);
+
+    ck_assert(point_map_remove(map, 0, &p));
+    ck_assert(p.x == 5.0f);
+    ck_assert(!point_map_remove(map, 0, NULL));
+    ck_assert(!point_map_contains(map, 0));
+    ck_assert(point_map_remove(map, UINT64_MAX, NULL));
+    ck_assert(point_map_size(map) == 0);
+
+    pthread_t   writers[N_CONCURRENT_WRITERS];
+    typed_arg_t args[N_CONCURRENT_WRITERS];
+
+    for (size_t i = 0; i < N_CONCURRENT_WRITERS; ++i)
+    {
+        args[i] = (typed_arg_t){ .map = map, .id = i };
+        pthread_create(&writers[i], NULL, typed_writer, &args[i]);
+    }
+
+    for (size_t i = 0; i < N_CONCURRENT_WRITERS; ++i)
+    {
+        pthread_join(writers[i], NULL);
+    }
+
+    ck_assert(point_map_size(map) == N_TYPED_KEYS);
+
+    for (uint64_t k = 0; k < N_TYPED_KEYS; ++k)
+    {
+        ck_assert(point_map_find(map, k, &p));
+        ck_assert(p.x == (float)k);
+    }
+
+    // churn leaves tombstones, which are purged by resize
+    for (uint64_t k = 0; k < N_TYPED_KEYS; ++k)
+    {
+        ck_assert(point_map_remove(map, k, NULL));
+        ck_assert(point_map_insert(map, k + N_TYPED_KEYS, (point_t){ (float)k, (float)k }));
+    }
+
+    ck_assert(point_map_size(map) == N_TYPED_KEYS);
+
+    point_map_delete(map);
+}
+END_TEST
+
+START_TEST(test_flat_map_concurrent)
+{
+    flat_map_t* map = flat_map_new(4, delete_point);
+    ck_assert(map != NULL);
+
+    bool stop = false;
+
+    pthread_t writers[N_CONCURRENT_WRITERS];
+    pthread_t readers[N_CONCURRENT_READERS];
+
+    concurrent_arg_t writer_args[N_CONCURRENT_WRITERS];
+    concurrent_arg_t reader_args[N_CONCURRENT_READERS];
+
+    for (size_t i = 0; i < N_CONCURRENT_READERS; ++i)
+    {
+        reader_args[i] = (concurrent_arg_t){ .map = map, .id = i, .stop = &stop };
+        pthread_create(&readers[i], NULL, concurrent_reader, &reader_args[i]);
+    }
+
+    for (size_t i = 0; i < N_CONCURRENT_WRITERS; ++i)
+    {
+        writer_args[i] = (concurrent_arg_t){ .map = map, .id = i, .stop = &stop };
+        pthread_create(&writers[i], NULL, concurrent_writer, &writer_args[i]);
+    }
+
+    for (size_t i = 0; i < N_CONCURRENT_WRITERS; ++i)
+    {
+        pthread_join(writers[i], NULL);
+    }
+
+    __atomic_store_n(&stop, true, __ATOMIC_RELEASE);
+
+    for (size_t i = 0; i < N_CONCURRENT_READERS; ++i)
+    {
+        pthread_join(readers[i], NULL);
+    }
+
+    // every key inserted by the writers is now visible
+    for (map_key_t k = 1; k <= N_CONCURRENT_KEYS; ++k)
+    {
+        point_t* p = (point_t*)flat_map_find(map, k);
+        ck_assert(p != NULL);
+        ck_assert(p->x == (float)k);
+    }
+
+    ck_assert(flat_map_size(map) == N_CONCURRENT_KEYS);
+
+    flat_map_delete(map);
+}
+END_TEST
+
 // ----------------------------------------------------------------------------
 // Infrastructure
  
@@ -188,6 +2088,28 @@ Suite* flat_map_suite(void)
     tcase_add_test(tc_core, test_flat_map_insert);
     tcase_add_test(tc_core, test_flat_map_find);
     tcase_add_test(tc_core, test_flat_map_remove);
+    tcase_add_test(tc_core, test_flat_map_new_with_attr);
+    tcase_add_test(tc_core, test_flat_map_incremental_resize);
+    tcase_add_test(tc_core, test_flat_map_control_bytes);
+    tcase_add_test(tc_core, test_flat_map_robin_hood);
+    tcase_add_test(tc_core, test_flat_map_hopscotch);
+    tcase_add_test(tc_core, test_flat_map_iterate);
+    tcase_add_test(tc_core, test_flat_map_numa);
+    tcase_add_test(tc_core, test_flat_map_batch);
+    tcase_add_test(tc_core, test_flat_map_paged_layout);
+    tcase_add_test(tc_core, test_flat_map_compact);
+    tcase_add_test(tc_core, test_flat_map_new_with_capacity);
+    tcase_add_test(tc_core, test_flat_map_bulk_load);
+    tcase_add_test(tc_core, test_flat_map_parallel_resize);
+    tcase_add_test(tc_core, test_flat_map_size);
+    tcase_add_test(tc_core, test_flat_map_compute);
+    tcase_add_test(tc_core, test_flat_map_stats);
+    tcase_add_test(tc_core, test_flat_map_lock_kinds);
+    tcase_add_test(tc_core, test_flat_map_reclaim);
+    tcase_add_test(tc_core, test_flat_map_memory);
+    tcase_add_test(tc_core, test_flat_map_snapshot);
+    tcase_add_test(tc_core, test_flat_map_typed);
+    tcase_add_test(tc_core, test_flat_map_concurrent);
 
     suite_add_tcase(s, tc_core);
     
@@ -4,27 +4,161 @@
 
 #define _GNU_SOURCE
 #include <assert.h>
+#include <stdio.h>
+#include <fcntl.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
 #include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "murmur3.h"
 #include "flat_map.h"
+#include "../sync/rwlock.h"
+#include "../rcu/rcu.h"
 
 // ----------------------------------------------------------------------------
 // Internal Declarations
 
 // The key used to represent an empty cell.
-static const uint32_t EMPTY_KEY     = 0;
+static const map_key_t EMPTY_KEY     = 0;
 
 // The key used to represent a tombstone cell.
-static const uint32_t TOMBSTONE_KEY = ~0;
+static const map_key_t TOMBSTONE_KEY = ~0ULL;
 
 // The default maximum load factor for the table.
 static const float LOAD_FACTOR = 0.75f;
 
+// The maximum load factor for a table under hopscotch probing,
+// which bounds the probe length of every key by its neighborhood.
+static const float HOPSCOTCH_LOAD_FACTOR = 0.9f;
+
+// The load factor below which a table under hopscotch probing is not
+// grown when a key cannot be placed within its neighborhood, as the
+// key then shares it with too many keys for a larger table to help.
+static const float HOPSCOTCH_MIN_GROWTH_LOAD = 0.25f;
+
 // The initial capacity of the map, in cells.
 static const size_t INITIAL_CAPACITY = 16;
 
+// The number of optimistic (lock-free) read attempts on a
+// single page before a reader falls back to the page lock.
+static const size_t MAX_OPTIMISTIC_READS = 16;
+
+// The minimum number of cells migrated by each insert or remove
+// operation while an incremental resize is in progress.
+static const size_t MIGRATION_CHUNK_CELLS = 64;
+
+// The minimum number of cells remaining to be migrated for which
+// a complete migration is divided among multiple threads; below
+// this, the cost of starting the threads outweighs the benefit.
+static const size_t PARALLEL_MIGRATION_MIN_CELLS = 1 << 16;
+
+// The control byte for an empty cell.
+static const uint8_t CONTROL_EMPTY     = 0x80;
+
+// The control byte for a tombstone cell.
+static const uint8_t CONTROL_TOMBSTONE = 0xFE;
+
+// The number of cells in the neighborhood of a cell under hopscotch
+// probing, and the number of cells, from the initial cell of a key,
+// searched for a free cell to move into the neighborhood of the key,
+// which is reduced such that the run of pages held by an insertion
+// spans at most HOP_ADD_PAGES pages.
+#define HOP_RANGE     31
+#define HOP_ADD_RANGE 256
+#define HOP_ADD_PAGES 32
+
+// The number of control bytes examined at once when probing;
+// equal to the width of an SSE2 vector register, in bytes.
+#define GROUP_WIDTH 16
+
+// The cell index that denotes the absence of a cell.
+static const size_t NO_CELL = SIZE_MAX;
+
+// The assumed size of a cache line, in bytes.
+#define CACHE_LINE_SIZE 64
+
+// The assumed size of a memory page, in bytes.
+#define MEMORY_PAGE_SIZE 4096
+
+// The assumed size of a huge memory page, in bytes.
+#define HUGE_PAGE_SIZE (2UL << 20)
+
+// The number of keys resolved together by the batched operations;
+// larger batches are processed in consecutive chunks of this size.
+#define BATCH_CHUNK_KEYS 64
+
+// The maximum number of pages an optimistic reader spans under
+// robin hood probing before it falls back to the page locks.
+#define MAX_OPTIMISTIC_RUN_PAGES 32
+
+// The number of shards over which the occupancy counts are
+// distributed; each shard occupies a distinct cache line.
+#define N_COUNTER_SHARDS 64
+
+// The inverse of the maximum relative error, with respect to the
+// capacity of the current table, in the folded occupancy counts.
+static const size_t COUNTER_ERROR_INVERSE = 32;
+
+// The maximum number of NUMA nodes across which a map is placed;
+// the width of the node mask passed to mbind().
+#define MAX_NUMA_NODES 64
+
+// The NUMA node declared by the calling thread with
+// flat_map_set_thread_node(), or -1 if it has declared none.
+static __thread int thread_node = -1;
+
+// The number of shards over which the counts of lookups in progress
+// are distributed; each shard occupies a distinct cache line.
+#define N_READER_SHARDS 64
+
+// The reader shard of the calling thread, or SIZE_MAX until the
+// thread first looks up a key; assigned from `next_reader_shard`.
+static __thread size_t thread_reader_shard = SIZE_MAX;
+static size_t next_reader_shard = 0;
+
+// The number of values retired under deferred reclamation
+// between attempts to collect them.
+static const size_t RECLAIM_BATCH_VALUES = 256;
+
+// The initial capacity of the buffer into which an iteration
+// collects the keys of a slice; grown as needed.
+static const size_t INITIAL_SLICE_ENTRIES = 64;
+
+// The number of chunks of slices allotted to each thread of
+// flat_map_parallel_for_each(), such that threads that finish
+// their chunks early claim those of slower threads.
+static const size_t CHUNKS_PER_THREAD = 8;
+
+#if defined(FLAT_MAP_STATS)
+
+// The cells examined and the pages visited by the operation
+// in progress on the calling thread; see flat_map_stats_t.
+static __thread size_t probe_cells;
+static __thread size_t probe_pages;
+
+#define STATS_BEGIN_PROBE()           (probe_cells = 0, probe_pages = 0)
+#define STATS_PROBE(n_cells, n_pages) (probe_cells += (n_cells), probe_pages += (n_pages))
+#define STATS_END_PROBE(map, hash)    record_probe((map), (hash))
+
+#else
+
+#define STATS_BEGIN_PROBE()           ((void)0)
+#define STATS_PROBE(n_cells, n_pages) ((void)0)
+#define STATS_END_PROBE(map, hash)    ((void)0)
+
+#endif
+
 // An invidual cell in the internal table.
 typedef struct cell
 {
@@ -34,27 +168,342 @@ typedef struct cell
 
 // Internally, the map is composed of a large, contiguous
 // array of cells, organized into pages that are protected
-// by a single reader-writer lock.
-typedef pthread_rwlock_t page_lock_t;
+// by a single reader-writer lock. Each page also carries a
+// version counter (seqlock) that allows readers to search
+// the page optimistically, without writing shared memory.
+//
+// The members read by optimistic readers come first, such that
+// under the paged layout they occupy the first cache line of the
+// page block, alongside the beginning of the lock itself.
+typedef struct page_lock
+{
+    // The page version; incremented by a writer both on
+    // acquisition and on release, so it is odd while the
+    // contents of the page are being modified.
+    size_t version;
+
+    // Set once the contents of the page have been moved
+    // to the new table during an incremental resize; the
+    // cells of a migrated page are no longer owned by it.
+    bool migrated;
+
+    // The lock that serializes writers to the page; the
+    // member in use is selected by the lock kind of the table.
+    union
+    {
+        pthread_rwlock_t rwlock;
+
+        // The rwlock_t of the page, which is too large to be
+        // embedded in the page, resides in a separate array.
+        rwlock_t* sync;
+
+        uint32_t spin;
+
+        struct
+        {
+            uint32_t next;
+            uint32_t serving;
+        } ticket;
+    } lock;
+} page_lock_t;
+
+// The size of the header that precedes the cells of each page
+// block in the paged layout; the header holds the page lock, and
+// is padded such that the cells begin on a cache line boundary.
+static const size_t PAGE_HEADER_SIZE =
+    (sizeof(page_lock_t) + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1);
+
+// A single shard of the statistics of a map; operations record
+// into the shard selected by the location of the key, such that
+// the statistics are rarely written by more than one thread at once.
+typedef struct stats_shard
+{
+    uint64_t probe_length[FLAT_MAP_STATS_BUCKETS];
+    uint64_t pages_crossed[FLAT_MAP_STATS_BUCKETS];
+    uint64_t lock_acquisitions;
+    uint64_t lock_contentions;
+    uint64_t lock_wait_ns;
+} __attribute__((aligned(CACHE_LINE_SIZE))) stats_shard_t;
+
+// A single generation of the internal table.
+//
+// Under the split layout, cells and page locks are stored in
+// two separate arrays. Under the paged layout, each page is a
+// single block, aligned to a cache line, composed of the page
+// lock followed by the cells of the page; cells and page locks
+// are only ever located by way of get_cell() and get_page_lock().
+typedef struct table
+{
+    // A contiguous array of cells, organzied into
+    // disjoint pages each protected by distinct rwlock;
+    // NULL under the paged layout.
+    cell_t* cells;
+
+    // The array of page locks, one per page in the table;
+    // NULL under the paged layout.
+    page_lock_t* page_locks;
+
+    // The contiguous array of page blocks under the
+    // paged layout; NULL under the split layout.
+    uint8_t* blocks;
+
+    // The size of a single page block, in bytes.
+    size_t block_size;
+
+    // The size of the mapping that holds the cells (or blocks)
+    // when mapped from the kernel; 0 if allocated from the heap.
+    size_t mapped_size;
+
+    // The array of control bytes, one per cell, when enabled;
+    // NULL otherwise. The control byte for a live cell holds a
+    // 7-bit tag derived from its key, allowing a probe to reject
+    // non-matching cells without loading the cells themselves.
+    uint8_t* control;
+
+    // The array of hop bitmaps, one per cell, under hopscotch
+    // probing; NULL otherwise. Bit `d` of the bitmap of a cell is
+    // set if the cell `d` cells later holds a key that has the cell
+    // as its initial cell.
+    uint32_t* hop;
+
+    // The number of pages that compose the table.
+    size_t n_pages;
+
+    // The number of cells in an individual page.
+    size_t cells_per_page;
+
+    // The base-2 logarithm of `cells_per_page`.
+    size_t page_shift;
+
+    // The scheme used to resolve collisions in the table.
+    flat_map_probing_t probing;
+
+    // The implementation of the page locks.
+    flat_map_lock_kind_t lock_kind;
+
+    // The array of rwlock_t, one per page, under the
+    // FLAT_MAP_LOCK_RWLOCK lock kind; NULL otherwise.
+    rwlock_t* sync_locks;
+
+    // The statistics shards of the map that owns the table;
+    // NULL unless built with FLAT_MAP_STATS.
+    stats_shard_t* stats;
+
+    // Under FLAT_MAP_NUMA_REPLICATE, the array of replicas of
+    // the table, one per node, and NULL otherwise. A replica is
+    // a view of the table that shares all of its members other
+    // than its cells, which are a copy of those of the table;
+    // a replica is only ever read.
+    struct table* replicas;
+    size_t        n_replicas;
+
+    // The table of which this table is a replica, or
+    // the table itself if it is not a replica.
+    struct table* primary;
+} table_t;
+
+// A contiguous (possibly wrapping) range of pages held by a
+// single operation under robin hood probing, in which keys may
+// be shifted across page boundaries.
+typedef struct page_run
+{
+    // The index of the first page in the run.
+    size_t first_page;
+
+    // The number of pages in the run.
+    size_t n_pages;
+} page_run_t;
+
+// The outcome of an insertion into a single table.
+typedef enum insert_result
+{
+    // No suitable cell was located.
+    INSERT_FAILED,
+    // The key was inserted into a previously-unoccupied cell.
+    INSERT_NEW,
+    // The value associated with an existing key was replaced.
+    INSERT_UPDATED,
+    // The key was inserted into a tombstone cell, which remains
+    // occupied; only under hopscotch probing.
+    INSERT_REUSED,
+    // No free cell could be moved into the neighborhood of the key,
+    // so the table must grow; only under hopscotch probing.
+    INSERT_FULL
+} insert_result_t;
+
+// An in-progress flat_map_compute() operation.
+typedef struct compute
+{
+    // The user callback and its context.
+    flat_map_compute_f fn;
+    void*              ctx;
+
+    // The value most recently returned by the callback.
+    void* result;
+
+    // The existing value, if the callback replaced it.
+    void* replaced;
+} compute_t;
+
+// The identifying prefix of a snapshot file.
+static const char SNAPSHOT_MAGIC[8] = "FLATMAP";
+
+// The version of the snapshot format; incremented on any change.
+static const uint32_t SNAPSHOT_VERSION = 2;
+
+// The region of addresses from which the address of the blob of a
+// snapshot is chosen, and the alignment of each address in it. The
+// region lies above the randomized load address of executables and
+// far below that of shared mappings, and within the memory available
+// to programs built with the address and thread sanitizers.
+#define SNAPSHOT_BLOB_REGION_BEGIN ((uintptr_t)0x566000000000)
+#define SNAPSHOT_BLOB_REGION_SIZE  ((uintptr_t)0x2000000000)
+#define SNAPSHOT_BLOB_ALIGNMENT    ((uintptr_t)1 << 30)
+
+// Kernels prior to 4.17 treat the flag as a hint, and
+// place the mapping elsewhere if the address is in use.
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+// The header at the beginning of a snapshot file. Each section
+// begins on a memory page boundary, such that it may be mapped.
+typedef struct snapshot_header
+{
+    char     magic[8];
+    uint32_t version;
+
+    // The size of a single cell; the cells section is an
+    // array of cells exactly as it resides in memory.
+    uint32_t cell_size;
+
+    uint64_t n_pages;
+    uint64_t cells_per_page;
+    uint64_t probing;
+    uint64_t occupied_cells;
+    uint64_t live_cells;
+
+    // The size of each value in the blob section, in bytes, or 0
+    // if values are stored inline; otherwise, the value of each
+    // cell is the address of its value when the blob is mapped
+    // at `blob_address`, or 0 (NULL).
+    uint64_t value_size;
+
+    uint64_t cells_offset;
+    uint64_t blob_offset;
+    uint64_t blob_address;
+    uint64_t blob_size;
+} snapshot_header_t;
+
+// A single shard of the occupancy counts of the map; holds the
+// changes to the counts not yet folded into the shared counts.
+typedef struct counter_shard
+{
+    ptrdiff_t occupied;
+    ptrdiff_t live;
+    uint8_t   padding[CACHE_LINE_SIZE - 2*sizeof(ptrdiff_t)];
+} counter_shard_t;
+
+// A single shard of the counts of lookups in progress, one count
+// for each parity of the reader epoch of the map.
+typedef struct reader_shard
+{
+    size_t  active[2];
+    uint8_t padding[CACHE_LINE_SIZE - 2*sizeof(size_t)];
+} reader_shard_t;
+
+// A single key in a chunk of a batched operation.
+typedef struct batch_entry
+{
+    // The index of the key within the chunk.
+    size_t position;
+
+    // The index of the initial page for the key.
+    size_t page_index;
+
+    // The hash of the key.
+    uint32_t hash;
+} batch_entry_t;
+
+// A single key / value pair collected by an iteration.
+typedef struct slice_entry
+{
+    map_key_t key;
+    void*     value;
+} slice_entry_t;
+
+// The pairs collected from a single slice of the map.
+typedef struct slice_buffer
+{
+    slice_entry_t* entries;
+    size_t         count;
+    size_t         capacity;
+} slice_buffer_t;
+
+// The state shared by the threads of flat_map_parallel_for_each().
+typedef struct for_each
+{
+    flat_map_t*      map;
+    flat_map_visit_f fn;
+    void*            ctx;
+
+    // The number of chunks into which the slices are divided, a
+    // power of two; each chunk comprises the slices whose cursors
+    // agree in their low bits. Static once the threads start.
+    size_t n_chunks;
+
+    // The index of the next chunk to be claimed; updated concurrently.
+    size_t next_chunk;
+
+    // Set if any thread failed to visit one of its chunks in full.
+    bool failed;
+} for_each_t;
 
 // A map instance.
 struct flat_map
 {
-    // The global map lock; utilized for resize only.
+    // The global map lock; held shared by operations that modify
+    // the map, and exclusively for resize. Lookups never acquire it.
     // Static after map initialization.
     pthread_rwlock_t map_lock;
 
-    // The internal table; a contiguous array of cells,
-    // organzied into disjoint pages each protected by distinct rwlock.
-    // Only updated under exclusive map lock.
-    cell_t* cells;
+    // The current internal table; all new keys are inserted here.
+    // Only updated under exclusive map lock, within a table update.
+    table_t* table;
 
-    // The array of page locks, one per page in the table.
-    page_lock_t* page_locks;
+    // The previous internal table while an incremental resize
+    // is in progress, NULL otherwise. Lookups consult this table
+    // before the current table, skipping pages already migrated.
+    // Only updated under exclusive map lock, within a table update.
+    table_t* old_table;
 
-    // The current number of pages that compose page array.
+    // The version of the table pointers above, which is odd while
+    // they are updated; lookups validate it as for a page version,
+    // and retry if the tables were replaced during the search.
     // Only updated under exclusive map lock.
-    size_t n_pages;
+    size_t table_version;
+
+    // The reader epoch, and the array of reader shards. A lookup
+    // counts itself in the shard of its thread under the parity
+    // of the epoch, such that a table replaced under exclusive map
+    // lock is destroyed only once the epoch is advanced and every
+    // lookup counted under its previous parity has completed.
+    // The epoch is only updated under exclusive map lock.
+    size_t          reader_epoch;
+    reader_shard_t* readers;
+
+    // The index of the next page of the previous table to be
+    // claimed for migration; updated concurrently.
+    size_t migration_cursor;
+
+    // The number of pages of the previous table that
+    // have been migrated; updated concurrently.
+    size_t migrated_pages;
+
+    // Set once a key of the previous table cannot be placed in the
+    // current table under hopscotch probing, after which the keys of
+    // both tables are rehashed into a larger table; updated concurrently.
+    bool migration_failed;
 
     // The number of cells in an individual page.
     // Static after map initialization.
@@ -64,68 +513,561 @@ struct flat_map
     // Static after map initialization.
     deleter_f deleter;
 
-    // The current count of occupied cells in the map;
-    // this count includes tombstone cells, decremented on resize.
-    // Updated concurrently by insert operations.
+    // The policy followed when the table grows.
+    // Static after map initialization.
+    flat_map_resize_policy_t resize_policy;
+
+    // The scheme used to resolve collisions.
+    // Static after map initialization.
+    flat_map_probing_t probing;
+
+    // The arrangement of tables in memory.
+    // Static after map initialization.
+    flat_map_layout_t layout;
+
+    // The source of the memory for tables.
+    // Static after map initialization.
+    flat_map_memory_t memory;
+
+    // The implementation of the page locks of tables.
+    // Static after map initialization.
+    flat_map_lock_kind_t lock_kind;
+
+    // The collector to which removed values are deferred,
+    // NULL under immediate reclamation, and the number of
+    // values deferred since the last attempt to collect them.
+    gc_t*  gc;
+    size_t n_retired;
+
+    // Whether tables maintain control bytes.
+    // Static after map initialization.
+    bool control_bytes;
+
+    // The number of threads that perform a complete migration.
+    // Static after map initialization.
+    size_t resize_threads;
+
+    // The placement of tables across NUMA nodes, and the number
+    // of nodes. Static after map initialization.
+    flat_map_numa_t numa;
+    size_t          n_nodes;
+
+    // The current count of occupied cells in the current table;
+    // this count includes tombstone cells, reset on resize.
+    // Updated concurrently by folding counter shards.
     size_t occupied_cells;
+
+    // The current count of live keys in the map, across both the
+    // current and the previous table; unaffected by migration.
+    // Updated concurrently by folding counter shards.
+    size_t live_cells;
+
+    // The array of counter shards. Operations record changes to
+    // the occupancy counts in a shard selected by the location of
+    // the key, and fold the shard into the shared counts above
+    // only once its changes reach `fold_threshold` in magnitude,
+    // such that the shared counts are rarely written and always
+    // within a small fraction of the capacity of the true counts.
+    counter_shard_t* shards;
+
+    // The magnitude of the changes accumulated in a single shard
+    // before the shard is folded; derived from the capacity of the
+    // current table. Only updated under exclusive map lock.
+    size_t fold_threshold;
+
+    // The number of tables installed over the lifetime of the map;
+    // identifies the current table for the purpose of resize races.
+    // Only updated under exclusive map lock.
+    size_t generation;
+
+    // The statistics shards, NULL unless built with FLAT_MAP_STATS,
+    // and the statistics of resizes; the latter are only updated
+    // under exclusive map lock.
+    stats_shard_t* stats;
+    uint64_t       n_resizes;
+    uint64_t       resize_ns;
+    uint64_t       max_resize_ns;
+
+    // The mapping of the blob section of the snapshot from which
+    // the map was opened, if any; values that reside within it
+    // are owned by the mapping rather than by the user.
+    // Static after map initialization.
+    uint8_t* snapshot_values;
+    size_t   snapshot_size;
+};
+
+// An iterator over a map instance.
+struct flat_map_iter
+{
+    // The map over which the iterator ranges.
+    flat_map_t* map;
+
+    // The cursor of the next slice to be collected, and whether
+    // the final slice has already been collected.
+    size_t cursor;
+    bool   exhausted;
+
+    // The pairs of the most recently collected slice, and the
+    // index of the next pair to be returned from it.
+    slice_buffer_t buffer;
+    size_t         position;
+
+    // The read-side critical section within which the pairs of
+    // the buffer were collected; ended as the buffer is refilled.
+    rcu_handle_t handle;
 };
 
 static bool is_power_of_two(size_t n);
+static void cpu_relax(void);
 
-static size_t get_capacity(flat_map_t* map);
+static size_t get_capacity(table_t* table);
+static bool is_snapshot_value(flat_map_t* map, void* value);
+static void dispose_value(flat_map_t* map, void* value);
+static void retire_value(flat_map_t* map, void* value);
+static void reclaim_values(flat_map_t* map);
+
+static cell_t* get_cell(table_t* table, size_t cell_index);
+static page_lock_t* get_page_lock(table_t* table, size_t page_index);
 
 static uint32_t get_hash(map_key_t key);
-static size_t get_cell_index_for_hash(flat_map_t* map, uint32_t hash);
-static size_t get_page_index_for_hash(flat_map_t* map, uint32_t hash);
+static uint8_t get_tag(map_key_t key);
+static size_t get_cell_index_for_hash(table_t* table, uint32_t hash);
+static size_t get_page_index_for_hash(table_t* table, uint32_t hash);
 
 static void lock_map_rw(flat_map_t* map);
 static void lock_map_resize(flat_map_t* map);
 static void unlock_map(flat_map_t* map);
 
-static void lock_page_read(page_lock_t* locks, size_t page_index);
-static void lock_page_write(page_lock_t* locks, size_t page_index);
-static void unlock_page(page_lock_t* locks, size_t page_index);
-
-static bool insert_at(
+static size_t* enter_lookup(flat_map_t* map);
+static void leave_lookup(size_t* active);
+static size_t read_tables_begin(flat_map_t* map);
+static bool read_tables_validate(flat_map_t* map, size_t version);
+static bool begin_table_update(flat_map_t* map);
+static void end_table_update(flat_map_t* map);
+static void replace_tables(flat_map_t* map, table_t* table, table_t* old_table);
+static void wait_for_lookups(flat_map_t* map);
+
+static void lock_page_read(table_t* table, size_t page_index);
+static void unlock_page_read(table_t* table, size_t page_index);
+static void lock_page_write(table_t* table, size_t page_index);
+static void unlock_page_write(table_t* table, size_t page_index);
+static bool try_lock_page_read(table_t* table, size_t page_index);
+static bool try_lock_page_write(table_t* table, size_t page_index);
+static void acquire_page_lock(
+    table_t*     table,
+    size_t       page_index,
+    page_lock_t* lock,
+    bool         exclusive);
+
+static void initialize_page_lock(table_t* table, size_t page_index);
+static void destroy_page_lock(table_t* table, size_t page_index);
+static bool try_acquire_page_lock(
+    table_t*     table,
+    page_lock_t* lock,
+    bool         exclusive);
+static void block_on_page_lock(
+    table_t*     table,
+    page_lock_t* lock,
+    bool         exclusive);
+static void release_page_lock(
+    table_t*     table,
+    page_lock_t* lock,
+    bool         exclusive);
+
+static size_t read_page_begin(table_t* table, size_t page_index);
+static bool read_page_validate(
+    table_t* table,
+    size_t   page_index,
+    size_t   version);
+
+static bool is_page_migrated(table_t* table, size_t page_index);
+
+static uint32_t match_group(
+    const uint8_t* control,
+    size_t         n_cells,
+    uint8_t        tag,
+    uint32_t*      empty);
+static size_t probe_page(
+    table_t*  table,
+    size_t    cell_index,
+    map_key_t key,
+    bool*     found);
+
+static insert_result_t insert_key(
     flat_map_t* map,
-    size_t      cell_index,
+    uint32_t    hash,
     map_key_t   key,
     void*       value,
     void**      replaced,
-    bool*       continue_search);
+    compute_t*  compute);
+static insert_result_t insert_key_or_grow(
+    flat_map_t* map,
+    uint32_t    hash,
+    map_key_t   key,
+    void*       value,
+    void**      replaced,
+    compute_t*  compute);
+static bool grow_full_table(flat_map_t* map);
+static void* find_key(
+    flat_map_t* map,
+    uint32_t    hash,
+    map_key_t   key);
+
+static insert_result_t insert_into_table(
+    table_t*   table,
+    uint32_t   hash,
+    map_key_t  key,
+    void*      value,
+    void**     replaced,
+    bool       update_only,
+    compute_t* compute);
+static bool remove_from_table(
+    flat_map_t* map,
+    table_t*    table,
+    uint32_t    hash,
+    map_key_t   key);
+static void* find_in_table(
+    flat_map_t* map,
+    table_t*    table,
+    uint32_t    hash,
+    map_key_t   key);
+
+static void* find_in_page(
+    table_t*  table,
+    size_t    page_index,
+    size_t    cell_index,
+    map_key_t key,
+    bool*     continue_search);
+
+static insert_result_t insert_at(
+    table_t*   table,
+    size_t     cell_index,
+    map_key_t  key,
+    void*      value,
+    void**     replaced,
+    bool       update_only,
+    compute_t* compute,
+    bool*      continue_search);
+static void* compute_value(
+    compute_t* compute,
+    map_key_t  key,
+    void*      current);
+static bool compute_new_value(
+    compute_t* compute,
+    map_key_t  key,
+    void**     value);
 static bool remove_at(
-    flat_map_t* map, 
-    size_t      cell_index, 
-    uint32_t    key, 
+    flat_map_t* map,
+    table_t*    table,
+    size_t      cell_index,
+    map_key_t   key,
     bool*       continue_search);
 static void* find_at(
-    flat_map_t* map, 
-    size_t      cell_index, 
-    uint32_t    key, 
-    bool*       continue_search);
-
-static bool need_resize(size_t occupied_cells, size_t capacity);
-static void resize_map(flat_map_t* map);
+    table_t*  table,
+    size_t    cell_index,
+    map_key_t key,
+    bool*     continue_search);
+
+static void prefetch_cell(
+    table_t* table,
+    size_t   cell_index,
+    bool     for_write);
+static size_t prepare_batch(
+    table_t*         table,
+    const map_key_t* keys,
+    size_t           n_keys,
+    batch_entry_t*   entries,
+    bool             for_write);
+static void sort_batch(batch_entry_t* entries, size_t n_entries);
+static bool is_batch_groupable(flat_map_t* map);
+
+static size_t insert_batch_chunk(
+    flat_map_t*      map,
+    const map_key_t* keys,
+    void* const*     values,
+    void**           out,
+    batch_entry_t*   entries,
+    size_t           n_entries);
+static size_t insert_page_group(
+    flat_map_t*      map,
+    const map_key_t* keys,
+    void* const*     values,
+    void**           out,
+    batch_entry_t*   entries,
+    size_t           n_entries);
+static size_t find_batch_chunk(
+    flat_map_t*      map,
+    table_t*         table,
+    const map_key_t* keys,
+    void**           values,
+    batch_entry_t*   entries,
+    size_t           n_entries);
+static size_t find_page_group(
+    flat_map_t*      map,
+    table_t*         table,
+    const map_key_t* keys,
+    void**           values,
+    batch_entry_t*   entries,
+    size_t           n_entries);
+
+static size_t get_probe_distance(
+    table_t*  table,
+    size_t    cell_index,
+    map_key_t key);
+
+static bool run_contains(
+    table_t*    table,
+    page_run_t* run,
+    size_t      cell_index);
+static bool lock_run_page(
+    table_t*    table,
+    page_run_t* run,
+    size_t      cell_index,
+    bool        exclusive);
+static void unlock_run(
+    table_t*    table,
+    page_run_t* run,
+    bool        exclusive);
+static bool validate_run(
+    table_t*      table,
+    page_run_t*   run,
+    const size_t* versions);
+
+static bool lock_search_run(
+    table_t*    table,
+    size_t      home,
+    map_key_t   key,
+    page_run_t* run,
+    size_t*     index,
+    bool*       found);
+static bool extend_run(
+    table_t*    table,
+    page_run_t* run,
+    size_t      cell_index,
+    bool        stop_at_home,
+    size_t*     end);
+
+static insert_result_t insert_robin_hood(
+    table_t*   table,
+    uint32_t   hash,
+    map_key_t  key,
+    void*      value,
+    void**     replaced,
+    compute_t* compute);
+static void place_robin_hood(
+    table_t*  table,
+    size_t    home,
+    size_t    index,
+    map_key_t key,
+    void*     value);
+static bool remove_robin_hood(
+    flat_map_t* map,
+    table_t*    table,
+    uint32_t    hash,
+    map_key_t   key);
+static void* find_robin_hood(
+    table_t*  table,
+    uint32_t  hash,
+    map_key_t key);
+static void* search_robin_hood(
+    table_t*    table,
+    size_t      home,
+    map_key_t   key,
+    page_run_t* run,
+    size_t*     versions,
+    bool*       complete);
+
+static size_t get_hop_range(table_t* table);
+static size_t get_add_range(table_t* table);
+static bool enter_run_page(
+    table_t*    table,
+    page_run_t* run,
+    size_t      cell_index,
+    size_t*     versions,
+    bool        exclusive);
+static size_t search_hopscotch(
+    table_t*    table,
+    size_t      home,
+    map_key_t   key,
+    page_run_t* run,
+    size_t*     versions,
+    bool        exclusive,
+    bool*       complete);
+static bool lock_free_cell(
+    table_t*    table,
+    page_run_t* run,
+    size_t      home,
+    size_t*     index);
+static insert_result_t insert_hopscotch(
+    table_t*   table,
+    uint32_t   hash,
+    map_key_t  key,
+    void*      value,
+    void**     replaced,
+    compute_t* compute);
+static size_t get_hop_source(table_t* table, size_t index, size_t* owner);
+static bool trace_hopscotch(table_t* table, size_t home, size_t index);
+static void place_hopscotch(
+    table_t*  table,
+    size_t    home,
+    size_t    index,
+    map_key_t key,
+    void*     value);
+static bool remove_hopscotch(
+    flat_map_t* map,
+    table_t*    table,
+    uint32_t    hash,
+    map_key_t   key);
+static void* find_hopscotch(
+    table_t*  table,
+    uint32_t  hash,
+    map_key_t key);
+static bool rebuild_hops(table_t* table);
+
+static bool collect_slice(
+    flat_map_t*     map,
+    size_t*         cursor,
+    size_t          fixed_mask,
+    slice_buffer_t* buffer,
+    bool*           last);
+static bool collect_page(
+    table_t*        table,
+    size_t          page_index,
+    slice_buffer_t* buffer);
+static bool append_entry(
+    slice_buffer_t* buffer,
+    map_key_t       key,
+    void*           value);
+static void deduplicate_slice(slice_buffer_t* buffer, size_t n_old);
+static int compare_slice_entries(const void* a, const void* b);
+static size_t reverse_bits(size_t n);
+static size_t get_n_chunks(flat_map_t* map, size_t n_threads);
+static void* for_each_worker(void* arg);
+
+static insert_result_t insert_unlocked(
+    table_t*  table,
+    uint32_t  hash,
+    map_key_t key,
+    void*     value,
+    void**    replaced);
+
+static void count_cells(
+    flat_map_t* map,
+    size_t      shard_hint,
+    ptrdiff_t   d_occupied,
+    ptrdiff_t   d_live);
+static void fold_shard(
+    ptrdiff_t* pending,
+    size_t*    count,
+    ptrdiff_t  delta,
+    ptrdiff_t  threshold);
+static size_t get_folded_count(size_t* count);
+static void sum_counts(flat_map_t* map, size_t* occupied, size_t* live);
+static void fold_counts(flat_map_t* map);
+static size_t get_fold_threshold(size_t capacity);
+
+static bool need_resize(flat_map_t* map, size_t occupied_cells, size_t capacity);
+static size_t get_n_pages_for_items(flat_map_t* map, size_t n_items);
+static size_t get_resize_n_pages(flat_map_t* map, size_t n_additional);
+static size_t get_compact_n_pages(flat_map_t* map, size_t live);
+static bool resize_map(
+    flat_map_t* map,
+    size_t      generation,
+    size_t      n_pages,
+    bool        complete);
+
+static bool migrate_pages(flat_map_t* map);
+static bool migrate_chunk(flat_map_t* map, bool* complete);
+static void migrate_remaining_pages(flat_map_t* map);
+static size_t get_n_migration_helpers(flat_map_t* map);
+static void* migration_worker(void* arg);
+static bool migrate_page(
+    flat_map_t* map,
+    table_t*    old_table,
+    size_t      page_index);
+static void withdraw_page(
+    flat_map_t* map,
+    table_t*    old_table,
+    size_t      begin,
+    size_t      end);
+static table_t* retire_old_table(flat_map_t* map);
+static void finish_migration(flat_map_t* map);
+static bool rehash_map(flat_map_t* map);
+static bool rehash_table(table_t* table, table_t* source, size_t* n_keys);
 
 static bool initialize_map_lock(flat_map_t* map);
 static void destroy_map_lock(flat_map_t* map);
 
-static cell_t* new_cells(size_t n_cells);
-static void initialize_cells(
-    cell_t* cells, 
-    size_t n_cells);
+static table_t* new_table(flat_map_t* map, size_t n_pages);
+static void destroy_table(table_t* table, flat_map_t* owner);
+
+static bool new_cells(table_t* table, flat_map_memory_t memory);
 static void destroy_cells(
-    cell_t* cells,
-    size_t n_cells,
-    deleter_f deleter);
+    table_t*    table,
+    flat_map_t* owner);
+
+static bool new_blocks(table_t* table, flat_map_memory_t memory);
+static void destroy_blocks(table_t* table);
+
+static void* map_table_memory(table_t* table, size_t size, flat_map_memory_t memory);
+static void* map_aligned(size_t size, size_t alignment);
+static void free_table_memory(table_t* table, void* memory);
+
+static size_t get_n_numa_nodes(void);
+static void bind_memory(
+    void*  memory,
+    size_t size,
+    int    mode,
+    size_t first_node,
+    size_t n_nodes);
+static void place_table(flat_map_t* map, table_t* table);
+static bool new_replicas(flat_map_t* map, table_t* table);
+static void destroy_replicas(table_t* table);
+static void copy_page_to_replicas(table_t* table, size_t page_index);
+static void copy_table_to_replicas(table_t* table);
+static table_t* get_local_table(table_t* table);
+static size_t get_thread_node(void);
+
+static counter_shard_t* new_counter_shards(void);
+static reader_shard_t* new_reader_shards(void);
+
+#if defined(FLAT_MAP_STATS)
+static stats_shard_t* new_stats_shards(void);
+static void record_probe(flat_map_t* map, uint32_t hash);
+static void record_resize(flat_map_t* map, uint64_t duration_ns);
+static size_t get_stats_bucket(size_t n);
+static uint64_t now_ns(void);
+#endif
+
+static bool copy_snapshot(
+    flat_map_t*        map,
+    size_t             value_size,
+    snapshot_header_t* header,
+    cell_t**           cells,
+    uint8_t**          blob);
+static uintptr_t choose_blob_address(size_t blob_size);
+static bool write_snapshot(
+    FILE*                    file,
+    const snapshot_header_t* header,
+    const cell_t*            cells,
+    const uint8_t*           blob);
+static bool write_padding(FILE* file, size_t n_bytes);
+static bool sync_directory_of(const char* path);
+static bool read_snapshot_header(
+    int                fd,
+    snapshot_header_t* header);
+static table_t* map_snapshot_table(
+    flat_map_t*              map,
+    int                      fd,
+    const snapshot_header_t* header);
+static bool relocate_snapshot_values(
+    table_t*                 table,
+    uint8_t*                 values,
+    const snapshot_header_t* header);
 
 static page_lock_t* new_page_locks(size_t n_locks);
-static void initialize_page_locks(
-    page_lock_t* page_locks,
-    size_t n_locks);
-static void destroy_page_locks(
-    page_lock_t* page_locks, 
-    size_t n_locks);
+static bool initialize_page_locks(table_t* table);
+static void destroy_page_locks(table_t* table);
 
 // ----------------------------------------------------------------------------
 // Exported
@@ -134,12 +1076,57 @@ flat_map_t* flat_map_new(
     size_t    page_size, 
     deleter_f deleter)
 {
-    if (!is_power_of_two(page_size) 
-     || NULL == deleter)
+    flat_map_attr_t* attr = flat_map_attr_default();
+    if (NULL == attr)
+    {
+        return NULL;
+    }
+
+    attr->page_size = page_size;
+    attr->deleter   = deleter;
+
+    flat_map_t* map = flat_map_new_with_attr(attr);
+
+    flat_map_attr_delete(attr);
+    return map;
+}
+
+flat_map_t* flat_map_new_with_capacity(
+    size_t    page_size,
+    deleter_f deleter,
+    size_t    expected_items)
+{
+    flat_map_attr_t* attr = flat_map_attr_default();
+    if (NULL == attr)
+    {
+        return NULL;
+    }
+
+    attr->page_size      = page_size;
+    attr->deleter        = deleter;
+    attr->expected_items = expected_items;
+
+    flat_map_t* map = flat_map_new_with_attr(attr);
+
+    flat_map_attr_delete(attr);
+    return map;
+}
+
+flat_map_t* flat_map_new_with_attr(flat_map_attr_t* attr)
+{
+    if (NULL == attr
+     || !is_power_of_two(attr->page_size)
+     || NULL == attr->deleter
+     || 0 == attr->resize_threads
+     || (attr->control_bytes && attr->probing != FLAT_MAP_PROBING_LINEAR)
+     || attr->numa_nodes > MAX_NUMA_NODES
+     || (FLAT_MAP_NUMA_REPLICATE == attr->numa && attr->layout != FLAT_MAP_LAYOUT_SPLIT))
     {
         return NULL;
     }
 
+    const size_t page_size = attr->page_size;
+
     flat_map_t* map = malloc(sizeof(flat_map_t));
     if (NULL == map)
     {
@@ -153,37 +1140,110 @@ flat_map_t* flat_map_new(
         return NULL;
     }
 
-    // compute the initial number of pages we need
-    const size_t n_pages = INITIAL_CAPACITY / page_size;
+    map->cells_per_page = page_size;
 
-    // allocate the cell array
-    cell_t* cells = new_cells(INITIAL_CAPACITY);
-    if (NULL == cells)
+    map->deleter       = attr->deleter;
+    map->resize_policy = attr->resize_policy;
+    map->probing       = attr->probing;
+    map->layout        = attr->layout;
+    map->memory        = attr->memory;
+    map->lock_kind     = attr->lock_kind;
+    map->control_bytes = attr->control_bytes;
+
+    map->resize_threads = attr->resize_threads;
+
+    map->numa    = attr->numa;
+    map->n_nodes = (attr->numa_nodes > 0) ? attr->numa_nodes : get_n_numa_nodes();
+
+    // compute the initial number of pages we need;
+    // the map always begins with at least a single page
+    const size_t n_pages = get_n_pages_for_items(map, attr->expected_items);
+
+    counter_shard_t* shards = new_counter_shards();
+    if (NULL == shards)
     {
-        pthread_rwlock_destroy(&map->map_lock);
+        destroy_map_lock(map);
         free(map);
         return NULL;
     }
 
-    // allocate the page locks array
-    page_lock_t* page_locks = new_page_locks(n_pages);
-    if (NULL == page_locks)
+    reader_shard_t* readers = new_reader_shards();
+    if (NULL == readers)
     {
-        destroy_cells(cells, INITIAL_CAPACITY, NULL);
-        pthread_rwlock_destroy(&map->map_lock);
+        free(shards);
+        destroy_map_lock(map);
         free(map);
         return NULL;
     }
 
-    map->cells      = cells;
-    map->page_locks = page_locks;
+    map->stats = NULL;
 
-    map->n_pages        = n_pages;
-    map->cells_per_page = page_size;
+#if defined(FLAT_MAP_STATS)
+    map->stats = new_stats_shards();
+    if (NULL == map->stats)
+    {
+        free(readers);
+        free(shards);
+        destroy_map_lock(map);
+        free(map);
+        return NULL;
+    }
+#endif
+
+    map->n_resizes     = 0;
+    map->resize_ns     = 0;
+    map->max_resize_ns = 0;
 
-    map->deleter = deleter;
+    map->gc        = NULL;
+    map->n_retired = 0;
+
+    if (FLAT_MAP_RECLAIM_DEFERRED == attr->reclaim)
+    {
+        map->gc = gc_new();
+        if (NULL == map->gc)
+        {
+            free(map->stats);
+            free(readers);
+            free(shards);
+            destroy_map_lock(map);
+            free(map);
+            return NULL;
+        }
+    }
+
+    // allocate the initial table
+    table_t* table = new_table(map, n_pages);
+    if (NULL == table)
+    {
+        gc_delete(map->gc);
+        free(map->stats);
+        free(readers);
+        free(shards);
+        destroy_map_lock(map);
+        free(map);
+        return NULL;
+    }
+
+    map->table     = table;
+    map->old_table = NULL;
+
+    map->table_version = 0;
+    map->reader_epoch  = 0;
+    map->readers       = readers;
+
+    map->migration_cursor = 0;
+    map->migrated_pages   = 0;
+    map->migration_failed = false;
 
     map->occupied_cells = 0;
+    map->live_cells     = 0;
+    map->generation     = 0;
+
+    map->shards         = shards;
+    map->fold_threshold = get_fold_threshold(get_capacity(table));
+
+    map->snapshot_values = NULL;
+    map->snapshot_size   = 0;
 
     return map;
 }
@@ -195,11 +1255,27 @@ void flat_map_delete(flat_map_t* map)
         return;
     }
 
-    const size_t capacity = map->n_pages*map->cells_per_page;
+    // no readers remain, so every deferred value is destroyed
+    gc_delete(map->gc);
+
+    // values that reside in pages of the previous table
+    // that were never migrated are still owned by the map
+    if (map->old_table != NULL)
+    {
+        destroy_table(map->old_table, map);
+    }
+
+    destroy_table(map->table, map);
+
+    if (map->snapshot_values != NULL)
+    {
+        munmap(map->snapshot_values, map->snapshot_size);
+    }
 
-    destroy_page_locks(map->page_locks, map->n_pages);
-    destroy_cells(map->cells, capacity, map->deleter);
     destroy_map_lock(map);
+    free(map->readers);
+    free(map->shards);
+    free(map->stats);
     free(map);
 }
 
@@ -209,7 +1285,7 @@ bool flat_map_insert(
     void*       value, 
     void**      out)
 {
-    if (NULL == map || 0 == key)
+    if (NULL == map || EMPTY_KEY == key || TOMBSTONE_KEY == key)
     {
         return false;
     }
@@ -222,574 +1298,5693 @@ bool flat_map_insert(
     lock_map_rw(map);
 
     // compute the current total capacity of the map
-    const size_t capacity = map->n_pages*map->cells_per_page;
+    const size_t capacity = get_capacity(map->table);
+    const size_t occupied = get_folded_count(&map->occupied_cells);
 
     // determine if a resize is required
-    if (need_resize(map->occupied_cells + 1, capacity))
+    if (need_resize(map, occupied + 1, capacity))
     {
+        const size_t generation = map->generation;
+        const size_t n_pages    = get_resize_n_pages(map, 1);
+
         // release the shared lock
         unlock_map(map);
         
         // acquire exclusive access to map for resize
-        resize_map(map);
+        resize_map(map, generation, n_pages, false);
 
         // re-acquire shared lock
         lock_map_rw(map);
     }
 
+    // perform a share of any outstanding incremental migration
+    const bool migration_complete = migrate_pages(map);
+
     // hash the key
     const uint32_t hash = get_hash(key);
 
-    // locate the appropriate cell index to begin search
-    size_t cell_index = get_cell_index_for_hash(map, hash);
-    // locate the appropriate page index to begin search
-    size_t page_index = get_page_index_for_hash(map, hash);
-    
-    // track the starting cell index so that if we make a full
-    // cycle of the table without finding key, we terminate search
-    const size_t init_cell_index = page_index * map->cells_per_page;
-    
-    bool inserted        = false;
-    bool continue_search = true;
+    STATS_BEGIN_PROBE();
+    const insert_result_t result = insert_key_or_grow(map, hash, key, value, out, NULL);
+    STATS_END_PROBE(map, hash);
+
+    unlock_map(map);
 
-    do
+    if (migration_complete)
     {
-        // acquire exclusive access to the page
-        lock_page_write(map->page_locks, page_index);
+        finish_migration(map);
+    }
 
-        // search for the key in the current page
-        inserted = insert_at(map, cell_index, 
-            key, value, out, &continue_search);
-        if (!continue_search)
-        {
-            // key was removed, or empty cell encountered
-            break;
-        }
+    return result != INSERT_FAILED;
+}
 
-        // release exclusive access to the page
-        unlock_page(map->page_locks, page_index);
+void* flat_map_compute(
+    flat_map_t*        map,
+    map_key_t          key,
+    flat_map_compute_f fn,
+    void*              ctx)
+{
+    if (NULL == map || NULL == fn || EMPTY_KEY == key || TOMBSTONE_KEY == key)
+    {
+        return NULL;
+    }
 
-        // increment the page and cell indices for next iteration
-        page_index = (page_index + 1) % map->n_pages;
-        cell_index = page_index * map->cells_per_page;
+    compute_t compute = { .fn = fn, .ctx = ctx, .result = NULL, .replaced = NULL };
+
+    lock_map_rw(map);
 
-    } while (cell_index != init_cell_index);
+    // a new key may be inserted, so the map is resized
+    // on the same terms as for flat_map_insert()
+    const size_t capacity = get_capacity(map->table);
+    const size_t occupied = get_folded_count(&map->occupied_cells);
+
+    if (need_resize(map, occupied + 1, capacity))
+    {
+        const size_t generation = map->generation;
+        const size_t n_pages    = get_resize_n_pages(map, 1);
+
+        unlock_map(map);
+        resize_map(map, generation, n_pages, false);
+        lock_map_rw(map);
+    }
+
+    const bool migration_complete = migrate_pages(map);
+
+    const uint32_t hash = get_hash(key);
+
+    // the callback is invoked from within the probe, under the
+    // write lock on the page at which the probe terminates
+    STATS_BEGIN_PROBE();
+    insert_key_or_grow(map, hash, key, NULL, NULL, &compute);
+    STATS_END_PROBE(map, hash);
 
     unlock_map(map);
 
-    if (inserted)
+    // the replaced value is destroyed outside of the page lock
+    if (compute.replaced != NULL)
+    {
+        retire_value(map, compute.replaced);
+        reclaim_values(map);
+    }
+
+    if (migration_complete)
     {
-        // need to atomically increment the number of occupied cells
-        // because no lock is held here and this field may be 
-        // incremented concurrently by mutliple insert operations
-        __atomic_fetch_add(&map->occupied_cells, 1, __ATOMIC_SEQ_CST);
+        finish_migration(map);
     }
 
-    return inserted;
+    return compute.result;
 }
 
 bool flat_map_remove(flat_map_t* map, map_key_t key)
 {
-    if (NULL == map || 0 == key)
+    if (NULL == map || EMPTY_KEY == key || TOMBSTONE_KEY == key)
     {
         return false;
     }
 
     lock_map_rw(map);
 
+    // perform a share of any outstanding incremental migration
+    const bool migration_complete = migrate_pages(map);
+
     // hash the key
     const uint32_t hash = get_hash(key);
 
-    // locate the appropriate cell index to begin search
-    size_t cell_index = get_cell_index_for_hash(map, hash);
-    // locate the appropriate page index to begin search
-    size_t page_index = get_page_index_for_hash(map, hash);
+    bool removed = false;
+    bool vacated = false;
+
+    STATS_BEGIN_PROBE();
     
-    // track the starting cell index so that if we make a full
-    // cycle of the table without finding key, we terminate search
-    const size_t init_cell_index = page_index * map->cells_per_page;
+    if (map->old_table != NULL)
+    {
+        removed = remove_from_table(map, map->old_table, hash, key);
+    }
     
-    bool removed         = false;
-    bool continue_search = true;
-
-    do
+    if (!removed)
     {
-        // acquire exclusive access to the page
-        lock_page_write(map->page_locks, page_index);
+        removed = remove_from_table(map, map->table, hash, key);
 
-        // search for the key in the current page
-        removed = remove_at(map, cell_index, key, &continue_search);
-        if (!continue_search)
-        {
-            // key was removed, or empty cell encountered
-            break;
-        }
+        // robin hood removal from the current table vacates the
+        // cell entirely, rather than leaving behind a tombstone
+        vacated = removed && FLAT_MAP_PROBING_ROBIN_HOOD == map->probing;
+    }
 
-        // release exclusive access to the page
-        unlock_page(map->page_locks, page_index);
+    STATS_END_PROBE(map, hash);
 
-        // increment the page and cell indices for next iteration
-        page_index = (page_index + 1) % map->n_pages;
-        cell_index = page_index * map->cells_per_page;
+    if (removed)
+    {
+        count_cells(map, hash, vacated ? -1 : 0, -1);
+    }
+
+    unlock_map(map);
+
+    if (removed)
+    {
+        reclaim_values(map);
+    }
+
+    if (migration_complete)
+    {
+        finish_migration(map);
+    }
+
+    return removed;
+}
+
+void* flat_map_find(flat_map_t* map, map_key_t key)
+{
+    if (NULL == map || EMPTY_KEY == key || TOMBSTONE_KEY == key)
+    {
+        return NULL;
+    }
+
+    // hash the key
+    const uint32_t hash = get_hash(key);
+
+    // the map lock is not acquired; a search that overlaps the
+    // replacement of the tables is instead retried in full
+    for (;;)
+    {
+        size_t* active = enter_lookup(map);
+
+        const size_t version = read_tables_begin(map);
+        if ((version & 1) == 0)
+        {
+            STATS_BEGIN_PROBE();
+            void* value = find_key(map, hash, key);
+
+            if (read_tables_validate(map, version))
+            {
+                STATS_END_PROBE(map, hash);
+                leave_lookup(active);
+                return value;
+            }
+        }
+
+        // the tables are never awaited while counted as a lookup,
+        // as a resize may itself be awaiting the lookup
+        leave_lookup(active);
+        cpu_relax();
+    }
+}   
+
+bool flat_map_contains(flat_map_t* map, map_key_t key)
+{
+    return flat_map_find(map, key) != NULL;
+}
+
+rcu_handle_t flat_map_enter(flat_map_t* map)
+{
+    if (NULL == map || NULL == map->gc)
+    {
+        const rcu_handle_t handle = { .generation = 0 };
+        return handle;
+    }
+
+    return rcu_enter(map->gc);
+}
+
+void flat_map_leave(flat_map_t* map, rcu_handle_t handle)
+{
+    if (NULL == map || NULL == map->gc)
+    {
+        return;
+    }
+
+    rcu_leave(map->gc, handle);
+}
+
+void flat_map_synchronize(flat_map_t* map)
+{
+    if (NULL == map || NULL == map->gc)
+    {
+        return;
+    }
+
+    __atomic_store_n(&map->n_retired, 0, __ATOMIC_RELAXED);
+    rcu_synchronize(map->gc);
+}
+
+bool flat_map_get_stats(flat_map_t* map, flat_map_stats_t* stats)
+{
+    if (NULL == map || NULL == stats)
+    {
+        return false;
+    }
+
+    memset(stats, 0, sizeof(flat_map_stats_t));
+
+#if defined(FLAT_MAP_STATS)
+    size_t occupied = 0;
+    size_t live     = 0;
+
+    lock_map_rw(map);
+
+    sum_counts(map, &occupied, &live);
+
+    // removal under robin hood probing vacates the cell, so
+    // occupied cells that are not live cells are tombstones
+    stats->tombstones    = (occupied > live) ? occupied - live : 0;
+    stats->resizes       = map->n_resizes;
+    stats->resize_ns     = map->resize_ns;
+    stats->max_resize_ns = map->max_resize_ns;
+
+    unlock_map(map);
+
+    for (size_t i = 0; i < N_COUNTER_SHARDS; ++i)
+    {
+        stats_shard_t* shard = &map->stats[i];
+        for (size_t j = 0; j < FLAT_MAP_STATS_BUCKETS; ++j)
+        {
+            stats->probe_length[j]  += __atomic_load_n(&shard->probe_length[j], __ATOMIC_RELAXED);
+            stats->pages_crossed[j] += __atomic_load_n(&shard->pages_crossed[j], __ATOMIC_RELAXED);
+        }
+
+        stats->lock_acquisitions += __atomic_load_n(&shard->lock_acquisitions, __ATOMIC_RELAXED);
+        stats->lock_contentions  += __atomic_load_n(&shard->lock_contentions, __ATOMIC_RELAXED);
+        stats->lock_wait_ns      += __atomic_load_n(&shard->lock_wait_ns, __ATOMIC_RELAXED);
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+size_t flat_map_size(flat_map_t* map)
+{
+    if (NULL == map)
+    {
+        return 0;
+    }
+
+    size_t occupied = 0;
+    size_t live     = 0;
+
+    lock_map_rw(map);
+    sum_counts(map, &occupied, &live);
+    unlock_map(map);
+
+    return live;
+}
+
+bool flat_map_bulk_load(
+    flat_map_t*      map,
+    const map_key_t* keys,
+    void* const*     values,
+    size_t           n_keys)
+{
+    if (NULL == map || NULL == keys || NULL == values)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < n_keys; ++i)
+    {
+        if (EMPTY_KEY == keys[i] || TOMBSTONE_KEY == keys[i])
+        {
+            return false;
+        }
+    }
+
+    // size the table for every key up front, such that
+    // the load never triggers a resize of the map
+    table_t* table = NULL;
+    const size_t n_pages = get_n_pages_for_items(map, n_keys);
+
+    lock_map_resize(map);
+    fold_counts(map);
+
+    if (map->live_cells != 0)
+    {
+        unlock_map(map);
+        return false;
+    }
+
+    if (n_pages > map->table->n_pages || map->old_table != NULL || map->occupied_cells != 0)
+    {
+        table = new_table(map, n_pages);
+        if (NULL == table)
+        {
+            unlock_map(map);
+            return false;
+        }
+    }
+
+    // we now have exclusive access to the entire map structure, so
+    // keys are placed without acquiring any of the page locks; the
+    // table version remains odd throughout, such that lookups, which
+    // acquire neither, are retried until the load is complete
+    begin_table_update(map);
+
+    // tables that hold only tombstones own no values
+    table_t* retired     = NULL;
+    table_t* old_retired = NULL;
+    if (table != NULL)
+    {
+        old_retired = map->old_table;
+        retired     = map->table;
+
+        replace_tables(map, table, NULL);
+
+        map->migration_cursor = 0;
+        map->migrated_pages   = 0;
+        map->migration_failed = false;
+
+        map->fold_threshold = get_fold_threshold(get_capacity(table));
+
+        ++map->generation;
+    }
+
+    size_t n_new = 0;
+    bool loaded  = true;
+    for (size_t begin = 0; loaded && begin < n_keys; begin += BATCH_CHUNK_KEYS)
+    {
+        const size_t n_chunk = (n_keys - begin < BATCH_CHUNK_KEYS)
+            ? n_keys - begin
+            : BATCH_CHUNK_KEYS;
+
+        batch_entry_t entries[BATCH_CHUNK_KEYS];
+        const size_t n_entries = prepare_batch(map->table,
+            &keys[begin], n_chunk, entries, true);
+
+        for (size_t i = 0; loaded && i < n_entries; ++i)
+        {
+            const size_t position = begin + entries[i].position;
+
+            void* replaced = NULL;
+            insert_result_t result = insert_unlocked(map->table,
+                entries[i].hash, keys[position], values[position], &replaced);
+
+            // under hopscotch probing, the table grows
+            // until the key is placed within its neighborhood
+            while (INSERT_FULL == result && rehash_map(map))
+            {
+                result = insert_unlocked(map->table,
+                    entries[i].hash, keys[position], values[position], &replaced);
+            }
+
+            if (INSERT_FULL == result)
+            {
+                loaded = false;
+            }
+            else if (INSERT_NEW == result)
+            {
+                ++n_new;
+            }
+            else if (INSERT_UPDATED == result)
+            {
+                // the map owns the value for a repeated key
+                retire_value(map, replaced);
+            }
+        }
+    }
+
+    // keys were placed without the page locks, which
+    // otherwise propagate each modified page to the replicas
+    copy_table_to_replicas(map->table);
+
+    map->occupied_cells = n_new;
+    map->live_cells     = n_new;
+
+    end_table_update(map);
+
+    if (retired != NULL || old_retired != NULL)
+    {
+        wait_for_lookups(map);
+    }
+
+    unlock_map(map);
+
+    if (retired != NULL)
+    {
+        destroy_table(retired, NULL);
+    }
+
+    if (old_retired != NULL)
+    {
+        destroy_table(old_retired, NULL);
+    }
+
+    return loaded;
+}
+
+bool flat_map_compact(flat_map_t* map)
+{
+    if (NULL == map)
+    {
+        return false;
+    }
+
+    lock_map_rw(map);
+
+    size_t occupied = 0;
+    size_t live     = 0;
+    sum_counts(map, &occupied, &live);
+
+    const size_t generation = map->generation;
+    const size_t n_pages    = get_compact_n_pages(map, live);
+
+    // there is nothing to reclaim if the table would not shrink
+    // and contains no tombstones, including those that remain in
+    // the previous table during an incremental resize
+    const bool compact = map->old_table != NULL
+        || n_pages != map->table->n_pages
+        || occupied != live;
+
+    unlock_map(map);
+
+    if (!compact)
+    {
+        return true;
+    }
+
+    return resize_map(map, generation, n_pages, true);
+}
+
+bool flat_map_save(flat_map_t* map, const char* path, size_t value_size)
+{
+    if (NULL == map || NULL == path)
+    {
+        return false;
+    }
+
+    // the snapshot replaces the file at `path` only once complete;
+    // the temporary file is unique to this save, and resides in the
+    // same directory, such that the rename is atomic
+    const size_t path_length = strlen(path);
+    char* temp_path = malloc(path_length + sizeof(".XXXXXX"));
+    if (NULL == temp_path)
+    {
+        return false;
+    }
+
+    memcpy(temp_path, path, path_length);
+    memcpy(temp_path + path_length, ".XXXXXX", sizeof(".XXXXXX"));
+
+    const int fd = mkstemp(temp_path);
+    if (fd < 0)
+    {
+        free(temp_path);
+        return false;
+    }
+
+    FILE* file = fdopen(fd, "wb");
+    if (NULL == file)
+    {
+        close(fd);
+        remove(temp_path);
+        free(temp_path);
+        return false;
+    }
+
+    // the file is written from a copy, with no lock held
+    snapshot_header_t header;
+    cell_t*  cells = NULL;
+    uint8_t* blob  = NULL;
+
+    bool saved = copy_snapshot(map, value_size, &header, &cells, &blob)
+        && write_snapshot(file, &header, cells, blob);
+
+    free(cells);
+    free(blob);
+
+    // the contents reach storage before the file replaces `path`,
+    // and the rename itself before the save is reported complete
+    saved = saved && 0 == fflush(file) && 0 == fsync(fileno(file));
+    saved = (0 == fclose(file)) && saved;
+    saved = saved && (0 == rename(temp_path, path));
+    if (!saved)
+    {
+        remove(temp_path);
+    }
+
+    saved = saved && sync_directory_of(path);
+
+    free(temp_path);
+    return saved;
+}
+
+flat_map_t* flat_map_open_mapped(const char* path, deleter_f deleter)
+{
+    if (NULL == path || NULL == deleter)
+    {
+        return NULL;
+    }
+
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    snapshot_header_t header;
+    if (!read_snapshot_header(fd, &header))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    flat_map_attr_t* attr = flat_map_attr_default();
+    if (NULL == attr)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    attr->page_size = header.cells_per_page;
+    attr->deleter   = deleter;
+    attr->probing   = (flat_map_probing_t)header.probing;
+
+    flat_map_t* map = flat_map_new_with_attr(attr);
+    flat_map_attr_delete(attr);
+    if (NULL == map)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    table_t* table = map_snapshot_table(map, fd, &header);
+    if (NULL == table)
+    {
+        close(fd);
+        flat_map_delete(map);
+        return NULL;
+    }
+
+    // the blob is mapped where its cells point, if the address is
+    // free; otherwise it is mapped elsewhere, and its cells relocated
+    uint8_t* values   = NULL;
+    bool     relocate = false;
+    if (header.blob_size > 0)
+    {
+        void* address = (void*)(uintptr_t)header.blob_address;
+        values = mmap(address, header.blob_size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_FIXED_NOREPLACE, fd, (off_t)header.blob_offset);
+        if ((void*)values != address)
+        {
+            if (MAP_FAILED != (void*)values)
+            {
+                munmap(values, header.blob_size);
+            }
+
+            values = mmap(NULL, header.blob_size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE, fd, (off_t)header.blob_offset);
+            relocate = true;
+        }
+
+        if (MAP_FAILED == (void*)values)
+        {
+            values = NULL;
+        }
+    }
+
+    // the mappings remain valid once the file is closed
+    close(fd);
+
+    if ((header.blob_size > 0 && NULL == values)
+     || (relocate && !relocate_snapshot_values(table, values, &header)))
+    {
+        if (values != NULL)
+        {
+            munmap(values, header.blob_size);
+        }
+
+        destroy_table(table, NULL);
+        flat_map_delete(map);
+        return NULL;
+    }
+
+    // the map is not yet shared, so no lock is required
+    destroy_table(map->table, NULL);
+
+    map->table          = table;
+    map->occupied_cells = header.occupied_cells;
+    map->live_cells     = header.live_cells;
+    map->fold_threshold = get_fold_threshold(get_capacity(table));
+
+    map->snapshot_values = values;
+    map->snapshot_size   = header.blob_size;
+
+    return map;
+}
+
+size_t flat_map_insert_batch(
+    flat_map_t*      map,
+    const map_key_t* keys,
+    void* const*     values,
+    void**           out,
+    size_t           n_keys)
+{
+    if (NULL == map || NULL == keys || NULL == values)
+    {
+        return 0;
+    }
+
+    size_t n_inserted       = 0;
+    bool migration_complete = false;
+
+    lock_map_rw(map);
+
+    for (size_t begin = 0; begin < n_keys; begin += BATCH_CHUNK_KEYS)
+    {
+        const size_t n_chunk = (n_keys - begin < BATCH_CHUNK_KEYS)
+            ? n_keys - begin
+            : BATCH_CHUNK_KEYS;
+
+        if (out != NULL)
+        {
+            memset(&out[begin], 0, n_chunk*sizeof(void*));
+        }
+
+        // grow the map ahead of time such that it can
+        // accommodate every key in the chunk as a new key
+        for (;;)
+        {
+            const size_t capacity = get_capacity(map->table);
+            const size_t occupied = get_folded_count(&map->occupied_cells);
+            if (!need_resize(map, occupied + n_chunk, capacity))
+            {
+                break;
+            }
+
+            const size_t generation = map->generation;
+            const size_t n_pages    = get_resize_n_pages(map, n_chunk);
+
+            unlock_map(map);
+            const bool resized = resize_map(map, generation, n_pages, false);
+            lock_map_rw(map);
+
+            if (!resized)
+            {
+                // the new table could not be allocated
+                break;
+            }
+        }
+
+        // perform a share of any outstanding incremental migration
+        if (migrate_pages(map))
+        {
+            migration_complete = true;
+        }
+
+        batch_entry_t entries[BATCH_CHUNK_KEYS];
+        const size_t n_entries = prepare_batch(map->table,
+            &keys[begin], n_chunk, entries, true);
+
+        n_inserted += insert_batch_chunk(map, &keys[begin], &values[begin],
+            (NULL == out) ? NULL : &out[begin], entries, n_entries);
+    }
+
+    unlock_map(map);
+
+    reclaim_values(map);
+
+    if (migration_complete)
+    {
+        finish_migration(map);
+    }
+
+    return n_inserted;
+}
+
+size_t flat_map_find_batch(
+    flat_map_t*      map,
+    const map_key_t* keys,
+    void**           values,
+    size_t           n_keys)
+{
+    if (NULL == map || NULL == keys || NULL == values)
+    {
+        return 0;
+    }
+
+    size_t n_found = 0;
+
+    // as in flat_map_find(), a chunk whose search overlaps
+    // the replacement of the tables is retried in full
+    for (size_t begin = 0; begin < n_keys; begin += BATCH_CHUNK_KEYS)
+    {
+        const size_t n_chunk = (n_keys - begin < BATCH_CHUNK_KEYS)
+            ? n_keys - begin
+            : BATCH_CHUNK_KEYS;
+
+        for (;;)
+        {
+            size_t* active = enter_lookup(map);
+
+            const size_t version = read_tables_begin(map);
+            if ((version & 1) == 0)
+            {
+                memset(&values[begin], 0, n_chunk*sizeof(void*));
+
+                batch_entry_t entries[BATCH_CHUNK_KEYS];
+                table_t* table = __atomic_load_n(&map->table, __ATOMIC_ACQUIRE);
+                const size_t n_entries = prepare_batch(table,
+                    &keys[begin], n_chunk, entries, false);
+
+                const size_t n_chunk_found = find_batch_chunk(map, table,
+                    &keys[begin], &values[begin], entries, n_entries);
+
+                if (read_tables_validate(map, version))
+                {
+                    leave_lookup(active);
+                    n_found += n_chunk_found;
+                    break;
+                }
+            }
+
+            leave_lookup(active);
+            cpu_relax();
+        }
+    }
+
+    return n_found;
+}
+
+flat_map_iter_t* flat_map_iter_new(flat_map_t* map)
+{
+    if (NULL == map)
+    {
+        return NULL;
+    }
+
+    flat_map_iter_t* iter = malloc(sizeof(flat_map_iter_t));
+    if (NULL == iter)
+    {
+        return NULL;
+    }
+
+    iter->map       = map;
+    iter->cursor    = 0;
+    iter->exhausted = false;
+    iter->position  = 0;
+
+    iter->buffer.entries  = NULL;
+    iter->buffer.count    = 0;
+    iter->buffer.capacity = 0;
+
+    iter->handle = flat_map_enter(map);
+
+    return iter;
+}
+
+void flat_map_iter_delete(flat_map_iter_t* iter)
+{
+    if (NULL == iter)
+    {
+        return;
+    }
+
+    flat_map_leave(iter->map, iter->handle);
+
+    free(iter->buffer.entries);
+    free(iter);
+}
+
+bool flat_map_iter_next(
+    flat_map_iter_t* iter,
+    map_key_t*       key,
+    void**           value)
+{
+    if (NULL == iter || NULL == key)
+    {
+        return false;
+    }
+
+    while (iter->position == iter->buffer.count)
+    {
+        if (iter->exhausted)
+        {
+            return false;
+        }
+
+        // the values of the previous slice are no longer
+        // accessible, so its critical section may end
+        flat_map_leave(iter->map, iter->handle);
+        iter->handle = flat_map_enter(iter->map);
+
+        iter->position = 0;
+        if (!collect_slice(iter->map, &iter->cursor, 0, &iter->buffer, &iter->exhausted))
+        {
+            // return the part of the slice that was collected
+            iter->exhausted = true;
+        }
+    }
+
+    const slice_entry_t* entry = &iter->buffer.entries[iter->position++];
+
+    *key = entry->key;
+    if (value != NULL)
+    {
+        *value = entry->value;
+    }
+
+    return true;
+}
+
+bool flat_map_parallel_for_each(
+    flat_map_t*      map,
+    size_t           n_threads,
+    flat_map_visit_f fn,
+    void*            ctx)
+{
+    if (NULL == map || NULL == fn || 0 == n_threads)
+    {
+        return false;
+    }
+
+    for_each_t each;
+    each.map        = map;
+    each.fn         = fn;
+    each.ctx        = ctx;
+    each.n_chunks   = get_n_chunks(map, n_threads);
+    each.next_chunk = 0;
+    each.failed     = false;
+
+    const size_t n_helpers = n_threads - 1;
+
+    pthread_t* helpers   = NULL;
+    size_t     n_started = 0;
+    if (n_helpers > 0)
+    {
+        helpers = malloc(n_helpers*sizeof(pthread_t));
+    }
+
+    // any helper that fails to start leaves its share of the
+    // chunks to the remaining threads, so failure is benign
+    for (size_t i = 0; helpers != NULL && i < n_helpers; ++i)
+    {
+        if (pthread_create(&helpers[i], NULL, for_each_worker, &each) != 0)
+        {
+            break;
+        }
+
+        ++n_started;
+    }
+
+    for_each_worker(&each);
+
+    for (size_t i = 0; i < n_started; ++i)
+    {
+        pthread_join(helpers[i], NULL);
+    }
+
+    free(helpers);
+
+    return !each.failed;
+}
+
+void flat_map_set_thread_node(int node)
+{
+    thread_node = (node < 0) ? -1 : node;
+}
+
+// ----------------------------------------------------------------------------
+// Internal: Utilities
+
+// determine if the given value is a power of 2.
+static bool is_power_of_two(size_t n)
+{
+    return (n != 0) && ((n & (n - 1)) == 0);
+}
+
+// hint to the processor that we are spinning
+static void cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// determine the total capacity of a table
+static size_t get_capacity(table_t* table)
+{
+    return table->n_pages*table->cells_per_page;
+}
+
+// determine if a value resides in the snapshot
+// from which the map was opened
+static bool is_snapshot_value(flat_map_t* map, void* value)
+{
+    const uint8_t* as_bytes = (const uint8_t*)value;
+    return map->snapshot_values != NULL
+        && as_bytes >= map->snapshot_values
+        && as_bytes < map->snapshot_values + map->snapshot_size;
+}
+
+// destroy a value owned by the map, unless it resides
+// in the snapshot from which the map was opened
+static void dispose_value(flat_map_t* map, void* value)
+{
+    if (!is_snapshot_value(map, value))
+    {
+        map->deleter(value);
+    }
+}
+
+// destroy a value removed from or replaced in the map, which
+// concurrent readers may still hold; under deferred reclamation
+// the value is destroyed once all such readers have left
+static void retire_value(flat_map_t* map, void* value)
+{
+    // the snapshot mapping outlives every reader
+    if (NULL == map->gc || is_snapshot_value(map, value))
+    {
+        dispose_value(map, value);
+        return;
+    }
+
+    // a value whose deferral cannot be allocated is leaked rather
+    // than destroyed, as the caller may not wait for the readers
+    if (rcu_defer(map->gc, map->deleter, value))
+    {
+        __atomic_add_fetch(&map->n_retired, 1, __ATOMIC_RELAXED);
+    }
+}
+
+// collect retired values once enough have accumulated; called
+// without any lock held, and never waits for readers, such that
+// writers may also be readers of the map
+static void reclaim_values(flat_map_t* map)
+{
+    if (NULL == map->gc)
+    {
+        return;
+    }
+
+    // a single writer claims each batch
+    size_t n_retired = __atomic_load_n(&map->n_retired, __ATOMIC_RELAXED);
+    if (n_retired < RECLAIM_BATCH_VALUES
+     || !__atomic_compare_exchange_n(&map->n_retired, &n_retired, 0,
+            false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+        return;
+    }
+
+    rcu_try_synchronize(map->gc);
+}
+
+// locate the cell at `cell_index` in a table
+static cell_t* get_cell(table_t* table, size_t cell_index)
+{
+    if (NULL == table->blocks)
+    {
+        return &table->cells[cell_index];
+    }
+
+    const size_t page_index    = cell_index >> table->page_shift;
+    const size_t index_in_page = cell_index & (table->cells_per_page - 1);
+
+    uint8_t* block = table->blocks + page_index*table->block_size;
+    return (cell_t*)(block + PAGE_HEADER_SIZE) + index_in_page;
+}
+
+// locate the lock for the page at `page_index` in a table
+static page_lock_t* get_page_lock(table_t* table, size_t page_index)
+{
+    if (NULL == table->blocks)
+    {
+        return &table->page_locks[page_index];
+    }
+
+    return (page_lock_t*)(table->blocks + page_index*table->block_size);
+}
+
+static uint32_t get_hash(map_key_t key)
+{
+    unsigned char buffer[sizeof(uint32_t)];
+    MurmurHash3_x86_32((void*)&key, sizeof(map_key_t), 0, buffer);
+    return (*(uint32_t*)buffer);
+}
+
+// compute the 7-bit tag stored in the control byte for `key`; the
+// tag is derived independently of the hash that selects the initial
+// cell, so that keys which collide in the table rarely share a tag
+static uint8_t get_tag(map_key_t key)
+{
+    return (uint8_t)((key * 0x9E3779B97F4A7C15ULL) >> 57);
+}
+
+static size_t get_cell_index_for_hash(table_t* table, uint32_t hash)
+{
+    const size_t capacity = get_capacity(table);
+    return hash & (capacity - 1);
+}
+
+static size_t get_page_index_for_hash(table_t* table, uint32_t hash)
+{
+    // determine the appropriate cell index
+    const size_t cell_index = get_cell_index_for_hash(table, hash);
+
+    // compute the corresponding page index
+    return cell_index / table->cells_per_page;
+}
+
+// acquire shared access to the map for read / write operations
+static void lock_map_rw(flat_map_t* map)
+{
+    pthread_rwlock_rdlock(&map->map_lock);
+}
+
+// acquire exclusive access to the map for resize
+static void lock_map_resize(flat_map_t* map)
+{
+    pthread_rwlock_wrlock(&map->map_lock);
+}
+
+// release the map lock
+static void unlock_map(flat_map_t* map)
+{
+    pthread_rwlock_unlock(&map->map_lock);
+}
+
+// count a lookup in progress under the current reader epoch,
+// returning the count to be passed to leave_lookup()
+static size_t* enter_lookup(flat_map_t* map)
+{
+    if (SIZE_MAX == thread_reader_shard)
+    {
+        thread_reader_shard = __atomic_fetch_add(&next_reader_shard, 1, __ATOMIC_RELAXED)
+            & (N_READER_SHARDS - 1);
+    }
+
+    reader_shard_t* shard = &map->readers[thread_reader_shard];
+
+    for (;;)
+    {
+        const size_t epoch = __atomic_load_n(&map->reader_epoch, __ATOMIC_ACQUIRE);
+        size_t* active     = &shard->active[epoch & 1];
+
+        // the epoch is re-checked once the lookup is counted; if it
+        // advanced in between, the count may have been missed by
+        // wait_for_lookups(), so the lookup is counted again
+        __atomic_fetch_add(active, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&map->reader_epoch, __ATOMIC_SEQ_CST) == epoch)
+        {
+            return active;
+        }
+
+        __atomic_fetch_sub(active, 1, __ATOMIC_RELEASE);
+    }
+}
+
+// complete a lookup counted by enter_lookup()
+static void leave_lookup(size_t* active)
+{
+    __atomic_fetch_sub(active, 1, __ATOMIC_RELEASE);
+}
+
+// begin an optimistic read of the table pointers of the map,
+// returning the observed version
+static size_t read_tables_begin(flat_map_t* map)
+{
+    return __atomic_load_n(&map->table_version, __ATOMIC_SEQ_CST);
+}
+
+// determine if an optimistic read of the table pointers of the
+// map that began at `version` observed tables that remain current
+static bool read_tables_validate(flat_map_t* map, size_t version)
+{
+    // order the preceding loads from tables before the version re-check
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return (version & 1) == 0
+        && __atomic_load_n(&map->table_version, __ATOMIC_RELAXED) == version;
+}
+
+// mark the table pointers of the map as being updated for lookups;
+// must be called with the exclusive map lock held
+//
+// returns `false` if an update is already in progress, in which
+// case it is completed only by its own end_table_update()
+static bool begin_table_update(flat_map_t* map)
+{
+    if (map->table_version & 1)
+    {
+        return false;
+    }
+
+    // version becomes odd; the fence orders the version
+    // update before any of the subsequent stores to the map
+    __atomic_store_n(&map->table_version, map->table_version + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return true;
+}
+
+// publish updated table pointers to lookups
+static void end_table_update(flat_map_t* map)
+{
+    __atomic_store_n(&map->table_version, map->table_version + 1, __ATOMIC_SEQ_CST);
+}
+
+// install `table` and `old_table` as the tables of the map;
+// must be called with the exclusive map lock held
+static void replace_tables(flat_map_t* map, table_t* table, table_t* old_table)
+{
+    const bool began = begin_table_update(map);
+
+    // the release stores publish the initialization of the tables
+    __atomic_store_n(&map->table, table, __ATOMIC_RELEASE);
+    __atomic_store_n(&map->old_table, old_table, __ATOMIC_RELEASE);
+
+    if (began)
+    {
+        end_table_update(map);
+    }
+}
+
+// block until every lookup that may have observed a table since
+// replaced has completed, such that the table may be destroyed;
+// must be called with the exclusive map lock held
+static void wait_for_lookups(flat_map_t* map)
+{
+    // lookups that begin hereafter are counted under the other
+    // parity, and observe only the tables now installed
+    const size_t epoch = __atomic_fetch_add(&map->reader_epoch, 1, __ATOMIC_SEQ_CST);
+
+    for (size_t i = 0; i < N_READER_SHARDS; ++i)
+    {
+        while (__atomic_load_n(&map->readers[i].active[epoch & 1], __ATOMIC_SEQ_CST) != 0)
+        {
+            cpu_relax();
+        }
+    }
+}
+
+// acquire shared access to a page; used only as the fallback
+// for readers that repeatedly fail optimistic validation
+static void lock_page_read(table_t* table, size_t page_index)
+{
+    page_lock_t* lock = get_page_lock(table, page_index);
+    acquire_page_lock(table, page_index, lock, false);
+}
+
+// release shared access to a page
+static void unlock_page_read(table_t* table, size_t page_index)
+{
+    page_lock_t* lock = get_page_lock(table, page_index);
+    release_page_lock(table, lock, false);
+}
+
+// acquire exclusive access to a page and mark
+// the page as being modified for optimistic readers
+static void lock_page_write(table_t* table, size_t page_index)
+{
+    page_lock_t* lock = get_page_lock(table, page_index);
+    acquire_page_lock(table, page_index, lock, true);
+
+    // version becomes odd; the fence orders the version
+    // update before any of the subsequent stores to cells
+    __atomic_store_n(&lock->version, lock->version + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+// publish modifications to a page and release exclusive access
+static void unlock_page_write(table_t* table, size_t page_index)
+{
+    page_lock_t* lock = get_page_lock(table, page_index);
+
+    if (table->n_replicas > 0)
+    {
+        copy_page_to_replicas(table, page_index);
+    }
+
+    // version becomes even again; all stores to cells
+    // in the page happen-before this release store
+    __atomic_store_n(&lock->version, lock->version + 1, __ATOMIC_RELEASE);
+
+    release_page_lock(table, lock, true);
+}
+
+// attempt to acquire shared access to a page without blocking
+static bool try_lock_page_read(table_t* table, size_t page_index)
+{
+    page_lock_t* lock = get_page_lock(table, page_index);
+    return try_acquire_page_lock(table, lock, false);
+}
+
+// attempt to acquire exclusive access to a page without blocking
+static bool try_lock_page_write(table_t* table, size_t page_index)
+{
+    page_lock_t* lock = get_page_lock(table, page_index);
+    if (!try_acquire_page_lock(table, lock, true))
+    {
+        return false;
+    }
+
+    __atomic_store_n(&lock->version, lock->version + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return true;
+}
+
+// begin an optimistic read of a page, returning the observed version
+static size_t read_page_begin(table_t* table, size_t page_index)
+{
+    return __atomic_load_n(&get_page_lock(table, page_index)->version, __ATOMIC_ACQUIRE);
+}
+
+// determine if an optimistic read of a page that began
+// at `version` observed a consistent view of its cells
+static bool read_page_validate(
+    table_t* table,
+    size_t   page_index,
+    size_t   version)
+{
+    // order the preceding loads from cells before the version re-check
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return (version & 1) == 0
+        && __atomic_load_n(&get_page_lock(table, page_index)->version, __ATOMIC_RELAXED) == version;
+}
+
+// block until a page lock is acquired; with statistics enabled,
+// an uncontended acquisition is attempted first, and the time
+// spent blocked is recorded if that attempt fails
+static void acquire_page_lock(
+    table_t*     table,
+    size_t       page_index,
+    page_lock_t* lock,
+    bool         exclusive)
+{
+#if defined(FLAT_MAP_STATS)
+    stats_shard_t* shard = &table->stats[page_index & (N_COUNTER_SHARDS - 1)];
+    __atomic_fetch_add(&shard->lock_acquisitions, 1, __ATOMIC_RELAXED);
+
+    if (try_acquire_page_lock(table, lock, exclusive))
+    {
+        return;
+    }
+
+    const uint64_t start = now_ns();
+#else
+    (void)page_index;
+#endif
+
+    block_on_page_lock(table, lock, exclusive);
+
+#if defined(FLAT_MAP_STATS)
+    __atomic_fetch_add(&shard->lock_contentions, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&shard->lock_wait_ns, now_ns() - start, __ATOMIC_RELAXED);
+#endif
+}
+
+// determine if a page has been migrated to a newer table;
+// the flag is only ever set under the page write lock
+static bool is_page_migrated(table_t* table, size_t page_index)
+{
+    return __atomic_load_n(&get_page_lock(table, page_index)->migrated, __ATOMIC_RELAXED);
+}
+
+// ----------------------------------------------------------------------------
+// Internal: Page Locks
+
+// Each kind of page lock is operated on through the functions below;
+// the spinning kinds have no shared mode, so a shared acquisition of
+// such a lock is exclusive.
+
+// initialize the lock of a single page
+static void initialize_page_lock(table_t* table, size_t page_index)
+{
+    page_lock_t* lock = get_page_lock(table, page_index);
+
+    lock->version  = 0;
+    lock->migrated = false;
+
+    if (FLAT_MAP_LOCK_SPINLOCK == table->lock_kind)
+    {
+        lock->lock.spin = 0;
+    }
+    else if (FLAT_MAP_LOCK_TICKET == table->lock_kind)
+    {
+        lock->lock.ticket.next    = 0;
+        lock->lock.ticket.serving = 0;
+    }
+    else if (FLAT_MAP_LOCK_RWLOCK == table->lock_kind)
+    {
+        lock->lock.sync = &table->sync_locks[page_index];
+        rwlock_init(lock->lock.sync);
+    }
+    else
+    {
+        pthread_rwlock_init(&lock->lock.rwlock, NULL);
+    }
+}
+
+// destroy the lock of a single page
+static void destroy_page_lock(table_t* table, size_t page_index)
+{
+    page_lock_t* lock = get_page_lock(table, page_index);
+
+    if (FLAT_MAP_LOCK_RWLOCK == table->lock_kind)
+    {
+        rwlock_destroy(lock->lock.sync);
+    }
+    else if (FLAT_MAP_LOCK_PTHREAD_RWLOCK == table->lock_kind)
+    {
+        pthread_rwlock_destroy(&lock->lock.rwlock);
+    }
+}
+
+// attempt to acquire a page lock without blocking
+static bool try_acquire_page_lock(
+    table_t*     table,
+    page_lock_t* lock,
+    bool         exclusive)
+{
+    if (FLAT_MAP_LOCK_SPINLOCK == table->lock_kind)
+    {
+        return 0 == __atomic_load_n(&lock->lock.spin, __ATOMIC_RELAXED)
+            && 0 == __atomic_exchange_n(&lock->lock.spin, 1, __ATOMIC_ACQUIRE);
+    }
+    else if (FLAT_MAP_LOCK_TICKET == table->lock_kind)
+    {
+        // the lock is free only if no ticket has been
+        // taken beyond the one currently being served
+        uint32_t serving = __atomic_load_n(&lock->lock.ticket.serving, __ATOMIC_ACQUIRE);
+        return __atomic_compare_exchange_n(&lock->lock.ticket.next, &serving,
+            serving + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+    }
+    else if (FLAT_MAP_LOCK_RWLOCK == table->lock_kind)
+    {
+        return exclusive
+            ? rwlock_try_lock_write(lock->lock.sync)
+            : rwlock_try_lock_read(lock->lock.sync);
+    }
+
+    const int acquired = exclusive
+        ? pthread_rwlock_trywrlock(&lock->lock.rwlock)
+        : pthread_rwlock_tryrdlock(&lock->lock.rwlock);
+    return 0 == acquired;
+}
+
+// acquire a page lock, blocking (or spinning) until it is available
+static void block_on_page_lock(
+    table_t*     table,
+    page_lock_t* lock,
+    bool         exclusive)
+{
+    if (FLAT_MAP_LOCK_SPINLOCK == table->lock_kind)
+    {
+        while (__atomic_exchange_n(&lock->lock.spin, 1, __ATOMIC_ACQUIRE) != 0)
+        {
+            // wait on plain loads, which leave the cache line shared
+            // among the waiters, until the lock appears to be free
+            while (__atomic_load_n(&lock->lock.spin, __ATOMIC_RELAXED) != 0)
+            {
+                cpu_relax();
+            }
+        }
+    }
+    else if (FLAT_MAP_LOCK_TICKET == table->lock_kind)
+    {
+        const uint32_t ticket =
+            __atomic_fetch_add(&lock->lock.ticket.next, 1, __ATOMIC_RELAXED);
+        while (__atomic_load_n(&lock->lock.ticket.serving, __ATOMIC_ACQUIRE) != ticket)
+        {
+            cpu_relax();
+        }
+    }
+    else if (FLAT_MAP_LOCK_RWLOCK == table->lock_kind)
+    {
+        if (exclusive)
+        {
+            rwlock_lock_write(lock->lock.sync);
+        }
+        else
+        {
+            rwlock_lock_read(lock->lock.sync);
+        }
+    }
+    else
+    {
+        if (exclusive)
+        {
+            pthread_rwlock_wrlock(&lock->lock.rwlock);
+        }
+        else
+        {
+            pthread_rwlock_rdlock(&lock->lock.rwlock);
+        }
+    }
+}
+
+// release a page lock acquired with the given mode
+static void release_page_lock(
+    table_t*     table,
+    page_lock_t* lock,
+    bool         exclusive)
+{
+    if (FLAT_MAP_LOCK_SPINLOCK == table->lock_kind)
+    {
+        __atomic_store_n(&lock->lock.spin, 0, __ATOMIC_RELEASE);
+    }
+    else if (FLAT_MAP_LOCK_TICKET == table->lock_kind)
+    {
+        // only the holder of the lock advances the ticket being served
+        __atomic_store_n(&lock->lock.ticket.serving,
+            lock->lock.ticket.serving + 1, __ATOMIC_RELEASE);
+    }
+    else if (FLAT_MAP_LOCK_RWLOCK == table->lock_kind)
+    {
+        if (exclusive)
+        {
+            rwlock_unlock_write(lock->lock.sync);
+        }
+        else
+        {
+            rwlock_unlock_read(lock->lock.sync);
+        }
+    }
+    else
+    {
+        pthread_rwlock_unlock(&lock->lock.rwlock);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Internal: Insert, Remove, Find
+
+// insert `key` into the map, or update the value associated with `key`
+// if it is already present; must be called with shared map lock held
+static insert_result_t insert_key(
+    flat_map_t* map,
+    uint32_t    hash,
+    map_key_t   key,
+    void*       value,
+    void**      replaced,
+    compute_t*  compute)
+{
+    insert_result_t result = INSERT_FAILED;
+    
+    // during an incremental resize, the key may still reside in
+    // an unmigrated page of the previous table; in that case it
+    // is updated in place and moved later along with its page
+    if (map->old_table != NULL)
+    {
+        result = insert_into_table(map->old_table,
+            hash, key, value, replaced, true, compute);
+    }
+    
+    if (INSERT_FAILED == result)
+    {
+        result = insert_into_table(map->table,
+            hash, key, value, replaced, false, compute);
+    }
+
+    if (INSERT_NEW == result)
+    {
+        count_cells(map, hash, 1, 1);
+    }
+    else if (INSERT_REUSED == result)
+    {
+        count_cells(map, hash, 0, 1);
+    }
+
+    return result;
+}
+
+// insert `key` into the map as for insert_key(), growing the table
+// whenever the key cannot be placed within its neighborhood under
+// hopscotch probing; must be called with shared map lock held, which
+// is released while the table grows
+//
+// returns INSERT_FAILED if the key could not be placed
+static insert_result_t insert_key_or_grow(
+    flat_map_t* map,
+    uint32_t    hash,
+    map_key_t   key,
+    void*       value,
+    void**      replaced,
+    compute_t*  compute)
+{
+    for (;;)
+    {
+        const insert_result_t result = insert_key(map,
+            hash, key, value, replaced, compute);
+        if (result != INSERT_FULL)
+        {
+            return result;
+        }
+
+        if (!grow_full_table(map))
+        {
+            return INSERT_FAILED;
+        }
+    }
+}
+
+// replace the current table with a table of twice its size, once a key
+// cannot be placed in it; must be called with shared map lock held,
+// which is released while the table grows
+//
+// returns `false` if the table is too sparse for growth to help,
+// or the new table could not be allocated
+static bool grow_full_table(flat_map_t* map)
+{
+    const size_t capacity = get_capacity(map->table);
+    const size_t live     = get_folded_count(&map->live_cells);
+    if (live < capacity*HOPSCOTCH_MIN_GROWTH_LOAD)
+    {
+        return false;
+    }
+
+    const size_t generation = map->generation;
+    const size_t n_pages    = map->table->n_pages << 1;
+
+    unlock_map(map);
+    const bool resized = resize_map(map, generation, n_pages, false);
+    lock_map_rw(map);
+
+    return resized;
+}
+
+// search the map for `key`; must be called with shared map lock held,
+// or within a lookup that validates the table version thereafter
+static void* find_key(
+    flat_map_t* map,
+    uint32_t    hash,
+    map_key_t   key)
+{
+    void* value = NULL;
+    
+    // the previous table is consulted first; a page is marked
+    // as migrated only after its contents are visible in the
+    // current table, so a key in flight is never missed
+    table_t* old_table = __atomic_load_n(&map->old_table, __ATOMIC_ACQUIRE);
+    if (old_table != NULL)
+    {
+        value = find_in_table(map, get_local_table(old_table), hash, key);
+    }
+    
+    if (NULL == value)
+    {
+        table_t* table = __atomic_load_n(&map->table, __ATOMIC_ACQUIRE);
+        value = find_in_table(map, get_local_table(table), hash, key);
+    }
+
+    return value;
+}
+
+// insert `key` into a single table, or update the value associated
+// with `key` if it is already present; when `update_only` is set,
+// the search terminates without inserting if the key is not found
+static insert_result_t insert_into_table(
+    table_t*   table,
+    uint32_t   hash,
+    map_key_t  key,
+    void*      value,
+    void**     replaced,
+    bool       update_only,
+    compute_t* compute)
+{
+    // keys are only ever inserted into the current table, and a
+    // previous table, in which keys no longer move, is searched
+    // page by page just as under plain linear probing
+    if (FLAT_MAP_PROBING_ROBIN_HOOD == table->probing && !update_only)
+    {
+        return insert_robin_hood(table, hash, key, value, replaced, compute);
+    }
+
+    if (FLAT_MAP_PROBING_HOPSCOTCH == table->probing && !update_only)
+    {
+        return insert_hopscotch(table, hash, key, value, replaced, compute);
+    }
+
+    // locate the appropriate cell index to begin search
+    size_t cell_index = get_cell_index_for_hash(table, hash);
+    // locate the appropriate page index to begin search
+    size_t page_index = get_page_index_for_hash(table, hash);
+
+
+    insert_result_t result = INSERT_FAILED;
+    bool continue_search   = true;
+
+    // each page is visited at most once, except for the initial page,
+    // which is revisited from its first cell after a full cycle of the
+    // table in order to examine the cells that precede the initial cell
+    for (size_t n_visited = 0; n_visited <= table->n_pages; ++n_visited)
+    {
+        // acquire exclusive access to the page
+        lock_page_write(table, page_index);
+
+        // search for the key in the current page
+        result = insert_at(table, cell_index,
+            key, value, replaced, update_only, compute, &continue_search);
+
+        // release exclusive access to the page
+        unlock_page_write(table, page_index);
+
+        if (!continue_search)
+        {
+            // key was inserted or updated, or empty cell encountered
+            break;
+        }
+
+        // increment the page and cell indices for next iteration
+        page_index = (page_index + 1) % table->n_pages;
+        cell_index = page_index * table->cells_per_page;
+    }
+
+    return result;
+}
+
+// remove `key` from a single table
+static bool remove_from_table(
+    flat_map_t* map,
+    table_t*    table,
+    uint32_t    hash,
+    map_key_t   key)
+{
+    // keys in the previous table are never shifted, as they
+    // could be moved into pages that have already been migrated;
+    // removal from that table leaves a tombstone instead
+    if (FLAT_MAP_PROBING_ROBIN_HOOD == table->probing && table == map->table)
+    {
+        return remove_robin_hood(map, table, hash, key);
+    }
+
+    if (FLAT_MAP_PROBING_HOPSCOTCH == table->probing && table == map->table)
+    {
+        return remove_hopscotch(map, table, hash, key);
+    }
+
+    // locate the appropriate cell index to begin search
+    size_t cell_index = get_cell_index_for_hash(table, hash);
+    // locate the appropriate page index to begin search
+    size_t page_index = get_page_index_for_hash(table, hash);
+
+
+    bool removed         = false;
+    bool continue_search = true;
+
+    // each page is visited at most once, except for the initial page,
+    // which is revisited from its first cell after a full cycle of the
+    // table in order to examine the cells that precede the initial cell
+    for (size_t n_visited = 0; n_visited <= table->n_pages; ++n_visited)
+    {
+        // acquire exclusive access to the page
+        lock_page_write(table, page_index);
+
+        // search for the key in the current page
+        removed = remove_at(map, table, cell_index, key, &continue_search);
+
+        // release exclusive access to the page
+        unlock_page_write(table, page_index);
+
+        if (!continue_search)
+        {
+            // key was removed, or empty cell encountered
+            break;
+        }
+
+        // increment the page and cell indices for next iteration
+        page_index = (page_index + 1) % table->n_pages;
+        cell_index = page_index * table->cells_per_page;
+    }
+
+    return removed;
+}
+
+// search a single table for `key`
+static void* find_in_table(
+    flat_map_t* map,
+    table_t*    table,
+    uint32_t    hash,
+    map_key_t   key)
+{
+    // the table may be a replica of the current table
+    const bool current = table->primary == __atomic_load_n(&map->table, __ATOMIC_RELAXED);
+    if (FLAT_MAP_PROBING_ROBIN_HOOD == table->probing && current)
+    {
+        return find_robin_hood(table, hash, key);
+    }
+
+    if (FLAT_MAP_PROBING_HOPSCOTCH == table->probing && current)
+    {
+        return find_hopscotch(table, hash, key);
+    }
+
+    // locate the appropriate cell index to begin search
+    size_t cell_index = get_cell_index_for_hash(table, hash);
+    // locate the appropriate page index to begin search
+    size_t page_index = get_page_index_for_hash(table, hash);
+
+
+    void* value          = NULL;
+    bool continue_search = true;
+
+    // each page is visited at most once, except for the initial page,
+    // which is revisited from its first cell after a full cycle of the
+    // table in order to examine the cells that precede the initial cell
+    for (size_t n_visited = 0; n_visited <= table->n_pages; ++n_visited)
+    {
+        // search for the key in the current page; readers
+        // do not acquire the page lock on the common path
+        value = find_in_page(table, page_index,
+            cell_index, key, &continue_search);
+        if (!continue_search)
+        {
+            // key was found, or empty cell encountered
+            break;
+        }
+
+        // increment the page and cell indices for next iteration
+        page_index = (page_index + 1) % table->n_pages;
+        cell_index = page_index * table->cells_per_page;
+    }
+
+    return value;
+}
+
+// examine the control bytes of a group of at most GROUP_WIDTH cells;
+// returns the mask of cells whose control byte matches `tag`, and
+// sets `empty` to the mask of cells that are empty
+static uint32_t match_group(
+    const uint8_t* control,
+    size_t         n_cells,
+    uint8_t        tag,
+    uint32_t*      empty)
+{
+    uint32_t match_mask = 0;
+    uint32_t empty_mask = 0;
+
+#if defined(__SSE2__)
+    // control arrays are padded, so a full group may always be loaded
+    const __m128i group = _mm_loadu_si128((const __m128i*)control);
+    match_mask = (uint32_t)_mm_movemask_epi8(
+        _mm_cmpeq_epi8(group, _mm_set1_epi8((char)tag)));
+    empty_mask = (uint32_t)_mm_movemask_epi8(
+        _mm_cmpeq_epi8(group, _mm_set1_epi8((char)CONTROL_EMPTY)));
+#else
+    const size_t n_bytes = (n_cells < GROUP_WIDTH) ? n_cells : GROUP_WIDTH;
+    for (size_t i = 0; i < n_bytes; ++i)
+    {
+        const uint8_t byte = __atomic_load_n(&control[i], __ATOMIC_RELAXED);
+        match_mask |= (uint32_t)(byte == tag) << i;
+        empty_mask |= (uint32_t)(byte == CONTROL_EMPTY) << i;
+    }
+#endif
+
+    // discard lanes beyond the end of the page
+    const uint32_t valid = (n_cells >= GROUP_WIDTH)
+        ? (1u << GROUP_WIDTH) - 1
+        : (1u << n_cells) - 1;
+
+    *empty = empty_mask & valid;
+    return match_mask & valid;
+}
+
+// search the cells of a page, beginning at `cell_index`, by way of
+// their control bytes; returns the index of the cell that contains
+// `key` (with `found` set), the index of the first empty cell that
+// terminates the search, or NO_CELL if the search must continue
+static size_t probe_page(
+    table_t*  table,
+    size_t    cell_index,
+    map_key_t key,
+    bool*     found)
+{
+    *found = false;
+
+    const uint8_t tag = get_tag(key);
+
+    // compute the index of the cell relative to page
+    const size_t index_in_page = cell_index % table->cells_per_page;
+    // compute the index at which iteration for this page should end (exclusive)
+    const size_t end_index = cell_index + (table->cells_per_page - index_in_page);
+
+    for (size_t i = cell_index; i < end_index; i += GROUP_WIDTH)
+    {
+        uint32_t empty;
+        uint32_t match = match_group(
+            &table->control[i], end_index - i, tag, &empty);
+
+        // only cells that precede the first empty cell are candidates
+        if (empty != 0)
+        {
+            match &= (empty & (~empty + 1)) - 1;
+        }
+
+        // compare the full key only for cells with a matching tag
+        while (match != 0)
+        {
+            const size_t index = i + (size_t)__builtin_ctz(match);
+            if (__atomic_load_n(&get_cell(table, index)->key, __ATOMIC_RELAXED) == key)
+            {
+                *found = true;
+                STATS_PROBE(index - cell_index + 1, 0);
+                return index;
+            }
+
+            match &= match - 1;
+        }
+
+        if (empty != 0)
+        {
+            const size_t index = i + (size_t)__builtin_ctz(empty);
+            STATS_PROBE(index - cell_index + 1, 0);
+            return index;
+        }
+    }
+
+    STATS_PROBE(end_index - cell_index, 0);
+    return NO_CELL;
+}
+
+// search a single page for `key` without acquiring the page lock;
+// the search is retried whenever a concurrent writer is observed,
+// and falls back to the shared page lock under sustained contention
+static void* find_in_page(
+    table_t*  table,
+    size_t    page_index,
+    size_t    cell_index,
+    map_key_t key,
+    bool*     continue_search)
+{
+    for (size_t i = 0; i < MAX_OPTIMISTIC_READS; ++i)
+    {
+        const size_t version = read_page_begin(table, page_index);
+        if (version & 1)
+        {
+            // a writer is active in the page
+            cpu_relax();
+            continue;
+        }
+
+        void* value = find_at(table, cell_index, key, continue_search);
+        if (read_page_validate(table, page_index, version))
+        {
+            return value;
+        }
+    }
+
+    lock_page_read(table, page_index);
+    void* value = find_at(table, cell_index, key, continue_search);
+    unlock_page_read(table, page_index);
+
+    return value;
+}
+
+// run the callback of a compute operation on the value currently
+// associated with `key`, or NULL if the key is not present
+static void* compute_value(
+    compute_t* compute,
+    map_key_t  key,
+    void*      current)
+{
+    void* value = compute->fn(key, current, compute->ctx);
+
+    compute->result = value;
+    if (current != NULL && value != current)
+    {
+        compute->replaced = current;
+    }
+
+    return value;
+}
+
+// determine the value for a key about to be inserted into an empty
+// cell; returns false if a compute operation declines the insertion
+static bool compute_new_value(
+    compute_t* compute,
+    map_key_t  key,
+    void**     value)
+{
+    if (NULL == compute)
+    {
+        return true;
+    }
+
+    *value = compute_value(compute, key, NULL);
+    return *value != NULL;
+}
+
+static insert_result_t insert_at(
+    table_t*   table,
+    size_t     cell_index,
+    map_key_t  key,
+    void*      value,
+    void**     replaced,
+    bool       update_only,
+    compute_t* compute,
+    bool*      continue_search)
+{
+    *continue_search       = true;
+    insert_result_t result = INSERT_FAILED;
+
+    STATS_PROBE(0, 1);
+
+    // the contents of a migrated page now reside in the
+    // new table; the page is treated as if it were full
+    if (is_page_migrated(table, cell_index / table->cells_per_page))
+    {
+        return result;
+    }
+
+    if (table->control != NULL)
+    {
+        bool found;
+        const size_t index = probe_page(table, cell_index, key, &found);
+        if (NO_CELL == index)
+        {
+            return result;
+        }
+
+        cell_t* cell = get_cell(table, index);
+        if (found)
+        {
+            // found a matching key, replace the value
+            if (replaced != NULL)
+            {
+                *replaced = cell->value;
+            }
+
+            if (compute != NULL)
+            {
+                value = compute_value(compute, key, cell->value);
+            }
+
+            __atomic_store_n(&cell->value, value, __ATOMIC_RELAXED);
+            result = INSERT_UPDATED;
+        }
+        else if (!update_only && compute_new_value(compute, key, &value))
+        {
+            // found an empty cell, insert here
+            __atomic_store_n(&cell->key, key, __ATOMIC_RELAXED);
+            __atomic_store_n(&cell->value, value, __ATOMIC_RELAXED);
+            __atomic_store_n(&table->control[index], get_tag(key), __ATOMIC_RELAXED);
+            result = INSERT_NEW;
+        }
+
+        *continue_search = false;
+        return result;
+    }
+
+    // compute the index of the cell relative to page
+    const size_t index_in_page = cell_index % table->cells_per_page;
+    // compute the index at which iteration for this page should end (exclusive)
+    const size_t end_index = cell_index + (table->cells_per_page - index_in_page);
+
+    // iterate over all cells in the page
+    for (size_t i = cell_index; i < end_index; ++i)
+    {
+        STATS_PROBE(1, 0);
+
+        // locate a single cell
+        cell_t* cell = get_cell(table, i);
+
+        if (cell->key == key)
+        {
+            // found a matching key, replace the value
+            if (replaced != NULL)
+            {
+                *replaced = cell->value;
+            }
+
+            if (compute != NULL)
+            {
+                value = compute_value(compute, key, cell->value);
+            }
+
+            __atomic_store_n(&cell->value, value, __ATOMIC_RELAXED);
+            result           = INSERT_UPDATED;
+            *continue_search = false;
+            break;
+        }
+
+        if (cell->key == EMPTY_KEY)
+        {
+            if (!update_only && compute_new_value(compute, key, &value))
+            {
+                // found an empty cell, insert here
+                __atomic_store_n(&cell->key, key, __ATOMIC_RELAXED);
+                __atomic_store_n(&cell->value, value, __ATOMIC_RELAXED);
+                result = INSERT_NEW;
+            }
+
+            *continue_search = false;
+            break;
+        }
+    }
+
+    // if we fall off the end of the page without finding 
+    // a matching key or an empty cell, we must continue
+    // the search on the following page
+
+    return result;
+}
+
+static bool remove_at(
+    flat_map_t* map, 
+    table_t*    table,
+    size_t      cell_index, 
+    map_key_t   key,
+    bool*       continue_search)
+{
+    *continue_search = true;
+    bool removed     = false;
+
+    STATS_PROBE(0, 1);
+
+    // the contents of a migrated page now reside in the
+    // new table; the page is treated as if it were full
+    if (is_page_migrated(table, cell_index / table->cells_per_page))
+    {
+        return removed;
+    }
+
+    if (table->control != NULL)
+    {
+        bool found;
+        const size_t index = probe_page(table, cell_index, key, &found);
+        if (NO_CELL == index)
+        {
+            return removed;
+        }
+
+        if (found)
+        {
+            // delete the stored value and mark the cell with a tombstone
+            retire_value(map, get_cell(table, index)->value);
+
+            __atomic_store_n(&get_cell(table, index)->key, TOMBSTONE_KEY, __ATOMIC_RELAXED);
+            __atomic_store_n(&table->control[index], CONTROL_TOMBSTONE, __ATOMIC_RELAXED);
+            removed = true;
+        }
+
+        *continue_search = false;
+        return removed;
+    }
+
+    // compute the index of the cell relative to page
+    const size_t index_in_page = cell_index % table->cells_per_page;
+    // compute the index at which iteration for this page should end (exclusive)
+    const size_t end_index = cell_index + (table->cells_per_page - index_in_page);
+
+    // iterate over all cells in the page
+    for (size_t i = cell_index; i < end_index; ++i)
+    {
+        STATS_PROBE(1, 0);
+
+        // locate a single cell
+        cell_t* cell = get_cell(table, i);
+
+        if (cell->key == key)
+        {
+            // found a match
+            
+            // delete the stored value
+            retire_value(map, cell->value);
+            
+            // mark the cell with a tombstone
+            __atomic_store_n(&cell->key, TOMBSTONE_KEY, __ATOMIC_RELAXED);
+
+            removed          = true;
+            *continue_search = false;
+            break;
+        }
+
+        if (cell->key == EMPTY_KEY)
+        {
+            // found an empty cell, search is over
+            removed          = false;
+            *continue_search = false;
+            break;
+        }
+    }
+
+    // if we fall off the end of the page without finding 
+    // a matching key or an empty cell, we must continue
+    // the search on the following page
+
+    return removed;
+}
+
+static void* find_at(
+    table_t*  table,
+    size_t    cell_index,
+    map_key_t key,
+    bool*     continue_search)
+{
+    *continue_search = true;
+    void* value      = NULL;
+
+    STATS_PROBE(0, 1);
+
+    // the contents of a migrated page now reside in the
+    // new table; the page is treated as if it were full
+    if (is_page_migrated(table, cell_index / table->cells_per_page))
+    {
+        return value;
+    }
+
+    if (table->control != NULL)
+    {
+        bool found;
+        const size_t index = probe_page(table, cell_index, key, &found);
+        if (NO_CELL == index)
+        {
+            return value;
+        }
+
+        if (found)
+        {
+            value = __atomic_load_n(&get_cell(table, index)->value, __ATOMIC_RELAXED);
+        }
+
+        *continue_search = false;
+        return value;
+    }
+
+    // compute the index of the cell relative to page
+    const size_t index_in_page = cell_index % table->cells_per_page;
+    // compute the index at which iteration for this page should end (exclusive)
+    const size_t end_index = cell_index + (table->cells_per_page - index_in_page);
+
+    // iterate over all cells in the page
+    for (size_t i = cell_index; i < end_index; ++i)
+    {
+        STATS_PROBE(1, 0);
+
+        // locate a single cell; the cell may be modified
+        // concurrently, so each field is loaded atomically
+        cell_t* cell = get_cell(table, i);
+        const map_key_t cell_key = __atomic_load_n(&cell->key, __ATOMIC_RELAXED);
+
+        if (cell_key == key)
+        {
+            // found a match for our query
+            value = __atomic_load_n(&cell->value, __ATOMIC_RELAXED);
+            *continue_search = false;
+            break;
+        }
+
+        if (cell_key == EMPTY_KEY)
+        {
+            // found an empty cell, terminate search
+            *continue_search = false;
+            break;
+        }
+    }
+
+    // if we fall off the end of the page without finding 
+    // a matching key or an empty cell, we must continue
+    // the search on the following page
+
+    return value;
+}
+
+// ----------------------------------------------------------------------------
+// Internal: Batched Operations
+
+// Each chunk of a batch is hashed in full, and the initial cell and
+// page lock of every key are prefetched, before any key is resolved;
+// the cache misses for the keys in a chunk then overlap, rather than
+// each being paid in sequence. The keys of a chunk are then grouped
+// by initial page, such that each page is locked (or optimistically
+// read) once for all of the keys that begin their search within it.
+
+// issue prefetches for a cell and the lock of the page that contains it
+static void prefetch_cell(
+    table_t* table,
+    size_t   cell_index,
+    bool     for_write)
+{
+    const size_t page_index = cell_index / table->cells_per_page;
+
+    if (for_write)
+    {
+        __builtin_prefetch(get_cell(table, cell_index), 1, 3);
+        __builtin_prefetch(get_page_lock(table, page_index), 1, 3);
+    }
+    else
+    {
+        __builtin_prefetch(get_cell(table, cell_index), 0, 3);
+        __builtin_prefetch(get_page_lock(table, page_index), 0, 3);
+    }
+
+    if (table->control != NULL)
+    {
+        __builtin_prefetch(&table->control[cell_index], 0, 3);
+    }
+}
+
+// hash each key in a chunk of at most BATCH_CHUNK_KEYS keys, prefetch
+// its initial cell, and populate `entries` ordered by initial page;
+// the reserved keys are omitted from `entries`
+//
+// returns the number of entries populated
+static size_t prepare_batch(
+    table_t*         table,
+    const map_key_t* keys,
+    size_t           n_keys,
+    batch_entry_t*   entries,
+    bool             for_write)
+{
+    size_t n_entries = 0;
+
+    for (size_t i = 0; i < n_keys; ++i)
+    {
+        if (EMPTY_KEY == keys[i] || TOMBSTONE_KEY == keys[i])
+        {
+            continue;
+        }
+
+        const uint32_t hash       = get_hash(keys[i]);
+        const size_t   cell_index = get_cell_index_for_hash(table, hash);
+
+        prefetch_cell(table, cell_index, for_write);
+
+        batch_entry_t* entry = &entries[n_entries++];
+        entry->position   = i;
+        entry->page_index = cell_index / table->cells_per_page;
+        entry->hash       = hash;
+    }
+
+    sort_batch(entries, n_entries);
+
+    return n_entries;
+}
+
+// order entries by initial page; the sort is stable, so repeated
+// keys within a batch are resolved in the order they were provided
+static void sort_batch(batch_entry_t* entries, size_t n_entries)
+{
+    for (size_t i = 1; i < n_entries; ++i)
+    {
+        const batch_entry_t entry = entries[i];
+
+        size_t j = i;
+        while (j > 0 && entries[j - 1].page_index > entry.page_index)
+        {
+            entries[j] = entries[j - 1];
+            --j;
+        }
+
+        entries[j] = entry;
+    }
+}
+
+// determine if the keys of a batch may be resolved in page groups;
+// this requires that each key resides in a single table, in which
+// keys never move once inserted, which excludes the duration of an
+// incremental resize and tables that utilize robin hood probing
+static bool is_batch_groupable(flat_map_t* map)
+{
+    return NULL == __atomic_load_n(&map->old_table, __ATOMIC_RELAXED)
+        && FLAT_MAP_PROBING_LINEAR == __atomic_load_n(&map->table, __ATOMIC_ACQUIRE)->probing;
+}
+
+// insert the keys of a single chunk of a batch
+//
+// returns the number of keys inserted or updated
+static size_t insert_batch_chunk(
+    flat_map_t*      map,
+    const map_key_t* keys,
+    void* const*     values,
+    void**           out,
+    batch_entry_t*   entries,
+    size_t           n_entries)
+{
+    size_t n_inserted = 0;
+
+    if (!is_batch_groupable(map))
+    {
+        for (size_t i = 0; i < n_entries; ++i)
+        {
+            const size_t position = entries[i].position;
+            const insert_result_t result = insert_key_or_grow(map, entries[i].hash,
+                keys[position], values[position],
+                (NULL == out) ? NULL : &out[position], NULL);
+            if (result != INSERT_FAILED)
+            {
+                ++n_inserted;
+            }
+        }
+
+        return n_inserted;
+    }
+
+    size_t first = 0;
+    while (first < n_entries)
+    {
+        size_t last = first + 1;
+        while (last < n_entries && entries[last].page_index == entries[first].page_index)
+        {
+            ++last;
+        }
+
+        n_inserted += insert_page_group(map,
+            keys, values, out, &entries[first], last - first);
+
+        first = last;
+    }
+
+    return n_inserted;
+}
+
+// insert a group of keys that share an initial page while holding
+// the page lock once; keys whose search continues beyond the page
+// are subsequently inserted individually
+//
+// returns the number of keys inserted or updated
+static size_t insert_page_group(
+    flat_map_t*      map,
+    const map_key_t* keys,
+    void* const*     values,
+    void**           out,
+    batch_entry_t*   entries,
+    size_t           n_entries)
+{
+    table_t* table          = map->table;
+    const size_t page_index = entries[0].page_index;
+
+    bool continue_search[BATCH_CHUNK_KEYS];
+
+    size_t n_inserted = 0;
+    size_t n_new      = 0;
+
+    lock_page_write(table, page_index);
+
+    for (size_t i = 0; i < n_entries; ++i)
+    {
+        const size_t position = entries[i].position;
+        const insert_result_t result = insert_at(table,
+            get_cell_index_for_hash(table, entries[i].hash),
+            keys[position], values[position],
+            (NULL == out) ? NULL : &out[position],
+            false, NULL, &continue_search[i]);
+
+        if (INSERT_NEW == result)
+        {
+            ++n_new;
+        }
+
+        if (result != INSERT_FAILED)
+        {
+            ++n_inserted;
+        }
+    }
+
+    unlock_page_write(table, page_index);
+
+    if (n_new > 0)
+    {
+        count_cells(map, page_index, (ptrdiff_t)n_new, (ptrdiff_t)n_new);
+    }
+
+    for (size_t i = 0; i < n_entries; ++i)
+    {
+        if (!continue_search[i])
+        {
+            continue;
+        }
+
+        const size_t position = entries[i].position;
+        const insert_result_t result = insert_key_or_grow(map, entries[i].hash,
+            keys[position], values[position],
+            (NULL == out) ? NULL : &out[position], NULL);
+        if (result != INSERT_FAILED)
+        {
+            ++n_inserted;
+        }
+    }
+
+    return n_inserted;
+}
+
+// search for the keys of a single chunk of a batch, the entries
+// of which were prepared against `table`, the current table
+//
+// returns the number of keys found
+static size_t find_batch_chunk(
+    flat_map_t*      map,
+    table_t*         table,
+    const map_key_t* keys,
+    void**           values,
+    batch_entry_t*   entries,
+    size_t           n_entries)
+{
+    size_t n_found = 0;
+
+    if (!is_batch_groupable(map))
+    {
+        for (size_t i = 0; i < n_entries; ++i)
+        {
+            const size_t position = entries[i].position;
+            values[position] = find_key(map, entries[i].hash, keys[position]);
+            if (values[position] != NULL)
+            {
+                ++n_found;
+            }
+        }
+
+        return n_found;
+    }
+
+    size_t first = 0;
+    while (first < n_entries)
+    {
+        size_t last = first + 1;
+        while (last < n_entries && entries[last].page_index == entries[first].page_index)
+        {
+            ++last;
+        }
+
+        n_found += find_page_group(map, table,
+            keys, values, &entries[first], last - first);
+
+        first = last;
+    }
+
+    return n_found;
+}
+
+// search for a group of keys that share an initial page with a single
+// optimistic read of the page, falling back to the shared page lock
+// under sustained contention; keys whose search continues beyond
+// the page are subsequently searched for individually
+//
+// returns the number of keys found
+static size_t find_page_group(
+    flat_map_t*      map,
+    table_t*         table,
+    const map_key_t* keys,
+    void**           values,
+    batch_entry_t*   entries,
+    size_t           n_entries)
+{
+    const size_t page_index = entries[0].page_index;
+
+    bool continue_search[BATCH_CHUNK_KEYS];
+    bool validated = false;
+
+    for (size_t attempt = 0; attempt < MAX_OPTIMISTIC_READS && !validated; ++attempt)
+    {
+        const size_t version = read_page_begin(table, page_index);
+        if (version & 1)
+        {
+            // a writer is active in the page
+            cpu_relax();
+            continue;
+        }
+
+        for (size_t i = 0; i < n_entries; ++i)
+        {
+            const size_t position = entries[i].position;
+            values[position] = find_at(table,
+                get_cell_index_for_hash(table, entries[i].hash),
+                keys[position], &continue_search[i]);
+        }
+
+        validated = read_page_validate(table, page_index, version);
+    }
+
+    if (!validated)
+    {
+        lock_page_read(table, page_index);
+        for (size_t i = 0; i < n_entries; ++i)
+        {
+            const size_t position = entries[i].position;
+            values[position] = find_at(table,
+                get_cell_index_for_hash(table, entries[i].hash),
+                keys[position], &continue_search[i]);
+        }
+        unlock_page_read(table, page_index);
+    }
+
+    size_t n_found = 0;
+    for (size_t i = 0; i < n_entries; ++i)
+    {
+        const size_t position = entries[i].position;
+        if (continue_search[i])
+        {
+            values[position] = find_in_table(map,
+                table, entries[i].hash, keys[position]);
+        }
+
+        if (values[position] != NULL)
+        {
+            ++n_found;
+        }
+    }
+
+    return n_found;
+}
+
+// ----------------------------------------------------------------------------
+// Internal: Robin Hood Probing
+
+// Under robin hood probing, an insertion or removal may move keys
+// across page boundaries, so each operation holds the entire run of
+// pages that it spans at once, rather than a single page at a time.
+// Nothing is modified until the entire run is held, so an operation
+// that fails to extend its run simply releases it and starts over.
+//
+// Only the current table is operated on in this manner; it never
+// contains tombstones or migrated pages. Once a table is replaced,
+// its keys no longer move, and it is treated as a linear table.
+
+// determine the distance of `cell_index` from the initial cell for `key`
+static size_t get_probe_distance(
+    table_t*  table,
+    size_t    cell_index,
+    map_key_t key)
+{
+    const size_t home = get_cell_index_for_hash(table, get_hash(key));
+    return (cell_index - home) & (get_capacity(table) - 1);
+}
+
+// determine if the page that contains `cell_index` belongs to `run`
+static bool run_contains(
+    table_t*    table,
+    page_run_t* run,
+    size_t      cell_index)
+{
+    const size_t page_index = cell_index / table->cells_per_page;
+    const size_t offset =
+        (page_index + table->n_pages - run->first_page) % table->n_pages;
+    return offset < run->n_pages;
+}
+
+// extend `run` to the page that contains `cell_index`, which must
+// either belong to the run or immediately follow it; pages are locked
+// in ascending order, and the pages of a run that wraps around the end
+// of the table are only try-locked, such that a thread never blocks
+// on a page while holding a page with a greater index
+//
+// returns `false` if the page could not be acquired without blocking
+static bool lock_run_page(
+    table_t*    table,
+    page_run_t* run,
+    size_t      cell_index,
+    bool        exclusive)
+{
+    if (run_contains(table, run, cell_index))
+    {
+        return true;
+    }
+
+    const size_t page_index = cell_index / table->cells_per_page;
+    if (page_index >= run->first_page)
+    {
+        if (exclusive)
+        {
+            lock_page_write(table, page_index);
+        }
+        else
+        {
+            lock_page_read(table, page_index);
+        }
+    }
+    else
+    {
+        const bool locked = exclusive
+            ? try_lock_page_write(table, page_index)
+            : try_lock_page_read(table, page_index);
+        if (!locked)
+        {
+            return false;
+        }
+    }
+
+    STATS_PROBE(0, 1);
+
+    ++run->n_pages;
+    return true;
+}
+
+// release each page in `run`
+static void unlock_run(
+    table_t*    table,
+    page_run_t* run,
+    bool        exclusive)
+{
+    for (size_t i = 0; i < run->n_pages; ++i)
+    {
+        const size_t page_index = (run->first_page + i) % table->n_pages;
+        if (exclusive)
+        {
+            unlock_page_write(table, page_index);
+        }
+        else
+        {
+            unlock_page_read(table, page_index);
+        }
+    }
+
+    run->n_pages = 0;
+}
+
+// determine if an optimistic read of each page in `run`, which
+// began at the corresponding version in `versions`, was consistent
+static bool validate_run(
+    table_t*      table,
+    page_run_t*   run,
+    const size_t* versions)
+{
+    for (size_t i = 0; i < run->n_pages; ++i)
+    {
+        const size_t page_index = (run->first_page + i) % table->n_pages;
+        if (!read_page_validate(table, page_index, versions[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// lock each page from the initial cell `home` through the cell that
+// contains `key` (with `found` set) or that terminates the search for
+// it, and set `index` to that cell; the search terminates at an empty
+// cell, or at a key nearer its own initial cell than `key` would be,
+// since an insertion of `key` would have displaced that key
+//
+// returns `false` if the run could not be locked without blocking
+static bool lock_search_run(
+    table_t*    table,
+    size_t      home,
+    map_key_t   key,
+    page_run_t* run,
+    size_t*     index,
+    bool*       found)
+{
+    const size_t mask = get_capacity(table) - 1;
+
+    run->first_page = home / table->cells_per_page;
+    run->n_pages    = 0;
+
+    *index = NO_CELL;
+    *found = false;
+
+    size_t i = home;
+    for (size_t distance = 0; distance <= mask; ++distance, i = (i + 1) & mask)
+    {
+        if (!lock_run_page(table, run, i, true))
+        {
+            unlock_run(table, run, true);
+            return false;
+        }
+
+        STATS_PROBE(1, 0);
+
+        const map_key_t cell_key = get_cell(table, i)->key;
+        if (cell_key == key)
+        {
+            *index = i;
+            *found = true;
+            break;
+        }
+
+        if (EMPTY_KEY == cell_key
+         || get_probe_distance(table, i, cell_key) < distance)
+        {
+            *index = i;
+            break;
+        }
+    }
+
+    return true;
+}
+
+// extend a locked run from `cell_index` through the first empty
+// cell, or, if `stop_at_home` is set, through the first cell that
+// holds a key in its initial cell, and set `end` to that cell
+//
+// returns `false` if the run could not be locked without blocking
+static bool extend_run(
+    table_t*    table,
+    page_run_t* run,
+    size_t      cell_index,
+    bool        stop_at_home,
+    size_t*     end)
+{
+    const size_t mask = get_capacity(table) - 1;
+
+    *end = NO_CELL;
+
+    size_t i = cell_index;
+    for (size_t n_visited = 0; n_visited <= mask; ++n_visited, i = (i + 1) & mask)
+    {
+        if (!lock_run_page(table, run, i, true))
+        {
+            unlock_run(table, run, true);
+            return false;
+        }
+
+        STATS_PROBE(1, 0);
+
+        const map_key_t cell_key = get_cell(table, i)->key;
+        if (EMPTY_KEY == cell_key
+         || (stop_at_home && 0 == get_probe_distance(table, i, cell_key)))
+        {
+            *end = i;
+            break;
+        }
+    }
+
+    return true;
+}
+
+// insert `key` into the current table under robin hood probing,
+// or update the value associated with `key` if it is already present
+static insert_result_t insert_robin_hood(
+    table_t*   table,
+    uint32_t   hash,
+    map_key_t  key,
+    void*      value,
+    void**     replaced,
+    compute_t* compute)
+{
+    const size_t home = get_cell_index_for_hash(table, hash);
+
+    page_run_t run;
+    size_t index;
+    size_t end = NO_CELL;
+    bool found;
+
+    for (;;)
+    {
+        if (!lock_search_run(table, home, key, &run, &index, &found))
+        {
+            cpu_relax();
+            continue;
+        }
+
+        // a new key is placed by displacing keys up to the next empty cell
+        if (found || NO_CELL == index
+         || extend_run(table, &run, index, false, &end))
+        {
+            break;
+        }
+
+        cpu_relax();
+    }
+
+    insert_result_t result = INSERT_FAILED;
+
+    if (found)
+    {
+        // found a matching key, replace the value
+        cell_t* cell = get_cell(table, index);
+        if (replaced != NULL)
+        {
+            *replaced = cell->value;
+        }
+
+        if (compute != NULL)
+        {
+            value = compute_value(compute, key, cell->value);
+        }
+
+        __atomic_store_n(&cell->value, value, __ATOMIC_RELAXED);
+        result = INSERT_UPDATED;
+    }
+    else if (end != NO_CELL && compute_new_value(compute, key, &value))
+    {
+        place_robin_hood(table, home, index, key, value);
+        result = INSERT_NEW;
+    }
+
+    unlock_run(table, &run, true);
+    return result;
+}
+
+// place the new `key` at the cell `index` that terminated its search,
+// swapping the carried key with each subsequent key that is nearer to
+// its initial cell, until the carried key lands in an empty cell; the
+// caller guarantees that an empty cell follows `index`
+static void place_robin_hood(
+    table_t*  table,
+    size_t    home,
+    size_t    index,
+    map_key_t key,
+    void*     value)
+{
+    const size_t mask = get_capacity(table) - 1;
+
+    map_key_t carried_key   = key;
+    void*     carried_value = value;
+    size_t    distance      = (index - home) & mask;
+
+    for (size_t i = index; ; i = (i + 1) & mask, ++distance)
+    {
+        cell_t* cell = get_cell(table, i);
+        const map_key_t cell_key = cell->key;
+
+        if (EMPTY_KEY == cell_key
+         || get_probe_distance(table, i, cell_key) < distance)
+        {
+            void* cell_value = cell->value;
+
+            __atomic_store_n(&cell->key, carried_key, __ATOMIC_RELAXED);
+            __atomic_store_n(&cell->value, carried_value, __ATOMIC_RELAXED);
+
+            if (EMPTY_KEY == cell_key)
+            {
+                break;
+            }
+
+            distance      = get_probe_distance(table, i, cell_key);
+            carried_key   = cell_key;
+            carried_value = cell_value;
+        }
+    }
+}
+
+// remove `key` from the current table under robin hood probing;
+// each subsequent key that is displaced from its initial cell is
+// shifted back by one cell to fill the vacancy, such that removal
+// never leaves behind a tombstone
+static bool remove_robin_hood(
+    flat_map_t* map,
+    table_t*    table,
+    uint32_t    hash,
+    map_key_t   key)
+{
+    const size_t home = get_cell_index_for_hash(table, hash);
+    const size_t mask = get_capacity(table) - 1;
+
+    page_run_t run;
+    size_t index;
+    size_t end = NO_CELL;
+    bool found;
+
+    for (;;)
+    {
+        if (!lock_search_run(table, home, key, &run, &index, &found))
+        {
+            cpu_relax();
+            continue;
+        }
+
+        // the shift spans every key up to the end of the cluster
+        if (!found
+         || extend_run(table, &run, (index + 1) & mask, true, &end))
+        {
+            break;
+        }
+
+        cpu_relax();
+    }
+
+    if (!found)
+    {
+        unlock_run(table, &run, true);
+        return false;
+    }
+
+    // delete the stored value
+    retire_value(map, get_cell(table, index)->value);
+
+    // the cluster spans the entire table only if it is full
+    if (NO_CELL == end)
+    {
+        end = index;
+    }
+
+    size_t hole = index;
+    for (size_t i = (index + 1) & mask; i != end; i = (i + 1) & mask)
+    {
+        __atomic_store_n(&get_cell(table, hole)->key, get_cell(table, i)->key, __ATOMIC_RELAXED);
+        __atomic_store_n(&get_cell(table, hole)->value, get_cell(table, i)->value, __ATOMIC_RELAXED);
+        hole = i;
+    }
+
+    __atomic_store_n(&get_cell(table, hole)->key, EMPTY_KEY, __ATOMIC_RELAXED);
+    __atomic_store_n(&get_cell(table, hole)->value, NULL, __ATOMIC_RELAXED);
+
+    unlock_run(table, &run, true);
+    return true;
+}
+
+// search the current table for `key` under robin hood probing; the
+// search is performed optimistically, falling back to the page locks
+// under sustained contention or when the search spans too many pages
+static void* find_robin_hood(
+    table_t*  table,
+    uint32_t  hash,
+    map_key_t key)
+{
+    const size_t home = get_cell_index_for_hash(table, hash);
+
+    page_run_t run;
+    bool complete;
+
+    for (size_t i = 0; i < MAX_OPTIMISTIC_READS; ++i)
+    {
+        size_t versions[MAX_OPTIMISTIC_RUN_PAGES];
+
+        run.first_page = home / table->cells_per_page;
+        run.n_pages    = 0;
+
+        void* value = search_robin_hood(table,
+            home, key, &run, versions, &complete);
+        if (complete && validate_run(table, &run, versions))
+        {
+            return value;
+        }
+
+        if (MAX_OPTIMISTIC_RUN_PAGES == run.n_pages)
+        {
+            break;
+        }
+
+        cpu_relax();
+    }
+
+    for (;;)
+    {
+        run.first_page = home / table->cells_per_page;
+        run.n_pages    = 0;
+
+        void* value = search_robin_hood(table,
+            home, key, &run, NULL, &complete);
+        unlock_run(table, &run, false);
+
+        if (complete)
+        {
+            return value;
+        }
+
+        cpu_relax();
+    }
+}
+
+// search for `key` from its initial cell `home`; each page entered by
+// the search is read optimistically, with its version recorded in
+// `versions`, or is locked for reading if `versions` is NULL
+//
+// sets `complete` to `false` if the search must be restarted
+static void* search_robin_hood(
+    table_t*    table,
+    size_t      home,
+    map_key_t   key,
+    page_run_t* run,
+    size_t*     versions,
+    bool*       complete)
+{
+    const size_t mask = get_capacity(table) - 1;
+
+    *complete = false;
+
+    size_t i = home;
+    for (size_t distance = 0; distance <= mask; ++distance, i = (i + 1) & mask)
+    {
+        const size_t page_index = i / table->cells_per_page;
+
+        if (NULL == versions)
+        {
+            if (!lock_run_page(table, run, i, false))
+            {
+                return NULL;
+            }
+        }
+        else if (!run_contains(table, run, i))
+        {
+            if (MAX_OPTIMISTIC_RUN_PAGES == run->n_pages)
+            {
+                return NULL;
+            }
+
+            const size_t version = read_page_begin(table, page_index);
+            if (version & 1)
+            {
+                // a writer is active in the page
+                return NULL;
+            }
+
+            versions[run->n_pages++] = version;
+            STATS_PROBE(0, 1);
+        }
+
+        STATS_PROBE(1, 0);
+
+        // the cell may be modified concurrently, so
+        // each field is loaded atomically
+        cell_t* cell = get_cell(table, i);
+        const map_key_t cell_key = __atomic_load_n(&cell->key, __ATOMIC_RELAXED);
+
+        if (cell_key == key)
+        {
+            *complete = true;
+            return __atomic_load_n(&cell->value, __ATOMIC_RELAXED);
+        }
+
+        if (EMPTY_KEY == cell_key
+         || get_probe_distance(table, i, cell_key) < distance)
+        {
+            break;
+        }
+    }
+
+    *complete = true;
+    return NULL;
+}
+
+// insert `key` into a table to which the caller has exclusive access,
+// without acquiring any of the page locks; the table must have room
+static insert_result_t insert_unlocked(
+    table_t*  table,
+    uint32_t  hash,
+    map_key_t key,
+    void*     value,
+    void**    replaced)
+{
+    const size_t home = get_cell_index_for_hash(table, hash);
+    const size_t mask = get_capacity(table) - 1;
+
+    if (FLAT_MAP_PROBING_ROBIN_HOOD == table->probing)
+    {
+        size_t i = home;
+        for (size_t distance = 0; distance <= mask; ++distance, i = (i + 1) & mask)
+        {
+            cell_t* cell = get_cell(table, i);
+            if (cell->key == key)
+            {
+                *replaced   = cell->value;
+                cell->value = value;
+                return INSERT_UPDATED;
+            }
+
+            if (EMPTY_KEY == cell->key
+             || get_probe_distance(table, i, cell->key) < distance)
+            {
+                place_robin_hood(table, home, i, key, value);
+                return INSERT_NEW;
+            }
+        }
+
+        return INSERT_FAILED;
+    }
+
+    if (FLAT_MAP_PROBING_HOPSCOTCH == table->probing)
+    {
+        bool complete;
+        const size_t index = search_hopscotch(table,
+            home, key, NULL, NULL, true, &complete);
+        if (index != NO_CELL)
+        {
+            cell_t* cell = get_cell(table, index);
+            *replaced    = cell->value;
+            cell->value  = value;
+            return INSERT_UPDATED;
+        }
+
+        size_t free_index;
+        lock_free_cell(table, NULL, home, &free_index);
+        if (NO_CELL == free_index || !trace_hopscotch(table, home, free_index))
+        {
+            return INSERT_FULL;
+        }
+
+        const bool reused = (TOMBSTONE_KEY == get_cell(table, free_index)->key);
+        place_hopscotch(table, home, free_index, key, value);
+        return reused ? INSERT_REUSED : INSERT_NEW;
+    }
+
+    size_t cell_index = home;
+    size_t page_index = home / table->cells_per_page;
+
+    insert_result_t result = INSERT_FAILED;
+    bool continue_search   = true;
+
+    for (size_t n_visited = 0; n_visited <= table->n_pages; ++n_visited)
+    {
+        result = insert_at(table, cell_index,
+            key, value, replaced, false, NULL, &continue_search);
+        if (!continue_search)
+        {
+            break;
+        }
+
+        page_index = (page_index + 1) % table->n_pages;
+        cell_index = page_index * table->cells_per_page;
+    }
+
+    return result;
+}
+
+// ----------------------------------------------------------------------------
+// Internal: Hopscotch Probing
+
+// Under hopscotch probing, every key resides within the neighborhood
+// of HOP_RANGE cells that begins at its initial cell, and the hop
+// bitmap of each cell records which cells of its neighborhood hold
+// keys that share it as their initial cell, so a lookup examines only
+// those cells. An insertion claims the first free cell within the
+// HOP_ADD_RANGE cells that begin at the initial cell of the key, then
+// moves the free cell back into the neighborhood by displacing keys
+// that remain within their own.
+//
+// Each operation holds the run of pages that spans the neighborhood,
+// and any cells beyond it up to the free cell, just as under robin
+// hood probing, so no operation holds more than the pages of the add
+// range; keys only ever move within a held run. A bit of a hop
+// bitmap is only modified by a thread that holds the page of the cell
+// to which the bit refers, but the bitmap of a cell may be modified
+// by threads that hold distinct pages, so bitmaps are updated with
+// atomic read-modify-write operations.
+//
+// Removal leaves a tombstone, which later insertions reuse, such that
+// an empty cell never separates a key from its initial cell; once the
+// table is replaced, it is treated as a linear table, just as under
+// robin hood probing. When no free cell can be moved into the
+// neighborhood of a key, which is rare below the maximum load of the
+// table, the key is not placed and the table grows instead, so that a
+// key never resides outside of its neighborhood.
+
+// determine the number of cells in a neighborhood of `table`
+static size_t get_hop_range(table_t* table)
+{
+    const size_t capacity = get_capacity(table);
+    return (capacity < HOP_RANGE) ? capacity : HOP_RANGE;
+}
+
+// determine the number of cells searched for a free cell in `table`;
+// a range of at most HOP_ADD_PAGES - 1 pages of cells spans at most
+// HOP_ADD_PAGES pages, wherever it begins
+static size_t get_add_range(table_t* table)
+{
+    const size_t capacity  = get_capacity(table);
+    const size_t max_range = (HOP_ADD_PAGES - 1)*table->cells_per_page;
+
+    const size_t range = (capacity < HOP_ADD_RANGE) ? capacity : HOP_ADD_RANGE;
+    return (range < max_range) ? range : max_range;
+}
+
+// enter the page that contains `cell_index` on behalf of a search that
+// holds `run`; the page is read optimistically, with its version
+// recorded in `versions`, or locked if `versions` is NULL, and nothing
+// is done if `run` is NULL, as the caller has exclusive access
+//
+// returns `false` if the search must be restarted
+static bool enter_run_page(
+    table_t*    table,
+    page_run_t* run,
+    size_t      cell_index,
+    size_t*     versions,
+    bool        exclusive)
+{
+    if (NULL == run)
+    {
+        return true;
+    }
+
+    if (NULL == versions)
+    {
+        return lock_run_page(table, run, cell_index, exclusive);
+    }
+
+    if (run_contains(table, run, cell_index))
+    {
+        return true;
+    }
+
+    if (MAX_OPTIMISTIC_RUN_PAGES == run->n_pages)
+    {
+        return false;
+    }
+
+    const size_t version = read_page_begin(table, cell_index / table->cells_per_page);
+    if (version & 1)
+    {
+        // a writer is active in the page
+        return false;
+    }
+
+    versions[run->n_pages++] = version;
+    STATS_PROBE(0, 1);
+
+    return true;
+}
+
+// search for `key` from its initial cell `home`; every page of the
+// neighborhood is entered before the hop bitmap is read, such that a
+// concurrent move of a key within the neighborhood is never missed
+//
+// returns the index of the cell that holds `key`, or NO_CELL; sets
+// `complete` to `false` if the search must be restarted
+static size_t search_hopscotch(
+    table_t*    table,
+    size_t      home,
+    map_key_t   key,
+    page_run_t* run,
+    size_t*     versions,
+    bool        exclusive,
+    bool*       complete)
+{
+    const size_t mask  = get_capacity(table) - 1;
+    const size_t range = get_hop_range(table);
+
+    *complete = false;
+
+    // enter each page of the neighborhood once, at its first cell
+    for (size_t distance = 0; distance < range; )
+    {
+        const size_t i = (home + distance) & mask;
+        if (!enter_run_page(table, run, i, versions, exclusive))
+        {
+            return NO_CELL;
+        }
+
+        distance += table->cells_per_page - (i & (table->cells_per_page - 1));
+    }
+
+    const uint32_t hop = __atomic_load_n(&table->hop[home], __ATOMIC_RELAXED);
+
+    *complete = true;
+
+    for (uint32_t bits = hop; bits != 0; bits &= bits - 1)
+    {
+        STATS_PROBE(1, 0);
+
+        const size_t i = (home + (size_t)__builtin_ctz(bits)) & mask;
+        if (__atomic_load_n(&get_cell(table, i)->key, __ATOMIC_RELAXED) == key)
+        {
+            return i;
+        }
+    }
+
+    return NO_CELL;
+}
+
+// extend a run, which holds the neighborhood of `home`, through the
+// first free cell that follows `home`, either empty or a tombstone,
+// and set `index` to that cell, or to NO_CELL if there is none within
+// the add range of `home`
+//
+// returns `false` if the run could not be locked without blocking
+static bool lock_free_cell(
+    table_t*    table,
+    page_run_t* run,
+    size_t      home,
+    size_t*     index)
+{
+    const size_t mask  = get_capacity(table) - 1;
+    const size_t range = get_add_range(table);
+
+    *index = NO_CELL;
+
+    size_t i = home;
+    for (size_t distance = 0; distance < range; ++distance, i = (i + 1) & mask)
+    {
+        if (!enter_run_page(table, run, i, NULL, true))
+        {
+            return false;
+        }
+
+        STATS_PROBE(1, 0);
+
+        const map_key_t cell_key = get_cell(table, i)->key;
+        if (EMPTY_KEY == cell_key || TOMBSTONE_KEY == cell_key)
+        {
+            *index = i;
+            break;
+        }
+    }
+
+    return true;
+}
+
+// insert `key` into the current table under hopscotch probing,
+// or update the value associated with `key` if it is already present
+static insert_result_t insert_hopscotch(
+    table_t*   table,
+    uint32_t   hash,
+    map_key_t  key,
+    void*      value,
+    void**     replaced,
+    compute_t* compute)
+{
+    const size_t home = get_cell_index_for_hash(table, hash);
+
+    page_run_t run;
+    size_t index;
+    size_t free_index = NO_CELL;
+    bool complete;
+
+    for (;;)
+    {
+        run.first_page = home / table->cells_per_page;
+        run.n_pages    = 0;
+
+        // a new key is placed in the first free cell, which may lie
+        // beyond the neighborhood until it is moved back into it, so
+        // the run extends through the add range in the worst case
+        index = search_hopscotch(table, home, key, &run, NULL, true, &complete);
+        if (complete
+         && (index != NO_CELL || lock_free_cell(table, &run, home, &free_index)))
+        {
+            break;
+        }
+
+        unlock_run(table, &run, true);
+        cpu_relax();
+    }
+
+    insert_result_t result = INSERT_FAILED;
+
+    if (index != NO_CELL)
+    {
+        // found a matching key, replace the value
+        cell_t* cell = get_cell(table, index);
+        if (replaced != NULL)
+        {
+            *replaced = cell->value;
+        }
+
+        if (compute != NULL)
+        {
+            value = compute_value(compute, key, cell->value);
+        }
+
+        __atomic_store_n(&cell->value, value, __ATOMIC_RELAXED);
+        result = INSERT_UPDATED;
+    }
+    else if (NO_CELL == free_index || !trace_hopscotch(table, home, free_index))
+    {
+        // the callback of a computation is not yet invoked, as
+        // the key is inserted again once the table has grown
+        result = INSERT_FULL;
+    }
+    else if (compute_new_value(compute, key, &value))
+    {
+        result = (TOMBSTONE_KEY == get_cell(table, free_index)->key)
+            ? INSERT_REUSED
+            : INSERT_NEW;
+
+        place_hopscotch(table, home, free_index, key, value);
+    }
+
+    unlock_run(table, &run, true);
+    return result;
+}
+
+// locate the key that moves into the free cell `index` at a single step
+// of its move back into a neighborhood, which is the key that lies
+// farthest from the free cell among those whose neighborhood includes
+// it; `owner` is set to the initial cell of that key
+//
+// returns the index of the cell that holds the key, or NO_CELL if no
+// key may be moved into the free cell
+static size_t get_hop_source(table_t* table, size_t index, size_t* owner)
+{
+    const size_t mask  = get_capacity(table) - 1;
+    const size_t range = get_hop_range(table);
+
+    for (size_t h = (index - range + 1) & mask; h != index; h = (h + 1) & mask)
+    {
+        const size_t to_free = (index - h) & mask;
+        const uint32_t bits  = __atomic_load_n(&table->hop[h], __ATOMIC_RELAXED)
+            & ((1u << to_free) - 1);
+        if (bits != 0)
+        {
+            *owner = h;
+            return (h + (size_t)__builtin_ctz(bits)) & mask;
+        }
+    }
+
+    return NO_CELL;
+}
+
+// determine if the free cell `index` can be moved back into the
+// neighborhood of `home`; a move modifies only the bits of a hop
+// bitmap that refer to cells at or beyond the cell it vacates, none
+// of which are examined by the moves that follow, so the moves are
+// traced without being performed
+static bool trace_hopscotch(table_t* table, size_t home, size_t index)
+{
+    const size_t mask  = get_capacity(table) - 1;
+    const size_t range = get_hop_range(table);
+
+    size_t owner;
+    while (index != NO_CELL && ((index - home) & mask) >= range)
+    {
+        index = get_hop_source(table, index, &owner);
+    }
+
+    return index != NO_CELL;
+}
+
+// place the new `key`, whose initial cell is `home`, by moving the free
+// cell `index` back into its neighborhood, which trace_hopscotch() has
+// determined to be possible; at each step, a key is moved into the
+// free cell, vacating its own cell
+static void place_hopscotch(
+    table_t*  table,
+    size_t    home,
+    size_t    index,
+    map_key_t key,
+    void*     value)
+{
+    const size_t mask  = get_capacity(table) - 1;
+    const size_t range = get_hop_range(table);
+
+    while (((index - home) & mask) >= range)
+    {
+        // the candidate keys lie strictly between `home` and the free
+        // cell, and are thus held by the run, as are their hop bits
+        size_t owner;
+        const size_t from = get_hop_source(table, index, &owner);
+
+        cell_t* source = get_cell(table, from);
+        cell_t* target = get_cell(table, index);
+
+        __atomic_store_n(&target->key, source->key, __ATOMIC_RELAXED);
+        __atomic_store_n(&target->value, source->value, __ATOMIC_RELAXED);
+        __atomic_fetch_or(&table->hop[owner], 1u << ((index - owner) & mask), __ATOMIC_RELAXED);
+        __atomic_fetch_and(&table->hop[owner], ~(1u << ((from - owner) & mask)), __ATOMIC_RELAXED);
+
+        index = from;
+    }
+
+    cell_t* cell = get_cell(table, index);
+    __atomic_store_n(&cell->key, key, __ATOMIC_RELAXED);
+    __atomic_store_n(&cell->value, value, __ATOMIC_RELAXED);
+
+    __atomic_fetch_or(&table->hop[home], 1u << ((index - home) & mask), __ATOMIC_RELAXED);
+}
+
+// remove `key` from the current table under hopscotch probing,
+// leaving a tombstone in its cell; the value is retired to `map`,
+// unless `map` is NULL, as when a key is withdrawn from the table
+// into which it was migrated
+static bool remove_hopscotch(
+    flat_map_t* map,
+    table_t*    table,
+    uint32_t    hash,
+    map_key_t   key)
+{
+    const size_t home = get_cell_index_for_hash(table, hash);
+    const size_t mask = get_capacity(table) - 1;
+
+    page_run_t run;
+    size_t index;
+    bool complete;
+
+    for (;;)
+    {
+        run.first_page = home / table->cells_per_page;
+        run.n_pages    = 0;
+
+        index = search_hopscotch(table, home, key, &run, NULL, true, &complete);
+        if (complete)
+        {
+            break;
+        }
+
+        unlock_run(table, &run, true);
+        cpu_relax();
+    }
+
+    if (NO_CELL == index)
+    {
+        unlock_run(table, &run, true);
+        return false;
+    }
+
+    // delete the stored value and mark the cell with a tombstone
+    if (map != NULL)
+    {
+        retire_value(map, get_cell(table, index)->value);
+    }
+
+    __atomic_store_n(&get_cell(table, index)->key, TOMBSTONE_KEY, __ATOMIC_RELAXED);
+    __atomic_fetch_and(&table->hop[home], ~(1u << ((index - home) & mask)), __ATOMIC_RELAXED);
+
+    unlock_run(table, &run, true);
+    return true;
+}
+
+// search the current table for `key` under hopscotch probing; the
+// search is performed optimistically, falling back to the page locks
+// under sustained contention or when the search spans too many pages
+static void* find_hopscotch(
+    table_t*  table,
+    uint32_t  hash,
+    map_key_t key)
+{
+    const size_t home = get_cell_index_for_hash(table, hash);
+
+    page_run_t run;
+    bool complete;
+
+    for (size_t i = 0; i < MAX_OPTIMISTIC_READS; ++i)
+    {
+        size_t versions[MAX_OPTIMISTIC_RUN_PAGES];
+
+        run.first_page = home / table->cells_per_page;
+        run.n_pages    = 0;
+
+        const size_t index = search_hopscotch(table,
+            home, key, &run, versions, false, &complete);
+
+        void* value = (index != NO_CELL)
+            ? __atomic_load_n(&get_cell(table, index)->value, __ATOMIC_RELAXED)
+            : NULL;
+
+        if (complete && validate_run(table, &run, versions))
+        {
+            return value;
+        }
+
+        if (MAX_OPTIMISTIC_RUN_PAGES == run.n_pages)
+        {
+            break;
+        }
+
+        cpu_relax();
+    }
+
+    for (;;)
+    {
+        run.first_page = home / table->cells_per_page;
+        run.n_pages    = 0;
+
+        const size_t index = search_hopscotch(table,
+            home, key, &run, NULL, false, &complete);
+
+        void* value = (complete && index != NO_CELL)
+            ? get_cell(table, index)->value
+            : NULL;
+
+        unlock_run(table, &run, false);
+
+        if (complete)
+        {
+            return value;
+        }
+
+        cpu_relax();
+    }
+}
+
+// set the hop bitmap of every cell of a table from its live keys;
+// the table must be exclusively held
+//
+// returns `false` if a key lies outside of its neighborhood
+static bool rebuild_hops(table_t* table)
+{
+    const size_t capacity = get_capacity(table);
+    const size_t mask     = capacity - 1;
+    const size_t range    = get_hop_range(table);
+
+    memset(table->hop, 0, capacity*sizeof(uint32_t));
+
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        const map_key_t key = get_cell(table, i)->key;
+        if (EMPTY_KEY == key || TOMBSTONE_KEY == key)
+        {
+            continue;
+        }
+
+        const size_t home     = get_cell_index_for_hash(table, get_hash(key));
+        const size_t distance = (i - home) & mask;
+        if (distance >= range)
+        {
+            return false;
+        }
+
+        table->hop[home] |= 1u << distance;
+    }
+
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Internal: Iteration
+
+// An iteration visits the map one slice at a time, where a slice is
+// the set of keys whose initial cell lies within a single page of the
+// current table (or, during an incremental resize, of the smaller of
+// the current and previous tables, along with the pages of the larger
+// table whose keys share their initial page within the smaller one).
+// The keys of a slice reside in the cells from the first cell of the
+// page through the first empty cell that follows the page, as an empty
+// cell never separates a key from its initial cell; those cells are
+// held with the page read locks while the slice is collected, and no
+// lock is held once the slice is returned.
+//
+// The number of pages of a table is a power of two, so when the table
+// is resized, each slice either splits or merges with its siblings.
+// Slices are therefore visited in the order of the bit-reversed page
+// index, as with the cursor of the SCAN command in Redis, such that a
+// resize between any two slices never causes a slice that has already
+// been visited to be visited again in full, nor one that has not yet
+// been visited to be skipped. A key that remains in the map for the
+// whole of an iteration is visited at least once; it is visited more
+// than once only if the table shrinks during the iteration.
+//
+// Only the map lock is held shared while a slice is collected, so a
+// page of the previous table may be migrated between its collection
+// and that of the current table, and a key of the page collected from
+// both; such keys are de-duplicated before the slice is returned.
+
+// collect the keys of the slice identified by `cursor` into `buffer`,
+// and advance `cursor` to the next slice whose cursor agrees with it
+// in the bits of `fixed_mask`; `last` is set if there is no such slice
+//
+// returns `false` if memory for the collected keys could not be allocated
+static bool collect_slice(
+    flat_map_t*     map,
+    size_t*         cursor,
+    size_t          fixed_mask,
+    slice_buffer_t* buffer,
+    bool*           last)
+{
+    buffer->count = 0;
+
+    lock_map_rw(map);
+
+    // the previous table is collected first; a page is marked as
+    // migrated only after its keys are visible in the current table,
+    // so a key migrated during the collection is not missed
+    table_t* tables[2] = { map->old_table, map->table };
+
+    size_t small_mask = map->table->n_pages - 1;
+    if (map->old_table != NULL && map->old_table->n_pages - 1 < small_mask)
+    {
+        small_mask = map->old_table->n_pages - 1;
+    }
+
+    const size_t slice = *cursor & small_mask;
+
+    // the number of keys collected from the previous table
+    size_t n_old = 0;
+
+    bool collected = true;
+    for (size_t i = 0; i < 2 && collected; ++i)
+    {
+        if (NULL == tables[i])
+        {
+            continue;
+        }
+
+        if (1 == i)
+        {
+            n_old = buffer->count;
+        }
+
+        // visit each page of the table whose index agrees
+        // with the slice in the bits of the smaller table
+        const size_t mask = tables[i]->n_pages - 1;
+
+        size_t page_index = slice;
+        do
+        {
+            collected  = collect_page(tables[i], page_index & mask, buffer);
+            page_index = (((page_index | small_mask) + 1) & ~small_mask) | slice;
+        } while (collected && (page_index & (mask ^ small_mask)) != 0);
+    }
+
+    unlock_map(map);
+
+    if (collected && n_old > 0)
+    {
+        deduplicate_slice(buffer, n_old);
+    }
+
+    // the final slice is that for which every bit that is
+    // not fixed is set; otherwise, increment the cursor in
+    // bit-reversed order, which leaves the fixed bits intact
+    const size_t free_bits = small_mask & ~fixed_mask;
+    *last = ((slice & free_bits) == free_bits);
+    if (!*last)
+    {
+        *cursor = reverse_bits(reverse_bits(slice | ~small_mask) + 1);
+    }
+
+    return collected;
+}
+
+// append to `buffer` each live key of the current or previous table
+// `table` whose initial cell lies within the page `page_index`
+//
+// returns `false` if memory for the collected keys could not be allocated
+static bool collect_page(
+    table_t*        table,
+    size_t          page_index,
+    slice_buffer_t* buffer)
+{
+    const size_t mask  = get_capacity(table) - 1;
+    const size_t begin = page_index*table->cells_per_page;
+
+    const size_t n_collected = buffer->count;
+
+    page_run_t run;
+    for (;;)
+    {
+        run.first_page = page_index;
+        run.n_pages    = 0;
+
+        bool locked    = true;
+        bool collected = true;
+        bool migrated  = false;
+
+        size_t i = begin;
+        for (size_t distance = 0; distance <= mask; ++distance, i = (i + 1) & mask)
+        {
+            if (0 == (i & (table->cells_per_page - 1)))
+            {
+                if (!lock_run_page(table, &run, i, false))
+                {
+                    locked = false;
+                    break;
+                }
+
+                // the keys of a migrated page now reside in the
+                // new table; the page is treated as if it were full
+                migrated = is_page_migrated(table, i / table->cells_per_page);
+            }
+
+            if (migrated)
+            {
+                continue;
+            }
+
+            const cell_t* cell = get_cell(table, i);
+            if (EMPTY_KEY == cell->key && distance >= table->cells_per_page)
+            {
+                break;
+            }
+
+            if (EMPTY_KEY == cell->key
+             || TOMBSTONE_KEY == cell->key
+             || get_page_index_for_hash(table, get_hash(cell->key)) != page_index)
+            {
+                continue;
+            }
+
+            if (!append_entry(buffer, cell->key, cell->value))
+            {
+                collected = false;
+                break;
+            }
+        }
+
+        unlock_run(table, &run, false);
+
+        if (locked)
+        {
+            return collected;
+        }
+
+        // a page of a run that wraps around the end of the
+        // table could not be acquired without blocking
+        buffer->count = n_collected;
+        cpu_relax();
+    }
+}
+
+// append a single key / value pair to `buffer`, growing it as needed
+static bool append_entry(
+    slice_buffer_t* buffer,
+    map_key_t       key,
+    void*           value)
+{
+    if (buffer->count == buffer->capacity)
+    {
+        const size_t capacity = (0 == buffer->capacity)
+            ? INITIAL_SLICE_ENTRIES
+            : 2*buffer->capacity;
+
+        slice_entry_t* entries = realloc(buffer->entries, capacity*sizeof(slice_entry_t));
+        if (NULL == entries)
+        {
+            return false;
+        }
+
+        buffer->entries  = entries;
+        buffer->capacity = capacity;
+    }
+
+    buffer->entries[buffer->count].key   = key;
+    buffer->entries[buffer->count].value = value;
+    ++buffer->count;
+
+    return true;
+}
+
+// remove from `buffer` each key collected from the previous table,
+// its first `n_old` entries, that was also collected from the current
+// table once migrated; the value from the current table is retained
+static void deduplicate_slice(slice_buffer_t* buffer, size_t n_old)
+{
+    slice_entry_t* entries = buffer->entries;
+
+    qsort(entries, n_old, sizeof(slice_entry_t), compare_slice_entries);
+
+    size_t count = n_old;
+    for (size_t i = n_old; i < buffer->count; ++i)
+    {
+        slice_entry_t* old = bsearch(&entries[i],
+            entries, n_old, sizeof(slice_entry_t), compare_slice_entries);
+        if (old != NULL)
+        {
+            old->value = entries[i].value;
+        }
+        else
+        {
+            entries[count++] = entries[i];
+        }
+    }
+
+    buffer->count = count;
+}
+
+static int compare_slice_entries(const void* a, const void* b)
+{
+    const map_key_t x = ((const slice_entry_t*)a)->key;
+    const map_key_t y = ((const slice_entry_t*)b)->key;
+    return (x > y) - (x < y);
+}
+
+// reverse the order of the bits of `n`
+static size_t reverse_bits(size_t n)
+{
+    uint64_t v = (uint64_t)n;
+    v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+    v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+    v = ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    return (size_t)__builtin_bswap64(v);
+}
+
+// compute the number of chunks into which the slices of the map are
+// divided among `n_threads` threads; several chunks are allotted to
+// each thread to balance the load, but never more chunks than there
+// are slices, as each slice would then be visited by several chunks
+static size_t get_n_chunks(flat_map_t* map, size_t n_threads)
+{
+    lock_map_rw(map);
+
+    size_t n_slices = map->table->n_pages;
+    if (map->old_table != NULL && map->old_table->n_pages < n_slices)
+    {
+        n_slices = map->old_table->n_pages;
+    }
+
+    unlock_map(map);
+
+    size_t n_chunks = 1;
+    while (n_chunks < CHUNKS_PER_THREAD*n_threads && n_chunks < n_slices)
+    {
+        n_chunks *= 2;
+    }
+
+    return n_chunks;
+}
+
+// claim chunks of slices and visit the keys of each, until none
+// remain to be claimed; the keys of a slice are visited within
+// the read-side critical section in which they were collected
+static void* for_each_worker(void* arg)
+{
+    for_each_t* each = (for_each_t*)arg;
+    flat_map_t* map  = each->map;
+
+    slice_buffer_t buffer = { NULL, 0, 0 };
+
+    for (;;)
+    {
+        const size_t chunk = __atomic_fetch_add(&each->next_chunk, 1, __ATOMIC_RELAXED);
+        if (chunk >= each->n_chunks)
+        {
+            break;
+        }
+
+        size_t cursor = chunk;
+        bool last     = false;
+        while (!last)
+        {
+            const rcu_handle_t handle = flat_map_enter(map);
+
+            const bool collected = collect_slice(map,
+                &cursor, each->n_chunks - 1, &buffer, &last);
+
+            for (size_t i = 0; i < buffer.count; ++i)
+            {
+                each->fn(buffer.entries[i].key, buffer.entries[i].value, each->ctx);
+            }
+
+            flat_map_leave(map, handle);
+
+            if (!collected)
+            {
+                __atomic_store_n(&each->failed, true, __ATOMIC_RELAXED);
+                break;
+            }
+        }
+    }
+
+    free(buffer.entries);
+    return NULL;
+}
+
+// ----------------------------------------------------------------------------
+// Internal: Occupancy Counts
+
+// record a change to the occupancy counts of the map in the shard
+// selected by `shard_hint`; must be called with shared map lock held
+static void count_cells(
+    flat_map_t* map,
+    size_t      shard_hint,
+    ptrdiff_t   d_occupied,
+    ptrdiff_t   d_live)
+{
+    counter_shard_t* shard = &map->shards[shard_hint & (N_COUNTER_SHARDS - 1)];
+    const ptrdiff_t threshold = (ptrdiff_t)map->fold_threshold;
+
+    if (d_occupied != 0)
+    {
+        fold_shard(&shard->occupied, &map->occupied_cells, d_occupied, threshold);
+    }
+
+    if (d_live != 0)
+    {
+        fold_shard(&shard->live, &map->live_cells, d_live, threshold);
+    }
+}
+
+// add `delta` to the changes pending in a single shard, and fold
+// all pending changes into the shared `count` once they reach the
+// threshold; at the minimum threshold the shared count is exact
+static void fold_shard(
+    ptrdiff_t* pending,
+    size_t*    count,
+    ptrdiff_t  delta,
+    ptrdiff_t  threshold)
+{
+    if (threshold <= 1)
+    {
+        __atomic_fetch_add(count, (size_t)delta, __ATOMIC_RELAXED);
+        return;
+    }
+
+    const ptrdiff_t accumulated = __atomic_add_fetch(pending, delta, __ATOMIC_RELAXED);
+    if (accumulated >= threshold || accumulated <= -threshold)
+    {
+        // claim every change in the shard, including those
+        // recorded concurrently since it was incremented
+        const ptrdiff_t folded = __atomic_exchange_n(pending, 0, __ATOMIC_RELAXED);
+        __atomic_fetch_add(count, (size_t)folded, __ATOMIC_RELAXED);
+    }
+}
+
+// read one of the shared occupancy counts, which is approximate;
+// as shards are folded independently, a shared count may briefly
+// fall below zero, which is reported as zero
+static size_t get_folded_count(size_t* count)
+{
+    const size_t folded = __atomic_load_n(count, __ATOMIC_RELAXED);
+    return ((ptrdiff_t)folded < 0) ? 0 : folded;
+}
+
+// compute the occupancy counts of the map, including the changes
+// pending in each shard; the result is exact in the absence of
+// concurrent modification, and otherwise within the changes made
+// by operations concurrent with the summation
+static void sum_counts(flat_map_t* map, size_t* occupied, size_t* live)
+{
+    size_t occupied_sum = __atomic_load_n(&map->occupied_cells, __ATOMIC_RELAXED);
+    size_t live_sum     = __atomic_load_n(&map->live_cells, __ATOMIC_RELAXED);
+
+    for (size_t i = 0; i < N_COUNTER_SHARDS; ++i)
+    {
+        occupied_sum += (size_t)__atomic_load_n(&map->shards[i].occupied, __ATOMIC_RELAXED);
+        live_sum     += (size_t)__atomic_load_n(&map->shards[i].live, __ATOMIC_RELAXED);
+    }
+
+    // a concurrent fold may be observed in part
+    *occupied = ((ptrdiff_t)occupied_sum < 0) ? 0 : occupied_sum;
+    *live     = ((ptrdiff_t)live_sum < 0) ? 0 : live_sum;
+}
+
+// fold the changes pending in every shard into the shared counts,
+// which are then exact; must be called with exclusive map lock held
+static void fold_counts(flat_map_t* map)
+{
+    sum_counts(map, &map->occupied_cells, &map->live_cells);
+
+    for (size_t i = 0; i < N_COUNTER_SHARDS; ++i)
+    {
+        map->shards[i].occupied = 0;
+        map->shards[i].live     = 0;
+    }
+}
+
+// compute the fold threshold for a table of the given capacity, such
+// that the changes pending across all shards never exceed a small
+// fraction of the capacity
+static size_t get_fold_threshold(size_t capacity)
+{
+    const size_t threshold = capacity / (COUNTER_ERROR_INVERSE*N_COUNTER_SHARDS);
+    return (threshold > 1) ? threshold : 1;
+}
+
+// ----------------------------------------------------------------------------
+// Internal: Statistics
+
+#if defined(FLAT_MAP_STATS)
+
+// allocate the statistics shards of a map, zeroed
+static stats_shard_t* new_stats_shards(void)
+{
+    stats_shard_t* shards = aligned_alloc(
+        CACHE_LINE_SIZE, N_COUNTER_SHARDS*sizeof(stats_shard_t));
+    if (NULL == shards)
+    {
+        return NULL;
+    }
+
+    memset(shards, 0, N_COUNTER_SHARDS*sizeof(stats_shard_t));
+    return shards;
+}
+
+// record the probe of the operation in progress on the calling thread
+static void record_probe(flat_map_t* map, uint32_t hash)
+{
+    stats_shard_t* shard = &map->stats[hash & (N_COUNTER_SHARDS - 1)];
+
+    __atomic_fetch_add(&shard->probe_length[get_stats_bucket(probe_cells)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&shard->pages_crossed[get_stats_bucket(probe_pages)], 1, __ATOMIC_RELAXED);
+}
+
+// record a completed resize; must be called with exclusive map lock held
+static void record_resize(flat_map_t* map, uint64_t duration_ns)
+{
+    ++map->n_resizes;
+    map->resize_ns += duration_ns;
+    if (duration_ns > map->max_resize_ns)
+    {
+        map->max_resize_ns = duration_ns;
+    }
+}
+
+// determine the histogram bucket for a quantity `n`
+static size_t get_stats_bucket(size_t n)
+{
+    const size_t bucket = (n <= 1) ? 0 : (size_t)(63 - __builtin_clzl(n));
+    return (bucket < FLAT_MAP_STATS_BUCKETS) ? bucket : FLAT_MAP_STATS_BUCKETS - 1;
+}
+
+// read the monotonic clock, in nanoseconds
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+#endif
+
+// ----------------------------------------------------------------------------
+// Internal: Map Resize
+
+static bool need_resize(flat_map_t* map, size_t occupied_cells, size_t capacity)
+{
+    const float load_factor = (FLAT_MAP_PROBING_HOPSCOTCH == map->probing)
+        ? HOPSCOTCH_LOAD_FACTOR
+        : LOAD_FACTOR;
+
+    return occupied_cells >= capacity*load_factor;
+}
+
+// determine the number of pages in the smallest table, no smaller
+// than the initial capacity, that accommodates `n_items` keys without
+// reaching the maximum load factor
+static size_t get_n_pages_for_items(flat_map_t* map, size_t n_items)
+{
+    const size_t cells_per_page = map->cells_per_page;
+
+    size_t n_pages = (INITIAL_CAPACITY > cells_per_page)
+        ? INITIAL_CAPACITY / cells_per_page
+        : 1;
+
+    while (need_resize(map, n_items, n_pages*cells_per_page))
+    {
+        n_pages <<= 1;
+    }
+
+    return n_pages;
+}
+
+// determine the number of pages in the table that replaces the
+// current table once it can no longer accommodate `n_additional`
+// new keys; when at least half of the occupied cells at the resize
+// threshold are tombstones, the live keys are rehashed into a table
+// of the same size, rather than doubling the size of the table
+//
+// must be called with shared map lock held
+static size_t get_resize_n_pages(flat_map_t* map, size_t n_additional)
+{
+    const size_t n_pages  = map->table->n_pages;
+    const size_t capacity = get_capacity(map->table);
+    const size_t live     = get_folded_count(&map->live_cells);
+
+    return need_resize(map, 2*(live + n_additional), capacity)
+        ? n_pages << 1
+        : n_pages;
+}
+
+// determine the number of pages in the smallest table, no larger
+// than the current table, that holds `live` keys with at most half
+// of the maximum load, leaving room for growth
+//
+// must be called with shared map lock held
+static size_t get_compact_n_pages(flat_map_t* map, size_t live)
+{
+    const size_t n_pages = get_n_pages_for_items(map, 2*live);
+
+    return (n_pages < map->table->n_pages) ? n_pages : map->table->n_pages;
+}
+
+// replace the current table with a new table of `n_pages` pages, into
+// which the live keys are migrated and from which tombstones are thus
+// purged; if the table has been replaced by another thread since the
+// `generation` was observed, this is a no-op; when `complete` is set,
+// every key is migrated before returning, regardless of resize policy
+//
+// returns `false` if the new table could not be allocated, or the
+// keys of a migration that failed could not be rehashed
+static bool resize_map(
+    flat_map_t* map,
+    size_t      generation,
+    size_t      n_pages,
+    bool        complete)
+{
+    // the new table is allocated before excluding other threads
+    table_t* table = new_table(map, n_pages);
+    if (NULL == table)
+    {
+        return false;
+    }
+
+    lock_map_resize(map);
+    fold_counts(map);
+
+#if defined(FLAT_MAP_STATS)
+    const uint64_t start = now_ns();
+#endif
+
+    // a table smaller than the current table (when compacting) may
+    // no longer accommodate the keys inserted since it was sized
+    if (map->generation != generation
+     || need_resize(map, map->live_cells, get_capacity(table)))
+    {
+        // race for resize operation occurred, and we lost
+        unlock_map(map);
+        destroy_table(table, NULL);
+        return true;
+    }
+
+    // we now have exclusive access to the entire map structure
+
+    // a previous incremental resize must complete before the
+    // table it produced is itself replaced; this is only the
+    // case if migration did not keep pace with insertions
+    table_t* previous = NULL;
+    if (map->old_table != NULL)
+    {
+        migrate_remaining_pages(map);
+        previous = retire_old_table(map);
+        if (NULL == previous)
+        {
+            // a key of the previous table could not be placed, so
+            // both tables are instead rehashed into a larger table
+            const bool rehashed = rehash_map(map);
+            unlock_map(map);
+            destroy_table(table, NULL);
+            return rehashed;
+        }
+    }
+
+    replace_tables(map, table, map->table);
+    map->occupied_cells = 0;
+    map->fold_threshold = get_fold_threshold(get_capacity(table));
+
+    map->migration_cursor = 0;
+    map->migrated_pages   = 0;
+    map->migration_failed = false;
+
+    ++map->generation;
+
+    bool resized     = true;
+    table_t* retired = NULL;
+    if (complete || FLAT_MAP_RESIZE_BLOCKING == map->resize_policy)
+    {
+        // rehash the entire previous table before releasing the map
+        migrate_remaining_pages(map);
+        retired = retire_old_table(map);
+        if (NULL == retired)
+        {
+            resized = rehash_map(map);
+        }
+    }
+
+#if defined(FLAT_MAP_STATS)
+    record_resize(map, now_ns() - start);
+#endif
+
+    // lookups do not acquire the map lock, and may still be
+    // searching the tables that are no longer installed
+    if (previous != NULL || retired != NULL)
+    {
+        wait_for_lookups(map);
+    }
+
+    unlock_map(map);
+
+    // cleanup the old structures
+    if (previous != NULL)
+    {
+        destroy_table(previous, NULL);
+    }
+
+    if (retired != NULL)
+    {
+        destroy_table(retired, NULL);
+    }
+
+    return resized;
+}
+
+// migrate a chunk of pages from the previous table during an
+// incremental resize; must be called with shared map lock held
+//
+// returns `true` if the calling thread completed the migration
+static bool migrate_pages(flat_map_t* map)
+{
+    if (NULL == map->old_table)
+    {
+        return false;
+    }
+
+    bool complete = false;
+    migrate_chunk(map, &complete);
+    return complete;
+}
+
+// claim and migrate a single chunk of pages of the previous table;
+// `complete` is set if the calling thread migrated the final page, or
+// failed to migrate a page, as it must then finish the migration
+//
+// returns `false` if no pages remained to be claimed
+static bool migrate_chunk(flat_map_t* map, bool* complete)
+{
+    table_t* old_table = map->old_table;
+
+    // each operation migrates at least a single page
+    size_t chunk = MIGRATION_CHUNK_CELLS / old_table->cells_per_page;
+    if (0 == chunk)
+    {
+        chunk = 1;
+    }
+
+    // claim a range of pages; ranges are disjoint between threads
+    const size_t begin = __atomic_fetch_add(
+        &map->migration_cursor, chunk, __ATOMIC_RELAXED);
+    if (begin >= old_table->n_pages)
+    {
+        return false;
+    }
+
+    const size_t end = (begin + chunk < old_table->n_pages)
+        ? begin + chunk
+        : old_table->n_pages;
+
+    // a page that fails to migrate is never counted,
+    // so the migration does not complete on its own
+    size_t n_migrated = 0;
+    bool failed       = false;
+    for (size_t i = begin; i < end; ++i)
+    {
+        if (migrate_page(map, old_table, i))
+        {
+            ++n_migrated;
+        }
+        else
+        {
+            failed = true;
+        }
+    }
+
+    const size_t migrated = __atomic_add_fetch(
+        &map->migrated_pages, n_migrated, __ATOMIC_ACQ_REL);
+
+    *complete = failed || (migrated == old_table->n_pages);
+    return true;
+}
+
+// migrate all pages of the previous table not yet claimed by an
+// operation; must be called with the exclusive map lock held, at
+// which point every claimed page has been completely migrated
+//
+// when enough pages remain, helper threads claim chunks of pages
+// alongside the calling thread, exactly as concurrent operations
+// do during an incremental resize; the helpers act on behalf of
+// the calling thread, and so do not acquire the map lock
+static void migrate_remaining_pages(flat_map_t* map)
+{
+    table_t* old_table = map->old_table;
+
+    const size_t n_helpers = get_n_migration_helpers(map);
+
+    pthread_t* helpers   = NULL;
+    size_t     n_started = 0;
+    if (n_helpers > 0)
+    {
+        helpers = malloc(n_helpers*sizeof(pthread_t));
+    }
+
+    // any helper that fails to start leaves its share of the
+    // pages to the remaining threads, so failure is benign
+    for (size_t i = 0; helpers != NULL && i < n_helpers; ++i)
+    {
+        if (pthread_create(&helpers[i], NULL, migration_worker, map) != 0)
+        {
+            break;
+        }
+
+        ++n_started;
+    }
+
+    migration_worker(map);
+
+    for (size_t i = 0; i < n_started; ++i)
+    {
+        pthread_join(helpers[i], NULL);
+    }
+
+    free(helpers);
+
+    map->migration_cursor = old_table->n_pages;
+    map->migrated_pages   = old_table->n_pages;
+}
+
+// compute the number of helper threads for a complete migration
+static size_t get_n_migration_helpers(flat_map_t* map)
+{
+    table_t* old_table = map->old_table;
+
+    const size_t cursor = map->migration_cursor;
+    if (map->resize_threads < 2 || cursor >= old_table->n_pages)
+    {
+        return 0;
+    }
+
+    const size_t n_remaining = (old_table->n_pages - cursor)*old_table->cells_per_page;
+    if (n_remaining < PARALLEL_MIGRATION_MIN_CELLS)
+    {
+        return 0;
+    }
+
+    return map->resize_threads - 1;
+}
+
+// migrate chunks of pages until none remain to be claimed
+static void* migration_worker(void* arg)
+{
+    flat_map_t* map = (flat_map_t*)arg;
+
+    bool complete = false;
+    while (migrate_chunk(map, &complete))
+    {
+        // continue
+    }
+
+    return NULL;
+}
+
+// move each live cell in a single page of the previous table
+// into the current table; the page remains locked throughout,
+// so operations on its keys observe either table consistently
+//
+// returns `false` if a key of the page could not be placed under
+// hopscotch probing, in which case the keys already moved are
+// withdrawn and the page remains in the previous table
+static bool migrate_page(
+    flat_map_t* map,
+    table_t*    old_table,
+    size_t      page_index)
+{
+    lock_page_write(old_table, page_index);
+
+    bool migrated = true;
+
+    page_lock_t* lock = get_page_lock(old_table, page_index);
+    if (!lock->migrated)
+    {
+        const size_t begin = page_index*old_table->cells_per_page;
+        const size_t end   = begin + old_table->cells_per_page;
+
+        // new occupancy is published once for the entire page,
+        // as many threads may be migrating pages at once
+        size_t n_inserted = 0;
+
+        for (size_t i = begin; i < end; ++i)
+        {
+            cell_t cell = *get_cell(old_table, i);
+            if (cell.key == EMPTY_KEY || cell.key == TOMBSTONE_KEY)
+            {
+                continue;
+            }
+
+            // only live cells are carried over to the new table
+            const insert_result_t result = insert_into_table(map->table,
+                get_hash(cell.key), cell.key, cell.value, NULL, false, NULL);
+            if (INSERT_NEW == result)
+            {
+                ++n_inserted;
+            }
+            else if (INSERT_FULL == result)
+            {
+                // a key must never reside in both tables, as a removal
+                // from the previous table would leave its copy live
+                withdraw_page(map, old_table, begin, i);
+                __atomic_store_n(&map->migration_failed, true, __ATOMIC_RELAXED);
+                migrated = false;
+                break;
+            }
+        }
+
+        // a withdrawn key leaves a tombstone, which remains occupied
+        if (n_inserted > 0)
+        {
+            count_cells(map, page_index, (ptrdiff_t)n_inserted, 0);
+        }
+
+        if (migrated)
+        {
+            __atomic_store_n(&lock->migrated, true, __ATOMIC_RELAXED);
+        }
+    }
+
+    unlock_page_write(old_table, page_index);
+    return migrated;
+}
+
+// remove the live keys of the cells from `begin` up to `end` of
+// the previous table from the current table, into which they
+// were migrated, without retiring their values
+static void withdraw_page(
+    flat_map_t* map,
+    table_t*    old_table,
+    size_t      begin,
+    size_t      end)
+{
+    for (size_t i = begin; i < end; ++i)
+    {
+        const map_key_t key = get_cell(old_table, i)->key;
+        if (key != EMPTY_KEY && key != TOMBSTONE_KEY)
+        {
+            remove_hopscotch(NULL, map->table, get_hash(key), key);
+        }
+    }
+}
+
+// detach the fully-migrated previous table from the map;
+// must be called with the exclusive map lock held
+static table_t* retire_old_table(flat_map_t* map)
+{
+    table_t* old_table = map->old_table;
+    if (NULL == old_table
+     || map->migration_failed
+     || map->migrated_pages != old_table->n_pages)
+    {
+        return NULL;
+    }
+
+    replace_tables(map, map->table, NULL);
+    return old_table;
+}
+
+// retire the previous table once its final page has been migrated,
+// or rehash both tables once a page has failed to migrate
+static void finish_migration(flat_map_t* map)
+{
+    lock_map_resize(map);
+
+    table_t* retired = retire_old_table(map);
+    if (NULL == retired && map->migration_failed)
+    {
+        rehash_map(map);
+    }
+
+    if (retired != NULL)
+    {
+        wait_for_lookups(map);
+    }
+
+    unlock_map(map);
+
+    if (retired != NULL)
+    {
+        destroy_table(retired, NULL);
+    }
+}
+
+// rehash the live keys of the current table, and of the unmigrated
+// pages of the previous table, into a new table of twice the size of
+// the current table, which doubles again until every key is placed
+// within its neighborhood under hopscotch probing; must be called
+// with the exclusive map lock held, and destroys the tables that it
+// replaces at once, as this is rare
+//
+// returns `false` if the map is unchanged, as a table could not be
+// allocated, or the current table or a larger one is too sparse for
+// growth to help
+static bool rehash_map(flat_map_t* map)
+{
+    fold_counts(map);
 
-    } while (cell_index != init_cell_index);
+    for (size_t n_pages = map->table->n_pages << 1; ; n_pages <<= 1)
+    {
+        table_t* table = new_table(map, n_pages);
+        if (NULL == table)
+        {
+            return false;
+        }
 
-    unlock_map(map);
+        size_t n_keys = 0;
+        const bool placed = rehash_table(table, map->table, &n_keys)
+            && (NULL == map->old_table || rehash_table(table, map->old_table, &n_keys));
 
-    return removed;
+        // as for grow_full_table(), a sparse table is not replaced
+        if (placed && n_keys >= get_capacity(map->table)*HOPSCOTCH_MIN_GROWTH_LOAD)
+        {
+            copy_table_to_replicas(table);
+
+            table_t* replaced     = map->table;
+            table_t* old_replaced = map->old_table;
+            replace_tables(map, table, NULL);
+
+            wait_for_lookups(map);
+            destroy_table(replaced, NULL);
+            if (old_replaced != NULL)
+            {
+                destroy_table(old_replaced, NULL);
+            }
+
+            map->occupied_cells = n_keys;
+            map->fold_threshold = get_fold_threshold(get_capacity(table));
+
+            map->migration_cursor = 0;
+            map->migrated_pages   = 0;
+            map->migration_failed = false;
+
+            ++map->generation;
+            return true;
+        }
+
+        const size_t capacity = get_capacity(table);
+        destroy_table(table, NULL);
+
+        if (placed || n_keys < capacity*HOPSCOTCH_MIN_GROWTH_LOAD)
+        {
+            return false;
+        }
+    }
 }
 
-void* flat_map_find(flat_map_t* map, map_key_t key)
+// insert the live keys of the unmigrated pages of `source` into
+// `table`, to which the caller has exclusive access, adding the
+// number of keys inserted to `n_keys`
+//
+// returns `false` if a key could not be placed
+static bool rehash_table(table_t* table, table_t* source, size_t* n_keys)
 {
-    if (NULL == map || 0 == key)
+    for (size_t page_index = 0; page_index < source->n_pages; ++page_index)
     {
-        return NULL;
+        if (get_page_lock(source, page_index)->migrated)
+        {
+            continue;
+        }
+
+        const size_t begin = page_index*source->cells_per_page;
+        const size_t end   = begin + source->cells_per_page;
+
+        for (size_t i = begin; i < end; ++i)
+        {
+            const cell_t cell = *get_cell(source, i);
+            if (EMPTY_KEY == cell.key || TOMBSTONE_KEY == cell.key)
+            {
+                continue;
+            }
+
+            void* replaced = NULL;
+            if (INSERT_FULL == insert_unlocked(table,
+                get_hash(cell.key), cell.key, cell.value, &replaced))
+            {
+                return false;
+            }
+
+            ++*n_keys;
+        }
     }
 
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Internal: Snapshots
+
+// copy the cells of the current table, and the values to which they
+// point, and describe the copies in `header`; every page is locked
+// for the duration of the copy, as keys move between pages under
+// robin hood and hopscotch probing, so writers block until the copy
+// is complete, though never while the snapshot is written to its file
+static bool copy_snapshot(
+    flat_map_t*        map,
+    size_t             value_size,
+    snapshot_header_t* header,
+    cell_t**           cells,
+    uint8_t**          blob)
+{
     lock_map_rw(map);
 
-    // hash the key
-    const uint32_t hash = get_hash(key);
+    // a snapshot holds only a single table, so an incremental resize
+    // in progress is completed first; this requires the exclusive lock
+    while (map->old_table != NULL)
+    {
+        unlock_map(map);
+        lock_map_resize(map);
 
-    // locate the appropriate cell index to begin search
-    size_t cell_index = get_cell_index_for_hash(map, hash);
-    // locate the appropriate page index to begin search
-    size_t page_index = get_page_index_for_hash(map, hash);
-    
-    // track the starting cell index so that if we make a full
-    // cycle of the table without finding key, we terminate search
-    const size_t init_cell_index = page_index * map->cells_per_page;
-    
-    void* value          = NULL;
-    bool continue_search = true;
+        table_t* retired = NULL;
+        if (map->old_table != NULL)
+        {
+            migrate_remaining_pages(map);
+            retired = retire_old_table(map);
+
+            // a migration that failed is completed by a rehash,
+            // without which the snapshot cannot be taken
+            if (NULL == retired && !rehash_map(map))
+            {
+                unlock_map(map);
+                return false;
+            }
+        }
+
+        if (retired != NULL)
+        {
+            wait_for_lookups(map);
+        }
+
+        unlock_map(map);
+
+        if (retired != NULL)
+        {
+            destroy_table(retired, NULL);
+        }
+
+        lock_map_rw(map);
+    }
 
-    do
+    // no resize begins while the shared map lock is held
+    table_t* table = map->table;
+    const size_t n_cells = get_capacity(table);
+
+    cell_t* copy = malloc(n_cells*sizeof(cell_t));
+    if (NULL == copy)
     {
-        // acquire shared access to the page
-        lock_page_read(map->page_locks, page_index);
+        unlock_map(map);
+        return false;
+    }
 
-        // search for the key in the current page
-        value = find_at(map, cell_index, key, &continue_search);
-        if (!continue_search)
+    // pages are locked in ascending order, as in any run of pages
+    for (size_t i = 0; i < table->n_pages; ++i)
+    {
+        lock_page_read(table, i);
+    }
+
+    size_t occupied = 0;
+    size_t live     = 0;
+    size_t n_values = 0;
+    for (size_t i = 0; i < n_cells; ++i)
+    {
+        copy[i] = *get_cell(table, i);
+        if (EMPTY_KEY == copy[i].key)
         {
-            // key was found, or empty cell encountered
-            break;
+            continue;
+        }
+
+        ++occupied;
+        if (TOMBSTONE_KEY == copy[i].key)
+        {
+            // the value of a tombstone was destroyed on removal
+            copy[i].value = NULL;
+            continue;
+        }
+
+        ++live;
+        if (value_size > 0 && copy[i].value != NULL)
+        {
+            ++n_values;
         }
+    }
 
-        // release shared access to the page
-        unlock_page(map->page_locks, page_index);
+    // values are stored in the blob in the order of their cells,
+    // and each cell points to its value where the blob is mapped
+    const size_t blob_size  = n_values*value_size;
+    const uintptr_t address = (blob_size > 0) ? choose_blob_address(blob_size) : 0;
 
-        // increment the page and cell indices for next iteration
-        page_index = (page_index + 1) % map->n_pages;
-        cell_index = page_index * map->cells_per_page;
+    uint8_t* values = (blob_size > 0) ? malloc(blob_size) : NULL;
+    if (values != NULL)
+    {
+        size_t offset = 0;
+        for (size_t i = 0; i < n_cells; ++i)
+        {
+            if (copy[i].key != EMPTY_KEY && copy[i].key != TOMBSTONE_KEY && copy[i].value != NULL)
+            {
+                memcpy(values + offset, copy[i].value, value_size);
+                copy[i].value = (void*)(address + offset);
+                offset += value_size;
+            }
+        }
+    }
+
+    // the table may be retired once the map lock is released
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic));
+
+    header->version        = SNAPSHOT_VERSION;
+    header->cell_size      = sizeof(cell_t);
+    header->n_pages        = table->n_pages;
+    header->cells_per_page = table->cells_per_page;
+    header->probing        = table->probing;
 
-    } while (cell_index != init_cell_index);
+    for (size_t i = 0; i < table->n_pages; ++i)
+    {
+        unlock_page_read(table, i);
+    }
 
     unlock_map(map);
 
-    return value;
-}   
+    if (blob_size > 0 && NULL == values)
+    {
+        free(copy);
+        return false;
+    }
 
-bool flat_map_contains(flat_map_t* map, map_key_t key)
+    header->occupied_cells = occupied;
+    header->live_cells     = live;
+    header->value_size     = value_size;
+    header->cells_offset   = MEMORY_PAGE_SIZE;
+    header->blob_address   = address;
+    header->blob_size      = blob_size;
+
+    const size_t cells_size = n_cells*sizeof(cell_t);
+    header->blob_offset = (header->cells_offset + cells_size + MEMORY_PAGE_SIZE - 1)
+        & ~(size_t)(MEMORY_PAGE_SIZE - 1);
+
+    *cells = copy;
+    *blob  = values;
+    return true;
+}
+
+// choose the address at which the blob of a snapshot is to be mapped;
+// snapshots saved concurrently are likely given disjoint addresses,
+// such that a process may map several of them where they were saved
+static uintptr_t choose_blob_address(size_t blob_size)
 {
-    return flat_map_find(map, key) != NULL;
+    static const size_t n_slots = SNAPSHOT_BLOB_REGION_SIZE / SNAPSHOT_BLOB_ALIGNMENT;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    // a single round of splitmix64 over the time and the process
+    uint64_t x = (uint64_t)ts.tv_sec*1000000000ULL + (uint64_t)ts.tv_nsec;
+    x ^= (uint64_t)getpid() << 32;
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30))*0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27))*0x94D049BB133111EBULL;
+    x ^= x >> 31;
+
+    const uintptr_t address = SNAPSHOT_BLOB_REGION_BEGIN
+        + (uintptr_t)(x % n_slots)*SNAPSHOT_BLOB_ALIGNMENT;
+
+    // a blob that overruns the region from its slot begins at the
+    // start of the region, and is relocated on open if it must be
+    const uintptr_t end = SNAPSHOT_BLOB_REGION_BEGIN + SNAPSHOT_BLOB_REGION_SIZE;
+    return (blob_size <= end - address) ? address : SNAPSHOT_BLOB_REGION_BEGIN;
 }
 
-// ----------------------------------------------------------------------------
-// Internal: Utilities
+// write the header, the cells and the blob of values of a snapshot
+static bool write_snapshot(
+    FILE*                    file,
+    const snapshot_header_t* header,
+    const cell_t*            cells,
+    const uint8_t*           blob)
+{
+    const size_t cells_size = header->n_pages*header->cells_per_page*sizeof(cell_t);
 
-// determine if the given value is a power of 2.
-static bool is_power_of_two(size_t n)
+    if (fwrite(header, sizeof(*header), 1, file) != 1
+     || !write_padding(file, header->cells_offset - sizeof(*header))
+     || fwrite(cells, 1, cells_size, file) != cells_size)
+    {
+        return false;
+    }
+
+    if (0 == header->blob_size)
+    {
+        return true;
+    }
+
+    return write_padding(file, header->blob_offset - header->cells_offset - cells_size)
+        && fwrite(blob, 1, header->blob_size, file) == header->blob_size;
+}
+
+// write `n_bytes` zero bytes
+static bool write_padding(FILE* file, size_t n_bytes)
 {
-    return (n != 0) && ((n & (n - 1)) == 0);
+    static const uint8_t zeros[MEMORY_PAGE_SIZE];
+
+    while (n_bytes > 0)
+    {
+        const size_t n = (n_bytes < sizeof(zeros)) ? n_bytes : sizeof(zeros);
+        if (fwrite(zeros, 1, n, file) != n)
+        {
+            return false;
+        }
+
+        n_bytes -= n;
+    }
+
+    return true;
 }
 
-// determine the current total capacity of the map
-static size_t get_capacity(flat_map_t* map)
+// flush the directory entries of the directory that contains `path`
+static bool sync_directory_of(const char* path)
 {
-    return map->n_pages*map->cells_per_page;
+    const char* slash = strrchr(path, '/');
+    if (NULL == slash)
+    {
+        path  = ".";
+        slash = path + 1;
+    }
+    else if (slash == path)
+    {
+        // the root directory
+        ++slash;
+    }
+
+    const size_t length = (size_t)(slash - path);
+    char* directory = malloc(length + 1);
+    if (NULL == directory)
+    {
+        return false;
+    }
+
+    memcpy(directory, path, length);
+    directory[length] = '\0';
+
+    const int fd = open(directory, O_RDONLY | O_DIRECTORY);
+    free(directory);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    const bool synced = (0 == fsync(fd));
+    close(fd);
+
+    return synced;
 }
 
-static uint32_t get_hash(map_key_t key)
+// read and validate the header of a snapshot file against its size
+static bool read_snapshot_header(
+    int                fd,
+    snapshot_header_t* header)
 {
-    unsigned char buffer[sizeof(uint32_t)];
-    MurmurHash3_x86_32((void*)&key, sizeof(map_key_t), 0, buffer);
-    return (*(uint32_t*)buffer);
+    struct stat st;
+    if (fstat(fd, &st) != 0
+     || pread(fd, header, sizeof(*header), 0) != (ssize_t)sizeof(*header))
+    {
+        return false;
+    }
+
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0
+     || header->version != SNAPSHOT_VERSION
+     || header->cell_size != sizeof(cell_t)
+     || !is_power_of_two(header->n_pages)
+     || !is_power_of_two(header->cells_per_page)
+     || header->probing > FLAT_MAP_PROBING_HOPSCOTCH
+     || header->cells_offset % MEMORY_PAGE_SIZE != 0
+     || header->blob_offset % MEMORY_PAGE_SIZE != 0)
+    {
+        return false;
+    }
+
+    const uint64_t n_cells = header->n_pages*header->cells_per_page;
+    const uint64_t size    = (uint64_t)st.st_size;
+
+    return n_cells / header->cells_per_page == header->n_pages
+        && header->live_cells <= header->occupied_cells
+        && header->occupied_cells <= n_cells
+        && header->cells_offset + n_cells*sizeof(cell_t) <= size
+        && header->blob_offset + header->blob_size <= size
+        && (0 == header->blob_size || header->value_size > 0)
+        && header->blob_address % SNAPSHOT_BLOB_ALIGNMENT == 0
+        && header->blob_address <= UINTPTR_MAX - header->blob_size;
 }
 
-static size_t get_cell_index_for_hash(flat_map_t* map, uint32_t hash)
+// construct a table whose cells are mapped, copy-on-write, from
+// the cells section of a snapshot file
+static table_t* map_snapshot_table(
+    flat_map_t*              map,
+    int                      fd,
+    const snapshot_header_t* header)
 {
-    const size_t capacity = get_capacity(map);
-    return hash & (capacity - 1);
+    table_t* table = malloc(sizeof(table_t));
+    if (NULL == table)
+    {
+        return NULL;
+    }
+
+    table->n_pages        = header->n_pages;
+    table->cells_per_page = header->cells_per_page;
+    table->page_shift     = (size_t)__builtin_ctzl(header->cells_per_page);
+    table->probing        = map->probing;
+    table->lock_kind      = map->lock_kind;
+    table->stats          = map->stats;
+
+    table->sync_locks  = NULL;
+    table->blocks      = NULL;
+    table->block_size  = 0;
+    table->control     = NULL;
+    table->hop         = NULL;
+    table->replicas    = NULL;
+    table->n_replicas  = 0;
+    table->primary     = table;
+    table->mapped_size = get_capacity(table)*sizeof(cell_t);
+
+    table->cells = mmap(NULL, table->mapped_size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE, fd, (off_t)header->cells_offset);
+    if (MAP_FAILED == (void*)table->cells)
+    {
+        free(table);
+        return NULL;
+    }
+
+    table->page_locks = new_page_locks(table->n_pages);
+    if (NULL == table->page_locks)
+    {
+        munmap(table->cells, table->mapped_size);
+        free(table);
+        return NULL;
+    }
+
+    if (!initialize_page_locks(table))
+    {
+        free(table->page_locks);
+        munmap(table->cells, table->mapped_size);
+        free(table);
+        return NULL;
+    }
+
+    // hop bitmaps are not saved, as they are derived from the cells
+    if (FLAT_MAP_PROBING_HOPSCOTCH == table->probing)
+    {
+        table->hop = malloc(get_capacity(table)*sizeof(uint32_t));
+        if (NULL == table->hop)
+        {
+            destroy_table(table, NULL);
+            return NULL;
+        }
+
+        // a key outside of its neighborhood marks a corrupt snapshot
+        if (!rebuild_hops(table))
+        {
+            destroy_table(table, NULL);
+            return NULL;
+        }
+    }
+
+    return table;
 }
 
-static size_t get_page_index_for_hash(flat_map_t* map, uint32_t hash)
+// rewrite the value of each live cell of a table mapped from a snapshot
+// to point into the blob mapped at `values`, rather than at the address
+// at which the blob was to be mapped; this writes to, and thus copies,
+// every page of the mapped cells that holds a value
+//
+// returns `false` if any value lies outside of the blob
+static bool relocate_snapshot_values(
+    table_t*                 table,
+    uint8_t*                 values,
+    const snapshot_header_t* header)
 {
-    // determine the appropriate cell index
-    const size_t cell_index = get_cell_index_for_hash(map, hash);
+    const size_t n_cells = get_capacity(table);
+    for (size_t i = 0; i < n_cells; ++i)
+    {
+        cell_t* cell = get_cell(table, i);
+        if (EMPTY_KEY == cell->key || TOMBSTONE_KEY == cell->key || NULL == cell->value)
+        {
+            continue;
+        }
 
-    // compute the corresponding page index
-    return cell_index / map->cells_per_page;
+        const uint64_t offset = (uint64_t)(uintptr_t)cell->value - header->blob_address;
+        if (offset > header->blob_size || header->blob_size - offset < header->value_size)
+        {
+            return false;
+        }
+
+        cell->value = values + offset;
+    }
+
+    return true;
 }
 
-// acquire shared access to the map for read / write operations
-static void lock_map_rw(flat_map_t* map)
+// ----------------------------------------------------------------------------
+// Internal: NUMA Placement
+
+// Tables are placed with mbind(), invoked directly rather than through
+// libnuma such that the map requires no additional library; placement
+// is advisory, so a failure to place memory (as on a machine with fewer
+// nodes than the map, or a kernel without NUMA support) is ignored.
+
+// determine the number of NUMA nodes of the machine; node identifiers
+// may be sparse, so this is one greater than the greatest online node
+static size_t get_n_numa_nodes(void)
 {
-    pthread_rwlock_rdlock(&map->map_lock);
+    FILE* file = fopen("/sys/devices/system/node/online", "r");
+    if (NULL == file)
+    {
+        return 1;
+    }
+
+    // the list is composed of node identifiers and ranges thereof,
+    // separated by commas and dashes, e.g. "0-1,3"
+    size_t n_nodes = 1;
+    unsigned long node;
+    while (fscanf(file, "%lu", &node) == 1)
+    {
+        if (node + 1 > n_nodes)
+        {
+            n_nodes = node + 1;
+        }
+
+        if (EOF == fgetc(file))
+        {
+            break;
+        }
+    }
+
+    fclose(file);
+
+    return (n_nodes < MAX_NUMA_NODES) ? n_nodes : MAX_NUMA_NODES;
+}
+
+// apply the memory policy `mode` over the nodes
+// [first_node, first_node + n_nodes) to a mapping
+static void bind_memory(
+    void*  memory,
+    size_t size,
+    int    mode,
+    size_t first_node,
+    size_t n_nodes)
+{
+#if defined(SYS_mbind)
+    unsigned long mask = 0;
+    for (size_t i = first_node; i < first_node + n_nodes && i < MAX_NUMA_NODES; ++i)
+    {
+        mask |= 1UL << i;
+    }
+
+    // the kernel considers one fewer than the given number of bits
+    syscall(SYS_mbind, memory, size, mode, &mask, MAX_NUMA_NODES + 1, 0);
+#else
+    (void)memory;
+    (void)size;
+    (void)mode;
+    (void)first_node;
+    (void)n_nodes;
+#endif
+}
+
+// place the memory of a new table, which has not yet been touched,
+// across the nodes of the machine according to the policy of `map`
+static void place_table(flat_map_t* map, table_t* table)
+{
+    void* memory = (table->blocks != NULL) ? (void*)table->blocks : (void*)table->cells;
+    if (FLAT_MAP_NUMA_NONE == map->numa || 0 == table->mapped_size)
+    {
+        return;
+    }
+
+    if (map->numa != FLAT_MAP_NUMA_PARTITION)
+    {
+        bind_memory(memory, table->mapped_size, MPOL_INTERLEAVE, 0, map->n_nodes);
+        return;
+    }
+
+    // each range is a whole number of memory pages, so
+    // the final nodes may receive smaller ranges, or none
+    const size_t range = ((table->mapped_size / map->n_nodes) + MEMORY_PAGE_SIZE - 1)
+        & ~(size_t)(MEMORY_PAGE_SIZE - 1);
+
+    for (size_t i = 0; i < map->n_nodes && i*range < table->mapped_size; ++i)
+    {
+        const size_t offset = i*range;
+        const size_t size   = (table->mapped_size - offset < range)
+            ? table->mapped_size - offset
+            : range;
+
+        bind_memory((uint8_t*)memory + offset, size, MPOL_PREFERRED, i, 1);
+    }
+}
+
+// construct a replica of the cells of `table` on each node;
+// the table must be empty, as the replicas begin empty
+static bool new_replicas(flat_map_t* map, table_t* table)
+{
+    table->replicas = malloc(map->n_nodes*sizeof(table_t));
+    if (NULL == table->replicas)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < map->n_nodes; ++i)
+    {
+        table_t* replica = &table->replicas[i];
+
+        *replica = *table;
+        replica->replicas    = NULL;
+        replica->n_replicas  = 0;
+        replica->primary     = table;
+        replica->mapped_size = 0;
+
+        replica->cells = map_table_memory(replica,
+            get_capacity(table)*sizeof(cell_t), FLAT_MAP_MEMORY_MAPPED);
+        if (NULL == replica->cells)
+        {
+            destroy_replicas(table);
+            return false;
+        }
+
+        bind_memory(replica->cells, replica->mapped_size, MPOL_PREFERRED, i, 1);
+
+        // replicas are only destroyed up to the count
+        table->n_replicas = i + 1;
+    }
+
+    return true;
 }
 
-// acquire exclusive access to the map for resize
-static void lock_map_resize(flat_map_t* map)
-{
-    pthread_rwlock_wrlock(&map->map_lock);
+// destroy the replicas of a table, if any
+static void destroy_replicas(table_t* table)
+{
+    for (size_t i = 0; i < table->n_replicas; ++i)
+    {
+        free_table_memory(&table->replicas[i], table->replicas[i].cells);
+    }
+
+    free(table->replicas);
+
+    table->replicas   = NULL;
+    table->n_replicas = 0;
 }
 
-// release the map lock
-static void unlock_map(flat_map_t* map)
+// copy the cells of a single page of `table` to each of its replicas;
+// must be called with the page held exclusively, before its version
+// is published, such that a reader that validates its read of a
+// replica against the version observes the page consistently
+static void copy_page_to_replicas(table_t* table, size_t page_index)
 {
-    pthread_rwlock_unlock(&map->map_lock);
+    const size_t begin = page_index*table->cells_per_page;
+    const size_t end   = begin + table->cells_per_page;
+
+    for (size_t i = 0; i < table->n_replicas; ++i)
+    {
+        cell_t* cells = table->replicas[i].cells;
+        for (size_t j = begin; j < end; ++j)
+        {
+            __atomic_store_n(&cells[j].key, table->cells[j].key, __ATOMIC_RELAXED);
+            __atomic_store_n(&cells[j].value, table->cells[j].value, __ATOMIC_RELAXED);
+        }
+    }
 }
 
-static void lock_page_read(page_lock_t* locks, size_t page_index)
+// copy the cells of every page of `table` to each of its replicas,
+// once keys have been placed without acquiring the page locks
+static void copy_table_to_replicas(table_t* table)
 {
-    page_lock_t* lock = (page_lock_t*) ((unsigned char*)locks + sizeof(page_lock_t)*page_index);
-    pthread_rwlock_rdlock(lock);
+    for (size_t i = 0; table->n_replicas > 0 && i < table->n_pages; ++i)
+    {
+        copy_page_to_replicas(table, i);
+    }
 }
 
-static void lock_page_write(page_lock_t* locks, size_t page_index)
+// select the table from which a lookup on the calling thread
+// reads: the replica on its node, if the table is replicated
+static table_t* get_local_table(table_t* table)
 {
-    page_lock_t* lock = (page_lock_t*) ((unsigned char*)locks + sizeof(page_lock_t)*page_index);
-    pthread_rwlock_wrlock(lock);
+    if (0 == table->n_replicas)
+    {
+        return table;
+    }
+
+    return &table->replicas[get_thread_node() % table->n_replicas];
 }
 
-static void unlock_page(page_lock_t* locks, size_t page_index)
+// determine the NUMA node of the calling thread
+static size_t get_thread_node(void)
 {
-    page_lock_t* lock = (page_lock_t*) ((unsigned char*)locks + sizeof(page_lock_t)*page_index);
-    pthread_rwlock_unlock(lock);
+    if (thread_node >= 0)
+    {
+        return (size_t)thread_node;
+    }
+
+    unsigned int cpu;
+    unsigned int node;
+    if (getcpu(&cpu, &node) != 0)
+    {
+        return 0;
+    }
+
+    return node;
 }
 
 // ----------------------------------------------------------------------------
-// Internal: Insert, Remove, Find
+// Internal: Component Initialization and Destruction
 
-static bool insert_at(
-    flat_map_t* map,
-    size_t      cell_index,
-    map_key_t   key,
-    void*       value,
-    void**      replaced,
-    bool*       continue_search)
+// initialize the top-level map lock
+static bool initialize_map_lock(flat_map_t* map)
 {
-    *continue_search = true;
-    bool inserted    = false;
+    // set the atributes of the global rwlock such 
+    // that writer starvation is prevented
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
 
-    // compute the index of the cell relative to page
-    const size_t index_in_page = cell_index % map->cells_per_page;
-    // compute the index at which iteration for this page should end (exclusive)
-    const size_t end_index = cell_index + (map->cells_per_page - index_in_page);
+    return pthread_rwlock_init(&map->map_lock, &attr) == 0;
+}
 
-    // iterate over all cells in the page
-    for (size_t i = cell_index; i < end_index; ++i)
+static void destroy_map_lock(flat_map_t* map)
+{
+    pthread_rwlock_destroy(&map->map_lock);
+}
+
+// construct a new, empty table of `n_pages` pages
+static table_t* new_table(flat_map_t* map, size_t n_pages)
+{
+    const size_t cells_per_page = map->cells_per_page;
+
+    table_t* table = malloc(sizeof(table_t));
+    if (NULL == table)
     {
-        // locate a single cell
-        cell_t* cell = &map->cells[i];
+        return NULL;
+    }
 
-        if (cell->key == key)
+    table->n_pages        = n_pages;
+    table->cells_per_page = cells_per_page;
+    table->page_shift     = (size_t)__builtin_ctzl(cells_per_page);
+    table->probing        = map->probing;
+    table->lock_kind      = map->lock_kind;
+    table->stats          = map->stats;
+
+    table->cells       = NULL;
+    table->page_locks  = NULL;
+    table->sync_locks  = NULL;
+    table->blocks      = NULL;
+    table->block_size  = 0;
+    table->mapped_size = 0;
+    table->control     = NULL;
+    table->hop         = NULL;
+    table->replicas    = NULL;
+    table->n_replicas  = 0;
+    table->primary     = table;
+
+    // memory is only placed on nodes if mapped from the kernel
+    const flat_map_memory_t memory =
+        (map->numa != FLAT_MAP_NUMA_NONE && FLAT_MAP_MEMORY_HEAP == map->memory)
+        ? FLAT_MAP_MEMORY_MAPPED
+        : map->memory;
+
+    if (FLAT_MAP_LAYOUT_PAGED == map->layout)
+    {
+        if (!new_blocks(table, memory))
         {
-            // found a matching key, replace the value
-            if (replaced != NULL)
-            {
-                *replaced = cell->value;
-            }
-
-            cell->value       = value;
-            inserted         = true;
-            *continue_search = false;
-            break;
+            free(table);
+            return NULL;
+        }
+    }
+    else
+    {
+        if (!new_cells(table, memory))
+        {
+            free(table);
+            return NULL;
         }
 
-        if (cell->key == EMPTY_KEY)
+        table->page_locks = new_page_locks(n_pages);
+        if (NULL == table->page_locks)
         {
-            // found an empty cell, insert here
-            cell->key        = key;
-            cell->value      = value;
-            inserted         = true;
-            *continue_search = false;
-            break;
+            free_table_memory(table, table->cells);
+            free(table);
+            return NULL;
         }
     }
 
-    // if we fall off the end of the page without finding 
-    // a matching key or an empty cell, we must continue
-    // the search on the following page
-
-    return inserted;  
-}
-
-static bool remove_at(
-    flat_map_t* map, 
-    size_t      cell_index, 
-    uint32_t    key, 
-    bool*       continue_search)
-{
-    *continue_search = true;
-    bool removed     = false;
+    if (!initialize_page_locks(table))
+    {
+        if (table->blocks != NULL)
+        {
+            destroy_blocks(table);
+        }
+        else
+        {
+            free(table->page_locks);
+            free_table_memory(table, table->cells);
+        }
 
-    // compute the index of the cell relative to page
-    const size_t index_in_page = cell_index % map->cells_per_page;
-    // compute the index at which iteration for this page should end (exclusive)
-    const size_t end_index = cell_index + (map->cells_per_page - index_in_page);
+        free(table);
+        return NULL;
+    }
 
-    // iterate over all cells in the page
-    for (size_t i = cell_index; i < end_index; ++i)
+    if (map->control_bytes)
     {
-        // locate a single cell
-        cell_t* cell = &map->cells[i];
+        // padded such that a full group may be loaded at any cell
+        const size_t n_control = n_pages*cells_per_page + GROUP_WIDTH;
 
-        if (cell->key == key)
+        table->control = malloc(n_control);
+        if (NULL == table->control)
         {
-            // found a match
-            
-            // delete the stored value
-            map->deleter(cell->value);
-            
-            // mark the cell with a tombstone
-            cell->key = TOMBSTONE_KEY;
-
-            removed          = true;
-            *continue_search = false;
-            break;
+            destroy_table(table, NULL);
+            return NULL;
         }
 
-        if (cell->key == EMPTY_KEY)
+        memset(table->control, CONTROL_EMPTY, n_control);
+    }
+
+    if (FLAT_MAP_PROBING_HOPSCOTCH == map->probing)
+    {
+        table->hop = calloc(n_pages*cells_per_page, sizeof(uint32_t));
+        if (NULL == table->hop)
         {
-            // found an empty cell, search is over
-            removed          = false;
-            *continue_search = false;
-            break;
+            destroy_table(table, NULL);
+            return NULL;
         }
     }
 
-    // if we fall off the end of the page without finding 
-    // a matching key or an empty cell, we must continue
-    // the search on the following page
+    place_table(map, table);
 
-    return removed;
+    // replicas copy the members of the table, so are created last
+    if (FLAT_MAP_NUMA_REPLICATE == map->numa && !new_replicas(map, table))
+    {
+        destroy_table(table, NULL);
+        return NULL;
+    }
+
+    return table;
 }
 
-static void* find_at(
-    flat_map_t* map, 
-    size_t      cell_index, 
-    uint32_t    key, 
-    bool*       continue_search)
+// destroy a table, along with the values it owns if `owner` is provided
+static void destroy_table(table_t* table, flat_map_t* owner)
 {
-    *continue_search = true;
-    void* value      = NULL;
+    destroy_replicas(table);
+    destroy_cells(table, owner);
+    destroy_page_locks(table);
 
-    // compute the index of the cell relative to page
-    const size_t index_in_page = cell_index % map->cells_per_page;
-    // compute the index at which iteration for this page should end (exclusive)
-    const size_t end_index = cell_index + (map->cells_per_page - index_in_page);
+    if (table->blocks != NULL)
+    {
+        destroy_blocks(table);
+    }
+    else
+    {
+        free(table->page_locks);
+    }
 
-    // iterate over all cells in the page
-    for (size_t i = cell_index; i < end_index; ++i)
+    free(table->control);
+    free(table->hop);
+    free(table);
+}
+
+// allocate the counter shards of a map, each on its own cache line
+static counter_shard_t* new_counter_shards(void)
+{
+    counter_shard_t* shards = aligned_alloc(
+        CACHE_LINE_SIZE, N_COUNTER_SHARDS*sizeof(counter_shard_t));
+    if (NULL == shards)
     {
-        // locate a single cell
-        cell_t* cell = &map->cells[i];
+        return NULL;
+    }
 
-        if (cell->key == key)
+    memset(shards, 0, N_COUNTER_SHARDS*sizeof(counter_shard_t));
+    return shards;
+}
+
+// allocate the reader shards of a map, each on its own cache line
+static reader_shard_t* new_reader_shards(void)
+{
+    reader_shard_t* readers = aligned_alloc(
+        CACHE_LINE_SIZE, N_READER_SHARDS*sizeof(reader_shard_t));
+    if (NULL == readers)
+    {
+        return NULL;
+    }
+
+    memset(readers, 0, N_READER_SHARDS*sizeof(reader_shard_t));
+    return readers;
+}
+
+// allocate the page blocks of a table under the paged layout; the
+// array of blocks is aligned to a cache line, or to a memory page
+// if it spans at least a single memory page
+//
+// the blocks are zeroed, and a zeroed cell is empty; only the page
+// lock at the head of each block, by initialize_page_locks(), must
+// be initialized
+static bool new_blocks(table_t* table, flat_map_memory_t memory)
+{
+    const size_t cells_size = table->cells_per_page*sizeof(cell_t);
+    const size_t block_size = (PAGE_HEADER_SIZE + cells_size + CACHE_LINE_SIZE - 1)
+        & ~(size_t)(CACHE_LINE_SIZE - 1);
+
+    size_t size = table->n_pages*block_size;
+
+    uint8_t* blocks = NULL;
+    if (memory != FLAT_MAP_MEMORY_HEAP)
+    {
+        blocks = map_table_memory(table, size, memory);
+    }
+    else
+    {
+        size_t alignment = CACHE_LINE_SIZE;
+        if (size >= MEMORY_PAGE_SIZE)
         {
-            // found a match for our query
-            value = cell->value;
-            *continue_search = false;
-            break;
+            // aligned_alloc() requires a multiple of the alignment
+            alignment = MEMORY_PAGE_SIZE;
+            size      = (size + MEMORY_PAGE_SIZE - 1) & ~(size_t)(MEMORY_PAGE_SIZE - 1);
         }
 
-        if (cell->key == EMPTY_KEY)
+        blocks = aligned_alloc(alignment, size);
+        if (blocks != NULL)
         {
-            // found an empty cell, terminate search
-            *continue_search = false;
-            break;
+            memset(blocks, 0, size);
         }
     }
 
-    // if we fall off the end of the page without finding 
-    // a matching key or an empty cell, we must continue
-    // the search on the following page
+    if (NULL == blocks)
+    {
+        return false;
+    }
 
-    return value;
-}
+    table->blocks     = blocks;
+    table->block_size = block_size;
 
-// ----------------------------------------------------------------------------
-// Internal: Map Resize
+    return true;
+}
 
-static bool need_resize(size_t occupied_cells, size_t capacity)
+// release the page blocks; their page locks are destroyed beforehand
+static void destroy_blocks(table_t* table)
 {
-    return occupied_cells >= capacity*LOAD_FACTOR;
+    free_table_memory(table, table->blocks);
 }
 
-static void resize_map(flat_map_t* map)
+// allocate the cells of a table under the split layout; the
+// cells are zeroed, and a zeroed cell (EMPTY_KEY, NULL) is empty
+static bool new_cells(table_t* table, flat_map_memory_t memory)
 {
-    lock_map_resize(map);
+    const size_t n_cells = table->n_pages*table->cells_per_page;
 
-    const size_t capacity = map->n_pages*map->cells_per_page;
-    if (!need_resize(map->occupied_cells, capacity))
+    cell_t* cells = (FLAT_MAP_MEMORY_HEAP == memory)
+        ? calloc(n_cells, sizeof(cell_t))
+        : map_table_memory(table, n_cells*sizeof(cell_t), memory);
+    if (NULL == cells)
     {
-        // race for resize operation occurred, and we lost
-        unlock_map(map);
-        return;
+        return false;
     }
 
-    // we now have exclusive access to the entire map structure
-
-    // hang on to old references
-    const size_t old_n_pages  = map->n_pages;
-    const size_t old_capacity = old_n_pages*map->cells_per_page;
-
-    cell_t* old_cells      = map->cells;
-    page_lock_t* old_locks = map->page_locks;
-
-    // double the map capacity
-    const size_t new_n_pages  = map->n_pages << 1;
-    const size_t new_capacity = new_n_pages*map->cells_per_page;
+    table->cells = cells;
+    return true;
+}
 
-    map->cells          = new_cells(new_capacity);
-    map->page_locks     = new_page_locks(new_n_pages);
-    map->n_pages        = new_n_pages;
-    map->occupied_cells = 0;
+// map zeroed memory for the cells (or blocks) of a table directly
+// from the kernel, recording the size of the mapping in the table;
+// a mapping of at least a single huge page is aligned to a huge page,
+// such that transparent huge pages may back the entire mapping
+static void* map_table_memory(table_t* table, size_t size, flat_map_memory_t memory)
+{
+    const size_t huge_size = (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
 
-    // iterate over each existing cell in the map
-    for (size_t i = 0; i < old_capacity; ++i)
+#if defined(MAP_HUGETLB)
+    if (FLAT_MAP_MEMORY_HUGETLB == memory)
     {
-        cell_t cell = old_cells[i];
-
-        if (cell.key == EMPTY_KEY || cell.key == TOMBSTONE_KEY)
+        void* mapped = mmap(NULL, huge_size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mapped != MAP_FAILED)
         {
-            continue;
+            table->mapped_size = huge_size;
+            return mapped;
         }
 
-        // compute the new cell index for the cell
-        const uint32_t hash = get_hash(cell.key);
+        // no huge pages are reserved; fall back to a regular mapping
+    }
+#endif
 
-        uint32_t cell_index = get_cell_index_for_hash(map, hash);
-        uint32_t page_index = get_page_index_for_hash(map, hash);
+    const size_t mapped_size = (size >= HUGE_PAGE_SIZE)
+        ? huge_size
+        : (size + MEMORY_PAGE_SIZE - 1) & ~(size_t)(MEMORY_PAGE_SIZE - 1);
 
-        bool continue_search = true;
-        do
-        {
-            insert_at(map, cell_index, 
-                cell.key, cell.value, NULL, &continue_search);
-            
-            page_index = (page_index + 1) % new_n_pages;
-            cell_index = page_index * map->cells_per_page;
-        }
-        while (continue_search);
+    void* mapped = map_aligned(mapped_size,
+        (size >= HUGE_PAGE_SIZE) ? HUGE_PAGE_SIZE : MEMORY_PAGE_SIZE);
+    if (NULL == mapped)
+    {
+        return NULL;
     }
 
-    unlock_map(map);
+#if defined(MADV_HUGEPAGE)
+    if (size >= HUGE_PAGE_SIZE)
+    {
+        // advisory only; failure leaves the mapping with regular pages
+        madvise(mapped, mapped_size, MADV_HUGEPAGE);
+    }
+#endif
 
-    // cleanup the old structures
-    destroy_cells(old_cells, old_capacity, NULL);
-    destroy_page_locks(old_locks, old_n_pages);
+    table->mapped_size = mapped_size;
+    return mapped;
 }
 
-// ----------------------------------------------------------------------------
-// Internal: Component Initialization and Destruction
-
-// initialize the top-level map lock
-static bool initialize_map_lock(flat_map_t* map)
+// map `size` bytes of anonymous memory at an address aligned to
+// `alignment`, a multiple of the memory page size, by mapping an
+// excess of `alignment` bytes and then unmapping either end
+static void* map_aligned(size_t size, size_t alignment)
 {
-    // set the atributes of the global rwlock such 
-    // that writer starvation is prevented
-    pthread_rwlockattr_t attr;
-    pthread_rwlockattr_init(&attr);
-    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    const size_t reserved_size = (alignment > MEMORY_PAGE_SIZE)
+        ? size + alignment
+        : size;
 
-    return pthread_rwlock_init(&map->map_lock, &attr) == 0;
-}
+    uint8_t* reserved = mmap(NULL, reserved_size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == (void*)reserved)
+    {
+        return NULL;
+    }
 
-static void destroy_map_lock(flat_map_t* map)
-{
-    pthread_rwlock_destroy(&map->map_lock);
-}
+    const uintptr_t address = ((uintptr_t)reserved + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    uint8_t* aligned = (uint8_t*)address;
 
-static cell_t* new_cells(size_t n_cells)
-{
-    cell_t* cells = calloc(n_cells, sizeof(cell_t));
-    if (NULL == cells)
+    const size_t head = (size_t)(aligned - reserved);
+    const size_t tail = reserved_size - head - size;
+    if (head > 0)
     {
-        return NULL;
+        munmap(reserved, head);
     }
 
-    initialize_cells(cells, n_cells);
+    if (tail > 0)
+    {
+        munmap(aligned + size, tail);
+    }
 
-    return cells;
+    return aligned;
 }
 
-// initialize each cell in the table
-static void initialize_cells(
-    cell_t* cells, 
-    size_t n_cells)
+// release the cells (or blocks) of a table
+static void free_table_memory(table_t* table, void* memory)
 {
-    for (size_t i = 0; i < n_cells; ++i)
+    if (table->mapped_size > 0)
+    {
+        munmap(memory, table->mapped_size);
+    }
+    else
     {
-        cell_t* cell = &cells[i];
-        cell->key    = EMPTY_KEY;
-        cell->value  = NULL;
+        free(memory);
     }
 }
 
 // deallocate the data stored in each cell
 static void destroy_cells(
-    cell_t* cells,
-    size_t n_cells,
-    deleter_f deleter)
+    table_t*    table,
+    flat_map_t* owner)
 {
-    if (deleter != NULL)
+    if (owner != NULL)
     {
-        for (size_t i = 0; i < n_cells; ++i)
+        for (size_t i = 0; i < table->n_pages; ++i)
         {
-            cell_t cell = cells[i];
-            deleter(cell.value);
+            // the values in a migrated page are owned by the new table
+            if (get_page_lock(table, i)->migrated)
+            {
+                continue;
+            }
+
+            const size_t begin = i*table->cells_per_page;
+            const size_t end   = begin + table->cells_per_page;
+
+            for (size_t j = begin; j < end; ++j)
+            {
+                // the values of tombstone cells were destroyed on removal
+                cell_t cell = *get_cell(table, j);
+                if (cell.key != EMPTY_KEY && cell.key != TOMBSTONE_KEY)
+                {
+                    dispose_value(owner, cell.value);
+                }
+            }
         }
     }
 
-    free(cells);
+    if (table->cells != NULL)
+    {
+        free_table_memory(table, table->cells);
+    }
 }
 
-
+// allocate the array of page locks under the split layout;
+// the locks are initialized by initialize_page_locks()
 static page_lock_t* new_page_locks(size_t n_locks)
 {
-    page_lock_t* page_locks = calloc(n_locks, sizeof(page_lock_t));
-    if (NULL == page_locks)
-    {
-        return NULL;
-    }
-
-    initialize_page_locks(page_locks, n_locks);
-
-    return page_locks;
+    return calloc(n_locks, sizeof(page_lock_t));
 }
 
-// initialize the page lock for each page
-static void initialize_page_locks(
-    page_lock_t* page_locks,
-    size_t n_locks)
+// initialize the page lock for each page, wherever the page locks
+// reside; returns `false`, with no lock initialized, on failure
+static bool initialize_page_locks(table_t* table)
 {
-    for (size_t i = 0; i < n_locks; ++i)
+    if (FLAT_MAP_LOCK_RWLOCK == table->lock_kind)
     {
-        page_lock_t lock = page_locks[i];
-        pthread_rwlock_init(&lock, NULL);
+        table->sync_locks = malloc(table->n_pages*sizeof(rwlock_t));
+        if (NULL == table->sync_locks)
+        {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < table->n_pages; ++i)
+    {
+        initialize_page_lock(table, i);
     }
+
+    return true;
 }
 
 // destroy the per-page lock for each page
-static void destroy_page_locks(
-    page_lock_t* page_locks, 
-    size_t n_locks)
+static void destroy_page_locks(table_t* table)
 {
-    for (size_t i = 0; i < n_locks; ++i)
+    for (size_t i = 0; i < table->n_pages; ++i)
     {
-        page_lock_t lock = page_locks[i];
-        pthread_rwlock_destroy(&lock);
+        destroy_page_lock(table, i);
     }
-}
\ No newline at end of file
+
+    free(table->sync_locks);
+    table->sync_locks = NULL;
+}
@@ -9,13 +9,60 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "flat_map_attr.h"
+#include "../rcu/rcu.h"
+
 typedef struct flat_map flat_map_t;
 
-// We restrict the key type to 64-bit integers.
+typedef struct flat_map_iter flat_map_iter_t;
+
+// We restrict the key type to 64-bit integers; the 
+// values 0 and UINT64_MAX are reserved for internal use.
 typedef uint64_t map_key_t;
 
-// The signature for user-provided delete function.
-typedef void (*deleter_f)(void*);
+// The signature for the user-provided callback of flat_map_compute().
+typedef void* (*flat_map_compute_f)(map_key_t key, void* value, void* ctx);
+
+// The signature for the user-provided callback of flat_map_parallel_for_each().
+typedef void (*flat_map_visit_f)(map_key_t key, void* value, void* ctx);
+
+// The number of buckets in each histogram of flat_map_stats_t.
+#define FLAT_MAP_STATS_BUCKETS 16
+
+// A snapshot of the statistics of a map instance; statistics
+// are only collected when the map is built with FLAT_MAP_STATS
+// defined (e.g. `make STATS=1`), and are otherwise compiled out.
+//
+// Each histogram is logarithmic: bucket `i` counts operations
+// for which the quantity lies within [2^i, 2^(i+1)), except that
+// bucket 0 also counts zero and the final bucket is unbounded.
+typedef struct flat_map_stats
+{
+    // The number of cells examined by each insert, compute,
+    // remove, and find operation, including any retries.
+    uint64_t probe_length[FLAT_MAP_STATS_BUCKETS];
+
+    // The number of pages visited by each of these operations.
+    uint64_t pages_crossed[FLAT_MAP_STATS_BUCKETS];
+
+    // The number of tombstones in the current table; exact
+    // unless an incremental resize is in progress.
+    uint64_t tombstones;
+
+    // The number of completed resizes (including compactions),
+    // and the total and maximum time for which each excluded
+    // all other operations on the map, in nanoseconds.
+    uint64_t resizes;
+    uint64_t resize_ns;
+    uint64_t max_resize_ns;
+
+    // The number of page lock acquisitions, the number of those
+    // that found the lock held and had to block, and the total
+    // time spent blocked, in nanoseconds.
+    uint64_t lock_acquisitions;
+    uint64_t lock_contentions;
+    uint64_t lock_wait_ns;
+} flat_map_stats_t;
 
 // flat_map_new()
 //
@@ -36,6 +83,180 @@ flat_map_t* flat_map_new(
     size_t page_size, 
     deleter_f deleter);
 
+// flat_map_new_with_capacity()
+//
+// Construct a new map instance sized in advance
+// to hold an expected number of items.
+//
+// The internal table is allocated at the capacity
+// required to hold `expected_items` keys without
+// a resize, avoiding the series of resizes that
+// would otherwise occur as the map is populated.
+//
+// Arguments:
+//  page_size      - as for flat_map_new()
+//  deleter        - as for flat_map_new()
+//  expected_items - the number of items the map
+//                   is expected to hold
+//
+// Returns:
+//  A pointer to the newly constructed map instance on success
+//  NULL on failure
+flat_map_t* flat_map_new_with_capacity(
+    size_t    page_size,
+    deleter_f deleter,
+    size_t    expected_items);
+
+// flat_map_new_with_attr()
+//
+// Construct a new map instance with attributes
+// specified by the provided attributes structure.
+//
+// The `page_size` and `deleter` attributes have the
+// same meaning as the arguments to flat_map_new(), and
+// the `expected_items` attribute has the same meaning
+// as the argument to flat_map_new_with_capacity(); a
+// value of 0 selects the default initial capacity.
+// The `resize_policy` attribute determines how the
+// internal table grows:
+//
+//  - FLAT_MAP_RESIZE_BLOCKING rehashes the entire table
+//    at once, excluding all other operations on the map
+//  - FLAT_MAP_RESIZE_INCREMENTAL allocates the new table
+//    and then migrates pages to it in small chunks as part
+//    of subsequent insert and remove operations; lookups
+//    consult both tables until migration completes
+//
+// The `probing` attribute selects the collision policy:
+//
+//  - FLAT_MAP_PROBING_LINEAR is plain linear probing
+//  - FLAT_MAP_PROBING_ROBIN_HOOD applies the robin hood
+//    insertion policy and backward-shift deletion, which
+//    bounds the variance of probe lengths and never leaves
+//    tombstones behind in the table
+//  - FLAT_MAP_PROBING_HOPSCOTCH keeps every key within a
+//    neighborhood of 31 cells that begins at its initial cell,
+//    and a bitmap per cell of the keys in its neighborhood; a
+//    lookup examines only the cells set in the bitmap, so the
+//    map grows at a load factor of 0.9 rather than 0.75, at a
+//    cost of 4 bytes per cell; a page size of at least 32 cells
+//    lets the lock of at most two pages cover a neighborhood;
+//    the map also grows once no free cell among the 256 that
+//    follow the initial cell of a new key (fewer, for pages of
+//    at most 8 cells) can be moved into its neighborhood,
+//    which for a large map typically occurs at a load factor
+//    of about 0.8; an insertion fails only if the map is too
+//    sparse for growth to help, as when the neighborhood is
+//    shared with too many keys of the same hash
+//
+// The `layout` attribute selects the arrangement of the
+// internal table in memory:
+//
+//  - FLAT_MAP_LAYOUT_SPLIT keeps cells and page locks in
+//    two separate arrays
+//  - FLAT_MAP_LAYOUT_PAGED stores each page as one block,
+//    aligned to a cache line, holding the page lock and
+//    then its cells; the locks of distinct pages never
+//    share a cache line, and a probe of a page touches
+//    its lock and cells in adjacent memory
+//
+// The `memory` attribute selects the source of the memory
+// that backs the internal table:
+//
+//  - FLAT_MAP_MEMORY_HEAP allocates the table from the heap
+//  - FLAT_MAP_MEMORY_MAPPED maps the table with mmap(), and
+//    advises the kernel to back tables of at least a single
+//    huge page with transparent huge pages; large tables
+//    incur far fewer TLB misses on random probes, and the
+//    cells are never touched until first use, as the kernel
+//    provides zeroed memory
+//  - FLAT_MAP_MEMORY_HUGETLB maps the table from the pool of
+//    reserved huge pages (MAP_HUGETLB), falling back to the
+//    behavior of FLAT_MAP_MEMORY_MAPPED if none are available
+//
+// The `lock_kind` attribute selects the implementation of
+// the lock that serializes writers to each page:
+//
+//  - FLAT_MAP_LOCK_PTHREAD_RWLOCK is a pthread_rwlock_t
+//  - FLAT_MAP_LOCK_SPINLOCK is a test-and-test-and-set
+//    spinlock, which avoids the cost of a futex wait and wake
+//    for the short critical sections of small pages
+//  - FLAT_MAP_LOCK_TICKET is a ticket spinlock, which also
+//    grants a contended page in first-come, first-served order
+//  - FLAT_MAP_LOCK_RWLOCK is the write-preferring rwlock_t
+//    from sync/rwlock.h
+//
+// Lookups read pages optimistically regardless of the kind,
+// and the spinning kinds are only suitable when the number
+// of threads operating on the map does not exceed the number
+// of processors.
+//
+// The `reclaim` attribute selects when values that are
+// removed from the map, or replaced by flat_map_compute()
+// or a repeated key in flat_map_bulk_load(), are destroyed:
+//
+//  - FLAT_MAP_RECLAIM_IMMEDIATE invokes the delete function
+//    at once, such that a value returned by flat_map_find()
+//    may only be used while no other thread can remove it
+//  - FLAT_MAP_RECLAIM_DEFERRED hands the value to an RCU
+//    collector (rcu/rcu.h), and invokes the delete function
+//    only once every read-side critical section that began
+//    before the removal has ended; see flat_map_enter()
+//
+// When the `control_bytes` attribute is set, the map
+// maintains a parallel array of 1-byte control tags,
+// one per cell, recording whether the cell is empty, a
+// tombstone, or holds a key with a particular 7-bit tag.
+// Probes compare the tags of 16 cells at once and load
+// a cell only on a tag match, which substantially reduces
+// memory traffic for lookups of keys not in the map.
+// Control bytes are only supported with linear probing.
+//
+// The `resize_threads` attribute is the number of threads
+// that rehash the table whenever a resize must migrate all
+// of its keys at once (every resize under the blocking
+// policy); the thread that triggers the resize is one of
+// them, and the remainder are started for the duration of
+// the rehash only. Small tables are always rehashed by a
+// single thread. The default of 1 disables helper threads.
+//
+// The `numa` attribute selects the placement of tables
+// across the NUMA nodes of the machine, of which there are
+// `numa_nodes` (or, if 0, as many as the system reports):
+//
+//  - FLAT_MAP_NUMA_NONE leaves placement to the kernel, which
+//    places each page on the node that first touches it
+//  - FLAT_MAP_NUMA_INTERLEAVE interleaves the pages of each
+//    table across the nodes, such that probes from every node
+//    are spread evenly over the interconnect rather than
+//    concentrated on a single node
+//  - FLAT_MAP_NUMA_PARTITION places an equal, contiguous
+//    range of the pages of each table on each node
+//  - FLAT_MAP_NUMA_REPLICATE interleaves each table, and keeps
+//    a replica of its cells on each node, from which lookups
+//    on that node read; a writer copies each page that it
+//    modifies to every replica before releasing the page,
+//    so each write costs a page of cells per node. Intended
+//    for read-mostly maps; requires FLAT_MAP_LAYOUT_SPLIT
+//
+// The node of a lookup is the node of the processor on which
+// the calling thread runs, unless the thread has declared its
+// node with flat_map_set_thread_node(). Placement is advisory:
+// memory on a node that does not exist, or cannot be placed
+// there, falls back to the default placement, so a map with
+// more nodes than the machine (a simulated topology) behaves
+// correctly, if without any benefit. Any setting other than
+// FLAT_MAP_NUMA_NONE maps tables directly from the kernel,
+// as for FLAT_MAP_MEMORY_MAPPED.
+//
+// Arguments:
+//  attr - the attributes for the new map instance
+//
+// Returns:
+//  A pointer to the newly constructed map instance on success
+//  NULL on failure
+flat_map_t* flat_map_new_with_attr(flat_map_attr_t* attr);
+
 // flat_map_delete()
 //
 // Destroy an existing map instance.
@@ -90,6 +311,57 @@ bool flat_map_insert(
     void*       value, 
     void**      out);
 
+// flat_map_compute()
+//
+// Atomically compute the value associated with a key.
+//
+// This function is reentrant and may be invoked
+// from multiple threads of execution concurrently.
+//
+// The callback `fn` is invoked exactly once, with the value
+// currently associated with `key`, or NULL if `key` is not
+// present in the map, and returns the value to associate
+// with `key`. The callback runs while the page in which `key`
+// resides is locked for writing, such that no other operation
+// on `key` may intervene between the lookup and the update,
+// and a read-modify-write of a value (e.g. a counter) requires
+// only a single probe of the map. The callback must therefore
+// be brief, and must not access the map.
+//
+// The result of the callback is handled as follows:
+//
+//  - If `key` is not present, and the callback returns
+//    NULL, the map is left unmodified
+//  - If `key` is not present, `key` is inserted into the
+//    map with the value returned by the callback
+//  - If `key` is present, the value associated with `key`
+//    is updated to the value returned by the callback; if
+//    the value differs from the existing value, the existing
+//    value is destroyed via the delete function provided in
+//    the constructor of the map instance
+//
+// Because NULL is indistinguishable from an absent value,
+// a key associated with NULL is presented to the callback
+// as if it were not present in the map.
+//
+// This operation may trigger a map resize operation.
+//
+// Arguments:
+//  map - pointer to an existing map instance
+//  key - the key for which to compute a value
+//  fn  - the callback that computes the value
+//  ctx - an arbitrary pointer passed through to `fn`
+//
+// Returns:
+//  The value associated with `key` by the callback, which
+//  may be accessed as long as `key` is not updated or removed
+//  NULL if the callback returned NULL, or on invalid arguments
+void* flat_map_compute(
+    flat_map_t*        map,
+    map_key_t          key,
+    flat_map_compute_f fn,
+    void*              ctx);
+
 // flat_map_remove()
 //
 // Remove a key / value association from the map.
@@ -101,7 +373,8 @@ bool flat_map_insert(
 // with `key` is destroyed via the delete function provided
 // in the constructor of the flat map instance, and `true`
 // is returned. Otherwise, `key` is not present in the map,
-// and `false` is returned.
+// and `false` is returned. Under FLAT_MAP_RECLAIM_DEFERRED,
+// the value is destroyed once no reader may still hold it.
 //
 // Arguments:
 //  map - pointer to an existing map instance
@@ -119,12 +392,21 @@ bool flat_map_remove(flat_map_t* map, map_key_t key);
 // This function is reentrant and may be invoked
 // from multiple threads of execution concurrently.
 //
+// Lookups do not acquire the per-page locks in the
+// common case; instead, each page is searched optimistically
+// and the search is retried if a concurrent writer modified
+// the page in the interim. Nor do lookups acquire the map
+// lock that excludes resizes; a search that overlaps the
+// replacement of the internal table is retried in full.
+//
 // Arguments:
 //  map - pointer to an existing map instance
 //  key - the key that identifies the association for which to search
 //
 // Returns:
-//  A pointer to the value associated with `key` if present in the map
+//  A pointer to the value associated with `key` if present in the map;
+//  under FLAT_MAP_RECLAIM_DEFERRED, the pointer remains valid until the
+//  enclosing read-side critical section ends (see flat_map_enter())
 //  NULL otherwise
 void* flat_map_find(flat_map_t* map, map_key_t key);
 
@@ -144,4 +426,429 @@ void* flat_map_find(flat_map_t* map, map_key_t key);
 //  `false` otherwise
 bool flat_map_contains(flat_map_t* map, map_key_t key);
 
+// flat_map_enter()
+//
+// Begin a read-side critical section.
+//
+// This function is reentrant and may be invoked
+// from multiple threads of execution concurrently.
+//
+// For a map constructed with FLAT_MAP_RECLAIM_DEFERRED, a
+// value returned by flat_map_find() within a read-side critical
+// section remains valid until the section ends, even if the
+// value is concurrently removed from the map. Sections should
+// be short, as values removed while any section is active are
+// not destroyed until it ends. A thread may perform any
+// operation on the map from within a section, other than
+// flat_map_synchronize(). For any other map, this function
+// and flat_map_leave() do nothing.
+//
+// Arguments:
+//  map - pointer to an existing map instance
+//
+// Returns:
+//  The handle to pass to flat_map_leave() to end the section
+rcu_handle_t flat_map_enter(flat_map_t* map);
+
+// flat_map_leave()
+//
+// End a read-side critical section.
+//
+// Values found within the section must not be accessed
+// after the section ends.
+//
+// Arguments:
+//  map    - pointer to an existing map instance
+//  handle - the handle returned by flat_map_enter()
+void flat_map_leave(flat_map_t* map, rcu_handle_t handle);
+
+// flat_map_synchronize()
+//
+// Destroy every value removed from the map so far.
+//
+// Under FLAT_MAP_RECLAIM_DEFERRED, removed values are
+// collected in batches by subsequent removals, without
+// waiting for readers. This function instead blocks until
+// every read-side critical section that began before the
+// call has ended, and then destroys all of the values
+// removed before the call. It must not be called from
+// within a read-side critical section.
+//
+// Arguments:
+//  map - pointer to an existing map instance
+void flat_map_synchronize(flat_map_t* map);
+
+// flat_map_size()
+//
+// Query the number of keys in the map.
+//
+// The map maintains its count of keys in many shards, which
+// are combined only when queried. In the absence of concurrent
+// modification of the map the result is exact; otherwise, it
+// may or may not reflect each of the concurrent operations.
+//
+// This function is reentrant and may be invoked
+// from multiple threads of execution concurrently.
+//
+// Arguments:
+//  map - pointer to an existing map instance
+//
+// Returns:
+//  The number of keys in the map
+size_t flat_map_size(flat_map_t* map);
+
+// flat_map_get_stats()
+//
+// Take a snapshot of the statistics of the map.
+//
+// This function is reentrant and may be invoked
+// from multiple threads of execution concurrently.
+//
+// The counters are read individually, so a snapshot taken
+// concurrently with other operations may reflect some of
+// them only in part.
+//
+// Arguments:
+//  map   - pointer to an existing map instance
+//  stats - the statistics structure to populate
+//
+// Returns:
+//  `true` if the snapshot was taken
+//  `false` if the map was built without FLAT_MAP_STATS, in
+//  which case `stats` is zeroed, or on invalid arguments
+bool flat_map_get_stats(flat_map_t* map, flat_map_stats_t* stats);
+
+// flat_map_bulk_load()
+//
+// Populate an empty map from an array of key / value pairs.
+//
+// All other operations on the map are excluded for the
+// duration of the load. The internal table is sized to
+// hold every key before any is inserted, and keys are
+// placed directly, without acquiring the per-page locks.
+// A key that appears more than once in the array is
+// associated with its final value; the earlier values
+// for the key are destroyed via the delete function.
+//
+// Arguments:
+//  map    - pointer to an existing, empty map instance
+//  keys   - the array of keys to load
+//  values - the array of values to load, one per key
+//  n_keys - the number of keys in the array
+//
+// Returns:
+//  `true` if the pairs were loaded into the map
+//  `false` if the map is not empty, if a key is one
+//  of the reserved values, or on allocation failure,
+//  in which case the map is unmodified and ownership
+//  of the values remains with the caller; under hopscotch
+//  probing, also if a key cannot be placed as for
+//  flat_map_insert(), in which case the map holds some of
+//  the keys, and owns their values, while the values of the
+//  others, which flat_map_find() does not locate, remain
+//  with the caller
+bool flat_map_bulk_load(
+    flat_map_t*      map,
+    const map_key_t* keys,
+    void* const*     values,
+    size_t           n_keys);
+
+// flat_map_compact()
+//
+// Reclaim the memory held by removed keys.
+//
+// This function is reentrant and may be invoked
+// from multiple threads of execution concurrently.
+//
+// The live keys of the map are rehashed into a new
+// table, discarding the tombstones left behind by
+// removals. The new table is the smallest that holds
+// the live keys at no more than half the maximum load,
+// but is never larger than the current table, so a map
+// in which many keys have been removed shrinks. All
+// other operations on the map are excluded while the
+// keys are rehashed.
+//
+// Independently of this function, a map that reaches
+// its maximum load while mostly occupied by tombstones
+// rehashes its keys at the current size, rather than
+// doubling in size.
+//
+// Arguments:
+//  map - pointer to an existing map instance
+//
+// Returns:
+//  `true` on success
+//  `false` if the new table could not be allocated
+bool flat_map_compact(flat_map_t* map);
+
+// flat_map_save()
+//
+// Write a snapshot of the map to a file.
+//
+// The table, and the values to which it points, are copied
+// while every page of the map is locked, such that the
+// snapshot is consistent across pages: writers to the map
+// block for the duration of the copy, which is proportional
+// to the size of the map, while readers proceed. The file
+// is written from the copy without any lock held. An
+// incremental resize in progress is completed first. The
+// snapshot holds the internal table as it resides in memory,
+// such that it may be mapped back directly by
+// flat_map_open_mapped().
+//
+// The values of the map are saved in one of two ways:
+//
+//  - If `value_size` is 0, each value is stored inline, as
+//    the pointer itself; this is only meaningful for maps
+//    whose values are not pointers to memory (e.g. integers
+//    cast to `void*`)
+//  - Otherwise, each value is taken to point to an object of
+//    `value_size` bytes, which is copied into a blob in the
+//    snapshot; the cells then point into the blob at the
+//    address at which it is to be mapped
+//
+// The snapshot is written to a uniquely named temporary file
+// in the directory of `path`, which is flushed to storage and
+// then replaces `path`, such that a crash leaves either the
+// previous file or the complete snapshot at `path`. The format of the file is
+// versioned, but not portable between machines of different
+// byte order or word size.
+//
+// Arguments:
+//  map        - pointer to an existing map instance
+//  path       - the path of the snapshot file
+//  value_size - the size of each value, in bytes, or 0
+//
+// Returns:
+//  `true` on success
+//  `false` on failure
+bool flat_map_save(flat_map_t* map, const char* path, size_t value_size);
+
+// flat_map_open_mapped()
+//
+// Construct a new map instance from a snapshot file.
+//
+// The table in the snapshot is mapped into memory with
+// mmap(), copy-on-write, rather than rebuilt by inserting
+// each key, such that pages of the table are read from the
+// file only on first access; the file itself is never
+// modified. The blob of values, if any, is mapped at the
+// address recorded in the snapshot, such that its cells
+// are valid as saved; snapshots are thus opened in time
+// independent of their size, other than under hopscotch
+// probing, whose hop bitmaps are rebuilt. Only if that
+// address is in use is the blob mapped elsewhere, and the
+// cells rewritten in a single sequential pass. The file
+// is trusted to be one written by flat_map_save().
+//
+// The map has the page size and the probing scheme of the
+// saved map, and default values for its other attributes.
+// Values loaded from a blob reside in the mapping of the
+// snapshot, and are owned by the map: they are never passed
+// to `deleter`, and must not be destroyed by the user when
+// returned via the `out` parameter of flat_map_insert().
+// Values inserted after the map is opened are destroyed
+// via `deleter` as usual.
+//
+// Arguments:
+//  path    - the path of the snapshot file
+//  deleter - the user-provided delete function used to
+//            destroy values inserted into the map
+//
+// Returns:
+//  A pointer to the newly constructed map instance on success
+//  NULL on failure
+flat_map_t* flat_map_open_mapped(const char* path, deleter_f deleter);
+
+// flat_map_insert_batch()
+//
+// Insert a batch of key / value pairs into the map.
+//
+// This function is reentrant and may be invoked
+// from multiple threads of execution concurrently.
+//
+// Each pair is inserted with the same semantics as
+// flat_map_insert(); a key that appears more than once
+// in the batch is associated with its final value. All
+// keys in the batch are hashed, and their target cells
+// prefetched, before any is inserted, and keys that
+// begin their search in the same page are inserted
+// under a single acquisition of the page lock.
+//
+// The batch is not atomic: concurrent operations may
+// observe some keys in the batch before others.
+//
+// Arguments:
+//  map    - pointer to an existing map instance
+//  keys   - the array of keys to insert
+//  values - the array of values to insert, one per key
+//  out    - optional array, of the same length as `keys`,
+//           through which the existing value replaced for
+//           each key is returned (NULL where none was)
+//  n_keys - the number of keys in the batch
+//
+// Returns:
+//  The number of keys that were inserted or updated
+size_t flat_map_insert_batch(
+    flat_map_t*      map,
+    const map_key_t* keys,
+    void* const*     values,
+    void**           out,
+    size_t           n_keys);
+
+// flat_map_find_batch()
+//
+// Search the map instance for a batch of keys.
+//
+// This function is reentrant and may be invoked
+// from multiple threads of execution concurrently.
+//
+// All keys in the batch are hashed, and their target
+// cells prefetched, before any is resolved, such that
+// the cache misses for the batch are overlapped. Keys
+// that begin their search in the same page are resolved
+// with a single optimistic read of the page.
+//
+// Arguments:
+//  map    - pointer to an existing map instance
+//  keys   - the array of keys for which to search
+//  values - the array, of the same length as `keys`,
+//           through which the value associated with each
+//           key is returned (NULL if it is not present)
+//  n_keys - the number of keys in the batch
+//
+// Returns:
+//  The number of keys that were found
+size_t flat_map_find_batch(
+    flat_map_t*      map,
+    const map_key_t* keys,
+    void**           values,
+    size_t           n_keys);
+
+// flat_map_iter_new()
+//
+// Construct a new iterator over the key / value
+// associations of the map.
+//
+// The iterator visits the map one page at a time: each
+// call to flat_map_iter_next() that exhausts the keys of
+// the previous page collects those of the next page under
+// the read lock of the page, and no lock is held between
+// calls. Iteration is therefore never blocked by, nor ever
+// blocks, concurrent operations on the map for longer than
+// the time to collect a single page, and the map may be
+// modified (including by the thread that iterates) while
+// an iteration is in progress.
+//
+// A key that is present for the whole of the iteration
+// is visited at least once, even if the map is resized
+// during the iteration, including while its keys are
+// migrated incrementally; it is visited more than once only
+// if the map is compacted into a smaller table. A key that
+// is inserted or removed during the iteration may or may
+// not be visited.
+//
+// Each iterator may only be used by a single thread.
+// Under FLAT_MAP_RECLAIM_DEFERRED, an iterator remains
+// within a read-side critical section until it is deleted
+// (see flat_map_enter()), so the thread must not call
+// flat_map_synchronize() while it holds an iterator.
+//
+// Arguments:
+//  map - pointer to an existing map instance
+//
+// Returns:
+//  A pointer to the newly constructed iterator on success
+//  NULL on failure
+flat_map_iter_t* flat_map_iter_new(flat_map_t* map);
+
+// flat_map_iter_delete()
+//
+// Destroy an existing iterator.
+//
+// Arguments:
+//  iter - pointer to an existing iterator
+void flat_map_iter_delete(flat_map_iter_t* iter);
+
+// flat_map_iter_next()
+//
+// Advance an iterator to the next key / value association.
+//
+// Arguments:
+//  iter  - pointer to an existing iterator
+//  key   - the out parameter through which the key is returned
+//  value - optional out parameter through which the value
+//          associated with the key is returned; under
+//          FLAT_MAP_RECLAIM_DEFERRED, the value remains valid
+//          until the next call to flat_map_iter_next() or
+//          flat_map_iter_delete()
+//
+// Returns:
+//  `true` if a key / value association is returned
+//  `false` once every page of the map has been visited,
+//  or if memory to collect a page could not be allocated
+bool flat_map_iter_next(
+    flat_map_iter_t* iter,
+    map_key_t*       key,
+    void**           value);
+
+// flat_map_parallel_for_each()
+//
+// Invoke a callback on each key / value association of
+// the map, dividing the pages of the map among threads.
+//
+// This function is reentrant and may be invoked
+// from multiple threads of execution concurrently.
+//
+// The pages of the map are divided into chunks that are
+// claimed dynamically by `n_threads` threads, one of which
+// is the calling thread; each thread visits the pages of a
+// chunk just as flat_map_iter_next() does, such that the
+// guarantees of an iterator apply to the keys visited. No
+// lock is held while the callback is invoked, so the
+// callback may perform any operation on the map other
+// than flat_map_synchronize() (e.g. remove the key that
+// it is visiting). Under FLAT_MAP_RECLAIM_DEFERRED, the
+// value passed to the callback remains valid until the
+// callback returns.
+//
+// Should a thread fail to start, the remaining threads
+// divide its share of the pages among themselves.
+//
+// Arguments:
+//  map       - pointer to an existing map instance
+//  n_threads - the number of threads that visit the map
+//  fn        - the callback invoked on each association,
+//              possibly from several threads at once
+//  ctx       - an arbitrary pointer passed through to `fn`
+//
+// Returns:
+//  `true` if every page of the map was visited
+//  `false` on invalid arguments, or if memory to collect
+//  a page could not be allocated
+bool flat_map_parallel_for_each(
+    flat_map_t*      map,
+    size_t           n_threads,
+    flat_map_visit_f fn,
+    void*            ctx);
+
+// flat_map_set_thread_node()
+//
+// Declare the NUMA node on which the calling thread runs.
+//
+// Lookups in a map under FLAT_MAP_NUMA_REPLICATE read the
+// replica on the node of the calling thread; by default,
+// this is the node of the processor on which the thread is
+// running at the time of the lookup. A thread that is bound
+// to the processors of a single node may declare the node
+// instead, which also allows a thread to read the replica
+// of any node on a machine with fewer nodes than the map.
+//
+// Arguments:
+//  node - the node of the calling thread, reduced modulo the
+//         number of nodes of each map; a negative value
+//         restores the default
+void flat_map_set_thread_node(int node);
+
 #endif
\ No newline at end of file
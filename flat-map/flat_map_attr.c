@@ -0,0 +1,79 @@
+// flat_map_attr.c
+// Flat map attribute specification.
+
+#include "flat_map_attr.h"
+
+#include <stdlib.h>
+
+static const size_t FLAT_MAP_ATTR_DEFAULT_PAGE_SIZE = 8;
+
+static void flat_map_attr_default_deleter(void* value);
+
+// ----------------------------------------------------------------------------
+// Exported
+
+flat_map_attr_t* flat_map_attr_new(void)
+{
+    flat_map_attr_t* attr = malloc(sizeof(flat_map_attr_t));
+    if (NULL == attr)
+    {
+        return NULL;
+    }
+
+    attr->page_size      = 0;
+    attr->expected_items = 0;
+    attr->deleter        = NULL;
+    attr->resize_policy  = FLAT_MAP_RESIZE_BLOCKING;
+    attr->probing        = FLAT_MAP_PROBING_LINEAR;
+    attr->layout         = FLAT_MAP_LAYOUT_SPLIT;
+    attr->memory         = FLAT_MAP_MEMORY_HEAP;
+    attr->lock_kind      = FLAT_MAP_LOCK_PTHREAD_RWLOCK;
+    attr->reclaim        = FLAT_MAP_RECLAIM_IMMEDIATE;
+    attr->control_bytes  = false;
+    attr->resize_threads = 1;
+    attr->numa           = FLAT_MAP_NUMA_NONE;
+    attr->numa_nodes     = 0;
+
+    return attr;
+}
+
+flat_map_attr_t* flat_map_attr_default(void)
+{
+    flat_map_attr_t* attr = malloc(sizeof(flat_map_attr_t));
+    if (NULL == attr)
+    {
+        return NULL;
+    }
+
+    attr->page_size      = FLAT_MAP_ATTR_DEFAULT_PAGE_SIZE;
+    attr->expected_items = 0;
+    attr->deleter        = flat_map_attr_default_deleter;
+    attr->resize_policy  = FLAT_MAP_RESIZE_BLOCKING;
+    attr->probing        = FLAT_MAP_PROBING_LINEAR;
+    attr->layout         = FLAT_MAP_LAYOUT_SPLIT;
+    attr->memory         = FLAT_MAP_MEMORY_HEAP;
+    attr->lock_kind      = FLAT_MAP_LOCK_PTHREAD_RWLOCK;
+    attr->reclaim        = FLAT_MAP_RECLAIM_IMMEDIATE;
+    attr->control_bytes  = false;
+    attr->resize_threads = 1;
+    attr->numa           = FLAT_MAP_NUMA_NONE;
+    attr->numa_nodes     = 0;
+
+    return attr;
+}
+
+void flat_map_attr_delete(flat_map_attr_t* attr)
+{
+    if (attr != NULL)
+    {
+        free(attr);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Internal
+
+static void flat_map_attr_default_deleter(void* value)
+{
+    free(value);
+}
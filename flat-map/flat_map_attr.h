@@ -0,0 +1,169 @@
+// flat_map_attr.h
+// Flat map attribute specification.
+
+#ifndef FLAT_MAP_ATTR_H
+#define FLAT_MAP_ATTR_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// The signature for user-provided delete function.
+typedef void (*deleter_f)(void*);
+
+// The policy the map follows when the internal table must grow.
+typedef enum flat_map_resize_policy
+{
+    // The entire table is rehashed at once, while
+    // all other operations on the map are excluded.
+    FLAT_MAP_RESIZE_BLOCKING,
+
+    // The previous and the new table are kept alive together,
+    // and pages are migrated to the new table in small chunks
+    // by subsequent insert and remove operations.
+    FLAT_MAP_RESIZE_INCREMENTAL
+} flat_map_resize_policy_t;
+
+// The scheme used to resolve collisions between keys.
+typedef enum flat_map_probing
+{
+    // Plain linear probing; removed keys leave tombstones
+    // that are only reclaimed when the table is resized.
+    FLAT_MAP_PROBING_LINEAR,
+
+    // Linear probing with the robin hood insertion policy;
+    // an inserted key displaces any key that is closer to its
+    // initial cell, and removals shift subsequent keys back
+    // into the vacated cell rather than leaving tombstones.
+    FLAT_MAP_PROBING_ROBIN_HOOD,
+
+    // Hopscotch hashing; every key resides within a small
+    // neighborhood of its initial cell, recorded in a bitmap
+    // per cell, which permits a higher maximum load factor.
+    FLAT_MAP_PROBING_HOPSCOTCH
+} flat_map_probing_t;
+
+// The arrangement of the internal table in memory.
+typedef enum flat_map_layout
+{
+    // Cells and page locks are stored in two separate arrays.
+    FLAT_MAP_LAYOUT_SPLIT,
+
+    // Each page is stored as a single block, aligned to a cache
+    // line, that holds the page lock followed by its cells.
+    FLAT_MAP_LAYOUT_PAGED
+} flat_map_layout_t;
+
+// The source of the memory that backs the internal table.
+typedef enum flat_map_memory
+{
+    // The table is allocated from the heap.
+    FLAT_MAP_MEMORY_HEAP,
+
+    // The table is mapped directly from the kernel, and
+    // large tables are advised to use transparent huge pages.
+    FLAT_MAP_MEMORY_MAPPED,
+
+    // The table is mapped from the pool of reserved huge
+    // pages, where available; otherwise, as if MAPPED.
+    FLAT_MAP_MEMORY_HUGETLB
+} flat_map_memory_t;
+
+// The implementation of the lock that serializes writers to a page.
+typedef enum flat_map_lock_kind
+{
+    // A pthreads reader-writer lock.
+    FLAT_MAP_LOCK_PTHREAD_RWLOCK,
+
+    // A test-and-test-and-set spinlock; shared acquisitions
+    // are exclusive, which only affects readers that fall back
+    // from optimistic reads under sustained contention.
+    FLAT_MAP_LOCK_SPINLOCK,
+
+    // A ticket spinlock, which grants the page to waiting
+    // threads in the order of their arrival; shared acquisitions
+    // are exclusive, as for FLAT_MAP_LOCK_SPINLOCK.
+    FLAT_MAP_LOCK_TICKET,
+
+    // The write-preferring reader-writer lock from sync/rwlock.h.
+    FLAT_MAP_LOCK_RWLOCK
+} flat_map_lock_kind_t;
+
+// The point at which values removed from the map are destroyed.
+typedef enum flat_map_reclaim
+{
+    // The deleter is invoked as soon as the value is removed
+    // or replaced; values returned by flat_map_find() must
+    // not be used once another thread may have removed them.
+    FLAT_MAP_RECLAIM_IMMEDIATE,
+
+    // The deleter is deferred until every read-side critical
+    // section, delimited by flat_map_enter() and flat_map_leave(),
+    // that began before the removal has ended.
+    FLAT_MAP_RECLAIM_DEFERRED
+} flat_map_reclaim_t;
+
+// The placement of tables across the NUMA nodes of the machine.
+typedef enum flat_map_numa
+{
+    // Memory is placed by the default policy of the kernel,
+    // on the node of the thread that first touches it.
+    FLAT_MAP_NUMA_NONE,
+
+    // The memory pages of each table are interleaved
+    // across the nodes in round-robin order.
+    FLAT_MAP_NUMA_INTERLEAVE,
+
+    // Each table is divided into one contiguous range of
+    // pages per node, each placed on its node.
+    FLAT_MAP_NUMA_PARTITION,
+
+    // The memory pages of each table are interleaved, and a
+    // read-only replica of the cells of each table is placed
+    // on every node; lookups read the replica on their own
+    // node, and writers propagate each modified page to all
+    // of the replicas.
+    FLAT_MAP_NUMA_REPLICATE
+} flat_map_numa_t;
+
+typedef struct flat_map_attr
+{
+    size_t                   page_size;
+    size_t                   expected_items;
+    deleter_f                deleter;
+    flat_map_resize_policy_t resize_policy;
+    flat_map_probing_t       probing;
+    flat_map_layout_t        layout;
+    flat_map_memory_t        memory;
+    flat_map_lock_kind_t     lock_kind;
+    flat_map_reclaim_t       reclaim;
+    bool                     control_bytes;
+    size_t                   resize_threads;
+    flat_map_numa_t          numa;
+    size_t                   numa_nodes;
+} flat_map_attr_t;
+
+// flat_map_attr_new()
+//
+// Construct a new attributes instance.
+//
+// The members of the returned attributes instance
+// are default-initialized to invalid values. When
+// this function is used to construct an attributes
+// structure that will be used to construct a new
+// map, the `page_size` and `deleter` members must be
+// set by the user prior to map construction, otherwise
+// construction of the map will fail.
+flat_map_attr_t* flat_map_attr_new(void);
+
+// flat_map_attr_default()
+//
+// Construct a new attributes instance with valid
+// defaults for all of the attribute members.
+flat_map_attr_t* flat_map_attr_default(void);
+
+// flat_map_attr_delete()
+//
+// Destroy an attributes instance.
+void flat_map_attr_delete(flat_map_attr_t* attr);
+
+#endif // FLAT_MAP_ATTR_H
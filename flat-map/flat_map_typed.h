@@ -0,0 +1,633 @@
+// flat_map_typed.h
+// A generator for concurrent open-addressing hashmaps
+// specialized at compile time for their key and value types.
+//
+// FLAT_MAP_DEFINE(name, K, V, hash_fn, eq_fn) defines the type
+// `name##_t` along with the functions that operate on it:
+//
+//  name##_t* name##_new(size_t page_size);
+//  void      name##_delete(name##_t* map);
+//  bool      name##_insert(name##_t* map, K key, V value);
+//  bool      name##_remove(name##_t* map, K key, V* value);
+//  bool      name##_find(name##_t* map, K key, V* value);
+//  bool      name##_contains(name##_t* map, K key);
+//  size_t    name##_size(name##_t* map);
+//
+// Whereas flat_map stores a `void*` to each value and hashes each
+// key through an out-of-line call, the generated map stores keys
+// and values by value in its cells, and expands `hash_fn` and
+// `eq_fn` inline at each of their uses. The generated map thus
+// suits small values that would otherwise each be allocated.
+//
+// `hash_fn` must accept a single K and produce a uint64_t, of
+// which every bit is well mixed; `eq_fn` must accept two keys and
+// determine if they are equal. Either may be a function or a
+// function-like macro. Every value of K is a valid key; the state
+// of each cell is recorded alongside its key. Lookups read pages
+// optimistically, and so `eq_fn` may be applied to a key that is
+// concurrently modified (the result is then discarded); it must
+// not dereference pointers held in the key.
+//
+// The organization of the generated map follows that of flat_map:
+// cells are organized into pages, each protected by a single
+// reader-writer lock and searched optimistically by lookups
+// under its version, collisions are resolved by linear probing,
+// and the entire table is rehashed at once, under an exclusive
+// map lock, once it reaches the maximum load factor. Removed keys
+// leave tombstones, which are reclaimed by the subsequent resize.
+//
+// All of the generated functions are reentrant and may be invoked
+// from multiple threads of execution concurrently, with the
+// exception of name##_delete(). Those functions that return a
+// `bool` return `false` on failure, including failure to allocate
+// or an absent key; name##_new() returns NULL on failure.
+//
+// Like flat_map.c, this header relies on GNU extensions to pthreads,
+// so _GNU_SOURCE must be defined before any system header is included.
+
+#ifndef FLAT_MAP_TYPED_H
+#define FLAT_MAP_TYPED_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+// The state of an individual cell in a generated map.
+#define FLAT_MAP_TYPED_EMPTY     0
+#define FLAT_MAP_TYPED_FULL      1
+#define FLAT_MAP_TYPED_TOMBSTONE 2
+
+// The outcome of an insertion into the table of a generated map.
+#define FLAT_MAP_TYPED_INSERT_FAILED  0
+#define FLAT_MAP_TYPED_INSERT_NEW     1
+#define FLAT_MAP_TYPED_INSERT_UPDATED 2
+
+// The maximum load factor for the table of a generated map.
+#define FLAT_MAP_TYPED_LOAD_FACTOR 0.75f
+
+// The initial capacity of a generated map, in cells.
+#define FLAT_MAP_TYPED_INITIAL_CAPACITY 16
+
+// The number of optimistic read attempts on a single page
+// before a reader falls back to the page lock.
+#define FLAT_MAP_TYPED_MAX_OPTIMISTIC_READS 16
+
+// flat_map_hash_u64()
+//
+// A hash function for 64-bit integer keys; the
+// finalizer of MurmurHash3 for 64-bit values.
+static inline uint64_t flat_map_hash_u64(uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDULL;
+    key ^= key >> 33;
+    key *= 0xC4CEB9FE1A85EC53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+// flat_map_eq_u64()
+//
+// An equality function for 64-bit integer keys.
+static inline bool flat_map_eq_u64(uint64_t a, uint64_t b)
+{
+    return a == b;
+}
+
+// determine if the given value is a power of 2.
+static inline bool flat_map_typed_is_power_of_two(size_t n)
+{
+    return (n != 0) && ((n & (n - 1)) == 0);
+}
+
+static inline bool flat_map_typed_need_resize(size_t occupied_cells, size_t capacity)
+{
+    return occupied_cells >= capacity*FLAT_MAP_TYPED_LOAD_FACTOR;
+}
+
+// the map lock prevents writer starvation, as in flat_map
+static inline bool flat_map_typed_initialize_map_lock(pthread_rwlock_t* lock)
+{
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+
+    const bool initialized = pthread_rwlock_init(lock, &attr) == 0;
+
+    pthread_rwlockattr_destroy(&attr);
+    return initialized;
+}
+
+// The lock for a single page of a generated map; as in flat_map,
+// the version (seqlock) allows readers to search the page without
+// writing shared memory, and is odd while the page is modified.
+typedef struct flat_map_typed_page_lock
+{
+    size_t           version;
+    pthread_rwlock_t lock;
+} flat_map_typed_page_lock_t;
+
+static inline flat_map_typed_page_lock_t* flat_map_typed_new_page_locks(size_t n_pages)
+{
+    flat_map_typed_page_lock_t* page_locks = malloc(n_pages*sizeof(flat_map_typed_page_lock_t));
+    if (NULL == page_locks)
+    {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < n_pages; ++i)
+    {
+        page_locks[i].version = 0;
+        pthread_rwlock_init(&page_locks[i].lock, NULL);
+    }
+
+    return page_locks;
+}
+
+static inline void flat_map_typed_destroy_page_locks(
+    flat_map_typed_page_lock_t* page_locks,
+    size_t                      n_pages)
+{
+    for (size_t i = 0; i < n_pages; ++i)
+    {
+        pthread_rwlock_destroy(&page_locks[i].lock);
+    }
+
+    free(page_locks);
+}
+
+static inline void flat_map_typed_lock_page_write(flat_map_typed_page_lock_t* lock)
+{
+    pthread_rwlock_wrlock(&lock->lock);
+
+    __atomic_store_n(&lock->version, lock->version + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void flat_map_typed_unlock_page_write(flat_map_typed_page_lock_t* lock)
+{
+    __atomic_store_n(&lock->version, lock->version + 1, __ATOMIC_RELEASE);
+
+    pthread_rwlock_unlock(&lock->lock);
+}
+
+// begin an optimistic read of a page; returns an odd
+// version if the page is currently being modified
+static inline size_t flat_map_typed_read_page_begin(flat_map_typed_page_lock_t* lock)
+{
+    return __atomic_load_n(&lock->version, __ATOMIC_ACQUIRE);
+}
+
+// determine if the page was left unmodified throughout an
+// optimistic read that began at the given version
+static inline bool flat_map_typed_read_page_validate(
+    flat_map_typed_page_lock_t* lock,
+    size_t                      version)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return (version & 1) == 0
+        && __atomic_load_n(&lock->version, __ATOMIC_RELAXED) == version;
+}
+
+// FLAT_MAP_DEFINE()
+//
+// Define a map type `name##_t` that associates keys of type `K`
+// with values of type `V`, and the functions that operate on it.
+//
+// Arguments:
+//  name    - the prefix for the generated type and functions
+//  K       - the key type
+//  V       - the value type
+//  hash_fn - the hash function for keys of type `K`
+//  eq_fn   - the equality function for keys of type `K`
+#define FLAT_MAP_DEFINE(name, K, V, hash_fn, eq_fn)                                 \
+                                                                                    \
+typedef struct name##_cell                                                          \
+{                                                                                   \
+    uint8_t state;                                                                  \
+    K       key;                                                                    \
+    V       value;                                                                  \
+} name##_cell_t;                                                                    \
+                                                                                    \
+typedef struct name##_table                                                         \
+{                                                                                   \
+    name##_cell_t*              cells;                                              \
+    flat_map_typed_page_lock_t* page_locks;                                         \
+    size_t                      n_pages;                                            \
+    size_t                      cells_per_page;                                     \
+} name##_table_t;                                                                   \
+                                                                                    \
+typedef struct name                                                                 \
+{                                                                                   \
+    /* The global map lock; held exclusively for resize only. */                    \
+    pthread_rwlock_t map_lock;                                                      \
+                                                                                    \
+    /* Only updated under exclusive map lock. */                                    \
+    name##_table_t* table;                                                          \
+                                                                                    \
+    /* Occupied cells, including tombstones, and live keys; */                      \
+    /* updated concurrently by operations under the shared map lock. */             \
+    size_t occupied_cells;                                                          \
+    size_t live_cells;                                                              \
+                                                                                    \
+    /* Static after map initialization. */                                          \
+    size_t cells_per_page;                                                          \
+} name##_t;                                                                         \
+                                                                                    \
+static inline name##_table_t* name##_new_table(size_t n_pages, size_t cells_per_page) \
+{                                                                                   \
+    name##_table_t* table = malloc(sizeof(name##_table_t));                         \
+    if (NULL == table)                                                              \
+    {                                                                               \
+        return NULL;                                                                \
+    }                                                                               \
+                                                                                    \
+    table->n_pages        = n_pages;                                                \
+    table->cells_per_page = cells_per_page;                                         \
+                                                                                    \
+    /* zeroed cells are empty */                                                    \
+    table->cells      = calloc(n_pages*cells_per_page, sizeof(name##_cell_t));      \
+    table->page_locks = flat_map_typed_new_page_locks(n_pages);                     \
+    if (NULL == table->cells || NULL == table->page_locks)                          \
+    {                                                                               \
+        free(table->cells);                                                         \
+        if (table->page_locks != NULL)                                              \
+        {                                                                           \
+            flat_map_typed_destroy_page_locks(table->page_locks, n_pages);          \
+        }                                                                           \
+        free(table);                                                                \
+        return NULL;                                                                \
+    }                                                                               \
+                                                                                    \
+    return table;                                                                   \
+}                                                                                   \
+                                                                                    \
+static inline void name##_destroy_table(name##_table_t* table)                      \
+{                                                                                   \
+    flat_map_typed_destroy_page_locks(table->page_locks, table->n_pages);           \
+    free(table->cells);                                                             \
+    free(table);                                                                    \
+}                                                                                   \
+                                                                                    \
+static inline name##_t* name##_new(size_t page_size)                                \
+{                                                                                   \
+    if (!flat_map_typed_is_power_of_two(page_size))                                 \
+    {                                                                               \
+        return NULL;                                                                \
+    }                                                                               \
+                                                                                    \
+    name##_t* map = malloc(sizeof(name##_t));                                       \
+    if (NULL == map)                                                                \
+    {                                                                               \
+        return NULL;                                                                \
+    }                                                                               \
+                                                                                    \
+    if (!flat_map_typed_initialize_map_lock(&map->map_lock))                        \
+    {                                                                               \
+        free(map);                                                                  \
+        return NULL;                                                                \
+    }                                                                               \
+                                                                                    \
+    const size_t n_pages = (FLAT_MAP_TYPED_INITIAL_CAPACITY > page_size)            \
+        ? FLAT_MAP_TYPED_INITIAL_CAPACITY / page_size                               \
+        : 1;                                                                        \
+                                                                                    \
+    map->table = name##_new_table(n_pages, page_size);                              \
+    if (NULL == map->table)                                                         \
+    {                                                                               \
+        pthread_rwlock_destroy(&map->map_lock);                                     \
+        free(map);                                                                  \
+        return NULL;                                                                \
+    }                                                                               \
+                                                                                    \
+    map->occupied_cells = 0;                                                        \
+    map->live_cells     = 0;                                                        \
+    map->cells_per_page = page_size;                                                \
+                                                                                    \
+    return map;                                                                     \
+}                                                                                   \
+                                                                                    \
+static inline void name##_delete(name##_t* map)                                     \
+{                                                                                   \
+    if (NULL == map)                                                                \
+    {                                                                               \
+        return;                                                                     \
+    }                                                                               \
+                                                                                    \
+    name##_destroy_table(map->table);                                               \
+    pthread_rwlock_destroy(&map->map_lock);                                         \
+    free(map);                                                                      \
+}                                                                                   \
+                                                                                    \
+/* insert or update `key` in `table`, beginning at the cell for `hash` */           \
+/* and locking each page in turn, exactly as flat_map does under plain */           \
+/* linear probing; keys are only ever inserted into empty cells */                  \
+static inline int name##_insert_into_table(                                         \
+    name##_table_t* table,                                                          \
+    uint64_t        hash,                                                           \
+    K               key,                                                            \
+    V               value,                                                          \
+    bool            locked)                                                         \
+{                                                                                   \
+    const size_t capacity = table->n_pages*table->cells_per_page;                   \
+                                                                                    \
+    size_t cell_index = (size_t)hash & (capacity - 1);                              \
+    size_t page_index = cell_index / table->cells_per_page;                         \
+                                                                                    \
+    for (size_t n_visited = 0; n_visited <= table->n_pages; ++n_visited)            \
+    {                                                                               \
+        int result     = FLAT_MAP_TYPED_INSERT_FAILED;                              \
+        bool completed = false;                                                     \
+                                                                                    \
+        if (locked)                                                                 \
+        {                                                                           \
+            flat_map_typed_lock_page_write(&table->page_locks[page_index]);         \
+        }                                                                           \
+                                                                                    \
+        const size_t end = (page_index + 1)*table->cells_per_page;                  \
+        for (size_t i = cell_index; i < end; ++i)                                   \
+        {                                                                           \
+            name##_cell_t* cell = &table->cells[i];                                 \
+            if (FLAT_MAP_TYPED_FULL == cell->state && eq_fn(cell->key, key))        \
+            {                                                                       \
+                cell->value = value;                                                \
+                result      = FLAT_MAP_TYPED_INSERT_UPDATED;                        \
+                completed   = true;                                                 \
+                break;                                                              \
+            }                                                                       \
+                                                                                    \
+            if (FLAT_MAP_TYPED_EMPTY == cell->state)                                \
+            {                                                                       \
+                cell->key   = key;                                                  \
+                cell->value = value;                                                \
+                cell->state = FLAT_MAP_TYPED_FULL;                                  \
+                result      = FLAT_MAP_TYPED_INSERT_NEW;                            \
+                completed   = true;                                                 \
+                break;                                                              \
+            }                                                                       \
+        }                                                                           \
+                                                                                    \
+        if (locked)                                                                 \
+        {                                                                           \
+            flat_map_typed_unlock_page_write(&table->page_locks[page_index]);       \
+        }                                                                           \
+                                                                                    \
+        if (completed)                                                              \
+        {                                                                           \
+            return result;                                                          \
+        }                                                                           \
+                                                                                    \
+        page_index = (page_index + 1) % table->n_pages;                             \
+        cell_index = page_index*table->cells_per_page;                              \
+    }                                                                               \
+                                                                                    \
+    return FLAT_MAP_TYPED_INSERT_FAILED;                                            \
+}                                                                                   \
+                                                                                    \
+/* search a single page for `key`, beginning at `cell_index`, and, */               \
+/* when `remove` is set, replace it with a tombstone; the value of */               \
+/* the key is copied out to `value`, if set; */                                     \
+/* returns `true` if the search is complete, having found either the */             \
+/* key or an empty cell, and `false` if it continues to the next page */            \
+static inline bool name##_search_page(                                              \
+    name##_table_t* table,                                                          \
+    size_t          page_index,                                                     \
+    size_t          cell_index,                                                     \
+    K               key,                                                            \
+    V*              value,                                                          \
+    bool            remove,                                                         \
+    bool*           found)                                                          \
+{                                                                                   \
+    const size_t end = (page_index + 1)*table->cells_per_page;                      \
+    for (size_t i = cell_index; i < end; ++i)                                       \
+    {                                                                               \
+        name##_cell_t* cell = &table->cells[i];                                     \
+        const uint8_t state = cell->state;                                          \
+        if (FLAT_MAP_TYPED_FULL == state && eq_fn(cell->key, key))                  \
+        {                                                                           \
+            if (value != NULL)                                                      \
+            {                                                                       \
+                *value = cell->value;                                               \
+            }                                                                       \
+            if (remove)                                                             \
+            {                                                                       \
+                cell->state = FLAT_MAP_TYPED_TOMBSTONE;                             \
+            }                                                                       \
+            *found = true;                                                          \
+            return true;                                                            \
+        }                                                                           \
+                                                                                    \
+        if (FLAT_MAP_TYPED_EMPTY == state)                                          \
+        {                                                                           \
+            return true;                                                            \
+        }                                                                           \
+    }                                                                               \
+                                                                                    \
+    return false;                                                                   \
+}                                                                                   \
+                                                                                    \
+/* locate `key` in `table` and, when `remove` is set, replace it with */            \
+/* a tombstone; otherwise, each page is first read optimistically */                \
+static inline bool name##_search_table(                                             \
+    name##_table_t* table,                                                          \
+    uint64_t        hash,                                                           \
+    K               key,                                                            \
+    V*              value,                                                          \
+    bool            remove)                                                         \
+{                                                                                   \
+    const size_t capacity = table->n_pages*table->cells_per_page;                   \
+                                                                                    \
+    size_t cell_index = (size_t)hash & (capacity - 1);                              \
+    size_t page_index = cell_index / table->cells_per_page;                         \
+                                                                                    \
+    for (size_t n_visited = 0; n_visited <= table->n_pages; ++n_visited)            \
+    {                                                                               \
+        flat_map_typed_page_lock_t* lock = &table->page_locks[page_index];          \
+                                                                                    \
+        bool found     = false;                                                     \
+        bool completed = false;                                                     \
+        bool validated = false;                                                     \
+                                                                                    \
+        if (!remove)                                                                \
+        {                                                                           \
+            for (size_t n = 0; n < FLAT_MAP_TYPED_MAX_OPTIMISTIC_READS && !validated; ++n) \
+            {                                                                       \
+                V copy;                                                             \
+                found = false;                                                      \
+                                                                                    \
+                const size_t version = flat_map_typed_read_page_begin(lock);        \
+                completed = name##_search_page(table, page_index, cell_index,       \
+                    key, &copy, false, &found);                                     \
+                validated = flat_map_typed_read_page_validate(lock, version);       \
+                                                                                    \
+                if (validated && found && value != NULL)                            \
+                {                                                                   \
+                    *value = copy;                                                  \
+                }                                                                   \
+            }                                                                       \
+        }                                                                           \
+                                                                                    \
+        if (!validated)                                                             \
+        {                                                                           \
+            found = false;                                                          \
+            if (remove)                                                             \
+            {                                                                       \
+                flat_map_typed_lock_page_write(lock);                               \
+                completed = name##_search_page(table, page_index, cell_index,       \
+                    key, value, true, &found);                                      \
+                flat_map_typed_unlock_page_write(lock);                             \
+            }                                                                       \
+            else                                                                    \
+            {                                                                       \
+                pthread_rwlock_rdlock(&lock->lock);                                 \
+                completed = name##_search_page(table, page_index, cell_index,       \
+                    key, value, false, &found);                                     \
+                pthread_rwlock_unlock(&lock->lock);                                 \
+            }                                                                       \
+        }                                                                           \
+                                                                                    \
+        if (completed)                                                              \
+        {                                                                           \
+            return found;                                                           \
+        }                                                                           \
+                                                                                    \
+        page_index = (page_index + 1) % table->n_pages;                             \
+        cell_index = page_index*table->cells_per_page;                              \
+    }                                                                               \
+                                                                                    \
+    return false;                                                                   \
+}                                                                                   \
+                                                                                    \
+/* replace the table with one into which the live keys are rehashed; */             \
+/* the new table is the same size as the current table when at least */             \
+/* half of the occupied cells are tombstones, and double it otherwise */            \
+static inline bool name##_resize(name##_t* map, name##_table_t* observed)           \
+{                                                                                   \
+    pthread_rwlock_wrlock(&map->map_lock);                                          \
+                                                                                    \
+    name##_table_t* table = map->table;                                             \
+    if (table != observed)                                                          \
+    {                                                                               \
+        /* race for resize operation occurred, and we lost */                       \
+        pthread_rwlock_unlock(&map->map_lock);                                      \
+        return true;                                                                \
+    }                                                                               \
+                                                                                    \
+    const size_t capacity = table->n_pages*table->cells_per_page;                   \
+    const size_t n_pages  = flat_map_typed_need_resize(2*(map->live_cells + 1), capacity) \
+        ? table->n_pages << 1                                                       \
+        : table->n_pages;                                                           \
+                                                                                    \
+    name##_table_t* resized = name##_new_table(n_pages, table->cells_per_page);     \
+    if (NULL == resized)                                                            \
+    {                                                                               \
+        pthread_rwlock_unlock(&map->map_lock);                                      \
+        return false;                                                               \
+    }                                                                               \
+                                                                                    \
+    /* with exclusive access, cells are placed without the page locks */            \
+    for (size_t i = 0; i < capacity; ++i)                                           \
+    {                                                                               \
+        name##_cell_t* cell = &table->cells[i];                                     \
+        if (FLAT_MAP_TYPED_FULL == cell->state)                                     \
+        {                                                                           \
+            name##_insert_into_table(resized,                                       \
+                hash_fn(cell->key), cell->key, cell->value, false);                 \
+        }                                                                           \
+    }                                                                               \
+                                                                                    \
+    map->table          = resized;                                                  \
+    map->occupied_cells = map->live_cells;                                          \
+                                                                                    \
+    pthread_rwlock_unlock(&map->map_lock);                                          \
+                                                                                    \
+    name##_destroy_table(table);                                                    \
+    return true;                                                                    \
+}                                                                                   \
+                                                                                    \
+static inline bool name##_insert(name##_t* map, K key, V value)                     \
+{                                                                                   \
+    if (NULL == map)                                                                \
+    {                                                                               \
+        return false;                                                               \
+    }                                                                               \
+                                                                                    \
+    const uint64_t hash = hash_fn(key);                                             \
+                                                                                    \
+    pthread_rwlock_rdlock(&map->map_lock);                                          \
+                                                                                    \
+    name##_table_t* table = map->table;                                             \
+    const size_t occupied = __atomic_load_n(&map->occupied_cells, __ATOMIC_RELAXED); \
+    if (flat_map_typed_need_resize(occupied + 1, table->n_pages*table->cells_per_page)) \
+    {                                                                               \
+        pthread_rwlock_unlock(&map->map_lock);                                      \
+        if (!name##_resize(map, table))                                             \
+        {                                                                           \
+            return false;                                                           \
+        }                                                                           \
+        pthread_rwlock_rdlock(&map->map_lock);                                      \
+    }                                                                               \
+                                                                                    \
+    const int result = name##_insert_into_table(map->table, hash, key, value, true); \
+    if (FLAT_MAP_TYPED_INSERT_NEW == result)                                        \
+    {                                                                               \
+        __atomic_fetch_add(&map->occupied_cells, 1, __ATOMIC_RELAXED);              \
+        __atomic_fetch_add(&map->live_cells, 1, __ATOMIC_RELAXED);                  \
+    }                                                                               \
+                                                                                    \
+    pthread_rwlock_unlock(&map->map_lock);                                          \
+                                                                                    \
+    return result != FLAT_MAP_TYPED_INSERT_FAILED;                                  \
+}                                                                                   \
+                                                                                    \
+static inline bool name##_remove(name##_t* map, K key, V* value)                    \
+{                                                                                   \
+    if (NULL == map)                                                                \
+    {                                                                               \
+        return false;                                                               \
+    }                                                                               \
+                                                                                    \
+    const uint64_t hash = hash_fn(key);                                             \
+                                                                                    \
+    pthread_rwlock_rdlock(&map->map_lock);                                          \
+                                                                                    \
+    const bool removed = name##_search_table(map->table, hash, key, value, true);   \
+    if (removed)                                                                    \
+    {                                                                               \
+        __atomic_fetch_sub(&map->live_cells, 1, __ATOMIC_RELAXED);                  \
+    }                                                                               \
+                                                                                    \
+    pthread_rwlock_unlock(&map->map_lock);                                          \
+                                                                                    \
+    return removed;                                                                 \
+}                                                                                   \
+                                                                                    \
+static inline bool name##_find(name##_t* map, K key, V* value)                      \
+{                                                                                   \
+    if (NULL == map)                                                                \
+    {                                                                               \
+        return false;                                                               \
+    }                                                                               \
+                                                                                    \
+    const uint64_t hash = hash_fn(key);                                             \
+                                                                                    \
+    pthread_rwlock_rdlock(&map->map_lock);                                          \
+    const bool found = name##_search_table(map->table, hash, key, value, false);    \
+    pthread_rwlock_unlock(&map->map_lock);                                          \
+                                                                                    \
+    return found;                                                                   \
+}                                                                                   \
+                                                                                    \
+static inline bool name##_contains(name##_t* map, K key)                            \
+{                                                                                   \
+    return name##_find(map, key, NULL);                                             \
+}                                                                                   \
+                                                                                    \
+static inline size_t name##_size(name##_t* map)                                     \
+{                                                                                   \
+    return (NULL == map) ? 0 : __atomic_load_n(&map->live_cells, __ATOMIC_RELAXED); \
+}
+
+#endif // FLAT_MAP_TYPED_H
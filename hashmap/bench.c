@@ -0,0 +1,353 @@
+// bench.c
+// Benchmarks for the chaining hashmap.
+//
+// The allocator benchmark measures the throughput of inserts and
+// removes issued by a range of thread counts, each thread inserting
+// and then removing keys of its own, under each item allocator.
+//
+// The engine benchmark runs the same workload under each engine,
+// along with the longest stall of a single insert, which under the
+// locked engine is that of the largest resize.
+//
+// The growth benchmark populates a map from its initial size under
+// each growth of the locked engine, and reports the latency
+// percentiles of the inserts, which under doubling growth include
+// those of the inserts that rehash the map.
+//
+// The locking benchmark runs the workload of the allocator benchmark
+// on the locked engine with a lock in each bucket and with the locks
+// striped, whose smaller buckets make each resize cheaper.
+//
+// The lookup benchmark finds string keys, half of them present,
+// in a scattered order in maps of several load factors; the
+// comparator of string keys is called only for the key found.
+
+#define _GNU_SOURCE
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "hashmap.h"
+
+// The number of keys inserted and removed by each thread per round.
+#define N_THREAD_KEYS (1 << 14)
+
+// The number of rounds issued by each thread.
+#define N_ROUNDS 32
+
+// The number of keys inserted by the growth benchmark.
+#define N_GROWTH_KEYS (1 << 22)
+
+// The number of string keys inserted by the lookup benchmark,
+// and the number of bytes in each.
+#define N_LOOKUP_KEYS (1 << 20)
+#define LOOKUP_KEY_SIZE 48
+
+typedef struct worker_arg
+{
+    hashmap_t* map;
+    size_t     id;
+    uint64_t   max_stall;
+} worker_arg_t;
+
+static void bench_allocator(const char* label, hashmap_allocator_t allocator, size_t n_threads);
+static void bench_engine(const char* label, hashmap_engine_t engine, size_t n_threads);
+static void bench_growth(const char* label, hashmap_growth_t growth);
+static void bench_locking(const char* label, hashmap_locking_t locking, size_t n_threads);
+static void bench_lookup(float load_factor);
+static double run_workers(hashmap_t* map, size_t n_threads, uint64_t* max_stall);
+static void* allocator_worker(void* arg);
+static uint64_t now_ns(void);
+static int compare_u64(const void* a, const void* b);
+static void nop_deleter(void* value);
+static bool string_comparator(void* key_a, void* key_b);
+static size_t string_keylen(void* key);
+
+int main(void)
+{
+    const size_t thread_counts[] = { 1, 2, 4, 8, 16 };
+    for (size_t i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); ++i)
+    {
+        bench_allocator("malloc", HASHMAP_ALLOCATOR_MALLOC, thread_counts[i]);
+        bench_allocator("slab", HASHMAP_ALLOCATOR_SLAB, thread_counts[i]);
+    }
+
+    for (size_t i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); ++i)
+    {
+        bench_engine("locked", HASHMAP_ENGINE_LOCKED, thread_counts[i]);
+        bench_engine("split", HASHMAP_ENGINE_SPLIT_ORDERED, thread_counts[i]);
+    }
+
+    bench_growth("doubling", HASHMAP_GROWTH_DOUBLING);
+    bench_growth("linear", HASHMAP_GROWTH_LINEAR);
+
+    for (size_t i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); ++i)
+    {
+        bench_locking("bucket", HASHMAP_LOCKING_BUCKET, thread_counts[i]);
+        bench_locking("striped", HASHMAP_LOCKING_STRIPED, thread_counts[i]);
+    }
+
+    bench_lookup(0.75f);
+    bench_lookup(2.0f);
+    bench_lookup(4.0f);
+
+    return EXIT_SUCCESS;
+}
+
+static void bench_allocator(const char* label, hashmap_allocator_t allocator, size_t n_threads)
+{
+    hashmap_attr_t* attr = hashmap_attr_default();
+    attr->value_deleter = nop_deleter;
+    attr->allocator     = allocator;
+
+    hashmap_t* map = hashmap_new_with_attr(attr);
+    hashmap_attr_delete(attr);
+    if (NULL == map)
+    {
+        fprintf(stderr, "failed to construct map\n");
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t max_stall;
+    const double mops = run_workers(map, n_threads, &max_stall);
+
+    printf("allocator %-6s  threads %2zu  %7.2f Mops/s\n", label, n_threads, mops);
+
+    hashmap_delete(map);
+}
+
+static void bench_engine(const char* label, hashmap_engine_t engine, size_t n_threads)
+{
+    hashmap_attr_t* attr = hashmap_attr_default();
+    attr->value_deleter = nop_deleter;
+    attr->engine        = engine;
+
+    hashmap_t* map = hashmap_new_with_attr(attr);
+    hashmap_attr_delete(attr);
+    if (NULL == map)
+    {
+        fprintf(stderr, "failed to construct map\n");
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t max_stall;
+    const double mops = run_workers(map, n_threads, &max_stall);
+
+    printf("engine %-6s  threads %2zu  %7.2f Mops/s  max stall %8.1f us\n", 
+        label, n_threads, mops, (double)max_stall / 1e3);
+
+    hashmap_delete(map);
+}
+
+static void bench_growth(const char* label, hashmap_growth_t growth)
+{
+    hashmap_attr_t* attr = hashmap_attr_default();
+    attr->value_deleter = nop_deleter;
+    attr->growth        = growth;
+
+    hashmap_t* map = hashmap_new_with_attr(attr);
+    hashmap_attr_delete(attr);
+    if (NULL == map)
+    {
+        fprintf(stderr, "failed to construct map\n");
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t* samples = malloc(N_GROWTH_KEYS*sizeof(uint64_t));
+
+    const uint64_t begin = now_ns();
+    for (size_t k = 1; k <= N_GROWTH_KEYS; ++k)
+    {
+        const uint64_t start = now_ns();
+        hashmap_insert(map, (void*)k, (void*)1, NULL);
+        samples[k - 1] = now_ns() - start;
+    }
+
+    const double seconds = (double)(now_ns() - begin) / 1e9;
+
+    qsort(samples, N_GROWTH_KEYS, sizeof(uint64_t), compare_u64);
+
+    printf("growth %-8s  %6.2f s  p50 %5lu ns  p99.9 %7lu ns  max %10lu ns\n",
+        label, 
+        seconds,
+        samples[N_GROWTH_KEYS / 2],
+        samples[N_GROWTH_KEYS - N_GROWTH_KEYS / 1000],
+        samples[N_GROWTH_KEYS - 1]);
+
+    free(samples);
+    hashmap_delete(map);
+}
+
+static void bench_locking(const char* label, hashmap_locking_t locking, size_t n_threads)
+{
+    hashmap_attr_t* attr = hashmap_attr_default();
+    attr->value_deleter = nop_deleter;
+    attr->allocator     = HASHMAP_ALLOCATOR_SLAB;
+    attr->locking       = locking;
+
+    hashmap_t* map = hashmap_new_with_attr(attr);
+    hashmap_attr_delete(attr);
+    if (NULL == map)
+    {
+        fprintf(stderr, "failed to construct map\n");
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t max_stall;
+    const double mops = run_workers(map, n_threads, &max_stall);
+
+    printf("locking %-7s  threads %2zu  %7.2f Mops/s  max stall %8.1f us\n", 
+        label, n_threads, mops, (double)max_stall / 1e3);
+
+    hashmap_delete(map);
+}
+
+static void bench_lookup(float load_factor)
+{
+    hashmap_attr_t* attr = hashmap_attr_default();
+    attr->value_deleter  = nop_deleter;
+    attr->key_is_literal = false;
+    attr->comparator     = string_comparator;
+    attr->keylen         = string_keylen;
+    attr->load_factor    = load_factor;
+
+    hashmap_t* map = hashmap_new_with_attr(attr);
+    hashmap_attr_delete(attr);
+    if (NULL == map)
+    {
+        fprintf(stderr, "failed to construct map\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // keys share a long prefix, as do paths or URLs, such
+    // that each comparison reads most of both keys
+    char* keys = malloc((size_t)2*N_LOOKUP_KEYS*LOOKUP_KEY_SIZE);
+    for (size_t i = 0; i < 2*N_LOOKUP_KEYS; ++i)
+    {
+        snprintf(keys + i*LOOKUP_KEY_SIZE, LOOKUP_KEY_SIZE, 
+            "/containers/hashmap/bench/lookup/%012zu", i);
+    }
+
+    for (size_t i = 0; i < N_LOOKUP_KEYS; ++i)
+    {
+        hashmap_insert(map, keys + i*LOOKUP_KEY_SIZE, (void*)1, NULL);
+    }
+
+    // an odd stride visits every key in a scattered order
+    size_t n_found = 0;
+
+    const uint64_t start = now_ns();
+    for (size_t i = 0; i < 2*N_LOOKUP_KEYS; ++i)
+    {
+        const size_t k = (i*7919) & (2*N_LOOKUP_KEYS - 1);
+        n_found += (hashmap_find(map, keys + k*LOOKUP_KEY_SIZE) != NULL);
+    }
+
+    const double seconds = (double)(now_ns() - start) / 1e9;
+
+    if (n_found != N_LOOKUP_KEYS)
+    {
+        fprintf(stderr, "found %zu of %d keys\n", n_found, N_LOOKUP_KEYS);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("lookup load factor %4.2f  %7.2f Mops/s\n", 
+        load_factor, 2*N_LOOKUP_KEYS / seconds / 1e6);
+
+    hashmap_delete(map);
+    free(keys);
+}
+
+// Run the workers against the map, and report the throughput
+// in Mops/s and the longest stall of any insert.
+static double run_workers(hashmap_t* map, size_t n_threads, uint64_t* max_stall)
+{
+    pthread_t*    threads = malloc(n_threads*sizeof(pthread_t));
+    worker_arg_t* args    = malloc(n_threads*sizeof(worker_arg_t));
+
+    const uint64_t start = now_ns();
+
+    for (size_t i = 0; i < n_threads; ++i)
+    {
+        args[i].map       = map;
+        args[i].id        = i;
+        args[i].max_stall = 0;
+        pthread_create(&threads[i], NULL, allocator_worker, &args[i]);
+    }
+
+    *max_stall = 0;
+    for (size_t i = 0; i < n_threads; ++i)
+    {
+        pthread_join(threads[i], NULL);
+        if (args[i].max_stall > *max_stall)
+        {
+            *max_stall = args[i].max_stall;
+        }
+    }
+
+    const double seconds = (double)(now_ns() - start) / 1e9;
+
+    free(threads);
+    free(args);
+
+    return (double)n_threads*N_ROUNDS*N_THREAD_KEYS*2 / seconds / 1e6;
+}
+
+static void* allocator_worker(void* arg)
+{
+    worker_arg_t* worker = (worker_arg_t*)arg;
+
+    const size_t begin = worker->id*N_THREAD_KEYS + 1;
+    for (size_t round = 0; round < N_ROUNDS; ++round)
+    {
+        for (size_t k = begin; k < begin + N_THREAD_KEYS; ++k)
+        {
+            const uint64_t start = now_ns();
+            hashmap_insert(worker->map, (void*)k, (void*)1, NULL);
+
+            const uint64_t stall = now_ns() - start;
+            if (stall > worker->max_stall)
+            {
+                worker->max_stall = stall;
+            }
+        }
+
+        for (size_t k = begin; k < begin + N_THREAD_KEYS; ++k)
+        {
+            hashmap_remove(worker->map, (void*)k);
+        }
+    }
+
+    return NULL;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int compare_u64(const void* a, const void* b)
+{
+    const uint64_t x = *(const uint64_t*)a;
+    const uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void nop_deleter(void* value)
+{
+    return;
+}
+
+static bool string_comparator(void* key_a, void* key_b)
+{
+    return 0 == strcmp((const char*)key_a, (const char*)key_b);
+}
+
+static size_t string_keylen(void* key)
+{
+    return strlen((const char*)key);
+}
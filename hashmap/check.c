@@ -5,7 +5,9 @@
 #pragma GCC diagnostic ignored "-Wignored-attributes"
 
 #include <check.h>
+#include <sched.h>
 #include <stdlib.h>
+#include <pthread.h>
 
 #include "hashmap.h"
 
@@ -18,20 +20,241 @@ typedef struct point
     float y;
 } point_t;
 
-// static point_t* make_point(float x, float y)
-// {
-//     point_t* p = malloc(sizeof(point_t));
-//     p->x = x;
-//     p->y = y;
+// The number of keys inserted by the tests.
+#define N_KEYS 4096
 
-//     return p;
-// }
+// The number of threads in the concurrent tests.
+#define N_THREADS 4
 
-// static void delete_point(void* p)
-// {
-//     point_t* as_point = (point_t*)p;
-//     free(as_point);
-// }
+// The number of rounds of the churn threads.
+#define N_CHURN_ROUNDS 8
+
+// The number of maps with slab allocators alive at once,
+// more than the number of thread-specific data keys.
+#define N_MAPS 2048
+
+// A configuration of the map under test.
+typedef struct config
+{
+    hashmap_allocator_t allocator;
+    hashmap_engine_t    engine;
+    hashmap_growth_t    growth;
+    hashmap_locking_t   locking;
+    size_t              lock_stripes;
+} config_t;
+
+// The striped configurations use few stripes, such that
+// buckets, and the two buckets of a split, share locks.
+static const config_t CONFIGS[] = {
+    { HASHMAP_ALLOCATOR_MALLOC, HASHMAP_ENGINE_LOCKED,        HASHMAP_GROWTH_DOUBLING, HASHMAP_LOCKING_BUCKET,  0 },
+    { HASHMAP_ALLOCATOR_SLAB,   HASHMAP_ENGINE_LOCKED,        HASHMAP_GROWTH_DOUBLING, HASHMAP_LOCKING_BUCKET,  0 },
+    { HASHMAP_ALLOCATOR_SLAB,   HASHMAP_ENGINE_LOCKED,        HASHMAP_GROWTH_LINEAR,   HASHMAP_LOCKING_BUCKET,  0 },
+    { HASHMAP_ALLOCATOR_SLAB,   HASHMAP_ENGINE_LOCKED,        HASHMAP_GROWTH_DOUBLING, HASHMAP_LOCKING_STRIPED, 4 },
+    { HASHMAP_ALLOCATOR_SLAB,   HASHMAP_ENGINE_LOCKED,        HASHMAP_GROWTH_LINEAR,   HASHMAP_LOCKING_STRIPED, 4 },
+    { HASHMAP_ALLOCATOR_MALLOC, HASHMAP_ENGINE_SPLIT_ORDERED, HASHMAP_GROWTH_DOUBLING, HASHMAP_LOCKING_BUCKET,  0 },
+    { HASHMAP_ALLOCATOR_SLAB,   HASHMAP_ENGINE_SPLIT_ORDERED, HASHMAP_GROWTH_DOUBLING, HASHMAP_LOCKING_BUCKET,  0 }
+};
+
+#define N_CONFIGS (sizeof(CONFIGS) / sizeof(CONFIGS[0]))
+
+typedef struct thread_arg
+{
+    hashmap_t* map;
+    size_t     id;
+    bool*      stop;
+} thread_arg_t;
+
+// The number of calls to the counting comparator.
+static size_t n_comparisons = 0;
+
+static bool counting_comparator(void* key_a, void* key_b)
+{
+    __atomic_add_fetch(&n_comparisons, 1, __ATOMIC_RELAXED);
+    return key_a == key_b;
+}
+
+static point_t* make_point(float x, float y)
+{
+    point_t* p = malloc(sizeof(point_t));
+    p->x = x;
+    p->y = y;
+
+    return p;
+}
+
+static hashmap_t* new_map(const config_t* config)
+{
+    hashmap_attr_t* attr = hashmap_attr_default();
+    attr->allocator    = config->allocator;
+    attr->engine       = config->engine;
+    attr->growth       = config->growth;
+    attr->locking      = config->locking;
+    attr->lock_stripes = config->lock_stripes;
+
+    hashmap_t* map = hashmap_new_with_attr(attr);
+    hashmap_attr_delete(attr);
+
+    return map;
+}
+
+// Insert the keys in the range of the thread.
+static void* insert_range(void* arg)
+{
+    thread_arg_t* thread = (thread_arg_t*)arg;
+
+    const size_t begin = thread->id*(N_KEYS / N_THREADS) + 1;
+    for (size_t k = begin; k < begin + N_KEYS / N_THREADS; ++k)
+    {
+        ck_assert(hashmap_insert(thread->map, (void*)k, make_point((float)k, 0.0f), NULL));
+    }
+
+    return NULL;
+}
+
+// Remove the keys in the range of the next thread, which were
+// allocated by another thread.
+static void* remove_range(void* arg)
+{
+    thread_arg_t* thread = (thread_arg_t*)arg;
+
+    const size_t begin = ((thread->id + 1) % N_THREADS)*(N_KEYS / N_THREADS) + 1;
+    for (size_t k = begin; k < begin + N_KEYS / N_THREADS; ++k)
+    {
+        ck_assert(hashmap_remove(thread->map, (void*)k));
+    }
+
+    return NULL;
+}
+
+// Insert and remove keys beyond those of the tests, growing the map,
+// and replace the values of the keys of the tests.
+static void* churn_keys(void* arg)
+{
+    thread_arg_t* thread = (thread_arg_t*)arg;
+
+    const size_t begin = N_KEYS + thread->id*N_KEYS + 1;
+    for (size_t round = 0; round < N_CHURN_ROUNDS; ++round)
+    {
+        for (size_t k = begin; k < begin + N_KEYS; ++k)
+        {
+            ck_assert(hashmap_insert(thread->map, (void*)k, make_point((float)k, 0.0f), NULL));
+        }
+
+        for (size_t k = thread->id + 1; k <= N_KEYS; k += N_THREADS)
+        {
+            ck_assert(hashmap_insert(thread->map, (void*)k, make_point((float)k, 0.0f), NULL));
+        }
+
+        for (size_t k = begin; k < begin + N_KEYS; ++k)
+        {
+            ck_assert(hashmap_remove(thread->map, (void*)k));
+        }
+    }
+
+    return NULL;
+}
+
+// Find the keys of the tests until stopped.
+static void* find_keys(void* arg)
+{
+    thread_arg_t* thread = (thread_arg_t*)arg;
+
+    while (!__atomic_load_n(thread->stop, __ATOMIC_ACQUIRE))
+    {
+        for (size_t k = 1; k <= N_KEYS; ++k)
+        {
+            ck_assert(hashmap_contains(thread->map, (void*)k));
+        }
+    }
+
+    return NULL;
+}
+
+// Use the map, then, once the map has been replaced, use
+// the new one; the thread holds a cache of the first map's
+// allocator when it is deleted.
+static void* outlive_map(void* arg)
+{
+    thread_arg_t* thread = (thread_arg_t*)arg;
+
+    ck_assert(hashmap_insert(thread->map, (void*)1, make_point(1.0f, 0.0f), NULL));
+    __atomic_store_n(thread->stop, true, __ATOMIC_RELEASE);
+
+    while (__atomic_load_n(thread->stop, __ATOMIC_ACQUIRE))
+    {
+        sched_yield();
+    }
+
+    ck_assert(hashmap_insert(thread->map, (void*)1, make_point(1.0f, 0.0f), NULL));
+    ck_assert(hashmap_remove(thread->map, (void*)1));
+
+    return NULL;
+}
+
+static void run_threads(hashmap_t* map, void* (*fn)(void*))
+{
+    pthread_t    threads[N_THREADS];
+    thread_arg_t args[N_THREADS];
+
+    for (size_t i = 0; i < N_THREADS; ++i)
+    {
+        args[i] = (thread_arg_t){ .map = map, .id = i };
+        ck_assert(0 == pthread_create(&threads[i], NULL, fn, &args[i]));
+    }
+
+    for (size_t i = 0; i < N_THREADS; ++i)
+    {
+        ck_assert(0 == pthread_join(threads[i], NULL));
+    }
+}
+
+// Find stable keys while other threads grow the map
+// and replace the values of the stable keys.
+static void check_growth(const config_t* config)
+{
+    hashmap_t* map = new_map(config);
+    ck_assert(map != NULL);
+
+    for (size_t k = 1; k <= N_KEYS; ++k)
+    {
+        ck_assert(hashmap_insert(map, (void*)k, make_point((float)k, 0.0f), NULL));
+    }
+
+    // readers find every key while the map grows
+    // and the values of the keys are replaced
+    bool stop = false;
+
+    pthread_t    readers[N_THREADS];
+    thread_arg_t reader_args[N_THREADS];
+    for (size_t i = 0; i < N_THREADS; ++i)
+    {
+        reader_args[i] = (thread_arg_t){ .map = map, .id = i, .stop = &stop };
+        ck_assert(0 == pthread_create(&readers[i], NULL, find_keys, &reader_args[i]));
+    }
+
+    run_threads(map, churn_keys);
+
+    __atomic_store_n(&stop, true, __ATOMIC_RELEASE);
+    for (size_t i = 0; i < N_THREADS; ++i)
+    {
+        ck_assert(0 == pthread_join(readers[i], NULL));
+    }
+
+    for (size_t k = 1; k <= (N_THREADS + 1)*N_KEYS; ++k)
+    {
+        ck_assert(hashmap_contains(map, (void*)k) == (k <= N_KEYS));
+    }
+
+    void* replaced;
+    point_t* p = make_point(0.0f, 0.0f);
+    ck_assert(hashmap_insert(map, (void*)1, p, &replaced));
+    ck_assert(replaced != NULL);
+    ck_assert(((point_t*)replaced)->x == 1.0f);
+    ck_assert(hashmap_find(map, (void*)1) == p);
+    free(replaced);
+
+    hashmap_delete(map);
+}
 
 // ----------------------------------------------------------------------------
 // Test Cases
@@ -45,6 +268,196 @@ START_TEST(test_hashmap_new)
 }
 END_TEST
 
+START_TEST(test_hashmap_allocators)
+{
+    for (size_t i = 0; i < N_CONFIGS; ++i)
+    {
+        hashmap_t* map = new_map(&CONFIGS[i]);
+        ck_assert(map != NULL);
+
+        for (size_t k = 1; k <= N_KEYS; ++k)
+        {
+            ck_assert(hashmap_insert(map, (void*)k, make_point((float)k, 0.0f), NULL));
+        }
+
+        for (size_t k = 1; k <= N_KEYS; k += 2)
+        {
+            ck_assert(hashmap_remove(map, (void*)k));
+            ck_assert(!hashmap_remove(map, (void*)k));
+        }
+
+        // reinsertion reuses the items that were removed
+        for (size_t k = 1; k <= N_KEYS; k += 4)
+        {
+            ck_assert(hashmap_insert(map, (void*)k, make_point((float)k, 0.0f), NULL));
+        }
+
+        for (size_t k = 1; k <= N_KEYS; ++k)
+        {
+            point_t* p = (point_t*)hashmap_find(map, (void*)k);
+            if (k % 4 == 3)
+            {
+                ck_assert(NULL == p);
+            }
+            else
+            {
+                ck_assert(p != NULL);
+                ck_assert(p->x == (float)k);
+            }
+        }
+
+        hashmap_delete(map);
+    }
+}
+END_TEST
+
+START_TEST(test_hashmap_many_maps)
+{
+    hashmap_t** maps = malloc(N_MAPS*sizeof(hashmap_t*));
+    ck_assert(maps != NULL);
+
+    for (size_t i = 0; i < N_MAPS; ++i)
+    {
+        maps[i] = new_map(&CONFIGS[1]);
+        ck_assert(maps[i] != NULL);
+        ck_assert(hashmap_insert(maps[i], (void*)1, make_point(1.0f, 0.0f), NULL));
+    }
+
+    for (size_t i = 0; i < N_MAPS; ++i)
+    {
+        ck_assert(hashmap_find(maps[i], (void*)1) != NULL);
+        hashmap_delete(maps[i]);
+    }
+
+    free(maps);
+
+    // a map may be deleted while other threads hold
+    // caches of its allocator, and those threads continue
+    bool         replaced = false;
+    thread_arg_t arg      = { .map = new_map(&CONFIGS[1]), .id = 0, .stop = &replaced };
+    ck_assert(arg.map != NULL);
+
+    pthread_t thread;
+    ck_assert(0 == pthread_create(&thread, NULL, outlive_map, &arg));
+
+    while (!__atomic_load_n(&replaced, __ATOMIC_ACQUIRE))
+    {
+        sched_yield();
+    }
+
+    hashmap_delete(arg.map);
+    arg.map = new_map(&CONFIGS[1]);
+    ck_assert(arg.map != NULL);
+    __atomic_store_n(&replaced, false, __ATOMIC_RELEASE);
+
+    ck_assert(0 == pthread_join(thread, NULL));
+    hashmap_delete(arg.map);
+}
+END_TEST
+
+START_TEST(test_hashmap_concurrent)
+{
+    for (size_t i = 0; i < N_CONFIGS; ++i)
+    {
+        hashmap_t* map = new_map(&CONFIGS[i]);
+        ck_assert(map != NULL);
+
+        // each round starts new threads, which adopt
+        // the caches of the threads of the last round
+        for (size_t round = 0; round < 3; ++round)
+        {
+            run_threads(map, insert_range);
+
+            for (size_t k = 1; k <= N_KEYS; ++k)
+            {
+                ck_assert(hashmap_contains(map, (void*)k));
+            }
+
+            run_threads(map, remove_range);
+
+            for (size_t k = 1; k <= N_KEYS; ++k)
+            {
+                ck_assert(!hashmap_contains(map, (void*)k));
+            }
+        }
+
+        run_threads(map, insert_range);
+
+        hashmap_delete(map);
+    }
+}
+END_TEST
+
+START_TEST(test_hashmap_growth)
+{
+    for (size_t i = 0; i < N_CONFIGS; ++i)
+    {
+        check_growth(&CONFIGS[i]);
+    }
+}
+END_TEST
+
+START_TEST(test_hashmap_fingerprints)
+{
+    for (size_t i = 0; i < N_CONFIGS; ++i)
+    {
+        if (CONFIGS[i].engine != HASHMAP_ENGINE_LOCKED)
+        {
+            continue;
+        }
+
+        // a high load factor overflows the fingerprint
+        // index of every bucket with unindexed items
+        hashmap_attr_t* attr = hashmap_attr_default();
+        attr->load_factor  = 16.0f;
+        attr->comparator   = counting_comparator;
+        attr->allocator    = CONFIGS[i].allocator;
+        attr->engine       = CONFIGS[i].engine;
+        attr->growth       = CONFIGS[i].growth;
+        attr->locking      = CONFIGS[i].locking;
+        attr->lock_stripes = CONFIGS[i].lock_stripes;
+
+        hashmap_t* map = hashmap_new_with_attr(attr);
+        hashmap_attr_delete(attr);
+        ck_assert(map != NULL);
+
+        for (size_t k = 1; k <= N_KEYS; ++k)
+        {
+            ck_assert(hashmap_insert(map, (void*)k, make_point((float)k, 0.0f), NULL));
+        }
+
+        // removing indexed items promotes unindexed ones
+        for (size_t k = 3; k <= N_KEYS; k += 3)
+        {
+            ck_assert(hashmap_remove(map, (void*)k));
+        }
+
+        // the comparator is called only for the key found
+        __atomic_store_n(&n_comparisons, 0, __ATOMIC_RELAXED);
+
+        size_t n_found = 0;
+        for (size_t k = 1; k <= 2*N_KEYS; ++k)
+        {
+            point_t* p = (point_t*)hashmap_find(map, (void*)k);
+            if (k > N_KEYS || k % 3 == 0)
+            {
+                ck_assert(NULL == p);
+            }
+            else
+            {
+                ck_assert(p != NULL);
+                ck_assert(p->x == (float)k);
+                n_found++;
+            }
+        }
+
+        ck_assert(__atomic_load_n(&n_comparisons, __ATOMIC_RELAXED) == n_found);
+
+        hashmap_delete(map);
+    }
+}
+END_TEST
+
 // ----------------------------------------------------------------------------
 // Infrastructure
  
@@ -54,6 +467,11 @@ Suite* hashmap_suite(void)
     TCase* tc_core = tcase_create("hashmap-core");
     
     tcase_add_test(tc_core, test_hashmap_new);
+    tcase_add_test(tc_core, test_hashmap_allocators);
+    tcase_add_test(tc_core, test_hashmap_many_maps);
+    tcase_add_test(tc_core, test_hashmap_concurrent);
+    tcase_add_test(tc_core, test_hashmap_growth);
+    tcase_add_test(tc_core, test_hashmap_fingerprints);
 
     suite_add_tcase(s, tc_core);
     
@@ -3,11 +3,14 @@
 
 #define _GNU_SOURCE
 
+#include "slab.h"
 #include "murmur3.h"
 #include "hashmap.h"
 #include "intrusive_list.h"
 
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <pthread.h>
 
 // The output of the hash function used internally.
@@ -16,13 +19,51 @@ typedef uint32_t hash_t;
 // The top-level lock used to exclude entry during resize.
 typedef pthread_rwlock_t map_lock_t;
 
+// The lock that protects one or more buckets.
+typedef pthread_rwlock_t bucket_lock_t;
+
+// The size of a cache line, to which lock stripes are padded.
+#define CACHE_LINE_SIZE 64
+
+// The number of lock stripes per processor by default.
+static const size_t STRIPES_PER_PROCESSOR = 4;
+
+// The number of items at the front of each bucket indexed by fingerprint.
+#define BUCKET_SLOTS 4
+
 // The initial number of buckets in internal bucket array.
 static const size_t INITIAL_N_BUCKETS = 4;
 
+// The maximum number of bucket segments of the split-ordered
+// engine and of linear growth; segment 0 holds the initial buckets,
+// and each later segment doubles the number of buckets.
+#define MAX_SEGMENTS 32
+
+// The maximum number of buckets of the split-ordered engine;
+// the top bit of the hash distinguishes items from buckets.
+static const size_t MAX_SPLIT_ORDERED_BUCKETS = (size_t)1 << 31;
+
+// The number of nodes unlinked from the split-ordered list
+// between attempts to reclaim them.
+static const size_t RECLAIM_BATCH_NODES = 1024;
+
+// The number of reader slots of the split-ordered engine,
+// over which threads are spread.
+#define N_READER_SLOTS 64
+
+// The number of epochs whose unlinked nodes may await reclamation.
+#define N_LIMBO_EPOCHS 3
+
 typedef struct bucket_iter_ctx
 {
     void*        query_key;
+    hash_t       query_hash;
     comparator_f comparator;
+
+    // The position in the bucket of the next item visited, and the
+    // indexed positions whose fingerprint matches that of the query.
+    uint32_t position;
+    uint32_t matches;
 } bucket_iter_ctx_t;
 
 // Each key / value association in the table is stored in a bucket 
@@ -39,15 +80,77 @@ typedef struct bucket_item
     void* value;  // Inserted value
 } bucket_item_t;
 
+// Under the split-ordered engine, every item and every initialized
+// bucket is a node in a single lock-free list, sorted by split-order
+// key: the bit-reversed hash, with the low bit set for items and
+// clear for buckets, such that the items of each bucket follow the
+// node of the bucket, and splitting a bucket in two needs only a new
+// node between its items.
+typedef struct so_node
+{
+    // The next node in the list; the low bit is set
+    // once the node is removed, and then never changes.
+    struct so_node* next;
+
+    // The split-order key.
+    uint32_t so_key;
+
+    void* key;    // Inserted key
+    void* value;  // Inserted value, or the tombstone once removed
+
+    // The allocator from which the node was allocated, if any.
+    slab_t* slab;
+
+    // The next node in the batch awaiting reclamation once
+    // unlinked; `next` must remain intact for readers.
+    struct so_node* next_retired;
+} so_node_t;
+
 // Internally, the map utilizes a contiguous array of buckets to
 // stored key / value associations. Each bucket is an intrusive
-// linked-list of items protected by a reader / writer lock.
+// linked-list of items protected by a reader / writer lock, either
+// its own or that of the stripe into which its index falls.
+//
+// The first BUCKET_SLOTS items of the list are also indexed inline
+// by an 8-bit fingerprint of their hash, by their position in the
+// list, such that a lookup compares only the indexed items whose
+// fingerprint matches, and a miss in a bucket of no more items than
+// are indexed dereferences none of them. The index occupies what is
+// otherwise padding after the list head, so a bucket without a lock
+// of its own remains 24 bytes.
 typedef struct bucket
 {
-    list_entry_t     head;
-    pthread_rwlock_t lock;
+    list_entry_t head;
+
+    // The fingerprint of the item at each of the first
+    // positions of the list, 0 past the end of the list.
+    uint8_t tags[BUCKET_SLOTS];
+
+    // The number of items in the bucket.
+    uint32_t n_items;
 } bucket_t;
 
+// A bucket with a lock of its own.
+typedef struct locked_bucket
+{
+    bucket_t      bucket;
+    bucket_lock_t lock;
+} locked_bucket_t;
+
+// A lock stripe, padded such that each occupies its own cache line.
+typedef struct lock_stripe
+{
+    bucket_lock_t lock;
+} __attribute__((aligned(CACHE_LINE_SIZE))) lock_stripe_t;
+
+// A slot in which the operations of the split-ordered engine are
+// counted while in progress, by the parity of the epoch in which
+// each began, padded such that each occupies its own cache line.
+typedef struct reader_slot
+{
+    size_t active[2];
+} __attribute__((aligned(CACHE_LINE_SIZE))) reader_slot_t;
+
 struct hashmap
 {
     // The top-level map lock.
@@ -65,13 +168,47 @@ struct hashmap
     key_deleter_f   key_deleter;    // key deleter
     value_deleter_f value_deleter;  // value deleter
 
+    // The allocator for bucket items;
+    // NULL when items are allocated with malloc().
+    slab_t* slab;
+
     // The total count of items in the map.
     size_t n_items;
 
+    // The engine that implements the map.
+    hashmap_engine_t engine;
+
+    // The growth of the array of buckets.
+    hashmap_growth_t growth;
+
     // The dynamic array of buckets.
     bucket_t* buckets;
     // The number of buckets currently in the array.
     size_t    n_buckets;
+    // The size of each bucket in the array, which
+    // embeds a lock unless the locks are striped.
+    size_t    bucket_size;
+
+    // The lock stripes, or NULL when each bucket has its own lock.
+    lock_stripe_t* stripes;
+    size_t         n_stripes;
+
+    // Under linear growth, the segments of the array of buckets,
+    // which never move; the lock serializes bucket splits.
+    bucket_t*       bucket_segments[MAX_SEGMENTS];
+    pthread_mutex_t split_lock;
+
+    // Under the split-ordered engine, the segments of the
+    // array of bucket nodes, allocated on first use.
+    so_node_t** segments[MAX_SEGMENTS];
+
+    // Under the split-ordered engine, the epoch of reclamation, the
+    // slots in which operations in progress are counted, and a stack
+    // of the nodes unlinked in each of the last epochs.
+    size_t         epoch;
+    reader_slot_t* readers;
+    so_node_t*     limbo[N_LIMBO_EPOCHS];
+    size_t         n_retired;
 };
 
 // ----------------------------------------------------------------------------
@@ -87,30 +224,45 @@ static void unlock_map(hashmap_t* map);
 // ----------------------------------------------------------------------------
 // Internal Prototypes: Bucket Operations
 
-static bucket_t* new_buckets(size_t n_buckets);
-static void initialize_bucket(bucket_t* bucket);
-static void deinitialize_bucket(bucket_t* bucket);
+static bucket_t* new_buckets(hashmap_t* map, size_t n_buckets);
+static bucket_t* get_bucket(hashmap_t* map, bucket_t* buckets, size_t index);
+static void initialize_bucket(hashmap_t* map, bucket_t* bucket);
+static void deinitialize_bucket(hashmap_t* map, bucket_t* bucket);
 
 static void destroy_buckets(
-    bucket_t*       buckets, 
-    size_t          n_buckets, 
-    key_deleter_f   key_deleter, 
-    value_deleter_f value_deleter);
-static void flush_bucket(
-    bucket_t*       bucket, 
-    key_deleter_f   key_deleter, 
-    value_deleter_f value_deleter);
-
-static void lock_bucket_read(bucket_t* bucket);
-static void lock_bucket_write(bucket_t* bucket);
-static void unlock_bucket(bucket_t* bucket);
-
-static bucket_item_t* new_bucket_item(hash_t hash, void* key, void* value);
-static void destroy_bucket_item(bucket_item_t* item);
+    hashmap_t* map,
+    bucket_t*  buckets, 
+    size_t     n_buckets);
+static void flush_bucket(hashmap_t* map, bucket_t* bucket);
+
+static bool initialize_stripes(hashmap_t* map, size_t n_stripes);
+static void destroy_stripes(hashmap_t* map);
+
+static bucket_lock_t* get_bucket_lock(
+    hashmap_t* map, 
+    bucket_t*  bucket, 
+    size_t     index);
+static void lock_bucket_read(bucket_lock_t* lock);
+static void lock_bucket_write(bucket_lock_t* lock);
+static void unlock_bucket(bucket_lock_t* lock);
+
+static bucket_t* lock_bucket_for_hash(
+    hashmap_t*      map, 
+    hash_t          hash, 
+    bool            write,
+    bucket_lock_t** lock_out);
+
+static bucket_item_t* new_bucket_item(
+    slab_t* slab, 
+    hash_t  hash, 
+    void*   key, 
+    void*   value);
+static void destroy_bucket_item(slab_t* slab, bucket_item_t* item);
 
 static bucket_item_t* bucket_find_by_key(
     hashmap_t* map, 
     bucket_t*  bucket,
+    hash_t     hash,
     void*      key);
 static bool bucket_finder(list_entry_t* entry, void* ctx);
 
@@ -120,12 +272,65 @@ static void insert_into_bucket(
 static void remove_from_bucket(
     bucket_t*      bucket, 
     bucket_item_t* item);
+static void clear_index(bucket_t* bucket);
+static uint8_t fingerprint(const hash_t hash);
 
 // ----------------------------------------------------------------------------
 // Internal Prototypes: Resize
 
 static void resize_map(hashmap_t* map);
 
+static bool initialize_linear(hashmap_t* map);
+static void destroy_linear(hashmap_t* map);
+static void split_bucket(hashmap_t* map);
+static bucket_t* get_linear_bucket(hashmap_t* map, size_t index);
+static size_t linear_index(const hash_t hash, const size_t n_buckets);
+
+// ----------------------------------------------------------------------------
+// Internal Prototypes: Split-Ordered Engine
+
+static bool so_initialize(hashmap_t* map);
+static void so_destroy(hashmap_t* map);
+
+static bool so_insert(
+    hashmap_t* map, 
+    void*      key, 
+    void*      value, 
+    void**     replaced);
+static bool so_remove(hashmap_t* map, void* key);
+static void* so_find(hashmap_t* map, void* key);
+
+static bool so_search(
+    hashmap_t*  map,
+    so_node_t*  head,
+    uint32_t    so_key,
+    void*       key,
+    so_node_t*** prev_out,
+    so_node_t** curr_out);
+
+static so_node_t* so_get_bucket(hashmap_t* map, size_t index);
+static so_node_t* so_initialize_bucket(hashmap_t* map, size_t index);
+static so_node_t** so_get_slot(hashmap_t* map, size_t index);
+
+static so_node_t* so_new_node(
+    slab_t*  slab, 
+    uint32_t so_key, 
+    void*    key, 
+    void*    value);
+static void so_destroy_node(void* node);
+static void so_destroy_batch(void* batch);
+
+static size_t* so_enter(hashmap_t* map);
+static void so_leave(size_t* active);
+static size_t get_reader_slot(void);
+
+static void so_retire_node(hashmap_t* map, so_node_t* node);
+static void so_reclaim_nodes(hashmap_t* map);
+
+static uint32_t so_item_key(hash_t hash);
+static uint32_t so_bucket_key(size_t index);
+static uint32_t reverse_bits(uint32_t n);
+
 // ----------------------------------------------------------------------------
 // Internal Prototypes: Atomic Wrappers
 
@@ -146,6 +351,11 @@ static size_t bucket_index(
     const hash_t hash, 
     const size_t n_buckets);
 
+static size_t locate_segment(
+    const size_t index, 
+    size_t*      offset, 
+    size_t*      size);
+
 static bool need_resize(
     const size_t n_items, 
     const size_t n_buckets,
@@ -162,7 +372,11 @@ hashmap_t* hashmap_new(void)
         return NULL;
     }
 
-    return hashmap_new_with_attr(default_attr);
+    hashmap_t* map = hashmap_new_with_attr(default_attr);
+
+    hashmap_attr_delete(default_attr);
+
+    return map;
 }
 
 hashmap_t* hashmap_new_with_attr(hashmap_attr_t* attr)
@@ -172,27 +386,92 @@ hashmap_t* hashmap_new_with_attr(hashmap_attr_t* attr)
     || NULL == attr->comparator 
     || NULL == attr->keylen 
     || NULL == attr->key_deleter 
-    || NULL == attr->value_deleter)
+    || NULL == attr->value_deleter
+    || (attr->allocator != HASHMAP_ALLOCATOR_MALLOC
+     && attr->allocator != HASHMAP_ALLOCATOR_SLAB)
+    || (attr->engine != HASHMAP_ENGINE_LOCKED
+     && attr->engine != HASHMAP_ENGINE_SPLIT_ORDERED)
+    || (attr->growth != HASHMAP_GROWTH_DOUBLING
+     && attr->growth != HASHMAP_GROWTH_LINEAR)
+    || (attr->locking != HASHMAP_LOCKING_BUCKET
+     && attr->locking != HASHMAP_LOCKING_STRIPED))
     {
         return NULL;
     }
 
-    hashmap_t* map = malloc(sizeof(hashmap_t));
+    hashmap_t* map = calloc(1, sizeof(hashmap_t));
     if (NULL == map)
     {
         return NULL;
     }
 
-    bucket_t* buckets = new_buckets(INITIAL_N_BUCKETS);
-    if (NULL == buckets)
+    map->engine = attr->engine;
+    map->growth = attr->growth;
+
+    map->bucket_size = sizeof(locked_bucket_t);
+    if (HASHMAP_ENGINE_LOCKED == map->engine 
+     && HASHMAP_LOCKING_STRIPED == attr->locking)
     {
-        free(map);
-        return NULL;
+        if (!initialize_stripes(map, attr->lock_stripes))
+        {
+            free(map);
+            return NULL;
+        }
+
+        map->bucket_size = sizeof(bucket_t);
     }
 
-    initialize_map_lock(&map->map_lock);
+    map->slab = NULL;
+    if (HASHMAP_ALLOCATOR_SLAB == attr->allocator)
+    {
+        map->slab = slab_new(HASHMAP_ENGINE_LOCKED == map->engine 
+            ? sizeof(bucket_item_t) 
+            : sizeof(so_node_t));
+        if (NULL == map->slab)
+        {
+            destroy_stripes(map);
+            free(map);
+            return NULL;
+        }
+    }
+
+    if (HASHMAP_ENGINE_SPLIT_ORDERED == map->engine)
+    {
+        if (!so_initialize(map))
+        {
+            slab_delete(map->slab);
+            free(map);
+            return NULL;
+        }
+    }
+    else if (HASHMAP_GROWTH_LINEAR == map->growth)
+    {
+        if (!initialize_linear(map))
+        {
+            slab_delete(map->slab);
+            destroy_stripes(map);
+            free(map);
+            return NULL;
+        }
+
+        initialize_map_lock(&map->map_lock);
+    }
+    else
+    {
+        bucket_t* buckets = new_buckets(map, INITIAL_N_BUCKETS);
+        if (NULL == buckets)
+        {
+            slab_delete(map->slab);
+            destroy_stripes(map);
+            free(map);
+            return NULL;
+        }
+
+        initialize_map_lock(&map->map_lock);
+
+        map->buckets = buckets;
+    }
 
-    map->buckets   = buckets;
     map->n_buckets = INITIAL_N_BUCKETS;
 
     map->load_factor    = attr->load_factor;
@@ -214,13 +493,23 @@ void hashmap_delete(hashmap_t* map)
         return;
     }
 
-    destroy_map_lock(&map->map_lock);
+    if (HASHMAP_ENGINE_SPLIT_ORDERED == map->engine)
+    {
+        so_destroy(map);
+    }
+    else if (HASHMAP_GROWTH_LINEAR == map->growth)
+    {
+        destroy_map_lock(&map->map_lock);
+        destroy_linear(map);
+    }
+    else
+    {
+        destroy_map_lock(&map->map_lock);
+        destroy_buckets(map, map->buckets, map->n_buckets);
+    }
 
-    destroy_buckets(
-        map->buckets, 
-        map->n_buckets, 
-        map->key_deleter, 
-        map->value_deleter);
+    destroy_stripes(map);
+    slab_delete(map->slab);
 
     free(map);
 }
@@ -241,10 +530,16 @@ bool hashmap_insert(
         *replaced = NULL;
     }
 
+    if (HASHMAP_ENGINE_SPLIT_ORDERED == map->engine)
+    {
+        return so_insert(map, key, value, replaced);
+    }
+
     lock_map_rw(map);
 
     const size_t new_n_items = atomic_load(&map->n_items) + 1;
-    if (need_resize(new_n_items, map->n_buckets, map->load_factor))
+    if (HASHMAP_GROWTH_DOUBLING == map->growth
+     && need_resize(new_n_items, map->n_buckets, map->load_factor))
     {
         unlock_map(map);
 
@@ -258,21 +553,20 @@ bool hashmap_insert(
     // compute the hash for the key
     const hash_t hash  = hash_key(key, map->keylen, map->key_is_literal);
 
-    // locate the appropriate bucket
-    bucket_t* bucket = &map->buckets[bucket_index(hash, map->n_buckets)];
-    
-    // lock the bucket for writing 
-    lock_bucket_write(bucket);
+    // locate the appropriate bucket and lock it for writing
+    bucket_lock_t* lock;
+    bucket_t* bucket = lock_bucket_for_hash(map, hash, true, &lock);
 
     // search the bucket for the key
-    bucket_item_t* item = bucket_find_by_key(map, bucket, key);
+    bucket_item_t* item = bucket_find_by_key(map, bucket, hash, key);
     if (NULL == item)
     {
         // key not present in the map; insert a new item
-        bucket_item_t* new_item = new_bucket_item(hash, key, value);
+        bucket_item_t* new_item = new_bucket_item(map->slab, hash, key, value);
         if (new_item != NULL)
         {
             insert_into_bucket(bucket, new_item);
+            atomic_increment(&map->n_items);
             inserted = true;
         }
     }
@@ -295,12 +589,19 @@ bool hashmap_insert(
         inserted = true;
     }
 
-    unlock_bucket(bucket);
-
-    atomic_increment(&map->n_items);
-
+    unlock_bucket(lock);
     unlock_map(map);
 
+    // under linear growth, each insert splits at most one bucket
+    if (HASHMAP_GROWTH_LINEAR == map->growth
+     && need_resize(
+        atomic_load(&map->n_items), 
+        atomic_load(&map->n_buckets), 
+        map->load_factor))
+    {
+        split_bucket(map);
+    }
+
     return inserted;
 }
 
@@ -311,20 +612,23 @@ bool hashmap_remove(hashmap_t* map, void* key)
         return false;
     }
 
+    if (HASHMAP_ENGINE_SPLIT_ORDERED == map->engine)
+    {
+        return so_remove(map, key);
+    }
+
     // lock the map for read / write
     lock_map_rw(map);
 
     // compute the hash for the key
     const hash_t hash = hash_key(key, map->keylen, map->key_is_literal);
 
-    // locate the appropriate bucket
-    bucket_t* bucket = &map->buckets[bucket_index(hash, map->n_buckets)];
-
-    // lock the bucket for writing
-    lock_bucket_write(bucket);
+    // locate the appropriate bucket and lock it for writing
+    bucket_lock_t* lock;
+    bucket_t* bucket = lock_bucket_for_hash(map, hash, true, &lock);
 
     // search the bucket for the key
-    bucket_item_t* item = bucket_find_by_key(map, bucket, key);
+    bucket_item_t* item = bucket_find_by_key(map, bucket, hash, key);
     if (item != NULL)
     {
         // located a matching key, destroy the associated value
@@ -334,13 +638,12 @@ bool hashmap_remove(hashmap_t* map, void* key)
         remove_from_bucket(bucket, item);
 
         // and destroy the item
-        destroy_bucket_item(item);
-    }
-
-    unlock_bucket(bucket);
+        destroy_bucket_item(map->slab, item);
 
-    atomic_decrement(&map->n_items);
+        atomic_decrement(&map->n_items);
+    }
 
+    unlock_bucket(lock);
     unlock_map(map);
 
     return item != NULL;
@@ -353,23 +656,26 @@ void* hashmap_find(hashmap_t* map, void* key)
         return NULL;
     }
 
+    if (HASHMAP_ENGINE_SPLIT_ORDERED == map->engine)
+    {
+        return so_find(map, key);
+    }
+
     // lock the map for read / write
     lock_map_rw(map);
 
     // compute the hash for the key
     const hash_t hash = hash_key(key, map->keylen, map->key_is_literal);
 
-    // locate the appropriate bucket
-    bucket_t* bucket = &map->buckets[bucket_index(hash, map->n_buckets)];
-
-    // lock the bucket for reading
-    lock_bucket_read(bucket);
+    // locate the appropriate bucket and lock it for reading
+    bucket_lock_t* lock;
+    bucket_t* bucket = lock_bucket_for_hash(map, hash, false, &lock);
 
     // search the bucket for the key
-    bucket_item_t* item = bucket_find_by_key(map, bucket, key);
+    bucket_item_t* item = bucket_find_by_key(map, bucket, hash, key);
     void* value = (NULL == item) ? NULL : item->value;
     
-    unlock_bucket(bucket);
+    unlock_bucket(lock);
     unlock_map(map);
 
     return value;
@@ -388,8 +694,10 @@ bool hashmap_contains(hashmap_t* map, void* key)
 static void initialize_map_lock(map_lock_t* lock)
 {
     pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
     pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NP);
     pthread_rwlock_init(lock, &attr);
+    pthread_rwlockattr_destroy(&attr);
 }
 
 // Destroy the top-level map lock.
@@ -420,9 +728,9 @@ static void unlock_map(hashmap_t* map)
 // Internal: Bucket Operations 
 
 // Construct and initialize a new bucket array.
-static bucket_t* new_buckets(size_t n_buckets)
+static bucket_t* new_buckets(hashmap_t* map, size_t n_buckets)
 {
-    bucket_t* buckets = calloc(n_buckets, sizeof(bucket_t));
+    bucket_t* buckets = calloc(n_buckets, map->bucket_size);
     if (NULL == buckets)
     {
         return NULL;
@@ -430,47 +738,58 @@ static bucket_t* new_buckets(size_t n_buckets)
 
     for (size_t i = 0; i < n_buckets; ++i)
     {
-        initialize_bucket(&buckets[i]);
+        initialize_bucket(map, get_bucket(map, buckets, i));
     }
 
     return buckets;
 }
 
+// Get the bucket at `index` in an array of buckets, whose
+// size depends on whether the buckets embed their locks.
+static bucket_t* get_bucket(hashmap_t* map, bucket_t* buckets, size_t index)
+{
+    return (bucket_t*)((char*)buckets + index*map->bucket_size);
+}
+
 // Initialize a new bucket in the bucket array.
-static void initialize_bucket(bucket_t* bucket)
+static void initialize_bucket(hashmap_t* map, bucket_t* bucket)
 {
     list_init(&bucket->head);
-    pthread_rwlock_init(&bucket->lock, NULL);
+    clear_index(bucket);
+
+    if (NULL == map->stripes)
+    {
+        pthread_rwlock_init(&((locked_bucket_t*)bucket)->lock, NULL);
+    }
 }
 
-// Destroy the lock embedded in the bucket.
-static void deinitialize_bucket(bucket_t* bucket)
+// Destroy the lock embedded in the bucket, if any.
+static void deinitialize_bucket(hashmap_t* map, bucket_t* bucket)
 {
-    pthread_rwlock_destroy(&bucket->lock);
+    if (NULL == map->stripes)
+    {
+        pthread_rwlock_destroy(&((locked_bucket_t*)bucket)->lock);
+    }
 }
 
 // Destroy an entire bucket array.
 static void destroy_buckets(
-    bucket_t*       buckets, 
-    size_t          n_buckets, 
-    key_deleter_f   key_deleter, 
-    value_deleter_f value_deleter)
+    hashmap_t* map,
+    bucket_t*  buckets, 
+    size_t     n_buckets)
 {
     for (size_t i = 0; i < n_buckets; ++i)
     {
-        bucket_t* bucket = &buckets[i];
-        flush_bucket(bucket, key_deleter, value_deleter);
-        deinitialize_bucket(bucket);
+        bucket_t* bucket = get_bucket(map, buckets, i);
+        flush_bucket(map, bucket);
+        deinitialize_bucket(map, bucket);
     }
 
     free(buckets);
 }
 
 // Flush and destroy all items stored in an individual bucket.
-static void flush_bucket(
-    bucket_t*       bucket, 
-    key_deleter_f   key_deleter, 
-    value_deleter_f value_deleter)
+static void flush_bucket(hashmap_t* map, bucket_t* bucket)
 {
     list_entry_t* current;
     while ((current = list_pop_front(&bucket->head)) != NULL)
@@ -478,44 +797,154 @@ static void flush_bucket(
         bucket_item_t* item = (bucket_item_t*) current;
         
         // if the key deleter is provided, destroy the stored key
-        if (key_deleter != NULL)
+        if (map->key_deleter != NULL)
         {
-            key_deleter(item->key);
+            map->key_deleter(item->key);
         }
 
         // if the value deleter is provided, destroy the stored value
-        if (value_deleter != NULL)
+        if (map->value_deleter != NULL)
         {
-            value_deleter(item->value);
+            map->value_deleter(item->value);
         }
 
         // destroy the item itself
-        destroy_bucket_item(item);
+        destroy_bucket_item(map->slab, item);
+    }
+}
+
+// Construct the lock stripes, rounding their count up to
+// a power of two; a count of 0 selects the default.
+static bool initialize_stripes(hashmap_t* map, size_t n_stripes)
+{
+    if (0 == n_stripes)
+    {
+        const long n_processors = sysconf(_SC_NPROCESSORS_ONLN);
+        n_stripes = STRIPES_PER_PROCESSOR*((n_processors > 0) ? (size_t)n_processors : 1);
+    }
+
+    size_t count = 1;
+    while (count < n_stripes)
+    {
+        count <<= 1;
+    }
+
+    lock_stripe_t* stripes = aligned_alloc(CACHE_LINE_SIZE, count*sizeof(lock_stripe_t));
+    if (NULL == stripes)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        pthread_rwlock_init(&stripes[i].lock, NULL);
+    }
+
+    map->stripes   = stripes;
+    map->n_stripes = count;
+
+    return true;
+}
+
+// Destroy the lock stripes, if any.
+static void destroy_stripes(hashmap_t* map)
+{
+    if (NULL == map->stripes)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < map->n_stripes; ++i)
+    {
+        pthread_rwlock_destroy(&map->stripes[i].lock);
     }
+
+    free(map->stripes);
+}
+
+// Get the lock that protects the bucket at `index`.
+static bucket_lock_t* get_bucket_lock(
+    hashmap_t* map, 
+    bucket_t*  bucket, 
+    size_t     index)
+{
+    return (NULL == map->stripes)
+        ? &((locked_bucket_t*)bucket)->lock
+        : &map->stripes[index & (map->n_stripes - 1)].lock;
 }
 
 // Acquire shared access to the bucket.
-static void lock_bucket_read(bucket_t* bucket)
+static void lock_bucket_read(bucket_lock_t* lock)
 {
-    pthread_rwlock_rdlock(&bucket->lock);
+    pthread_rwlock_rdlock(lock);
 }
 
 // Acquire exclusive access to the bucket.
-static void lock_bucket_write(bucket_t* bucket)
+static void lock_bucket_write(bucket_lock_t* lock)
 {
-    pthread_rwlock_wrlock(&bucket->lock);
+    pthread_rwlock_wrlock(lock);
 }
 
 // Release access to the bucket.
-static void unlock_bucket(bucket_t* bucket)
+static void unlock_bucket(bucket_lock_t* lock)
+{
+    pthread_rwlock_unlock(lock);
+}
+
+// Locate the bucket for `hash` and lock it. Under linear growth,
+// the bucket of the hash changes when that bucket is split, which
+// requires its lock; the bucket is located again until the bucket
+// that was locked is still that of the hash.
+static bucket_t* lock_bucket_for_hash(
+    hashmap_t*      map, 
+    hash_t          hash, 
+    bool            write,
+    bucket_lock_t** lock_out)
 {
-    pthread_rwlock_unlock(&bucket->lock);
+    for (;;)
+    {
+        const size_t n_buckets = atomic_load(&map->n_buckets);
+        const size_t index     = (HASHMAP_GROWTH_LINEAR == map->growth)
+            ? linear_index(hash, n_buckets) 
+            : bucket_index(hash, n_buckets);
+
+        bucket_t* bucket = (HASHMAP_GROWTH_LINEAR == map->growth)
+            ? get_linear_bucket(map, index)
+            : get_bucket(map, map->buckets, index);
+
+        bucket_lock_t* lock = get_bucket_lock(map, bucket, index);
+        if (write)
+        {
+            lock_bucket_write(lock);
+        }
+        else
+        {
+            lock_bucket_read(lock);
+        }
+
+        // under doubling growth the map lock excludes resize
+        if (HASHMAP_GROWTH_DOUBLING == map->growth
+         || linear_index(hash, atomic_load(&map->n_buckets)) == index)
+        {
+            *lock_out = lock;
+            return bucket;
+        }
+
+        unlock_bucket(lock);
+    }
 }
 
-// Construct and initialize a new bucket item.
-static bucket_item_t* new_bucket_item(hash_t hash, void* key, void* value)
+// Construct and initialize a new bucket item,
+// allocated from `slab` if one is provided.
+static bucket_item_t* new_bucket_item(
+    slab_t* slab, 
+    hash_t  hash, 
+    void*   key, 
+    void*   value)
 {
-    bucket_item_t* item = malloc(sizeof(bucket_item_t*));
+    bucket_item_t* item = (NULL == slab) 
+        ? malloc(sizeof(bucket_item_t)) 
+        : slab_alloc(slab);
     if (NULL == item)
     {
         return NULL;
@@ -529,19 +958,49 @@ static bucket_item_t* new_bucket_item(hash_t hash, void* key, void* value)
 }
 
 // Destroy (deallocate) a bucket item.
-static void destroy_bucket_item(bucket_item_t* item)
+static void destroy_bucket_item(slab_t* slab, bucket_item_t* item)
 {
-    free(item);
+    if (NULL == slab)
+    {
+        free(item);
+    }
+    else
+    {
+        slab_free(slab, item);
+    }
 }
 
+// Search `bucket` for the item with `key`, whose hash is `hash`;
+// the comparator is called only for items with the same hash.
 static bucket_item_t* bucket_find_by_key(
     hashmap_t* map, 
     bucket_t*  bucket,
+    hash_t     hash,
     void*      key)
 {
+    const uint8_t tag = fingerprint(hash);
+
+    uint32_t matches = 0;
+    for (uint32_t i = 0; i < BUCKET_SLOTS; ++i)
+    {
+        if (bucket->tags[i] == tag)
+        {
+            matches |= 1u << i;
+        }
+    }
+
+    // every item of the bucket is indexed, and none matches
+    if (0 == matches && bucket->n_items <= BUCKET_SLOTS)
+    {
+        return NULL;
+    }
+
     bucket_iter_ctx_t ctx = {
         .query_key  = key,
-        .comparator = map->comparator
+        .query_hash = hash,
+        .comparator = map->comparator,
+        .position   = 0,
+        .matches    = matches
     };
 
     return (bucket_item_t*) list_find(&bucket->head, bucket_finder, &ctx);
@@ -552,23 +1011,86 @@ static bool bucket_finder(list_entry_t* entry, void* ctx)
     bucket_item_t*     item     = (bucket_item_t*) entry;
     bucket_iter_ctx_t* iter_ctx = (bucket_iter_ctx_t*) ctx;
 
-    return iter_ctx->comparator(item->key, iter_ctx->query_key);
+    // an indexed item whose fingerprint differs is not compared
+    const uint32_t position = iter_ctx->position++;
+    if (position < BUCKET_SLOTS && 0 == (iter_ctx->matches & (1u << position)))
+    {
+        return false;
+    }
+
+    return item->hash == iter_ctx->query_hash
+        && iter_ctx->comparator(item->key, iter_ctx->query_key);
 }
 
-// Insert the specified bucket item into `bucket`.
+// Insert the specified bucket item at the front of `bucket`;
+// the fingerprints of the indexed items shift back by one.
 static void insert_into_bucket(
     bucket_t*      bucket, 
     bucket_item_t* item)
 {
     list_push_front(&bucket->head, &item->entry);
+
+    memmove(&bucket->tags[1], &bucket->tags[0], BUCKET_SLOTS - 1);
+    bucket->tags[0] = fingerprint(item->hash);
+    bucket->n_items++;
 }
 
-// Remove the specified item from `bucket`. 
+// Remove the specified item from `bucket`. The fingerprints of the
+// indexed items after it shift forward by one, and the first item
+// that was not indexed, if any, takes the last indexed position.
 static void remove_from_bucket(
     bucket_t*      bucket, 
     bucket_item_t* item)
 {
+    uint32_t      position = 0;
+    list_entry_t* entry    = bucket->head.flink;
+    while (position < BUCKET_SLOTS && entry != &item->entry)
+    {
+        entry = entry->flink;
+        position++;
+    }
+
     list_remove_entry(&bucket->head, &item->entry);
+    bucket->n_items--;
+
+    if (BUCKET_SLOTS == position)
+    {
+        return;
+    }
+
+    memmove(&bucket->tags[position], &bucket->tags[position + 1],
+        BUCKET_SLOTS - 1 - position);
+
+    if (bucket->n_items < BUCKET_SLOTS)
+    {
+        bucket->tags[BUCKET_SLOTS - 1] = 0;
+        return;
+    }
+
+    list_entry_t* last = bucket->head.flink;
+    for (uint32_t i = 0; i < BUCKET_SLOTS - 1; ++i)
+    {
+        last = last->flink;
+    }
+
+    bucket->tags[BUCKET_SLOTS - 1] = fingerprint(((bucket_item_t*) last)->hash);
+}
+
+// Empty the index of `bucket`, whose items have been
+// popped from its list rather than removed.
+static void clear_index(bucket_t* bucket)
+{
+    memset(bucket->tags, 0, sizeof(bucket->tags));
+    bucket->n_items = 0;
+}
+
+// Compute the fingerprint of `hash` from its high bits, which
+// unlike its low bits do not select the bucket; 0 marks a position
+// past the end of the list, so a fingerprint is never 0.
+static uint8_t fingerprint(const hash_t hash)
+{
+    const uint8_t tag = (uint8_t)(hash >> 24);
+    return (0 == tag) ? 1 : tag;
 }
 
 // ----------------------------------------------------------------------------
@@ -591,12 +1113,12 @@ static void resize_map(hashmap_t* map)
     const size_t new_n_buckets = map->n_buckets << 1;
 
     // construct and initialize a new array of buckets
-    bucket_t* buckets = new_buckets(new_n_buckets);
+    bucket_t* buckets = new_buckets(map, new_n_buckets);
 
     // iterate over each bucket in existing array
     for (size_t i = 0; i < map->n_buckets; ++i)
     {
-        bucket_t* bucket = &map->buckets[i];
+        bucket_t* bucket = get_bucket(map, map->buckets, i);
 
         // iterate over each item in that bucket
         bucket_item_t* item;
@@ -606,7 +1128,7 @@ static void resize_map(hashmap_t* map)
             const size_t new_index = bucket_index(item->hash, new_n_buckets);
             
             // locate the new bucket for the item
-            bucket_t* new_bucket = &buckets[new_index];
+            bucket_t* new_bucket = get_bucket(map, buckets, new_index);
             
             // insert the item into its new bucket
             insert_into_bucket(new_bucket, item);
@@ -614,7 +1136,7 @@ static void resize_map(hashmap_t* map)
 
         // all of the items in the bucket have been moved;
         // just deinitialize the bucket to complete cleanup
-        deinitialize_bucket(bucket);
+        deinitialize_bucket(map, bucket);
     }
 
     bucket_t* old_buckets = map->buckets;
@@ -627,51 +1149,874 @@ static void resize_map(hashmap_t* map)
 }
 
 // ----------------------------------------------------------------------------
-// Internal: Atomic Wrappers
+// Internal: Split-Ordered Engine
 
-static inline size_t atomic_increment(size_t* n)
+// The value of a removed node.
+static char so_tombstone;
+#define SO_TOMBSTONE ((void*)&so_tombstone)
+
+// The mark on the next pointer of a removed node.
+#define SO_MARK ((uintptr_t)1)
+
+static inline bool is_marked(so_node_t* node)
 {
-    return __atomic_add_fetch(n, 1, __ATOMIC_SEQ_CST);
+    return ((uintptr_t)node & SO_MARK) != 0;
 }
 
-static inline size_t atomic_decrement(size_t* n)
+static inline so_node_t* get_marked(so_node_t* node)
 {
-    return __atomic_sub_fetch(n, 1, __ATOMIC_SEQ_CST);
+    return (so_node_t*)((uintptr_t)node | SO_MARK);
 }
 
-static inline size_t atomic_load(size_t* n)
+static inline so_node_t* get_unmarked(so_node_t* node)
 {
-    return __atomic_load_n(n, __ATOMIC_ACQUIRE);
+    return (so_node_t*)((uintptr_t)node & ~SO_MARK);
 }
 
-static inline void atomic_store(size_t* ptr, size_t* n)
+// Construct the reader slots and the node of the first bucket,
+// which heads the list.
+static bool so_initialize(hashmap_t* map)
 {
-    __atomic_store_n(ptr, n, __ATOMIC_RELEASE);
-}
+    map->readers = aligned_alloc(CACHE_LINE_SIZE, N_READER_SLOTS*sizeof(reader_slot_t));
+    if (NULL == map->readers)
+    {
+        return false;
+    }
 
-// ----------------------------------------------------------------------------
-// Internal: General Utility 
+    memset(map->readers, 0, N_READER_SLOTS*sizeof(reader_slot_t));
 
-// Compute the hash for `key`.
-static hash_t hash_key(
-    void*    key, 
-    keylen_f keylen, 
-    bool     key_is_literal)
+    so_node_t** slot = so_get_slot(map, 0);
+    so_node_t*  head = so_new_node(map->slab, so_bucket_key(0), NULL, NULL);
+    if (NULL == slot || NULL == head)
+    {
+        so_destroy_node(head);
+        free(map->segments[0]);
+        free(map->readers);
+        return false;
+    }
+
+    *slot = head;
+
+    return true;
+}
+
+// Destroy every node in the list; no operation may be in progress.
+static void so_destroy(hashmap_t* map)
 {
-    unsigned char buffer[sizeof(hash_t)];
-    void* to_hash = key_is_literal ? &key : key;
+    // destroy the nodes that have already been unlinked
+    for (size_t i = 0; i < N_LIMBO_EPOCHS; ++i)
+    {
+        so_destroy_batch(map->limbo[i]);
+    }
 
-    MurmurHash3_x86_32(to_hash, keylen(key), 0, buffer);
+    free(map->readers);
 
-    return (*(hash_t*)buffer);
+    so_node_t* node = *so_get_slot(map, 0);
+    while (node != NULL)
+    {
+        so_node_t* next = get_unmarked(node->next);
+
+        // the value of a removed node has been destroyed
+        if ((node->so_key & 1) != 0 && node->value != SO_TOMBSTONE)
+        {
+            map->key_deleter(node->key);
+            map->value_deleter(node->value);
+        }
+
+        so_destroy_node(node);
+        node = next;
+    }
+
+    for (size_t i = 0; i < MAX_SEGMENTS; ++i)
+    {
+        free(map->segments[i]);
+    }
 }
 
-// Compute the bucket index for `hash`.
-static size_t bucket_index(
-    const hash_t hash, 
-    const size_t n_buckets)
+static bool so_insert(
+    hashmap_t* map, 
+    void*      key, 
+    void*      value, 
+    void**     replaced)
 {
-    return hash & (n_buckets - 1);
+    const hash_t   hash   = hash_key(key, map->keylen, map->key_is_literal);
+    const uint32_t so_key = so_item_key(hash);
+
+    size_t* active = so_enter(map);
+
+    const size_t n_buckets = __atomic_load_n(&map->n_buckets, __ATOMIC_ACQUIRE);
+    so_node_t*   head      = so_get_bucket(map, hash & (n_buckets - 1));
+
+    bool       inserted = false;
+    so_node_t* node     = NULL;
+    while (head != NULL)
+    {
+        so_node_t** prev;
+        so_node_t*  curr;
+        if (so_search(map, head, so_key, key, &prev, &curr))
+        {
+            // key already exists in the map, replace the current
+            // value unless a concurrent remove claims it first
+            void* current = __atomic_load_n(&curr->value, __ATOMIC_ACQUIRE);
+            while (current != SO_TOMBSTONE
+                && !__atomic_compare_exchange_n(
+                    &curr->value, &current, value, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+            if (SO_TOMBSTONE == current)
+            {
+                continue;
+            }
+
+            if (replaced != NULL)
+            {
+                *replaced = current;
+            }
+            else
+            {
+                map->value_deleter(current);
+            }
+
+            // the node was never published
+            so_destroy_node(node);
+
+            inserted = true;
+            break;
+        }
+
+        if (NULL == node)
+        {
+            node = so_new_node(map->slab, so_key, key, value);
+            if (NULL == node)
+            {
+                break;
+            }
+        }
+
+        node->next = curr;
+        if (__atomic_compare_exchange_n(
+            prev, &curr, node, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        {
+            // grow once the load factor is exceeded; a new bucket
+            // splits an old one when it is first used
+            const size_t n_items = atomic_increment(&map->n_items);
+            
+            size_t current = __atomic_load_n(&map->n_buckets, __ATOMIC_RELAXED);
+            if (need_resize(n_items, current, map->load_factor)
+             && current < MAX_SPLIT_ORDERED_BUCKETS)
+            {
+                __atomic_compare_exchange_n(&map->n_buckets, &current, current << 1, 
+                    false, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+            }
+
+            inserted = true;
+            break;
+        }
+    }
+
+    so_leave(active);
+
+    so_reclaim_nodes(map);
+
+    return inserted;
+}
+
+static bool so_remove(hashmap_t* map, void* key)
+{
+    const hash_t   hash   = hash_key(key, map->keylen, map->key_is_literal);
+    const uint32_t so_key = so_item_key(hash);
+
+    size_t* active = so_enter(map);
+
+    const size_t n_buckets = __atomic_load_n(&map->n_buckets, __ATOMIC_ACQUIRE);
+    so_node_t*   head      = so_get_bucket(map, hash & (n_buckets - 1));
+
+    bool removed = false;
+    while (head != NULL)
+    {
+        so_node_t** prev;
+        so_node_t*  curr;
+        if (!so_search(map, head, so_key, key, &prev, &curr))
+        {
+            break;
+        }
+
+        // replacing the value with the tombstone removes
+        // the item; only one remove succeeds
+        void* current = __atomic_load_n(&curr->value, __ATOMIC_ACQUIRE);
+        while (current != SO_TOMBSTONE
+            && !__atomic_compare_exchange_n(
+                &curr->value, &current, SO_TOMBSTONE, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+        if (SO_TOMBSTONE == current)
+        {
+            continue;
+        }
+
+        map->value_deleter(current);
+        atomic_decrement(&map->n_items);
+
+        // mark the node such that no node is inserted after it, 
+        // then search again to unlink it
+        so_node_t* next = __atomic_load_n(&curr->next, __ATOMIC_ACQUIRE);
+        while (!__atomic_compare_exchange_n(
+            &curr->next, &next, get_marked(next), true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+        so_search(map, head, so_key, key, &prev, &curr);
+
+        removed = true;
+        break;
+    }
+
+    so_leave(active);
+
+    so_reclaim_nodes(map);
+
+    return removed;
+}
+
+static void* so_find(hashmap_t* map, void* key)
+{
+    const hash_t   hash   = hash_key(key, map->keylen, map->key_is_literal);
+    const uint32_t so_key = so_item_key(hash);
+
+    size_t* active = so_enter(map);
+
+    const size_t n_buckets = __atomic_load_n(&map->n_buckets, __ATOMIC_ACQUIRE);
+    so_node_t*   head      = so_get_bucket(map, hash & (n_buckets - 1));
+
+    void* value = NULL;
+
+    so_node_t** prev;
+    so_node_t*  curr;
+    if (head != NULL && so_search(map, head, so_key, key, &prev, &curr))
+    {
+        value = __atomic_load_n(&curr->value, __ATOMIC_ACQUIRE);
+        if (SO_TOMBSTONE == value)
+        {
+            value = NULL;
+        }
+    }
+
+    so_leave(active);
+
+    return value;
+}
+
+// Search the list from the node `head` for the first node whose
+// split-order key is `so_key` and, for an item, whose key is `key`,
+// unlinking any removed nodes on the way. On return, `curr_out` is
+// the node that was found or, if none was, the node before which
+// it would be inserted, and `prev_out` is the link to `curr_out`.
+//
+// Returns:
+//  `true` if the node is found
+//  `false` otherwise
+static bool so_search(
+    hashmap_t*  map,
+    so_node_t*  head,
+    uint32_t    so_key,
+    void*       key,
+    so_node_t*** prev_out,
+    so_node_t** curr_out)
+{
+    const bool is_item = (so_key & 1) != 0;
+
+retry:
+    ;
+    so_node_t** prev = &head->next;
+    so_node_t*  curr = __atomic_load_n(prev, __ATOMIC_ACQUIRE);
+    for (;;)
+    {
+        // the head of the search is never removed, and removed
+        // nodes are unlinked before they are passed, so the link
+        // from the previous node is unmarked unless it has since
+        // been removed, in which case the search restarts below
+        if (NULL == curr)
+        {
+            break;
+        }
+
+        so_node_t* next = __atomic_load_n(&curr->next, __ATOMIC_ACQUIRE);
+        if (__atomic_load_n(prev, __ATOMIC_ACQUIRE) != curr)
+        {
+            goto retry;
+        }
+
+        if (is_marked(next))
+        {
+            // curr is removed; unlink it, and the one thread that
+            // succeeds retires it
+            so_node_t* expected = curr;
+            if (!__atomic_compare_exchange_n(prev, &expected, get_unmarked(next), 
+                false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            {
+                goto retry;
+            }
+
+            so_retire_node(map, curr);
+            curr = get_unmarked(next);
+            continue;
+        }
+
+        if (curr->so_key > so_key)
+        {
+            break;
+        }
+
+        if (curr->so_key == so_key)
+        {
+            if (!is_item)
+            {
+                *prev_out = prev;
+                *curr_out = curr;
+                return true;
+            }
+
+            // a removed item awaiting its mark is skipped
+            if (__atomic_load_n(&curr->value, __ATOMIC_ACQUIRE) != SO_TOMBSTONE
+             && map->comparator(curr->key, key))
+            {
+                *prev_out = prev;
+                *curr_out = curr;
+                return true;
+            }
+        }
+
+        prev = &curr->next;
+        curr = next;
+    }
+
+    *prev_out = prev;
+    *curr_out = curr;
+    return false;
+}
+
+// Get the node of the bucket at `index`, initializing it if required.
+//
+// Returns:
+//  the node of the bucket
+//  NULL on allocation failure
+static so_node_t* so_get_bucket(hashmap_t* map, size_t index)
+{
+    so_node_t** slot = so_get_slot(map, index);
+    if (NULL == slot)
+    {
+        return NULL;
+    }
+
+    so_node_t* head = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+    if (head != NULL)
+    {
+        return head;
+    }
+
+    return so_initialize_bucket(map, index);
+}
+
+// Insert the node of the bucket at `index` into the list, after
+// the node of its parent bucket, which it splits.
+static so_node_t* so_initialize_bucket(hashmap_t* map, size_t index)
+{
+    // the parent of a bucket is that with the highest bit cleared
+    size_t parent = index;
+    for (size_t bit = 1; bit <= index; bit <<= 1)
+    {
+        if (index & bit)
+        {
+            parent = index & ~bit;
+        }
+    }
+
+    so_node_t* parent_head = so_get_bucket(map, parent);
+    if (NULL == parent_head)
+    {
+        return NULL;
+    }
+
+    const uint32_t so_key = so_bucket_key(index);
+
+    so_node_t* node = so_new_node(map->slab, so_key, NULL, NULL);
+    if (NULL == node)
+    {
+        return NULL;
+    }
+
+    for (;;)
+    {
+        so_node_t** prev;
+        so_node_t*  curr;
+        if (so_search(map, parent_head, so_key, NULL, &prev, &curr))
+        {
+            // another thread initialized the bucket first
+            so_destroy_node(node);
+            node = curr;
+            break;
+        }
+
+        node->next = curr;
+        if (__atomic_compare_exchange_n(
+            prev, &curr, node, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        {
+            break;
+        }
+    }
+
+    __atomic_store_n(so_get_slot(map, index), node, __ATOMIC_RELEASE);
+
+    return node;
+}
+
+// Get the slot of the array of bucket nodes for the bucket
+// at `index`, allocating the segment that holds it if required.
+static so_node_t** so_get_slot(hashmap_t* map, size_t index)
+{
+    size_t offset;
+    size_t size;
+    const size_t segment = locate_segment(index, &offset, &size);
+
+    so_node_t** slots = __atomic_load_n(&map->segments[segment], __ATOMIC_ACQUIRE);
+    if (NULL == slots)
+    {
+        so_node_t** new_slots = calloc(size, sizeof(so_node_t*));
+        if (NULL == new_slots)
+        {
+            return NULL;
+        }
+
+        if (__atomic_compare_exchange_n(&map->segments[segment], &slots, new_slots, 
+            false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            slots = new_slots;
+        }
+        else
+        {
+            free(new_slots);
+        }
+    }
+
+    return &slots[offset];
+}
+
+// Construct and initialize a new node,
+// allocated from `slab` if one is provided.
+static so_node_t* so_new_node(
+    slab_t*  slab, 
+    uint32_t so_key, 
+    void*    key, 
+    void*    value)
+{
+    so_node_t* node = (NULL == slab) 
+        ? malloc(sizeof(so_node_t)) 
+        : slab_alloc(slab);
+    if (NULL == node)
+    {
+        return NULL;
+    }
+
+    node->next   = NULL;
+    node->so_key = so_key;
+    node->key    = key;
+    node->value  = value;
+    node->slab   = slab;
+
+    node->next_retired = NULL;
+
+    return node;
+}
+
+// Destroy (deallocate) a node.
+static void so_destroy_node(void* node)
+{
+    if (NULL == node)
+    {
+        return;
+    }
+
+    slab_t* slab = ((so_node_t*)node)->slab;
+    if (NULL == slab)
+    {
+        free(node);
+    }
+    else
+    {
+        slab_free(slab, node);
+    }
+}
+
+// Destroy a batch of unlinked nodes.
+static void so_destroy_batch(void* batch)
+{
+    so_node_t* node = (so_node_t*)batch;
+    while (node != NULL)
+    {
+        so_node_t* next = node->next_retired;
+        so_destroy_node(node);
+        node = next;
+    }
+}
+
+// Reclamation is epoch-based. Each operation is counted in the slot
+// of its thread, under the parity of the epoch in which it began, and
+// a node unlinked in epoch `e` is pushed onto the stack of that epoch.
+// The epoch advances from `e` to `e + 1` once no operation that began
+// in epoch `e - 1` remains; the nodes unlinked in epoch `e - 1` are
+// then destroyed, as every operation that could have reached them
+// began in epoch `e - 1` or earlier. Neither operations nor the
+// thread that advances the epoch ever wait on one another.
+
+// Begin an operation, counting it in the slot of the calling thread.
+//
+// Returns:
+//  the count to which the operation was added, for so_leave()
+static size_t* so_enter(hashmap_t* map)
+{
+    reader_slot_t* slot = &map->readers[get_reader_slot()];
+    for (;;)
+    {
+        const size_t epoch  = __atomic_load_n(&map->epoch, __ATOMIC_SEQ_CST);
+        size_t*      active = &slot->active[epoch & 1];
+
+        __atomic_add_fetch(active, 1, __ATOMIC_SEQ_CST);
+
+        // an operation counted under the parity of an epoch that
+        // has since advanced could be missed by the advance after
+        // next, which finds the same parity; count it again
+        if (__atomic_load_n(&map->epoch, __ATOMIC_SEQ_CST) == epoch)
+        {
+            return active;
+        }
+
+        __atomic_sub_fetch(active, 1, __ATOMIC_RELEASE);
+    }
+}
+
+// Complete an operation.
+static void so_leave(size_t* active)
+{
+    __atomic_sub_fetch(active, 1, __ATOMIC_RELEASE);
+}
+
+// Get the reader slot of the calling thread; threads
+// are assigned slots in turn on their first call.
+static size_t get_reader_slot(void)
+{
+    static size_t next_slot = 0;
+    static __thread size_t slot = SIZE_MAX;
+
+    if (SIZE_MAX == slot)
+    {
+        slot = __atomic_fetch_add(&next_slot, 1, __ATOMIC_RELAXED) % N_READER_SLOTS;
+    }
+
+    return slot;
+}
+
+// Destroy an unlinked node once no operation may hold it;
+// called within an operation.
+static void so_retire_node(hashmap_t* map, so_node_t* node)
+{
+    const size_t epoch = __atomic_load_n(&map->epoch, __ATOMIC_SEQ_CST);
+
+    so_node_t** limbo = &map->limbo[epoch % N_LIMBO_EPOCHS];
+    node->next_retired = __atomic_load_n(limbo, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(
+        limbo, &node->next_retired, node, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    __atomic_add_fetch(&map->n_retired, 1, __ATOMIC_RELAXED);
+}
+
+// Attempt to advance the epoch once enough nodes have been unlinked,
+// destroying those unlinked two epochs ago; called outside of an
+// operation, and never waits for the operations of other threads.
+static void so_reclaim_nodes(hashmap_t* map)
+{
+    // a single thread claims each batch
+    size_t n_retired = __atomic_load_n(&map->n_retired, __ATOMIC_RELAXED);
+    if (n_retired < RECLAIM_BATCH_NODES
+     || !__atomic_compare_exchange_n(&map->n_retired, &n_retired, 0,
+            false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+        return;
+    }
+
+    size_t epoch = __atomic_load_n(&map->epoch, __ATOMIC_SEQ_CST);
+    for (size_t i = 0; i < N_READER_SLOTS; ++i)
+    {
+        if (__atomic_load_n(&map->readers[i].active[(epoch + 1) & 1], __ATOMIC_SEQ_CST) != 0)
+        {
+            // an operation of the previous epoch remains;
+            // the next batch attempts the advance again
+            return;
+        }
+    }
+
+    if (!__atomic_compare_exchange_n(&map->epoch, &epoch, epoch + 1,
+            false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+    {
+        return;
+    }
+
+    // the stack of epoch `epoch - 1`, that of `epoch + 2`, is complete,
+    // as each node is pushed within the operation that unlinks it
+    so_node_t* batch = __atomic_exchange_n(
+        &map->limbo[(epoch + 2) % N_LIMBO_EPOCHS], NULL, __ATOMIC_ACQUIRE);
+    so_destroy_batch(batch);
+}
+
+// Compute the split-order key of an item.
+static uint32_t so_item_key(hash_t hash)
+{
+    return reverse_bits(hash | 0x80000000u);
+}
+
+// Compute the split-order key of the bucket at `index`.
+static uint32_t so_bucket_key(size_t index)
+{
+    return reverse_bits((uint32_t)index);
+}
+
+static uint32_t reverse_bits(uint32_t n)
+{
+    n = ((n >> 1) & 0x55555555u) | ((n & 0x55555555u) << 1);
+    n = ((n >> 2) & 0x33333333u) | ((n & 0x33333333u) << 2);
+    n = ((n >> 4) & 0x0F0F0F0Fu) | ((n & 0x0F0F0F0Fu) << 4);
+    return __builtin_bswap32(n);
+}
+
+// ----------------------------------------------------------------------------
+// Internal: Linear Growth
+
+// Construct the first segment of buckets.
+static bool initialize_linear(hashmap_t* map)
+{
+    map->bucket_segments[0] = new_buckets(map, INITIAL_N_BUCKETS);
+    if (NULL == map->bucket_segments[0])
+    {
+        return false;
+    }
+
+    pthread_mutex_init(&map->split_lock, NULL);
+
+    return true;
+}
+
+// Destroy every segment of buckets; no operation may be in progress.
+static void destroy_linear(hashmap_t* map)
+{
+    // only the buckets below the count have been initialized
+    size_t remaining = map->n_buckets;
+    size_t size      = INITIAL_N_BUCKETS;
+    for (size_t i = 0; i < MAX_SEGMENTS && map->bucket_segments[i] != NULL; ++i)
+    {
+        bucket_t* buckets = map->bucket_segments[i];
+        for (size_t j = 0; j < size && j < remaining; ++j)
+        {
+            bucket_t* bucket = get_bucket(map, buckets, j);
+            flush_bucket(map, bucket);
+            deinitialize_bucket(map, bucket);
+        }
+
+        free(buckets);
+
+        remaining = (remaining > size) ? remaining - size : 0;
+        size      = INITIAL_N_BUCKETS << i;
+    }
+
+    pthread_mutex_destroy(&map->split_lock);
+}
+
+// Split the next bucket in order into itself and a new bucket,
+// moving the items of the bucket that hash to the new one. Splits
+// are serialized, and an insert that finds another in progress
+// leaves the split to it rather than waiting.
+static void split_bucket(hashmap_t* map)
+{
+    if (pthread_mutex_trylock(&map->split_lock) != 0)
+    {
+        return;
+    }
+
+    const size_t n_buckets = atomic_load(&map->n_buckets);
+    if (!need_resize(atomic_load(&map->n_items), n_buckets, map->load_factor))
+    {
+        // another insert completed the split
+        pthread_mutex_unlock(&map->split_lock);
+        return;
+    }
+
+    // the new bucket begins a segment once the number of
+    // buckets reaches a power of two; the memory of the segment
+    // is left to the kernel to zero on first touch, and each
+    // bucket is initialized by the split that first uses it,
+    // such that no split pays for more than one bucket
+    size_t offset;
+    size_t size;
+    const size_t segment = locate_segment(n_buckets, &offset, &size);
+    if (segment >= MAX_SEGMENTS)
+    {
+        pthread_mutex_unlock(&map->split_lock);
+        return;
+    }
+
+    if (0 == offset)
+    {
+        bucket_t* buckets = calloc(size, map->bucket_size);
+        if (NULL == buckets)
+        {
+            pthread_mutex_unlock(&map->split_lock);
+            return;
+        }
+
+        __atomic_store_n(&map->bucket_segments[segment], buckets, __ATOMIC_RELEASE);
+    }
+
+    // the buckets [0, n) are split in order, with those
+    // below the split pointer already split in two
+    size_t round_size = INITIAL_N_BUCKETS;
+    while (round_size << 1 <= n_buckets)
+    {
+        round_size <<= 1;
+    }
+
+    bucket_t* source = get_linear_bucket(map, n_buckets - round_size);
+    bucket_t* target = get_linear_bucket(map, n_buckets);
+
+    // no operation locates the new bucket until it is published
+    initialize_bucket(map, target);
+
+    // under striped locking the two buckets may share a lock
+    bucket_lock_t* source_lock = get_bucket_lock(map, source, n_buckets - round_size);
+    bucket_lock_t* target_lock = get_bucket_lock(map, target, n_buckets);
+
+    lock_bucket_write(source_lock);
+    if (target_lock != source_lock)
+    {
+        lock_bucket_write(target_lock);
+    }
+
+    list_entry_t items;
+    list_init(&items);
+
+    bucket_item_t* item;
+    while ((item = (bucket_item_t*) list_pop_front(&source->head)) != NULL)
+    {
+        list_push_front(&items, &item->entry);
+    }
+
+    clear_index(source);
+
+    while ((item = (bucket_item_t*) list_pop_front(&items)) != NULL)
+    {
+        const size_t index = linear_index(item->hash, n_buckets + 1);
+        insert_into_bucket((index == n_buckets) ? target : source, item);
+    }
+
+    // operations that located the source bucket
+    // before the split locate their bucket again
+    __atomic_store_n(&map->n_buckets, n_buckets + 1, __ATOMIC_RELEASE);
+
+    if (target_lock != source_lock)
+    {
+        unlock_bucket(target_lock);
+    }
+    unlock_bucket(source_lock);
+
+    pthread_mutex_unlock(&map->split_lock);
+}
+
+// Get the bucket at `index` under linear growth.
+static bucket_t* get_linear_bucket(hashmap_t* map, size_t index)
+{
+    size_t offset;
+    size_t size;
+    const size_t segment = locate_segment(index, &offset, &size);
+
+    bucket_t* buckets = __atomic_load_n(&map->bucket_segments[segment], __ATOMIC_ACQUIRE);
+    return get_bucket(map, buckets, offset);
+}
+
+// Compute the bucket index for `hash` under linear growth: that
+// of the round of splits in progress, unless the bucket has
+// already been split, in which case that of the next round.
+static size_t linear_index(const hash_t hash, const size_t n_buckets)
+{
+    size_t round_size = INITIAL_N_BUCKETS;
+    while (round_size << 1 <= n_buckets)
+    {
+        round_size <<= 1;
+    }
+
+    const size_t index = hash & ((round_size << 1) - 1);
+    return (index < n_buckets) ? index : (hash & (round_size - 1));
+}
+
+// ----------------------------------------------------------------------------
+// Internal: Atomic Wrappers
+
+static inline size_t atomic_increment(size_t* n)
+{
+    return __atomic_add_fetch(n, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline size_t atomic_decrement(size_t* n)
+{
+    return __atomic_sub_fetch(n, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline size_t atomic_load(size_t* n)
+{
+    return __atomic_load_n(n, __ATOMIC_ACQUIRE);
+}
+
+static inline void atomic_store(size_t* ptr, size_t* n)
+{
+    __atomic_store_n(ptr, n, __ATOMIC_RELEASE);
+}
+
+// ----------------------------------------------------------------------------
+// Internal: General Utility 
+
+// Compute the hash for `key`.
+static hash_t hash_key(
+    void*    key, 
+    keylen_f keylen, 
+    bool     key_is_literal)
+{
+    unsigned char buffer[sizeof(hash_t)];
+    void* to_hash = key_is_literal ? &key : key;
+
+    MurmurHash3_x86_32(to_hash, keylen(key), 0, buffer);
+
+    return (*(hash_t*)buffer);
+}
+
+// Compute the bucket index for `hash`.
+static size_t bucket_index(
+    const hash_t hash, 
+    const size_t n_buckets)
+{
+    return hash & (n_buckets - 1);
+}
+
+// Locate the segment that holds the bucket at `index`, and
+// the offset of the bucket and the size of the segment.
+static size_t locate_segment(
+    const size_t index, 
+    size_t*      offset, 
+    size_t*      size)
+{
+    size_t segment = 0;
+
+    *offset = index;
+    *size   = INITIAL_N_BUCKETS;
+    while (*offset >= *size)
+    {
+        *offset -= *size;
+        *size    = INITIAL_N_BUCKETS << segment;
+        segment++;
+    }
+
+    return segment;
 }
 
 // Determine if a map resize is required.
@@ -32,6 +32,13 @@ hashmap_attr_t* hashmap_attr_new(void)
     attr->key_deleter   = NULL;
     attr->value_deleter = NULL;
 
+    attr->allocator = HASHMAP_ALLOCATOR_MALLOC;
+    attr->engine    = HASHMAP_ENGINE_LOCKED;
+    attr->growth    = HASHMAP_GROWTH_DOUBLING;
+    attr->locking   = HASHMAP_LOCKING_BUCKET;
+
+    attr->lock_stripes = 0;
+
     return attr;
 }
 
@@ -52,6 +59,13 @@ hashmap_attr_t* hashmap_attr_default(void)
     attr->key_deleter   = hashmap_attr_default_key_deleter;
     attr->value_deleter = hashmap_attr_default_value_deleter;
 
+    attr->allocator = HASHMAP_ALLOCATOR_MALLOC;
+    attr->engine    = HASHMAP_ENGINE_LOCKED;
+    attr->growth    = HASHMAP_GROWTH_DOUBLING;
+    attr->locking   = HASHMAP_LOCKING_BUCKET;
+
+    attr->lock_stripes = 0;
+
     return attr;
 }
 
@@ -28,14 +28,85 @@ typedef void (*key_deleter_f)(void*);
 // the values that are stored in the map.
 typedef void (*value_deleter_f)(void*);
 
+// The allocator for the items that store each key / value
+// association in the map.
+typedef enum hashmap_allocator
+{
+    // Each item is allocated with malloc() on insert
+    // and released with free() on remove.
+    HASHMAP_ALLOCATOR_MALLOC,
+
+    // Items are carved from large chunks owned by the map
+    // and recycled through per-thread caches, so inserts
+    // and removes do not contend on the locks of malloc();
+    // the memory of removed items is retained by the map
+    // until it is deleted.
+    HASHMAP_ALLOCATOR_SLAB
+} hashmap_allocator_t;
+
+// The engine that implements the operations of the map.
+typedef enum hashmap_engine
+{
+    // An array of buckets, each a linked-list protected by a
+    // reader-writer lock, under a map-wide lock that resize
+    // acquires exclusively.
+    HASHMAP_ENGINE_LOCKED,
+
+    // A single lock-free linked-list of all items in split
+    // order (Shalev and Shavit), into which buckets are
+    // shortcuts that are initialized on first use; the map
+    // grows without moving items and without pauses. Removed
+    // items are reclaimed once no operation may hold them, by
+    // epochs that operations enter and leave without locking.
+    HASHMAP_ENGINE_SPLIT_ORDERED
+} hashmap_engine_t;
+
+// The growth of the array of buckets of the locked engine;
+// the split-ordered engine always grows one bucket at a time.
+typedef enum hashmap_growth
+{
+    // The array doubles once the load factor is exceeded, and
+    // every item is rehashed into the new array while all other
+    // operations on the map wait.
+    HASHMAP_GROWTH_DOUBLING,
+
+    // Linear hashing: once the load factor is exceeded, an insert
+    // splits a single bucket, in order, into itself and one new
+    // bucket, such that no operation moves the items of more than
+    // one bucket. As each insert splits at most one bucket, the
+    // load of the map may exceed a load factor below 1.
+    HASHMAP_GROWTH_LINEAR
+} hashmap_growth_t;
+
+// The granularity of the bucket locks of the locked engine.
+typedef enum hashmap_locking
+{
+    // Each bucket embeds a reader-writer lock of its own.
+    HASHMAP_LOCKING_BUCKET,
+
+    // Buckets are bare list heads, protected by a fixed array of
+    // `lock_stripes` locks, each padded to a cache line; bucket i
+    // is protected by stripe i modulo the number of stripes. The
+    // array of buckets is several times denser, and growth does
+    // not initialize or destroy any locks. A count of 0 selects
+    // four stripes per online processor, and any count is
+    // rounded up to a power of two.
+    HASHMAP_LOCKING_STRIPED
+} hashmap_locking_t;
+
 typedef struct hashmap_attr
 {
-    float           load_factor;
-    bool            key_is_literal;
-    comparator_f    comparator;
-    keylen_f        keylen;
-    key_deleter_f   key_deleter;
-    value_deleter_f value_deleter;
+    float               load_factor;
+    bool                key_is_literal;
+    comparator_f        comparator;
+    keylen_f            keylen;
+    key_deleter_f       key_deleter;
+    value_deleter_f     value_deleter;
+    hashmap_allocator_t allocator;
+    hashmap_engine_t    engine;
+    hashmap_growth_t    growth;
+    hashmap_locking_t   locking;
+    size_t              lock_stripes;
 } hashmap_attr_t;
 
 // hashmap_attr_new()
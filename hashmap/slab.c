@@ -0,0 +1,529 @@
+// slab.c
+// A concurrent, fixed-size object allocator.
+
+#include "slab.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdalign.h>
+#include <pthread.h>
+
+// The size of each chunk obtained from malloc().
+#define SLAB_CHUNK_SIZE (64 * 1024)
+
+// The alignment of every object handed out by the allocator.
+#define SLAB_ALIGNMENT alignof(max_align_t)
+
+// The number of free objects moved between a thread cache and
+// the shared pool at once; a cache that accumulates twice this
+// many free objects returns a batch of them to the pool.
+#define SLAB_BATCH 64
+
+// A free object; the batch members are valid only for the
+// first object of each batch in the shared pool.
+typedef struct slab_node
+{
+    // The next free object in the cache or batch.
+    struct slab_node* next;
+
+    // The next batch in the shared pool.
+    struct slab_node* next_batch;
+
+    // The last object in the batch.
+    struct slab_node* tail;
+
+    // The number of objects in the batch.
+    size_t count;
+} slab_node_t;
+
+// Each chunk begins with a header that links it into the
+// list of all chunks; objects follow the header.
+typedef struct slab_chunk
+{
+    struct slab_chunk* next;
+} slab_chunk_t;
+
+// The free objects cached by a single thread.
+typedef struct slab_cache
+{
+    // The next cache in the registry of all caches of the allocator.
+    struct slab_cache* next;
+
+    // The next cache owned by the same thread.
+    struct slab_cache* next_owned;
+
+    // The allocator to which the cache belongs, or NULL once the
+    // allocator is deleted while a live thread owns the cache; the
+    // owner then frees the cache.
+    slab_t* slab;
+
+    // Set while a live thread owns the cache.
+    bool owned;
+
+    // The free objects in the cache.
+    slab_node_t* free;
+    size_t       n_free;
+} slab_cache_t;
+
+// The caches owned by a single thread, one per allocator it has used.
+typedef struct slab_thread
+{
+    slab_cache_t* caches;
+
+    // The cache most recently used by the thread.
+    slab_cache_t* last;
+} slab_thread_t;
+
+struct slab
+{
+    // The size of each object, rounded up to the alignment.
+    size_t object_size;
+
+    // The number of objects carved from each chunk.
+    size_t objects_per_chunk;
+
+    // The list of all chunks, released when the allocator is.
+    slab_chunk_t* chunks;
+
+    // The registry of all caches; the cache of an exited
+    // thread is adopted by the next thread that needs one.
+    slab_cache_t* caches;
+
+    // The shared pool, a stack of batches of free objects.
+    slab_node_t* pool;
+};
+
+static slab_cache_t* get_cache(slab_t* slab);
+static slab_cache_t* adopt_cache(slab_t* slab);
+static slab_thread_t* get_thread(bool create);
+static void release_thread(void* arg);
+static void create_key(void);
+
+static bool refill_cache(slab_t* slab, slab_cache_t* cache);
+static bool carve_chunk(slab_t* slab, slab_cache_t* cache);
+static void flush_batch(slab_t* slab, slab_cache_t* cache, size_t count);
+static void push_batch(slab_t* slab, slab_node_t* batch);
+
+static size_t round_up(size_t n, size_t multiple);
+
+// A single key is shared by all allocators, as the number of keys
+// in a process is limited; its value is the slab_thread_t of the
+// calling thread.
+static pthread_key_t  thread_key;
+static pthread_once_t thread_key_once = PTHREAD_ONCE_INIT;
+static bool           thread_key_created = false;
+
+// Serializes the release of the caches of an exiting thread
+// with the deletion of the allocators to which they belong.
+static pthread_mutex_t release_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// ----------------------------------------------------------------------------
+// Exported
+
+slab_t* slab_new(size_t object_size)
+{
+    if (0 == object_size)
+    {
+        return NULL;
+    }
+
+    if (object_size < sizeof(slab_node_t))
+    {
+        object_size = sizeof(slab_node_t);
+    }
+
+    object_size = round_up(object_size, SLAB_ALIGNMENT);
+
+    const size_t header_size = round_up(sizeof(slab_chunk_t), SLAB_ALIGNMENT);
+    if (object_size > SLAB_CHUNK_SIZE - header_size)
+    {
+        return NULL;
+    }
+
+    pthread_once(&thread_key_once, create_key);
+    if (!thread_key_created)
+    {
+        return NULL;
+    }
+
+    slab_t* slab = malloc(sizeof(slab_t));
+    if (NULL == slab)
+    {
+        return NULL;
+    }
+
+    slab->object_size       = object_size;
+    slab->objects_per_chunk = (SLAB_CHUNK_SIZE - header_size) / object_size;
+    slab->chunks            = NULL;
+    slab->caches            = NULL;
+    slab->pool              = NULL;
+
+    return slab;
+}
+
+void slab_delete(slab_t* slab)
+{
+    if (NULL == slab)
+    {
+        return;
+    }
+
+    // the cache of the calling thread, if any, is freed below
+    slab_thread_t* thread = get_thread(false);
+    if (thread != NULL)
+    {
+        slab_cache_t** link = &thread->caches;
+        while (*link != NULL)
+        {
+            slab_cache_t* cache = *link;
+            if (cache->slab == slab)
+            {
+                *link = cache->next_owned;
+                cache->owned = false;
+                break;
+            }
+
+            link = &cache->next_owned;
+        }
+
+        thread->last = NULL;
+    }
+
+    // the caches of other live threads are left to them to free
+    pthread_mutex_lock(&release_lock);
+
+    slab_cache_t* cache = slab->caches;
+    while (cache != NULL)
+    {
+        slab_cache_t* next = cache->next;
+        if (__atomic_load_n(&cache->owned, __ATOMIC_ACQUIRE))
+        {
+            __atomic_store_n(&cache->slab, NULL, __ATOMIC_RELEASE);
+        }
+        else
+        {
+            free(cache);
+        }
+
+        cache = next;
+    }
+
+    pthread_mutex_unlock(&release_lock);
+
+    slab_chunk_t* chunk = slab->chunks;
+    while (chunk != NULL)
+    {
+        slab_chunk_t* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    free(slab);
+}
+
+void* slab_alloc(slab_t* slab)
+{
+    slab_cache_t* cache = get_cache(slab);
+    if (NULL == cache)
+    {
+        return NULL;
+    }
+
+    if (NULL == cache->free && !refill_cache(slab, cache))
+    {
+        return NULL;
+    }
+
+    slab_node_t* node = cache->free;
+    cache->free = node->next;
+    cache->n_free--;
+
+    return node;
+}
+
+void slab_free(slab_t* slab, void* object)
+{
+    if (NULL == object)
+    {
+        return;
+    }
+
+    slab_node_t* node = (slab_node_t*)object;
+
+    slab_cache_t* cache = get_cache(slab);
+    if (NULL == cache)
+    {
+        // without a cache, return the object to the pool alone
+        node->next  = NULL;
+        node->tail  = node;
+        node->count = 1;
+        push_batch(slab, node);
+        return;
+    }
+
+    node->next  = cache->free;
+    cache->free = node;
+    cache->n_free++;
+
+    if (cache->n_free >= 2*SLAB_BATCH)
+    {
+        flush_batch(slab, cache, SLAB_BATCH);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Internal: Thread Caches
+
+// Get the cache of the calling thread for `slab`, adopting
+// or constructing one on its first call.
+static slab_cache_t* get_cache(slab_t* slab)
+{
+    slab_thread_t* thread = get_thread(true);
+    if (NULL == thread)
+    {
+        return NULL;
+    }
+
+    slab_cache_t* cache = thread->last;
+    if (cache != NULL && __atomic_load_n(&cache->slab, __ATOMIC_ACQUIRE) == slab)
+    {
+        return cache;
+    }
+
+    // search the caches of the thread, freeing along the
+    // way those whose allocators have been deleted
+    slab_cache_t** link = &thread->caches;
+    while ((cache = *link) != NULL)
+    {
+        slab_t* owner = __atomic_load_n(&cache->slab, __ATOMIC_ACQUIRE);
+        if (owner == slab)
+        {
+            thread->last = cache;
+            return cache;
+        }
+
+        if (NULL == owner)
+        {
+            if (thread->last == cache)
+            {
+                thread->last = NULL;
+            }
+
+            *link = cache->next_owned;
+            free(cache);
+            continue;
+        }
+
+        link = &cache->next_owned;
+    }
+
+    cache = adopt_cache(slab);
+    if (NULL == cache)
+    {
+        return NULL;
+    }
+
+    cache->next_owned = thread->caches;
+    thread->caches    = cache;
+    thread->last      = cache;
+
+    return cache;
+}
+
+// Adopt the cache of a thread that has exited, if any,
+// or construct a new cache for `slab`.
+static slab_cache_t* adopt_cache(slab_t* slab)
+{
+    slab_cache_t* cache;
+    for (cache = __atomic_load_n(&slab->caches, __ATOMIC_ACQUIRE);
+         cache != NULL;
+         cache = cache->next)
+    {
+        bool expected = false;
+        if (__atomic_compare_exchange_n(
+            &cache->owned, &expected, true, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        {
+            return cache;
+        }
+    }
+
+    cache = malloc(sizeof(slab_cache_t));
+    if (NULL == cache)
+    {
+        return NULL;
+    }
+
+    cache->slab   = slab;
+    cache->owned  = true;
+    cache->free   = NULL;
+    cache->n_free = 0;
+
+    cache->next = __atomic_load_n(&slab->caches, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(
+        &slab->caches, &cache->next, cache, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    return cache;
+}
+
+// Get the caches of the calling thread, constructing
+// them on its first call if `create` is set.
+static slab_thread_t* get_thread(bool create)
+{
+    slab_thread_t* thread = pthread_getspecific(thread_key);
+    if (thread != NULL || !create)
+    {
+        return thread;
+    }
+
+    thread = malloc(sizeof(slab_thread_t));
+    if (NULL == thread)
+    {
+        return NULL;
+    }
+
+    thread->caches = NULL;
+    thread->last   = NULL;
+
+    if (pthread_setspecific(thread_key, thread) != 0)
+    {
+        free(thread);
+        return NULL;
+    }
+
+    return thread;
+}
+
+// Return the objects in the caches of an exiting thread to
+// their pools and relinquish the caches for adoption, or free
+// those whose allocators have been deleted.
+static void release_thread(void* arg)
+{
+    slab_thread_t* thread = (slab_thread_t*)arg;
+
+    pthread_mutex_lock(&release_lock);
+
+    slab_cache_t* cache = thread->caches;
+    while (cache != NULL)
+    {
+        slab_cache_t* next = cache->next_owned;
+
+        slab_t* owner = __atomic_load_n(&cache->slab, __ATOMIC_ACQUIRE);
+        if (NULL == owner)
+        {
+            free(cache);
+        }
+        else
+        {
+            if (cache->n_free > 0)
+            {
+                flush_batch(owner, cache, cache->n_free);
+            }
+
+            __atomic_store_n(&cache->owned, false, __ATOMIC_RELEASE);
+        }
+
+        cache = next;
+    }
+
+    pthread_mutex_unlock(&release_lock);
+
+    free(thread);
+}
+
+static void create_key(void)
+{
+    thread_key_created = (0 == pthread_key_create(&thread_key, release_thread));
+}
+
+// ----------------------------------------------------------------------------
+// Internal: Shared Pool
+
+// Refill an empty cache from the pool or, if the pool
+// is empty, from a new chunk.
+static bool refill_cache(slab_t* slab, slab_cache_t* cache)
+{
+    // take every batch at once; unlike popping a single
+    // batch, this cannot be confused by a batch that is
+    // popped and pushed again while we read its link
+    slab_node_t* batch = __atomic_exchange_n(&slab->pool, NULL, __ATOMIC_ACQUIRE);
+    if (NULL == batch)
+    {
+        return carve_chunk(slab, cache);
+    }
+
+    while (batch != NULL)
+    {
+        slab_node_t* next = batch->next_batch;
+
+        batch->tail->next = cache->free;
+        cache->free       = batch;
+        cache->n_free    += batch->count;
+
+        batch = next;
+    }
+
+    return true;
+}
+
+// Allocate a new chunk and carve it into objects in the cache.
+static bool carve_chunk(slab_t* slab, slab_cache_t* cache)
+{
+    slab_chunk_t* chunk = malloc(SLAB_CHUNK_SIZE);
+    if (NULL == chunk)
+    {
+        return false;
+    }
+
+    chunk->next = __atomic_load_n(&slab->chunks, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(
+        &slab->chunks, &chunk->next, chunk, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    char* objects = (char*)chunk + round_up(sizeof(slab_chunk_t), SLAB_ALIGNMENT);
+    for (size_t i = slab->objects_per_chunk; i > 0; --i)
+    {
+        slab_node_t* node = (slab_node_t*)(objects + (i - 1)*slab->object_size);
+        node->next  = cache->free;
+        cache->free = node;
+    }
+
+    cache->n_free += slab->objects_per_chunk;
+
+    return true;
+}
+
+// Move `count` objects from the front of the cache to the pool.
+static void flush_batch(slab_t* slab, slab_cache_t* cache, size_t count)
+{
+    slab_node_t* head = cache->free;
+    slab_node_t* tail = head;
+    for (size_t i = 1; i < count; ++i)
+    {
+        tail = tail->next;
+    }
+
+    cache->free    = tail->next;
+    cache->n_free -= count;
+
+    tail->next  = NULL;
+    head->tail  = tail;
+    head->count = count;
+
+    push_batch(slab, head);
+}
+
+// Push a batch of free objects onto the pool.
+static void push_batch(slab_t* slab, slab_node_t* batch)
+{
+    batch->next_batch = __atomic_load_n(&slab->pool, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(
+        &slab->pool, &batch->next_batch, batch, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+// ----------------------------------------------------------------------------
+// Internal: General Utility
+
+static size_t round_up(size_t n, size_t multiple)
+{
+    return (n + multiple - 1) / multiple * multiple;
+}
@@ -0,0 +1,55 @@
+// slab.h
+// A concurrent, fixed-size object allocator.
+//
+// Objects are carved from large chunks obtained from malloc(),
+// and freed objects are recycled rather than returned to it.
+// Each thread allocates from and frees to its own cache, so
+// the common case takes no lock and touches no shared memory;
+// caches exchange objects through a lock-free pool in batches.
+// The caches of each thread are found through a single key
+// shared by all allocators, so any number may exist at once.
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+// The slab allocator type.
+typedef struct slab slab_t;
+
+// slab_new()
+//
+// Construct a new allocator for objects of `object_size` bytes.
+//
+// Returns:
+//  pointer to newly initialized allocator
+//  NULL on failure
+slab_t* slab_new(size_t object_size);
+
+// slab_delete()
+//
+// Destroy an existing allocator, releasing all of the
+// memory for the objects allocated from it, whether or
+// not they have been freed.
+//
+// No thread may use the allocator concurrently with,
+// or after, this call. The caches held by other live
+// threads are freed by those threads.
+void slab_delete(slab_t* slab);
+
+// slab_alloc()
+//
+// Allocate an object from the allocator.
+//
+// Returns:
+//  pointer to an uninitialized object
+//  NULL on failure
+void* slab_alloc(slab_t* slab);
+
+// slab_free()
+//
+// Return an object to the allocator; the object may be
+// freed by a thread other than the one that allocated it.
+void slab_free(slab_t* slab, void* object);
+
+#endif // SLAB_H
@@ -4,11 +4,11 @@
 #define _GNU_SOURCE
 
 #include "gc.h"
-#include "priority_queue.h"
 #include "intrusive_list.h"
 #include "../sync/event.h"
 
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <pthread.h>
 
@@ -21,6 +21,14 @@ typedef struct list_head
     pthread_rwlock_t lock;
 } list_head_t;
 
+// A generation reference count tracker.
+typedef struct ref_count
+{
+    list_entry_t entry;
+    size_t       generation;
+    size_t       count;
+} ref_count_t;
+
 struct gc
 {
     // The current global generation.
@@ -30,24 +38,31 @@ struct gc
 
     // The head of the intrusive list of reference counts.
     list_head_t ref_counts;
-    // Priority queue of deferred functions.
-    queue_t* deferred;
+
+    // The reference count for the generation that follows the
+    // current one, allocated in advance such that a generation
+    // is ended without allocating; NULL only if that allocation
+    // failed. Protected by the lock of `ref_counts`.
+    ref_count_t* next_rc;
+
+    // The list of deferred functions, in the order in which they
+    // were deferred; generations are nondecreasing along the list
+    // up to races between concurrent deferrals, which can only
+    // delay the collection of an entry.
+    list_entry_t    deferred;
+    pthread_mutex_t deferred_lock;
+
+    // Serializes collection, which advances `last_gc_gen`.
+    pthread_mutex_t collect_lock;
 
     // The event used to wake writers on generation end.
     event_t generation_complete;
 };
 
-// A generation reference count tracker.
-typedef struct ref_count
-{
-    list_entry_t entry;
-    size_t       generation;
-    size_t       count;
-} ref_count_t;
-
 // A single entry in the list of deferred functions.
 typedef struct deferred
 {
+    list_entry_t entry;
     deleter_f    deleter;    // the deferred function 
     void*        object;     // the object to be destroyed
     size_t       generation; // the generation in which garbage was created
@@ -70,11 +85,10 @@ static void unlock_list(list_head_t* list);
 
 static bool find_rc_by_generation(list_entry_t* entry, void* ctx);
 
-static bool prioritize_by_generation(void* d1, void* d2);
-static bool generation_is(void* deferred, void* ctx);
+static bool retire_generation(gc_t* gc, size_t generation);
+static void run_deferred_through(gc_t* gc, size_t generation);
 
 static size_t atomic_load_n(size_t* n);
-static size_t atomic_increment(size_t* n);
 static size_t atomic_decrement(size_t* n);
 
 // ----------------------------------------------------------------------------
@@ -88,14 +102,6 @@ gc_t* gc_new(void)
         return NULL;
     }
 
-    initialize_list_head(&gc->ref_counts);
-    event_init(&gc->generation_complete);
-
-    gc->deferred = queue_new(prioritize_by_generation);
-
-    gc->current_generation = 0;
-    gc->last_gc_gen        = 0;
-
     // initialize the gc with the first generation
     ref_count_t* rc = make_ref_count(0);
     if (NULL == rc)
@@ -104,6 +110,24 @@ gc_t* gc_new(void)
         return NULL;
     }
 
+    gc->next_rc = make_ref_count(1);
+    if (NULL == gc->next_rc)
+    {
+        destroy_ref_count(rc);
+        free(gc);
+        return NULL;
+    }
+
+    initialize_list_head(&gc->ref_counts);
+    event_init(&gc->generation_complete);
+
+    list_init(&gc->deferred);
+    pthread_mutex_init(&gc->deferred_lock, NULL);
+    pthread_mutex_init(&gc->collect_lock, NULL);
+
+    gc->current_generation = 0;
+    gc->last_gc_gen        = 0;
+
     list_push_back(&gc->ref_counts.head, &rc->entry);
 
     return gc;
@@ -116,7 +140,23 @@ void gc_delete(gc_t* gc)
         return;
     }
 
-    queue_delete(gc->deferred);
+    // no readers remain; run every outstanding deferred function
+    run_deferred_through(gc, SIZE_MAX);
+
+    list_entry_t* entry;
+    while ((entry = list_pop_front(&gc->ref_counts.head)) != NULL)
+    {
+        destroy_ref_count((ref_count_t*)entry);
+    }
+
+    if (gc->next_rc != NULL)
+    {
+        destroy_ref_count(gc->next_rc);
+    }
+
+    pthread_rwlock_destroy(&gc->ref_counts.lock);
+    pthread_mutex_destroy(&gc->deferred_lock);
+    pthread_mutex_destroy(&gc->collect_lock);
     event_destroy(&gc->generation_complete);
     free(gc);
 }
@@ -127,23 +167,53 @@ size_t gc_get_generation(gc_t* gc)
         &gc->current_generation, __ATOMIC_ACQUIRE);
 }
 
-size_t gc_inc_generation(gc_t* gc)
+bool gc_inc_generation(gc_t* gc, size_t* previous)
 {
-    return __atomic_fetch_add(
-        &gc->current_generation, 1, __ATOMIC_RELEASE);
+    lock_list_write(&gc->ref_counts);
+
+    const size_t generation = gc->current_generation;
+
+    // the reference count for the new generation must be
+    // in place before any reader is able to observe it; it
+    // is allocated here only if the allocation in advance failed
+    ref_count_t* rc = (gc->next_rc != NULL) ? gc->next_rc : make_ref_count(0);
+    if (NULL == rc)
+    {
+        unlock_list(&gc->ref_counts);
+        return false;
+    }
+
+    rc->generation = generation + 1;
+    rc->count      = 0;
+
+    list_push_back(&gc->ref_counts.head, &rc->entry);
+    __atomic_store_n(&gc->current_generation, generation + 1, __ATOMIC_SEQ_CST);
+
+    // a failure is retried when the next generation is installed,
+    // or made good by the count of the next retired generation
+    gc->next_rc = make_ref_count(generation + 2);
+
+    unlock_list(&gc->ref_counts);
+
+    *previous = generation;
+    return true;
 }
 
-void gc_inc_rc(gc_t* gc, size_t generation)
+bool gc_inc_rc(gc_t* gc, size_t generation)
 {
     lock_list_read(&gc->ref_counts);
 
+    // the generation may have been retired since it was read
     ref_count_t* rc = (ref_count_t*) list_find(
         &gc->ref_counts.head, find_rc_by_generation, (void*) generation);
-    assert(rc != NULL);
-
-    atomic_increment(&rc->count);
+    if (rc != NULL)
+    {
+        __atomic_add_fetch(&rc->count, 1, __ATOMIC_SEQ_CST);
+    }
 
     unlock_list(&gc->ref_counts);
+
+    return rc != NULL;
 }
 
 void gc_dec_rc(gc_t* gc, size_t generation)
@@ -154,8 +224,9 @@ void gc_dec_rc(gc_t* gc, size_t generation)
         &gc->ref_counts.head, find_rc_by_generation, (void*) generation);
     assert(rc != NULL);
 
+    // only a generation that has ended may have a waiting writer
     const size_t count = atomic_decrement(&rc->count);
-    if (0 == count)
+    if (0 == count && generation != gc_get_generation(gc))
     {
         // inform a waiting writer in rcu_synchronize()
         // that generation is available for collection
@@ -169,69 +240,74 @@ size_t gc_rc_for_generation(gc_t* gc, size_t generation)
 {
     lock_list_read(&gc->ref_counts);
 
+    // a retired generation has no outstanding references
     ref_count_t* rc = (ref_count_t*) list_find(
         &gc->ref_counts.head, find_rc_by_generation, (void*) generation);
-    assert(rc != NULL);
-
-    const size_t count = atomic_load_n(&rc->count);
+    const size_t count = (rc != NULL) ? atomic_load_n(&rc->count) : 0;
 
     unlock_list(&gc->ref_counts);
 
     return count;
 }
 
-void gc_defer_destroy(gc_t* gc, deleter_f deleter, void* object)
+bool gc_defer_destroy(gc_t* gc, deleter_f deleter, void* object)
 {
+    // the object is unreachable by the time it is deferred, such that
+    // only readers of the current or earlier generations may hold it
     deferred_t* deferred = make_deferred(deleter, object, gc_get_generation(gc));
     if (NULL == deferred)
     {
-        return;
+        return false;
     }
 
-    // add the deferred function to global queue
-    queue_push(gc->deferred, deferred);
+    pthread_mutex_lock(&gc->deferred_lock);
+    list_push_back(&gc->deferred, &deferred->entry);
+    pthread_mutex_unlock(&gc->deferred_lock);
+
+    return true;
 }
 
 void gc_collect_through_generation(gc_t* gc, size_t generation)
 {
-    while (gc->last_gc_gen < generation)
+    pthread_mutex_lock(&gc->collect_lock);
+
+    while (gc->last_gc_gen <= generation)
     {
         // wait for all outstanding references to drop
-        while (gc_rc_for_generation(gc, gc->last_gc_gen) > 0)
+        while (!retire_generation(gc, gc->last_gc_gen))
         {
             event_wait(&gc->generation_complete);
         }
 
         // the generation last_gc_gen is now complete, collect garbage
+        run_deferred_through(gc, gc->last_gc_gen);
 
-        // continue to remove garbage from global queue until the generation
-        // of the deferred function exceeds the current GC generation
-        deferred_t* deferred;
-        while ((deferred = (deferred_t*) queue_pop_if(
-            gc->deferred, generation_is, (void*)gc->last_gc_gen)) != NULL)
-        {
-            // invoke the deferred function
-            deferred->deleter(deferred->object);
-            // destroy the deferred instance
-            destroy_deferred(deferred);
-        }
-
-        // the generation is now collected and will no longer be used,
-        // safe to unlink its reference count entry from list
-        lock_list_write(&gc->ref_counts);
-
-        // find the refcount for the GCed generation
-        ref_count_t* rc = (ref_count_t*) list_find(
-            &gc->ref_counts.head, find_rc_by_generation, (void*)gc->last_gc_gen);
+        gc->last_gc_gen++;
+    }
 
-        // unlink it from the list and destroy it
-        list_remove_entry(&gc->ref_counts.head, &rc->entry);
-        destroy_ref_count(rc);
+    pthread_mutex_unlock(&gc->collect_lock);
+}
 
-        unlock_list(&gc->ref_counts);
+bool gc_try_collect_through_generation(gc_t* gc, size_t generation)
+{
+    // another writer is already collecting
+    if (pthread_mutex_trylock(&gc->collect_lock) != 0)
+    {
+        return false;
+    }
 
+    while (gc->last_gc_gen <= generation
+        && retire_generation(gc, gc->last_gc_gen))
+    {
+        run_deferred_through(gc, gc->last_gc_gen);
         gc->last_gc_gen++;
     }
+
+    const bool complete = gc->last_gc_gen > generation;
+
+    pthread_mutex_unlock(&gc->collect_lock);
+
+    return complete;
 }
 
 // ----------------------------------------------------------------------------
@@ -282,7 +358,14 @@ static void destroy_deferred(deferred_t* deferred)
 static void initialize_list_head(list_head_t* list)
 {
     list_init(&list->head);
-    pthread_rwlock_init(&list->lock, NULL);
+
+    // readers hold the lock only briefly, but continuously enough
+    // to starve the writers that advance and retire generations
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(&list->lock, &attr);
+    pthread_rwlockattr_destroy(&attr);
 }
 
 static void lock_list_read(list_head_t* list)
@@ -308,20 +391,63 @@ static bool find_rc_by_generation(list_entry_t* entry, void* ctx)
     return as_rc->generation == as_generation;
 }
 
-static bool prioritize_by_generation(void* d1, void* d2)
+// unlink the reference count for a generation once its count
+// drops to zero; readers that raced to enter the generation
+// observe it missing and enter the current generation instead
+static bool retire_generation(gc_t* gc, size_t generation)
 {
-    deferred_t* as_d1 = (deferred_t*)d1;
-    deferred_t* as_d2 = (deferred_t*)d2;
+    lock_list_write(&gc->ref_counts);
+
+    ref_count_t* rc = (ref_count_t*) list_find(
+        &gc->ref_counts.head, find_rc_by_generation, (void*) generation);
+
+    const bool retired = (NULL == rc) || 0 == atomic_load_n(&rc->count);
+    if (rc != NULL && retired)
+    {
+        list_remove_entry(&gc->ref_counts.head, &rc->entry);
+
+        // replace a count for the next generation that could not be allocated
+        if (NULL == gc->next_rc)
+        {
+            gc->next_rc = rc;
+        }
+        else
+        {
+            destroy_ref_count(rc);
+        }
+    }
+
+    unlock_list(&gc->ref_counts);
 
-    return as_d1->generation <= as_d2->generation;
+    return retired;
 }
 
-static bool generation_is(void* deferred, void* ctx)
+// invoke every deferred function of a generation at or before
+// `generation`; deferrals that raced with the collection of their
+// generation are collected along with the next generation
+static void run_deferred_through(gc_t* gc, size_t generation)
 {
-    deferred_t* as_deferred = (deferred_t*) deferred;
-    size_t as_generation    = (size_t) ctx;
+    list_entry_t collected;
+    list_init(&collected);
+
+    pthread_mutex_lock(&gc->deferred_lock);
+
+    while (gc->deferred.flink != &gc->deferred
+        && ((deferred_t*)gc->deferred.flink)->generation <= generation)
+    {
+        list_push_back(&collected, list_pop_front(&gc->deferred));
+    }
+
+    pthread_mutex_unlock(&gc->deferred_lock);
 
-    return as_deferred->generation == as_generation;
+    // deleters run outside of the lock
+    list_entry_t* entry;
+    while ((entry = list_pop_front(&collected)) != NULL)
+    {
+        deferred_t* deferred = (deferred_t*)entry;
+        deferred->deleter(deferred->object);
+        destroy_deferred(deferred);
+    }
 }
 
 static size_t atomic_load_n(size_t* n)
@@ -329,11 +455,6 @@ static size_t atomic_load_n(size_t* n)
     return __atomic_load_n(n, __ATOMIC_ACQUIRE);
 }
 
-static size_t atomic_increment(size_t* n)
-{
-    return __atomic_add_fetch(n, 1, __ATOMIC_RELEASE);
-}
-
 static size_t atomic_decrement(size_t* n)
 {
     return __atomic_sub_fetch(n, 1, __ATOMIC_RELEASE);
@@ -5,6 +5,7 @@
 #define GC_H
 
 #include <stddef.h>
+#include <stdbool.h>
 
 typedef struct gc gc_t;
 
@@ -21,10 +22,16 @@ void gc_delete(gc_t* gc);
 size_t gc_get_generation(gc_t* gc);
 
 // gc_inc_generation()
-size_t gc_inc_generation(gc_t* gc);
+// Returns `true` and the generation that ended in `previous`,
+// or `false` if the new generation could not be allocated; the
+// count of each generation is allocated when the generation
+// before it begins, so this fails only if that allocation, and
+// a retry at this call, both failed.
+bool gc_inc_generation(gc_t* gc, size_t* previous);
 
 // gc_inc_rc()
-void gc_inc_rc(gc_t* gc, size_t generation);
+// Returns `false` if `generation` has already been collected.
+bool gc_inc_rc(gc_t* gc, size_t generation);
 
 // gc_dec_rc()
 void gc_dec_rc(gc_t* gc, size_t generation);
@@ -33,9 +40,19 @@ void gc_dec_rc(gc_t* gc, size_t generation);
 size_t gc_rc_for_generation(gc_t* gc, size_t generation);
 
 // gc_defer_destroy()
-void gc_defer_destroy(gc_t* gc, deleter_f deleter, void* object);
+// Returns `false` if the deferral could not be allocated, in
+// which case `object` is not destroyed and remains the caller's.
+bool gc_defer_destroy(gc_t* gc, deleter_f deleter, void* object);
 
 // gc_collect_through_generation()
+// Blocks until every generation up to and including `generation`
+// is free of readers, and collects its garbage.
 void gc_collect_through_generation(gc_t* gc, size_t generation);
 
+// gc_try_collect_through_generation()
+// Collects the garbage of generations up to and including
+// `generation` without blocking, stopping at the first that
+// still has readers. Returns `true` if every one was collected.
+bool gc_try_collect_through_generation(gc_t* gc, size_t generation);
+
 #endif // GC_H
\ No newline at end of file
@@ -3,26 +3,26 @@
 
 #include "rcu.h"
 
+#include <sched.h>
 #include <stdlib.h>
 
-struct rcu_handle
-{
-    // The generation in which this handle resides.
-    size_t generation;
-};
-
 // ----------------------------------------------------------------------------
-// Exported: Writer Interface
+// Exported: Reader Interface
 
 rcu_handle_t rcu_enter(gc_t* gc)
 {
-    const size_t gen = gc_get_generation(gc);
+    // the generation read may end and be collected before the
+    // reference is taken, in which case the reader must retry
+    size_t gen;
+    do
+    {
+        gen = gc_get_generation(gc);
+    } while (!gc_inc_rc(gc, gen));
 
     rcu_handle_t handle = {
         .generation = gen
     };
 
-    gc_inc_rc(gc, gen);
     return handle;
 }
 
@@ -35,13 +35,45 @@ void rcu_leave(gc_t* gc, rcu_handle_t handle)
 // ----------------------------------------------------------------------------
 // Exported: Writer Interface
 
-void rcu_defer(gc_t* gc, deleter_f deleter, void* object)
+bool rcu_defer(gc_t* gc, deleter_f deleter, void* object)
 {
-    gc_defer_destroy(gc, deleter, object);
+    return gc_defer_destroy(gc, deleter, object);
 }
 
 void rcu_synchronize(gc_t* gc)
 {
-    const size_t prev_gen = gc_inc_generation(gc);
-    gc_collect_through_generation(gc, prev_gen);
-}
\ No newline at end of file
+    size_t prev_gen;
+    if (gc_inc_generation(gc, &prev_gen))
+    {
+        gc_collect_through_generation(gc, prev_gen);
+        return;
+    }
+
+    // the next generation could not be allocated, so wait out the
+    // readers of the current generation instead; its garbage is
+    // collected once a later generation ends
+    const size_t gen = gc_get_generation(gc);
+    if (gen > 0)
+    {
+        gc_collect_through_generation(gc, gen - 1);
+    }
+
+    // every reader in the generation at the time of the call has
+    // left once its count is observed to be zero; the writer is not
+    // woken for the current generation, so the count is polled
+    while (gc_rc_for_generation(gc, gen) > 0)
+    {
+        sched_yield();
+    }
+}
+
+bool rcu_try_synchronize(gc_t* gc)
+{
+    size_t prev_gen;
+    if (!gc_inc_generation(gc, &prev_gen))
+    {
+        return false;
+    }
+
+    return gc_try_collect_through_generation(gc, prev_gen);
+}
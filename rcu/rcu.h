@@ -4,9 +4,18 @@
 #ifndef RCU_H
 #define RCU_H
 
+#include <stddef.h>
+#include <stdbool.h>
+
 #include "gc.h"
 
-typedef struct rcu_handle rcu_handle_t;
+// The handle is returned to readers by value, so its
+// definition must be visible outside of the implementation.
+typedef struct rcu_handle
+{
+    // The generation in which this handle resides.
+    size_t generation;
+} rcu_handle_t;
 
 // ----------------------------------------------------------------------------
 // Exported: Reader Interface
@@ -18,8 +27,23 @@ void rcu_leave(gc_t* gc, rcu_handle_t handle);
 // ----------------------------------------------------------------------------
 // Exported: Writer Interface
 
-void rcu_defer(gc_t* gc, deleter_f deleter, void* object);
+// rcu_defer()
+// Returns `false` if the deferral could not be allocated, in
+// which case `object` is not destroyed and remains the caller's.
+bool rcu_defer(gc_t* gc, deleter_f deleter, void* object);
 
+// rcu_synchronize()
+// Blocks until every read-side critical section that began
+// before the call has ended, and collects the garbage of the
+// generations that ended. Never returns before a grace period,
+// even if the next generation could not be allocated.
 void rcu_synchronize(gc_t* gc);
 
-#endif // RCU_H
\ No newline at end of file
+// rcu_try_synchronize()
+// Ends the current generation and collects the garbage of every
+// ended generation that is already free of readers. Never blocks,
+// and so may be called from within a read-side critical section.
+// Returns `true` if all garbage deferred before the call was collected.
+bool rcu_try_synchronize(gc_t* gc);
+
+#endif // RCU_H
@@ -21,6 +21,8 @@ bool event_init(event_t* event)
     const int mu_init = pthread_mutex_init(&event->mu, NULL);
     const int cv_init = pthread_cond_init(&event->cv, NULL);
 
+    event->n_posted = 0;
+
     return 0 == mu_init && 0 == cv_init;
 }
 
@@ -43,7 +45,16 @@ void event_wait(event_t* event)
     }
 
     pthread_mutex_lock(&event->mu);
-    pthread_cond_wait(&event->cv, &event->mu);
+
+    // a condition variable does not remember a signal sent
+    // in the absence of waiters, so the posts are counted
+    while (0 == event->n_posted)
+    {
+        pthread_cond_wait(&event->cv, &event->mu);
+    }
+
+    --event->n_posted;
+
     pthread_mutex_unlock(&event->mu);
 }
 
@@ -54,15 +65,21 @@ void event_post(event_t* event)
         return;
     }
 
+    pthread_mutex_lock(&event->mu);
+    ++event->n_posted;
     pthread_cond_signal(&event->cv);
+    pthread_mutex_unlock(&event->mu);
 }
 
-void event_broadcast(event_t* event)
+void event_broadcast(event_t* event, size_t n)
 {
     if (NULL == event)
     {
         return;
     }
 
+    pthread_mutex_lock(&event->mu);
+    event->n_posted += n;
     pthread_cond_broadcast(&event->cv);
+    pthread_mutex_unlock(&event->mu);
 }
\ No newline at end of file
@@ -5,13 +5,18 @@
 #ifndef EVENT_H
 #define EVENT_H
 
+#include <stddef.h>
 #include <pthread.h>
 #include <stdbool.h>
 
+// Each post to an event releases exactly one wait, whether
+// that wait began before or after the post; posts are counted,
+// such that a post to an event without waiters is not lost.
 typedef struct event
 {
     pthread_mutex_t mu;
     pthread_cond_t  cv;
+    size_t          n_posted;
 } event_t;
 
 bool event_init(event_t* event);
@@ -22,6 +27,7 @@ void event_wait(event_t* event);
 
 void event_post(event_t* event);
 
-void event_broadcast(event_t* event);
+// Post to the event `n` times at once.
+void event_broadcast(event_t* event, size_t n);
 
 #endif // EVENT_H
\ No newline at end of file
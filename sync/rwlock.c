@@ -87,7 +87,7 @@ void rwlock_unlock_read(rwlock_t* lock)
     {
         if (__atomic_sub_fetch(&lock->readers_departing, 1, __ATOMIC_SEQ_CST) == 0)
         {
-            event_post(&lock->reader_release);
+            event_post(&lock->writer_release);
         }
     }
 }
@@ -122,6 +122,57 @@ void rwlock_lock_write(rwlock_t* lock)
     }
 }
 
+bool rwlock_try_lock_read(rwlock_t* lock)
+{
+    if (NULL == lock)
+    {
+        return false;
+    }
+
+    // A reader may only proceed without waiting while there is no
+    // writer pending, so the increment of n_pending is only made
+    // while it is nonnegative; otherwise, the attempt fails.
+
+    int_fast32_t n = __atomic_load_n(&lock->n_pending, __ATOMIC_SEQ_CST);
+    while (n >= 0)
+    {
+        if (__atomic_compare_exchange_n(&lock->n_pending, &n, n + 1,
+            false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool rwlock_try_lock_write(rwlock_t* lock)
+{
+    if (NULL == lock)
+    {
+        return false;
+    }
+
+    // The writer must hold the embedded mutex, and there must be
+    // no active readers; both conditions are established without
+    // waiting, or the attempt fails and the mutex is released.
+
+    if (pthread_mutex_trylock(&lock->mutex) != 0)
+    {
+        return false;
+    }
+
+    int_fast32_t expected = 0;
+    if (!__atomic_compare_exchange_n(&lock->n_pending, &expected, -MAX_READERS,
+        false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+    {
+        pthread_mutex_unlock(&lock->mutex);
+        return false;
+    }
+
+    return true;
+}
+
 void rwlock_unlock_write(rwlock_t* lock)
 {
     if (NULL == lock)
@@ -133,15 +184,19 @@ void rwlock_unlock_write(rwlock_t* lock)
     // back into n_pending, informing readers that there are no more
     // writers using or pending on the lock. The remaining value in
     // n_pending (positive) is the number of readers that accumulated
-    // while the writer held the lock, but it is not necessary to utilize
-    // this information to wake all waiting readers because we have
-    // access to broadcast functionality with event_broadcast(). Finally,
-    // the writer releases the embedded mutex so that future writers may
-    // proceed and annouce their intention to begin the process anew.
+    // while the writer held the lock; each of them waits (or is about
+    // to wait) on reader_release exactly once, so the writer posts
+    // exactly that many times. Finally, the writer releases the embedded
+    // mutex so that future writers may proceed and annouce their
+    // intention to begin the process anew.
 
-    __atomic_add_fetch(&lock->n_pending, MAX_READERS, __ATOMIC_SEQ_CST);
+    const int_fast32_t r
+        = __atomic_add_fetch(&lock->n_pending, MAX_READERS, __ATOMIC_SEQ_CST);
 
-    event_broadcast(&lock->reader_release);
+    if (r > 0)
+    {
+        event_broadcast(&lock->reader_release, (size_t)r);
+    }
 
     pthread_mutex_unlock(&lock->mutex);
 }
\ No newline at end of file
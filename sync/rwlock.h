@@ -49,6 +49,18 @@ void rwlock_unlock_read(rwlock_t* lock);
 // Acquire the lock with exclusive access.
 void rwlock_lock_write(rwlock_t* lock);
 
+// rwlock_try_lock_read()
+//
+// Attempt to acquire the lock with shared access,
+// without waiting; returns `true` if acquired.
+bool rwlock_try_lock_read(rwlock_t* lock);
+
+// rwlock_try_lock_write()
+//
+// Attempt to acquire the lock with exclusive access,
+// without waiting; returns `true` if acquired.
+bool rwlock_try_lock_write(rwlock_t* lock);
+
 // rwlock_unlock_write()
 //
 // Release exclusive access to the lock.